@@ -0,0 +1,151 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "authenticationcache.h"
+
+namespace remoteproxy {
+
+AuthenticationCache::AuthenticationCache()
+{
+    m_clock.start();
+}
+
+int AuthenticationCache::timeout() const
+{
+    return m_timeout;
+}
+
+void AuthenticationCache::setTimeout(int timeout)
+{
+    m_timeout = timeout;
+}
+
+int AuthenticationCache::maximumTimeout() const
+{
+    return m_maximumTimeout;
+}
+
+void AuthenticationCache::setMaximumTimeout(int maximumTimeout)
+{
+    m_maximumTimeout = maximumTimeout;
+}
+
+int AuthenticationCache::maximumSize() const
+{
+    return m_maximumSize;
+}
+
+void AuthenticationCache::setMaximumSize(int maximumSize)
+{
+    m_maximumSize = maximumSize;
+}
+
+bool AuthenticationCache::isEnabled() const
+{
+    return m_timeout > 0 && m_maximumSize > 0;
+}
+
+bool AuthenticationCache::isBlocked(const QByteArray &tokenHash)
+{
+    QHash<QByteArray, CacheEntry>::iterator entry = m_entries.find(tokenHash);
+    if (entry == m_entries.end())
+        return false;
+
+    if (entry->expirationTime <= m_clock.elapsed()) {
+        // Keep the failure count, repeated failures extend the next period
+        return false;
+    }
+
+    m_hitCount++;
+    return true;
+}
+
+void AuthenticationCache::addFailure(const QByteArray &tokenHash)
+{
+    if (!isEnabled())
+        return;
+
+    QHash<QByteArray, CacheEntry>::iterator entry = m_entries.find(tokenHash);
+    if (entry == m_entries.end()) {
+        // Make room for the new entry, the least recently failed tokens go first
+        while (m_entries.count() >= m_maximumSize && !m_order.isEmpty()) {
+            m_entries.remove(m_order.takeFirst());
+            m_evictionCount++;
+        }
+
+        CacheEntry newEntry;
+        newEntry.position = m_order.insert(m_order.end(), tokenHash);
+        entry = m_entries.insert(tokenHash, newEntry);
+    } else {
+        m_order.erase(entry->position);
+        entry->position = m_order.insert(m_order.end(), tokenHash);
+
+        // Forget old failures once the token has been quiet for a while
+        if (m_clock.elapsed() - entry->expirationTime > m_maximumTimeout)
+            entry->failureCount = 0;
+    }
+
+    // Double the period for each failure in a row
+    entry->failureCount++;
+    qint64 timeout = m_timeout;
+    for (int i = 1; i < entry->failureCount && timeout < m_maximumTimeout; i++)
+        timeout *= 2;
+
+    entry->expirationTime = m_clock.elapsed() + qMin(timeout, static_cast<qint64>(m_maximumTimeout));
+}
+
+void AuthenticationCache::remove(const QByteArray &tokenHash)
+{
+    QHash<QByteArray, CacheEntry>::iterator entry = m_entries.find(tokenHash);
+    if (entry == m_entries.end())
+        return;
+
+    m_order.erase(entry->position);
+    m_entries.erase(entry);
+}
+
+void AuthenticationCache::clear()
+{
+    m_entries.clear();
+    m_order.clear();
+}
+
+int AuthenticationCache::count() const
+{
+    return m_entries.count();
+}
+
+QVariantMap AuthenticationCache::currentStatistics() const
+{
+    QVariantMap statisticsMap;
+    statisticsMap.insert("entries", count());
+    statisticsMap.insert("hits", m_hitCount);
+    statisticsMap.insert("evictions", m_evictionCount);
+    return statisticsMap;
+}
+
+}
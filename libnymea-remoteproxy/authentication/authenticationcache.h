@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef AUTHENTICATIONCACHE_H
+#define AUTHENTICATIONCACHE_H
+
+#include <QHash>
+#include <QByteArray>
+#include <QLinkedList>
+#include <QVariantMap>
+#include <QElapsedTimer>
+
+namespace remoteproxy {
+
+// Remembers failed authentications by token hash, so repeated attempts using
+// the same bad token can be rejected without asking the authenticator again.
+class AuthenticationCache
+{
+public:
+    AuthenticationCache();
+
+    int timeout() const;
+    void setTimeout(int timeout);
+
+    int maximumTimeout() const;
+    void setMaximumTimeout(int maximumTimeout);
+
+    int maximumSize() const;
+    void setMaximumSize(int maximumSize);
+
+    bool isEnabled() const;
+
+    bool isBlocked(const QByteArray &tokenHash);
+    void addFailure(const QByteArray &tokenHash);
+    void remove(const QByteArray &tokenHash);
+    void clear();
+
+    int count() const;
+    QVariantMap currentStatistics() const;
+
+private:
+    class CacheEntry
+    {
+    public:
+        qint64 expirationTime = 0;
+        int failureCount = 0;
+        QLinkedList<QByteArray>::iterator position;
+    };
+
+    QElapsedTimer m_clock;
+    QHash<QByteArray, CacheEntry> m_entries;
+    QLinkedList<QByteArray> m_order;
+
+    int m_timeout = 30000;
+    int m_maximumTimeout = 600000;
+    int m_maximumSize = 10000;
+
+    quint64 m_hitCount = 0;
+    quint64 m_evictionCount = 0;
+
+};
+
+}
+
+#endif // AUTHENTICATIONCACHE_H
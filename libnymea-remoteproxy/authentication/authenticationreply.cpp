@@ -44,7 +44,7 @@ AuthenticationReply::AuthenticationReply(ProxyClient *proxyClient, QObject *pare
 
 ProxyClient *AuthenticationReply::proxyClient() const
 {
-    return m_proxyClient;
+    return m_proxyClient.data();
 }
 
 bool AuthenticationReply::isTimedOut() const
@@ -69,6 +69,11 @@ void AuthenticationReply::setError(Authenticator::AuthenticationError error)
 
 void AuthenticationReply::setFinished()
 {
+    // Finish only once, the timeout could have finished this reply already
+    if (m_finished)
+        return;
+
+    m_finished = true;
     m_timer->stop();
 
     // emit in next event loop
@@ -84,6 +89,9 @@ void AuthenticationReply::onTimeout()
 
 void AuthenticationReply::abort()
 {
+    if (m_finished)
+        return;
+
     m_error = Authenticator::AuthenticationErrorAborted;
     setFinished();
 }
@@ -31,9 +31,11 @@
 #include <QUuid>
 #include <QTimer>
 #include <QObject>
+#include <QPointer>
 #include <QProcess>
 #include <QElapsedTimer>
 
+#include "proxyclient.h"
 #include "authenticator.h"
 
 namespace remoteproxy {
@@ -43,7 +45,9 @@ class AuthenticationReply : public QObject
     Q_OBJECT
 public:
     friend class Authenticator;
+    friend class AuthenticationScheduler;
 
+    // Null once the client disconnected meanwhile
     ProxyClient *proxyClient() const;
 
     bool isTimedOut() const;
@@ -53,7 +57,7 @@ public:
 
 private:
     explicit AuthenticationReply(ProxyClient *proxyClient, QObject *parent = nullptr);
-    ProxyClient *m_proxyClient = nullptr;
+    QPointer<ProxyClient> m_proxyClient;
     QTimer *m_timer = nullptr;
 
     bool m_timedOut = false;
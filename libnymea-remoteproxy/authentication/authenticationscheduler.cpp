@@ -0,0 +1,242 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "engine.h"
+#include "loggingcategories.h"
+#include "authenticationscheduler.h"
+
+namespace remoteproxy {
+
+AuthenticationScheduler::AuthenticationScheduler(Authenticator *authenticator, QObject *parent) :
+    QObject(parent),
+    m_authenticator(authenticator)
+{
+
+}
+
+AuthenticationReply *AuthenticationScheduler::authenticate(ProxyClient *proxyClient)
+{
+    // Note: the reply timer starts now, so the authentication timeout is the deadline for queue time and authentication
+    AuthenticationReply *reply = new AuthenticationReply(proxyClient, this);
+
+    // Answer repeated attempts using a recently rejected token immediately
+    if (m_negativeCache.isEnabled() && m_negativeCache.isBlocked(proxyClient->tokenHash())) {
+        qCDebug(dcAuthentication()) << "Token has been rejected recently. Reject authentication request from" << proxyClient;
+        finishReply(reply, Authenticator::AuthenticationErrorAuthenticationFailed);
+        return reply;
+    }
+
+    // A valid session ticket replaces the authenticator
+    if (m_sessionTickets.isEnabled() && !proxyClient->sessionTicket().isEmpty()) {
+        QString userName;
+        if (m_sessionTickets.verifyTicket(proxyClient->sessionTicket(), proxyClient->tokenHash(), &userName)) {
+            qCDebug(dcAuthentication()) << "Authenticated" << proxyClient << "using the session ticket";
+            proxyClient->setUserName(userName);
+            finishReply(reply, Authenticator::AuthenticationErrorNoError);
+            return reply;
+        }
+    }
+
+    PendingAuthentication pendingAuthentication;
+    pendingAuthentication.reply = reply;
+    pendingAuthentication.proxyClient = proxyClient;
+    pendingAuthentication.tokenHash = proxyClient->tokenHash();
+
+    ProxyConfiguration *configuration = Engine::instance()->configuration();
+    int maximumRunning = configuration->maximumConcurrentAuthentications();
+    if (m_queue.isEmpty() && (maximumRunning <= 0 || m_runningAuthentications.count() < maximumRunning)) {
+        startAuthentication(pendingAuthentication);
+        return reply;
+    }
+
+    int maximumQueued = configuration->authenticationQueueSize();
+    if (m_queue.count() >= maximumQueued)
+        purgeQueue();
+
+    if (m_queue.count() >= maximumQueued) {
+        qCWarning(dcAuthentication()) << "Authentication queue is full (" << m_queue.count() << "). Reject authentication request from" << proxyClient;
+        m_rejectedCount++;
+        finishReply(reply, Authenticator::AuthenticationErrorBusy);
+        return reply;
+    }
+
+    qCDebug(dcAuthentication()) << "Queue authentication request from" << proxyClient << "Running:" << m_runningAuthentications.count() << "Queued:" << m_queue.count();
+
+    pendingAuthentication.waitTimer.start();
+    m_queue.enqueue(pendingAuthentication);
+
+    return reply;
+}
+
+AuthenticationCache *AuthenticationScheduler::negativeCache()
+{
+    return &m_negativeCache;
+}
+
+SessionTicketManager *AuthenticationScheduler::sessionTickets()
+{
+    return &m_sessionTickets;
+}
+
+int AuthenticationScheduler::runningCount() const
+{
+    return m_runningAuthentications.count();
+}
+
+int AuthenticationScheduler::queuedCount() const
+{
+    return m_queue.count();
+}
+
+void AuthenticationScheduler::reloadConfiguration()
+{
+    ProxyConfiguration *configuration = Engine::instance()->configuration();
+    m_negativeCache.setTimeout(configuration->negativeCacheTimeout());
+    m_negativeCache.setMaximumTimeout(configuration->negativeCacheMaximumTimeout());
+    m_negativeCache.setMaximumSize(configuration->negativeCacheSize());
+
+    m_sessionTickets.setLifetime(configuration->sessionTicketLifetime());
+    m_sessionTickets.setKeyFileName(configuration->sessionTicketKeyFileName());
+}
+
+void AuthenticationScheduler::tick()
+{
+    m_averageWaitTime = m_waitCount > 0 ? static_cast<int>(m_waitTimeSum / m_waitCount) : 0;
+    m_lastMaximumWaitTime = static_cast<int>(m_maximumWaitTime);
+
+    m_waitTimeSum = 0;
+    m_waitCount = 0;
+    m_maximumWaitTime = 0;
+
+    m_sessionTickets.tick();
+}
+
+QVariantMap AuthenticationScheduler::currentStatistics() const
+{
+    QVariantMap statisticsMap;
+    statisticsMap.insert("running", runningCount());
+    statisticsMap.insert("queued", queuedCount());
+    statisticsMap.insert("rejected", m_rejectedCount);
+    statisticsMap.insert("expired", m_expiredCount);
+    statisticsMap.insert("averageWaitTime", m_averageWaitTime);
+    statisticsMap.insert("maximumWaitTime", m_lastMaximumWaitTime);
+    statisticsMap.insert("negativeCache", m_negativeCache.currentStatistics());
+    statisticsMap.insert("sessionTickets", m_sessionTickets.currentStatistics());
+    return statisticsMap;
+}
+
+void AuthenticationScheduler::startAuthentication(const PendingAuthentication &pendingAuthentication)
+{
+    AuthenticationReply *authenticatorReply = m_authenticator->authenticate(pendingAuthentication.proxyClient.data());
+    connect(authenticatorReply, &AuthenticationReply::finished, this, &AuthenticationScheduler::onAuthenticationFinished);
+    // Authenticators create their replies as children of the client, they vanish without finishing on a disconnect
+    connect(authenticatorReply, &AuthenticationReply::destroyed, this, &AuthenticationScheduler::onAuthenticationDestroyed);
+    m_runningAuthentications.insert(authenticatorReply, pendingAuthentication);
+}
+
+void AuthenticationScheduler::processQueue()
+{
+    int maximumRunning = Engine::instance()->configuration()->maximumConcurrentAuthentications();
+    while (!m_queue.isEmpty() && (maximumRunning <= 0 || m_runningAuthentications.count() < maximumRunning)) {
+        PendingAuthentication pendingAuthentication = m_queue.dequeue();
+
+        // The deadline passed or the reply has been aborted while waiting
+        if (pendingAuthentication.reply.isNull() || pendingAuthentication.reply->isFinished()) {
+            m_expiredCount++;
+            continue;
+        }
+
+        // The client disconnected while waiting
+        if (pendingAuthentication.proxyClient.isNull()) {
+            finishReply(pendingAuthentication.reply.data(), Authenticator::AuthenticationErrorAborted);
+            continue;
+        }
+
+        qint64 waitTime = pendingAuthentication.waitTimer.elapsed();
+        m_waitTimeSum += waitTime;
+        m_waitCount++;
+        m_maximumWaitTime = qMax(m_maximumWaitTime, waitTime);
+
+        startAuthentication(pendingAuthentication);
+    }
+}
+
+void AuthenticationScheduler::purgeQueue()
+{
+    QQueue<PendingAuthentication> queue;
+    while (!m_queue.isEmpty()) {
+        PendingAuthentication pendingAuthentication = m_queue.dequeue();
+        if (pendingAuthentication.reply.isNull() || pendingAuthentication.reply->isFinished()) {
+            m_expiredCount++;
+            continue;
+        }
+
+        queue.enqueue(pendingAuthentication);
+    }
+
+    m_queue = queue;
+}
+
+void AuthenticationScheduler::finishReply(AuthenticationReply *reply, Authenticator::AuthenticationError error)
+{
+    reply->setError(error);
+    reply->setFinished();
+}
+
+void AuthenticationScheduler::onAuthenticationFinished()
+{
+    AuthenticationReply *authenticatorReply = static_cast<AuthenticationReply *>(sender());
+    authenticatorReply->disconnect(this);
+    authenticatorReply->deleteLater();
+
+    PendingAuthentication pendingAuthentication = m_runningAuthentications.take(authenticatorReply);
+
+    // Remember rejected tokens
+    if (authenticatorReply->error() == Authenticator::AuthenticationErrorAuthenticationFailed) {
+        m_negativeCache.addFailure(pendingAuthentication.tokenHash);
+    } else if (authenticatorReply->error() == Authenticator::AuthenticationErrorNoError) {
+        m_negativeCache.remove(pendingAuthentication.tokenHash);
+    }
+
+    if (!pendingAuthentication.reply.isNull() && !pendingAuthentication.reply->isFinished()) {
+        finishReply(pendingAuthentication.reply.data(), authenticatorReply->error());
+    }
+
+    processQueue();
+}
+
+void AuthenticationScheduler::onAuthenticationDestroyed(QObject *authenticatorReply)
+{
+    // Only the key is needed, the object is gone already
+    PendingAuthentication pendingAuthentication = m_runningAuthentications.take(static_cast<AuthenticationReply *>(authenticatorReply));
+    if (!pendingAuthentication.reply.isNull() && !pendingAuthentication.reply->isFinished())
+        finishReply(pendingAuthentication.reply.data(), Authenticator::AuthenticationErrorAborted);
+
+    processQueue();
+}
+
+}
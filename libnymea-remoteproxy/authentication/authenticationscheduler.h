@@ -0,0 +1,105 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef AUTHENTICATIONSCHEDULER_H
+#define AUTHENTICATIONSCHEDULER_H
+
+#include <QHash>
+#include <QQueue>
+#include <QObject>
+#include <QPointer>
+#include <QElapsedTimer>
+
+#include "proxyclient.h"
+#include "authenticator.h"
+#include "authenticationcache.h"
+#include "authenticationreply.h"
+#include "sessionticketmanager.h"
+
+namespace remoteproxy {
+
+class AuthenticationScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AuthenticationScheduler(Authenticator *authenticator, QObject *parent = nullptr);
+
+    AuthenticationReply *authenticate(ProxyClient *proxyClient);
+
+    AuthenticationCache *negativeCache();
+    SessionTicketManager *sessionTickets();
+
+    int runningCount() const;
+    int queuedCount() const;
+
+    // Applies the session ticket settings, called on start and after a configuration reload
+    void reloadConfiguration();
+
+    void tick();
+    QVariantMap currentStatistics() const;
+
+private:
+    class PendingAuthentication
+    {
+    public:
+        QPointer<AuthenticationReply> reply;
+        QPointer<ProxyClient> proxyClient;
+        QByteArray tokenHash;
+        QElapsedTimer waitTimer;
+    };
+
+    Authenticator *m_authenticator = nullptr;
+    AuthenticationCache m_negativeCache;
+    SessionTicketManager m_sessionTickets;
+
+    QQueue<PendingAuthentication> m_queue;
+    QHash<AuthenticationReply *, PendingAuthentication> m_runningAuthentications;
+
+    // Statistics
+    quint64 m_rejectedCount = 0;
+    quint64 m_expiredCount = 0;
+    qint64 m_waitTimeSum = 0;
+    int m_waitCount = 0;
+    qint64 m_maximumWaitTime = 0;
+    int m_averageWaitTime = 0;
+    int m_lastMaximumWaitTime = 0;
+
+    void startAuthentication(const PendingAuthentication &pendingAuthentication);
+    void processQueue();
+    void purgeQueue();
+
+    void finishReply(AuthenticationReply *reply, Authenticator::AuthenticationError error);
+
+private slots:
+    void onAuthenticationFinished();
+    void onAuthenticationDestroyed(QObject *authenticatorReply);
+
+};
+
+}
+
+#endif // AUTHENTICATIONSCHEDULER_H
@@ -46,7 +46,9 @@ public:
         AuthenticationErrorTimeout,
         AuthenticationErrorAborted,
         AuthenticationErrorAuthenticationFailed,
-        AuthenticationErrorProxyError
+        AuthenticationErrorProxyError,
+        AuthenticationErrorBusy,
+        AuthenticationErrorRedirected
     };
     Q_ENUM(AuthenticationError)
 
@@ -0,0 +1,117 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "authenticationbatchprocess.h"
+#include "authenticationprocess.h"
+#include "loggingcategories.h"
+
+#include <QNetworkReply>
+#include <QJsonDocument>
+
+namespace remoteproxy {
+
+AuthenticationBatchProcess::AuthenticationBatchProcess(QNetworkAccessManager *manager, const QString &accessKey, const QString &secretAccessKey, const QString &sessionToken, QObject *parent) :
+    QObject(parent),
+    m_manager(manager),
+    m_accessKey(accessKey),
+    m_secretAccessKey(secretAccessKey),
+    m_sessionToken(sessionToken)
+{
+
+}
+
+void AuthenticationBatchProcess::finishAll(Authenticator::AuthenticationError error)
+{
+    for (int i = 0; i < m_tokens.count(); i++) {
+        emit tokenAuthenticated(i, error);
+    }
+
+    emit finished();
+}
+
+void AuthenticationBatchProcess::onLambdaInvokeFunctionFinished()
+{
+    QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
+    reply->deleteLater();
+
+    qCDebug(dcAuthenticationProcess()) << "Lambda batch invoke request for" << m_tokens.count() << "tokens finished (" << m_lambdaTimer.elapsed() << "[ms] )";
+
+    if (reply->error()) {
+        qCWarning(dcAuthenticationProcess()) << "Lambda batch invoke reply error: " << reply->errorString();
+        finishAll(Authenticator::AuthenticationErrorProxyError);
+        return;
+    }
+
+    QByteArray data = reply->readAll();
+    qCDebug(dcAuthenticationProcess()) << "Lambda function batch result ready" << qUtf8Printable(data);
+
+    QJsonParseError error;
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError) {
+        qCWarning(dcAuthenticationProcess()) << "Failed to parse lambda batch invoke result data" << data << ":" << error.errorString();
+        finishAll(Authenticator::AuthenticationErrorProxyError);
+        return;
+    }
+
+    QVariantList results = jsonDoc.toVariant().toList();
+    if (results.count() != m_tokens.count()) {
+        qCWarning(dcAuthenticationProcess()) << "Lambda batch invoke returned" << results.count() << "results for" << m_tokens.count() << "tokens.";
+        finishAll(Authenticator::AuthenticationErrorProxyError);
+        return;
+    }
+
+    for (int i = 0; i < results.count(); i++) {
+        UserInformation userInformation;
+        Authenticator::AuthenticationError authenticationError = AuthenticationProcess::parseResult(results.at(i).toMap(), &userInformation);
+        emit tokenAuthenticated(i, authenticationError, userInformation);
+    }
+
+    emit finished();
+}
+
+void AuthenticationBatchProcess::authenticate(const QStringList &tokens)
+{
+    m_tokens = tokens;
+
+    // The authorizer receives the same request objects as for a single invocation, wrapped into an array
+    QVariantList requestList;
+    foreach (const QString &token, m_tokens) {
+        QVariantMap requestMap;
+        requestMap.insert("token", token);
+        requestList.append(requestMap);
+    }
+    QByteArray payload = QJsonDocument::fromVariant(requestList).toJson(QJsonDocument::Compact);
+
+    QNetworkRequest request = AuthenticationProcess::createInvokeRequest(payload, m_accessKey, m_secretAccessKey, m_sessionToken);
+
+    m_lambdaTimer.start();
+
+    QNetworkReply *reply = m_manager->post(request, payload);
+    connect(reply, &QNetworkReply::finished, this, &AuthenticationBatchProcess::onLambdaInvokeFunctionFinished);
+}
+
+}
@@ -50,7 +50,7 @@ AuthenticationProcess::AuthenticationProcess(QNetworkAccessManager *manager, con
     connect(m_process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, &AuthenticationProcess::onProcessFinished);
 }
 
-void AuthenticationProcess::invokeLambdaFunction()
+QNetworkRequest AuthenticationProcess::createInvokeRequest(const QByteArray &payload, const QString &accessKey, const QString &secretAccessKey, const QString &sessionToken)
 {
     // Known configurations
     QString region = Engine::instance()->configuration()->awsRegion();
@@ -59,21 +59,18 @@ void AuthenticationProcess::invokeLambdaFunction()
     QString invocationType = "RequestResponse";
     QString service = "lambda";
 
-    QUrl requestUrl;
-    requestUrl.setScheme("https");
-    requestUrl.setHost(QString("lambda.%1.amazonaws.com").arg(region));
+    QUrl requestUrl = Engine::instance()->configuration()->awsAuthorizerEndpoint();
+    if (requestUrl.isEmpty()) {
+        requestUrl.setScheme("https");
+        requestUrl.setHost(QString("lambda.%1.amazonaws.com").arg(region));
+    }
     requestUrl.setPath(QString("/2015-03-31/functions/%1/invocations").arg(lambdaFunctionName));
 
-    // Create request map
-    QVariantMap requestMap;
-    requestMap.insert("token", m_token);
-    QByteArray payload = QJsonDocument::fromVariant(requestMap).toJson(QJsonDocument::Compact);
-
     QNetworkRequest request(requestUrl);
     //request.setRawHeader("User-Agent", QString("%1/%2 JSON-RPC/%3").arg(SERVER_NAME_STRING).arg(SERVER_VERSION_STRING).arg(API_VERSION_STRING).toUtf8());
     //request.setRawHeader("Content-Type", "application/json");
     request.setRawHeader("host", requestUrl.host().toUtf8());
-    SigV4Utils::signRequest(QNetworkAccessManager::PostOperation, request, region, service, invocationType, m_accessKey.toUtf8(), m_secretAccessKey.toUtf8(), m_sessionToken.toUtf8(), payload);
+    SigV4Utils::signRequest(QNetworkAccessManager::PostOperation, request, region, service, invocationType, accessKey.toUtf8(), secretAccessKey.toUtf8(), sessionToken.toUtf8(), payload);
 
     qCDebug(dcAuthenticationProcess()) << "Invoke lambda function" << lambdaFunctionName;
 
@@ -86,6 +83,39 @@ void AuthenticationProcess::invokeLambdaFunction()
     qCDebug(dcAuthenticationProcess()) << payload;
     qCDebug(dcAuthenticationProcess()) << "--------------------------------------------";
 
+    return request;
+}
+
+Authenticator::AuthenticationError AuthenticationProcess::parseResult(const QVariantMap &result, UserInformation *userInformation)
+{
+    if (result.isEmpty()) {
+        qCWarning(dcAuthenticationProcess()) << "Received empty lambda result.";
+        return Authenticator::AuthenticationErrorProxyError;
+    }
+
+    if (!result.value("isValid").toBool())
+        return Authenticator::AuthenticationErrorAuthenticationFailed;
+
+    QVariantMap verifiedDataMap = result.value("verifiedData").toMap();
+    QString vendorId = verifiedDataMap.value("vendorId").toString();
+    QString userPoolId = verifiedDataMap.value("userPoolId").toString();
+    QVariantMap verifiedParsedTokenMap = verifiedDataMap.value("verifiedParsedToken").toMap();
+    QString email = verifiedParsedTokenMap.value("email").toString();
+    QString cognitoUsername = verifiedParsedTokenMap.value("cognito:username").toString();
+
+    *userInformation = UserInformation(email, cognitoUsername, vendorId, userPoolId);
+    return Authenticator::AuthenticationErrorNoError;
+}
+
+void AuthenticationProcess::invokeLambdaFunction()
+{
+    // Create request map
+    QVariantMap requestMap;
+    requestMap.insert("token", m_token);
+    QByteArray payload = QJsonDocument::fromVariant(requestMap).toJson(QJsonDocument::Compact);
+
+    QNetworkRequest request = createInvokeRequest(payload, m_accessKey, m_secretAccessKey, m_sessionToken);
+
     m_lambdaTimer.start();
 
     QNetworkReply *reply = m_manager->post(request, payload);
@@ -170,27 +200,10 @@ void AuthenticationProcess::onLambdaInvokeFunctionFinished()
 
     QVariantMap response = jsonDoc.toVariant().toMap();
     qCDebug(dcAuthenticationProcess()) << "-->" << response;
-    if (response.isEmpty()) {
-        qCWarning(dcAuthenticationProcess()) << "Received empty lambda result.";
-        emit authenticationFinished(Authenticator::AuthenticationErrorProxyError);
-        return;
-    }
-
-    bool isValid = response.value("isValid").toBool();
-    if (isValid) {
-        QVariantMap verifiedDataMap = response.value("verifiedData").toMap();
-        QString vendorId = verifiedDataMap.value("vendorId").toString();
-        QString userPoolId = verifiedDataMap.value("userPoolId").toString();
-        QVariantMap verifiedParsedTokenMap = verifiedDataMap.value("verifiedParsedToken").toMap();
-        QString email = verifiedParsedTokenMap.value("email").toString();
-        QString cognitoUsername = verifiedParsedTokenMap.value("cognito:username").toString();
 
-        UserInformation userInformation(email, cognitoUsername, vendorId, userPoolId);
-
-        emit authenticationFinished(Authenticator::AuthenticationErrorNoError, userInformation);
-    } else {
-        emit authenticationFinished(Authenticator::AuthenticationErrorAuthenticationFailed);
-    }
+    UserInformation userInformation;
+    Authenticator::AuthenticationError authenticationError = parseResult(response, &userInformation);
+    emit authenticationFinished(authenticationError, userInformation);
 }
 
 void AuthenticationProcess::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
@@ -241,27 +254,10 @@ void AuthenticationProcess::onProcessFinished(int exitCode, QProcess::ExitStatus
 
     QVariantMap response = jsonDoc.toVariant().toMap();
     qCDebug(dcAuthenticationProcess()) << "-->" << response;
-    if (response.isEmpty()) {
-        qCWarning(dcAuthenticationProcess()) << "Received empty lambda result.";
-        emit authenticationFinished(Authenticator::AuthenticationErrorProxyError);
-        return;
-    }
-
-    bool isValid = response.value("isValid").toBool();
-    if (isValid) {
-        QVariantMap verifiedDataMap = response.value("verifiedData").toMap();
-        QString vendorId = verifiedDataMap.value("vendorId").toString();
-        QString userPoolId = verifiedDataMap.value("userPoolId").toString();
-        QVariantMap verifiedParsedTokenMap = verifiedDataMap.value("verifiedParsedToken").toMap();
-        QString email = verifiedParsedTokenMap.value("email").toString();
-        QString cognitoUsername = verifiedParsedTokenMap.value("cognito:username").toString();
 
-        UserInformation userInformation(email, cognitoUsername, vendorId, userPoolId);
-
-        emit authenticationFinished(Authenticator::AuthenticationErrorNoError, userInformation);
-    } else {
-        emit authenticationFinished(Authenticator::AuthenticationErrorAuthenticationFailed);
-    }
+    UserInformation userInformation;
+    Authenticator::AuthenticationError authenticationError = parseResult(response, &userInformation);
+    emit authenticationFinished(authenticationError, userInformation);
 
 }
 
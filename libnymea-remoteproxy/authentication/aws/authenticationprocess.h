@@ -31,6 +31,7 @@
 #include <QObject>
 #include <QProcess>
 #include <QElapsedTimer>
+#include <QNetworkRequest>
 #include <QNetworkAccessManager>
 
 #include "userinformation.h"
@@ -44,6 +45,9 @@ class AuthenticationProcess : public QObject
 public:
     explicit AuthenticationProcess(QNetworkAccessManager *manager, const QString &accessKey, const QString &secretAccessKey, const QString &sessionToken, QObject *parent = nullptr);
 
+    static QNetworkRequest createInvokeRequest(const QByteArray &payload, const QString &accessKey, const QString &secretAccessKey, const QString &sessionToken);
+    static Authenticator::AuthenticationError parseResult(const QVariantMap &result, UserInformation *userInformation);
+
 private:
     QNetworkAccessManager *m_manager = nullptr;
     QString m_accessKey;
@@ -38,6 +38,10 @@ AwsAuthenticator::AwsAuthenticator(const QUrl &awsCredentialsUrl, QObject *paren
 {
     m_credentialsProvider = new AwsCredentialProvider(m_manager, awsCredentialsUrl, this);
     QMetaObject::invokeMethod(m_credentialsProvider, QString("enable").toLatin1().data(), Qt::QueuedConnection);
+
+    m_batchTimer = new QTimer(this);
+    m_batchTimer->setSingleShot(true);
+    connect(m_batchTimer, &QTimer::timeout, this, &AwsAuthenticator::flushBatch);
 }
 
 AwsAuthenticator::~AwsAuthenticator()
@@ -51,10 +55,20 @@ QString AwsAuthenticator::name() const
     return "AWS authenticator";
 }
 
-void AwsAuthenticator::onAuthenticationProcessFinished(Authenticator::AuthenticationError error, const UserInformation &userInformation)
+bool AwsAuthenticator::isReady() const
 {
-    AuthenticationProcess *process = static_cast<AuthenticationProcess *>(sender());
-    AuthenticationReply *reply = m_runningProcesses.take(process);
+    return m_credentialsProvider->isValid();
+}
+
+void AwsAuthenticator::finishAuthentication(AuthenticationReply *reply, Authenticator::AuthenticationError error, const UserInformation &userInformation)
+{
+    // The client disconnected while the lambda function was running, there is nobody to update
+    if (!reply->proxyClient()) {
+        qCDebug(dcAuthentication()) << name() << "The client disconnected during the authentication.";
+        setReplyError(reply, AuthenticationErrorAborted);
+        setReplyFinished(reply);
+        return;
+    }
 
     if (error == AuthenticationErrorNoError) {
         qCDebug(dcAuthentication()) << name() << reply->proxyClient() << "finished successfully." << userInformation;
@@ -68,6 +82,66 @@ void AwsAuthenticator::onAuthenticationProcessFinished(Authenticator::Authentica
     setReplyFinished(reply);
 }
 
+void AwsAuthenticator::onAuthenticationProcessFinished(Authenticator::AuthenticationError error, const UserInformation &userInformation)
+{
+    AuthenticationProcess *process = static_cast<AuthenticationProcess *>(sender());
+    QPointer<AuthenticationReply> reply = m_runningProcesses.take(process);
+    process->deleteLater();
+
+    // The scheduler deletes replies which timed out or got aborted in the meantime
+    if (reply.isNull() || reply->isFinished())
+        return;
+
+    finishAuthentication(reply.data(), error, userInformation);
+}
+
+void AwsAuthenticator::onTokenAuthenticated(int index, Authenticator::AuthenticationError error, const UserInformation &userInformation)
+{
+    AuthenticationBatchProcess *batchProcess = static_cast<AuthenticationBatchProcess *>(sender());
+    QPointer<AuthenticationReply> reply = m_runningBatches.value(batchProcess).value(index).reply;
+
+    // The reply is gone if the authentication timed out in the meantime
+    if (reply.isNull() || reply->isFinished())
+        return;
+
+    finishAuthentication(reply.data(), error, userInformation);
+}
+
+void AwsAuthenticator::onBatchProcessFinished()
+{
+    AuthenticationBatchProcess *batchProcess = static_cast<AuthenticationBatchProcess *>(sender());
+    m_runningBatches.remove(batchProcess);
+    batchProcess->deleteLater();
+}
+
+void AwsAuthenticator::flushBatch()
+{
+    m_batchTimer->stop();
+    if (m_pendingBatch.isEmpty())
+        return;
+
+    QList<BatchEntry> batch = m_pendingBatch;
+    m_pendingBatch.clear();
+
+    QStringList tokens;
+    foreach (const BatchEntry &entry, batch) {
+        tokens.append(entry.token);
+    }
+
+    qCDebug(dcAuthentication()) << name() << "Verify a batch of" << tokens.count() << "tokens";
+
+    AuthenticationBatchProcess *batchProcess = new AuthenticationBatchProcess(m_manager,
+                                                                              m_credentialsProvider->accessKey(),
+                                                                              m_credentialsProvider->secretAccessKey(),
+                                                                              m_credentialsProvider->sessionToken(), this);
+
+    connect(batchProcess, &AuthenticationBatchProcess::tokenAuthenticated, this, &AwsAuthenticator::onTokenAuthenticated);
+    connect(batchProcess, &AuthenticationBatchProcess::finished, this, &AwsAuthenticator::onBatchProcessFinished);
+
+    m_runningBatches.insert(batchProcess, batch);
+    batchProcess->authenticate(tokens);
+}
+
 AuthenticationReply *AwsAuthenticator::authenticate(ProxyClient *proxyClient)
 {
     qCDebug(dcAuthentication()) << name() << "Start authenticating" << proxyClient;
@@ -80,6 +154,24 @@ AuthenticationReply *AwsAuthenticator::authenticate(ProxyClient *proxyClient)
         return reply;
     }
 
+    // Collect the tokens of a burst and verify them with one lambda invocation
+    int batchInterval = Engine::instance()->configuration()->awsBatchInterval();
+    int batchSize = Engine::instance()->configuration()->awsBatchSize();
+    if (batchInterval > 0 && batchSize > 1) {
+        BatchEntry entry;
+        entry.reply = reply;
+        entry.token = proxyClient->token();
+        m_pendingBatch.append(entry);
+
+        if (m_pendingBatch.count() >= batchSize) {
+            flushBatch();
+        } else if (!m_batchTimer->isActive()) {
+            m_batchTimer->start(batchInterval);
+        }
+
+        return reply;
+    }
+
     AuthenticationProcess *process = new AuthenticationProcess(m_manager,
                                                                m_credentialsProvider->accessKey(),
                                                                m_credentialsProvider->secretAccessKey(),
@@ -87,6 +179,15 @@ AuthenticationReply *AwsAuthenticator::authenticate(ProxyClient *proxyClient)
 
     connect(process, &AuthenticationProcess::authenticationFinished, this, &AwsAuthenticator::onAuthenticationProcessFinished);
 
+    // Forget the processes whose replies are gone, their result is not needed any more
+    foreach (AuthenticationProcess *runningProcess, m_runningProcesses.keys()) {
+        QPointer<AuthenticationReply> runningReply = m_runningProcesses.value(runningProcess);
+        if (runningReply.isNull() || runningReply->isFinished()) {
+            m_runningProcesses.remove(runningProcess);
+            runningProcess->deleteLater();
+        }
+    }
+
     // Configure process
     m_runningProcesses.insert(process, reply);
 
@@ -28,11 +28,14 @@
 #ifndef AWSAUTHENTICATOR_H
 #define AWSAUTHENTICATOR_H
 
+#include <QTimer>
 #include <QObject>
+#include <QPointer>
 #include <QNetworkAccessManager>
 
 #include "awscredentialprovider.h"
 #include "authenticationprocess.h"
+#include "authenticationbatchprocess.h"
 #include "authentication/authenticator.h"
 #include "authentication/authenticationreply.h"
 
@@ -47,13 +50,31 @@ public:
 
     QString name() const override;
 
+    bool isReady() const;
+
 private:
+    class BatchEntry
+    {
+    public:
+        QPointer<AuthenticationReply> reply;
+        QString token;
+    };
+
     QNetworkAccessManager *m_manager = nullptr;
     AwsCredentialProvider *m_credentialsProvider = nullptr;
-    QHash<AuthenticationProcess *, AuthenticationReply *> m_runningProcesses;
+    QHash<AuthenticationProcess *, QPointer<AuthenticationReply>> m_runningProcesses;
+
+    QTimer *m_batchTimer = nullptr;
+    QList<BatchEntry> m_pendingBatch;
+    QHash<AuthenticationBatchProcess *, QList<BatchEntry>> m_runningBatches;
+
+    void finishAuthentication(AuthenticationReply *reply, Authenticator::AuthenticationError error, const UserInformation &userInformation);
 
 private slots:
     void onAuthenticationProcessFinished(Authenticator::AuthenticationError error, const UserInformation &userInformation);
+    void onTokenAuthenticated(int index, Authenticator::AuthenticationError error, const UserInformation &userInformation);
+    void onBatchProcessFinished();
+    void flushBatch();
 
 public slots:
     AuthenticationReply *authenticate(ProxyClient *proxyClient) override;
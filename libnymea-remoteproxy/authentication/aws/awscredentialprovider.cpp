@@ -28,21 +28,49 @@
 #include "loggingcategories.h"
 #include "awscredentialprovider.h"
 
+#include <limits>
+
 #include <QJsonDocument>
 #include <QNetworkReply>
 #include <QJsonParseError>
 #include <QNetworkRequest>
 
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#else
+#include <QThreadStorage>
+#include <unistd.h>
+#endif
+
 namespace remoteproxy {
 
+// Every instance has to pick its own offsets, otherwise all of them refresh at the same time
+static int randomJitter(int bound)
+{
+    if (bound <= 0)
+        return 0;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    return static_cast<int>(QRandomGenerator::global()->bounded(bound));
+#else
+    // qrand() uses the same seed in every process unless it got seeded, once per thread
+    static QThreadStorage<bool> seeded;
+    if (!seeded.hasLocalData()) {
+        qsrand(static_cast<uint>(QDateTime::currentMSecsSinceEpoch()) ^ static_cast<uint>(getpid()));
+        seeded.setLocalData(true);
+    }
+
+    return qrand() % bound;
+#endif
+}
+
 AwsCredentialProvider::AwsCredentialProvider(QNetworkAccessManager *networkManager, const QUrl &awsCredentialsUrl, QObject *parent) :
     QObject(parent),
     m_networkManager(networkManager),
     m_requestUrl(awsCredentialsUrl)
 {
     m_timer = new QTimer(this);
-    m_timer->setSingleShot(false);
-    m_timer->setInterval(90000);
+    m_timer->setSingleShot(true);
 
     connect(m_timer, &QTimer::timeout, this, &AwsCredentialProvider::onTimeout);
 }
@@ -64,7 +92,14 @@ QString AwsCredentialProvider::sessionToken() const
 
 bool AwsCredentialProvider::isValid() const
 {
-    return !m_accessKey.isEmpty() && !m_secretAccessKey.isEmpty() && !m_sessionToken.isEmpty();
+    if (m_accessKey.isEmpty() || m_secretAccessKey.isEmpty() || m_sessionToken.isEmpty())
+        return false;
+
+    // Credentials without expiration information are valid until they get replaced
+    if (!m_expirationTime.isValid())
+        return true;
+
+    return QDateTime::currentDateTimeUtc() < m_expirationTime;
 }
 
 bool AwsCredentialProvider::enabled() const
@@ -72,6 +107,27 @@ bool AwsCredentialProvider::enabled() const
     return m_enabled;
 }
 
+QDateTime AwsCredentialProvider::expirationTime() const
+{
+    return m_expirationTime;
+}
+
+void AwsCredentialProvider::setRefreshMargin(int refreshMargin)
+{
+    m_refreshMargin = refreshMargin;
+}
+
+void AwsCredentialProvider::setRefreshJitter(int refreshJitter)
+{
+    m_refreshJitter = refreshJitter;
+}
+
+void AwsCredentialProvider::setRetryIntervals(int minimumRetryInterval, int maximumRetryInterval)
+{
+    m_minimumRetryInterval = minimumRetryInterval;
+    m_maximumRetryInterval = maximumRetryInterval;
+}
+
 void AwsCredentialProvider::refreshCredentials()
 {
     qCDebug(dcAwsCredentialsProvider()) << "Update dynamic credentials form" << m_requestUrl.toString();
@@ -86,12 +142,61 @@ void AwsCredentialProvider::clear()
     m_accessKey.clear();
     m_secretAccessKey.clear();
     m_sessionToken.clear();
+    m_expirationTime = QDateTime();
+    m_lastUpdateTime = QDateTime();
+    m_retryInterval = 0;
 }
 
+void AwsCredentialProvider::scheduleRefresh()
+{
+    m_retryInterval = 0;
+
+    if (!m_expirationTime.isValid()) {
+        qCDebug(dcAwsCredentialsProvider()) << "No expiration time available. Refresh credentials in" << m_fallbackRefreshInterval << "[ms]";
+        m_timer->start(m_fallbackRefreshInterval);
+        return;
+    }
+
+    // Refresh before the credentials expire. The jitter prevents all instances from refreshing at the same time
+    qint64 lifetime = QDateTime::currentDateTimeUtc().msecsTo(m_expirationTime);
+    qint64 margin = qMin(static_cast<qint64>(m_refreshMargin), lifetime / 2);
+    qint64 jitter = randomJitter(m_refreshJitter);
+    qint64 interval = lifetime - margin - qMin(jitter, margin);
+
+    interval = qBound(static_cast<qint64>(m_minimumRetryInterval), interval, static_cast<qint64>(std::numeric_limits<int>::max()));
+
+    qCDebug(dcAwsCredentialsProvider()) << "Credentials expire at" << m_expirationTime.toString("dd.MM.yyyy hh:mm:ss") << "UTC. Refresh in" << interval << "[ms]";
+    m_timer->start(static_cast<int>(interval));
+}
+
+void AwsCredentialProvider::scheduleRetry()
+{
+    // Exponential backoff with jitter, the current credentials stay in use until new ones arrive
+    if (m_retryInterval <= 0) {
+        m_retryInterval = m_minimumRetryInterval;
+    } else {
+        m_retryInterval = qMin(m_retryInterval * 2, m_maximumRetryInterval);
+    }
+
+    int interval = m_retryInterval + randomJitter(m_retryInterval / 2 + 1);
+
+    // Never wait longer than the current credentials are usable
+    if (m_expirationTime.isValid() && isValid())
+        interval = static_cast<int>(qMin(static_cast<qint64>(interval), qMax(static_cast<qint64>(m_minimumRetryInterval), QDateTime::currentDateTimeUtc().msecsTo(m_expirationTime))));
+
+    qCDebug(dcAwsCredentialsProvider()) << "Retry refreshing credentials in" << interval << "[ms]";
+    m_timer->start(interval);
+}
+
+QDateTime AwsCredentialProvider::parseTime(const QString &timeString) const
+{
+    QDateTime dateTime = QDateTime::fromString(timeString, "yyyy-MM-ddThh:mm:ssZ");
+    dateTime.setTimeSpec(Qt::UTC);
+    return dateTime;
+}
 
 void AwsCredentialProvider::onTimeout()
 {
-    // TODO: check if we need to refresh
     refreshCredentials();
 }
 
@@ -101,8 +206,12 @@ void AwsCredentialProvider::onReplyFinished()
     reply->deleteLater();
 
     qCDebug(dcAwsCredentialsProvider()) << "Dynamic credentials request finished (" << m_requestTimer.elapsed() << "[ms] )";
+    if (!m_enabled)
+        return;
+
     if (reply->error()) {
         qCWarning(dcAwsCredentialsProvider()) << "Dynamic credentials reply error: " << reply->errorString();
+        scheduleRetry();
         return;
     }
 
@@ -113,21 +222,34 @@ void AwsCredentialProvider::onReplyFinished()
 
     if(error.error != QJsonParseError::NoError) {
         qCWarning(dcAwsCredentialsProviderTraffic()) << "Failed to parse dynamic credentials reply data" << data << ":" << error.errorString();
+        scheduleRetry();
         return;
     }
 
     QVariantMap response = jsonDoc.toVariant().toMap();
 
-    m_accessKey = response.value("AccessKeyId").toString();
-    m_secretAccessKey = response.value("SecretAccessKey").toString();
-    m_sessionToken = response.value("Token").toString();
+    QString accessKey = response.value("AccessKeyId").toString();
+    QString secretAccessKey = response.value("SecretAccessKey").toString();
+    QString sessionToken = response.value("Token").toString();
+    if (accessKey.isEmpty() || secretAccessKey.isEmpty() || sessionToken.isEmpty()) {
+        qCWarning(dcAwsCredentialsProvider()) << "Dynamic credentials reply does not contain valid credentials";
+        scheduleRetry();
+        return;
+    }
+
+    m_accessKey = accessKey;
+    m_secretAccessKey = secretAccessKey;
+    m_sessionToken = sessionToken;
 
     qCDebug(dcAwsCredentialsProviderTraffic()) << "Dynamic credentials updated:" << response;
 
-    QDateTime expirationTime = QDateTime::fromString(response.value("Expiration").toString(), "yyyy-MM-ddThh:mm:ssZ");
-    QDateTime lastUpdateTime = QDateTime::fromString(response.value("LastUpdated").toString(), "yyyy-MM-ddThh:mm:ssZ");
-    qCDebug(dcAwsCredentialsProviderTraffic()) << "Exipration time" << expirationTime.toString("dd.MM.yyyy hh:mm:ss");
-    qCDebug(dcAwsCredentialsProviderTraffic()) << "Last update time" << lastUpdateTime.toString("dd.MM.yyyy hh:mm:ss");
+    m_expirationTime = parseTime(response.value("Expiration").toString());
+    m_lastUpdateTime = parseTime(response.value("LastUpdated").toString());
+    qCDebug(dcAwsCredentialsProviderTraffic()) << "Exipration time" << m_expirationTime.toString("dd.MM.yyyy hh:mm:ss");
+    qCDebug(dcAwsCredentialsProviderTraffic()) << "Last update time" << m_lastUpdateTime.toString("dd.MM.yyyy hh:mm:ss");
+
+    scheduleRefresh();
+    emit credentialsChanged();
 }
 
 void AwsCredentialProvider::enable()
@@ -138,7 +260,7 @@ void AwsCredentialProvider::enable()
     }
 
     qCDebug(dcAwsCredentialsProvider()) << "Enable AWS dynamic credentials provider";
-    m_timer->start();
+    m_timer->stop();
     refreshCredentials();
 }
 
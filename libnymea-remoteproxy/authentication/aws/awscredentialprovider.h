@@ -50,6 +50,13 @@ public:
     bool isValid() const;
     bool enabled() const;
 
+    QDateTime expirationTime() const;
+
+    // Refresh scheduling in [ms]
+    void setRefreshMargin(int refreshMargin);
+    void setRefreshJitter(int refreshJitter);
+    void setRetryIntervals(int minimumRetryInterval, int maximumRetryInterval);
+
 private:
     QNetworkAccessManager *m_networkManager = nullptr;
     QTimer *m_timer = nullptr;
@@ -67,9 +74,22 @@ private:
     QDateTime m_expirationTime;
     QDateTime m_lastUpdateTime;
 
+    // Refresh scheduling in [ms]
+    int m_refreshMargin = 300000;
+    int m_refreshJitter = 60000;
+    int m_fallbackRefreshInterval = 90000;
+    int m_minimumRetryInterval = 1000;
+    int m_maximumRetryInterval = 60000;
+    int m_retryInterval = 0;
+
     void refreshCredentials();
     void clear();
 
+    void scheduleRefresh();
+    void scheduleRetry();
+
+    QDateTime parseTime(const QString &timeString) const;
+
 private slots:
     void onTimeout();
     void onReplyFinished();
@@ -0,0 +1,253 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "securerandom.h"
+#include "loggingcategories.h"
+#include "sessionticketmanager.h"
+
+#include <QUuid>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QMessageAuthenticationCode>
+
+namespace remoteproxy {
+
+SessionTicketManager::SessionTicketManager()
+{
+
+}
+
+int SessionTicketManager::lifetime() const
+{
+    return m_lifetime;
+}
+
+void SessionTicketManager::setLifetime(int lifetime)
+{
+    m_lifetime = lifetime;
+}
+
+bool SessionTicketManager::isEnabled() const
+{
+    return m_lifetime > 0;
+}
+
+QString SessionTicketManager::keyFileName() const
+{
+    return m_keyFileName;
+}
+
+void SessionTicketManager::setKeyFileName(const QString &keyFileName)
+{
+    if (m_keyFileName == keyFileName && !m_keys.isEmpty())
+        return;
+
+    m_keyFileName = keyFileName;
+    m_keyFileModified = QDateTime();
+    m_keys.clear();
+
+    if (m_keyFileName.isEmpty()) {
+        rotateKey();
+    } else {
+        loadKeyFile();
+    }
+}
+
+int SessionTicketManager::keyCount() const
+{
+    return m_keys.count();
+}
+
+QString SessionTicketManager::createTicket(const QByteArray &tokenHash, const QString &userName)
+{
+    if (m_keys.isEmpty())
+        return QString();
+
+    const Key &key = m_keys.first();
+
+    QVariantMap payloadMap;
+    payloadMap.insert("k", QString::fromLatin1(key.id));
+    payloadMap.insert("e", QDateTime::currentMSecsSinceEpoch() + m_lifetime);
+    payloadMap.insert("h", QString::fromLatin1(tokenHash.toHex()));
+    payloadMap.insert("u", userName);
+
+    QByteArray payload = QJsonDocument::fromVariant(payloadMap).toJson(QJsonDocument::Compact).toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+    QByteArray signature = QMessageAuthenticationCode::hash(payload, key.secret, QCryptographicHash::Sha256).toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+
+    m_issuedCount++;
+    return QString::fromLatin1(payload + '.' + signature);
+}
+
+bool SessionTicketManager::verifyTicket(const QString &ticket, const QByteArray &tokenHash, QString *userName)
+{
+    QList<QByteArray> parts = ticket.toLatin1().split('.');
+    if (parts.count() != 2) {
+        m_rejectedCount++;
+        return false;
+    }
+
+    QVariantMap payloadMap = QJsonDocument::fromJson(QByteArray::fromBase64(parts.at(0), QByteArray::Base64UrlEncoding)).toVariant().toMap();
+    QByteArray keyId = payloadMap.value("k").toString().toLatin1();
+
+    QByteArray secret;
+    foreach (const Key &key, m_keys) {
+        if (key.id == keyId) {
+            secret = key.secret;
+            break;
+        }
+    }
+
+    if (secret.isEmpty()) {
+        qCDebug(dcAuthentication()) << "Session ticket signed with unknown key" << keyId;
+        m_rejectedCount++;
+        return false;
+    }
+
+    // Compare in constant time
+    QByteArray expectedSignature = QMessageAuthenticationCode::hash(parts.at(0), secret, QCryptographicHash::Sha256);
+    QByteArray signature = QByteArray::fromBase64(parts.at(1), QByteArray::Base64UrlEncoding);
+    char difference = static_cast<char>(signature.size() ^ expectedSignature.size());
+    for (int i = 0; i < expectedSignature.size() && i < signature.size(); i++)
+        difference |= signature.at(i) ^ expectedSignature.at(i);
+
+    if (difference != 0) {
+        qCDebug(dcAuthentication()) << "Session ticket with invalid signature";
+        m_rejectedCount++;
+        return false;
+    }
+
+    if (payloadMap.value("e").toLongLong() <= QDateTime::currentMSecsSinceEpoch()) {
+        qCDebug(dcAuthentication()) << "Session ticket expired";
+        m_rejectedCount++;
+        return false;
+    }
+
+    if (payloadMap.value("h").toString().toLatin1() != tokenHash.toHex()) {
+        qCDebug(dcAuthentication()) << "Session ticket issued for a different token";
+        m_rejectedCount++;
+        return false;
+    }
+
+    if (userName)
+        *userName = payloadMap.value("u").toString();
+
+    m_acceptedCount++;
+    return true;
+}
+
+void SessionTicketManager::tick()
+{
+    if (!isEnabled())
+        return;
+
+    // Pick up keys rotated by the administrator
+    if (!m_keyFileName.isEmpty()) {
+        if (QFileInfo(m_keyFileName).lastModified() != m_keyFileModified)
+            loadKeyFile();
+
+        return;
+    }
+
+    // Generated keys rotate once per ticket lifetime
+    if (m_keys.isEmpty() || QDateTime::currentMSecsSinceEpoch() - m_keys.first().creationTime >= m_lifetime)
+        rotateKey();
+}
+
+QVariantMap SessionTicketManager::currentStatistics() const
+{
+    QVariantMap statisticsMap;
+    statisticsMap.insert("keys", keyCount());
+    statisticsMap.insert("issued", m_issuedCount);
+    statisticsMap.insert("accepted", m_acceptedCount);
+    statisticsMap.insert("rejected", m_rejectedCount);
+    return statisticsMap;
+}
+
+bool SessionTicketManager::loadKeyFile()
+{
+    QFile keyFile(m_keyFileName);
+    m_keyFileModified = QFileInfo(m_keyFileName).lastModified();
+    if (!keyFile.open(QFile::ReadOnly)) {
+        qCWarning(dcAuthentication()) << "Could not open session ticket key file" << m_keyFileName << keyFile.errorString();
+        return false;
+    }
+
+    // Format: one <keyId>:<base64 secret> per line, the first key signs new tickets
+    QList<Key> keys;
+    int lineNumber = 0;
+    while (!keyFile.atEnd()) {
+        QByteArray line = keyFile.readLine().trimmed();
+        lineNumber++;
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        int separator = line.indexOf(':');
+        Key key;
+        key.id = line.left(separator);
+        key.secret = QByteArray::fromBase64(line.mid(separator + 1));
+        key.creationTime = QDateTime::currentMSecsSinceEpoch();
+        if (separator <= 0 || key.secret.size() < 16) {
+            qCWarning(dcAuthentication()) << "Invalid session ticket key in" << m_keyFileName << "line" << lineNumber;
+            continue;
+        }
+
+        keys.append(key);
+    }
+
+    if (keys.isEmpty()) {
+        qCWarning(dcAuthentication()) << "No valid session ticket key found in" << m_keyFileName << ". Keeping the current keys.";
+        return false;
+    }
+
+    qCDebug(dcAuthentication()) << "Loaded" << keys.count() << "session ticket keys from" << m_keyFileName;
+    m_keys = keys;
+    return true;
+}
+
+void SessionTicketManager::rotateKey()
+{
+    Key key;
+    key.id = QUuid::createUuid().toRfc4122().left(4).toHex();
+    // The key signs the tickets, so it has to come from a secure random source
+    key.secret = SecureRandom::bytes(32);
+    if (key.secret.isEmpty()) {
+        qCWarning(dcAuthentication()) << "Could not create a new session ticket key. Keeping the current keys.";
+        return;
+    }
+
+    key.creationTime = QDateTime::currentMSecsSinceEpoch();
+
+    // Keep the previous key, so tickets issued shortly before stay valid
+    m_keys.prepend(key);
+    while (m_keys.count() > 2)
+        m_keys.removeLast();
+
+    qCDebug(dcAuthentication()) << "Rotated session ticket key" << key.id;
+}
+
+}
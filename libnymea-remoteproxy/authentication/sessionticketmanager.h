@@ -0,0 +1,92 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SESSIONTICKETMANAGER_H
+#define SESSIONTICKETMANAGER_H
+
+#include <QList>
+#include <QString>
+#include <QDateTime>
+#include <QByteArray>
+#include <QVariantMap>
+
+namespace remoteproxy {
+
+// Issues and verifies HMAC-SHA256 signed session tickets. A ticket binds the
+// user information to the token hash, so a reconnecting client presenting a
+// valid ticket together with its token can be authenticated locally. Nodes
+// sharing the same key file accept each others tickets.
+class SessionTicketManager
+{
+public:
+    SessionTicketManager();
+
+    int lifetime() const;
+    void setLifetime(int lifetime);
+
+    bool isEnabled() const;
+
+    QString keyFileName() const;
+    void setKeyFileName(const QString &keyFileName);
+
+    int keyCount() const;
+
+    QString createTicket(const QByteArray &tokenHash, const QString &userName);
+    bool verifyTicket(const QString &ticket, const QByteArray &tokenHash, QString *userName = nullptr);
+
+    void tick();
+    QVariantMap currentStatistics() const;
+
+private:
+    class Key
+    {
+    public:
+        QByteArray id;
+        QByteArray secret;
+        qint64 creationTime = 0;
+    };
+
+    // The first key signs new tickets, all of them are accepted for verification
+    QList<Key> m_keys;
+
+    QString m_keyFileName;
+    QDateTime m_keyFileModified;
+
+    int m_lifetime = 0;
+
+    quint64 m_issuedCount = 0;
+    quint64 m_acceptedCount = 0;
+    quint64 m_rejectedCount = 0;
+
+    bool loadKeyFile();
+    void rotateKey();
+
+};
+
+}
+
+#endif // SESSIONTICKETMANAGER_H
@@ -0,0 +1,323 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "tokendatabase.h"
+#include "loggingcategories.h"
+
+#include <QFile>
+#include <QVariant>
+#include <QSaveFile>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <QCryptographicHash>
+
+#include <limits>
+
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace remoteproxy {
+
+static const char s_magic[] = "NRPTOKDB";
+static const int s_magicSize = 8;
+static const quint32 s_version = 1;
+static const int s_headerSize = 64;
+static const int s_hashSize = 32;
+static const int s_bucketSize = 48;
+static const quint32 s_bucketUsed = 0x1;
+
+TokenDatabase::TokenDatabase()
+{
+
+}
+
+TokenDatabase::~TokenDatabase()
+{
+    close();
+}
+
+bool TokenDatabase::open(const QString &fileName)
+{
+    close();
+    m_fileName = fileName;
+    m_errorString.clear();
+
+    int fileDescriptor = ::open(QFile::encodeName(fileName).constData(), O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor < 0) {
+        m_errorString = QString("Could not open token database %1: %2").arg(fileName).arg(strerror(errno));
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) < 0) {
+        m_errorString = QString("Could not read token database %1: %2").arg(fileName).arg(strerror(errno));
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    if (fileStatus.st_size < s_headerSize) {
+        m_errorString = QString("Token database %1 is too small.").arg(fileName);
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    if (static_cast<quint64>(fileStatus.st_size) > static_cast<quint64>(std::numeric_limits<size_t>::max())) {
+        m_errorString = QString("Token database %1 is too large to be mapped.").arg(fileName);
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    void *data = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_SHARED, fileDescriptor, 0);
+
+    // The mapping stays valid after closing the file descriptor
+    ::close(fileDescriptor);
+
+    if (data == MAP_FAILED) {
+        m_errorString = QString("Could not map token database %1: %2").arg(fileName).arg(strerror(errno));
+        return false;
+    }
+
+    m_data = static_cast<const uchar *>(data);
+    m_size = fileStatus.st_size;
+
+    if (!validate()) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void TokenDatabase::close()
+{
+    if (m_data)
+        munmap(const_cast<uchar *>(m_data), static_cast<size_t>(m_size));
+
+    m_data = nullptr;
+    m_size = 0;
+    m_bucketCount = 0;
+    m_entryCount = 0;
+    m_dataOffset = 0;
+}
+
+bool TokenDatabase::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+QString TokenDatabase::fileName() const
+{
+    return m_fileName;
+}
+
+QString TokenDatabase::errorString() const
+{
+    return m_errorString;
+}
+
+int TokenDatabase::entryCount() const
+{
+    return static_cast<int>(m_entryCount);
+}
+
+int TokenDatabase::bucketCount() const
+{
+    return static_cast<int>(m_bucketCount);
+}
+
+bool TokenDatabase::lookup(const QByteArray &tokenHash, UserInformation *userInformation) const
+{
+    if (!isOpen() || tokenHash.size() != s_hashSize)
+        return false;
+
+    const uchar *hash = reinterpret_cast<const uchar *>(tokenHash.constData());
+    quint64 mask = m_bucketCount - 1;
+    quint64 index = qFromLittleEndian<quint64>(hash) & mask;
+
+    // Linear probing until the hash or an empty bucket has been found
+    for (quint32 probe = 0; probe < m_bucketCount; probe++) {
+        quint64 bucketOffset = s_headerSize + ((index + probe) & mask) * s_bucketSize;
+        if (bucketOffset + s_bucketSize > m_dataOffset) {
+            qCWarning(dcTokenDatabase()) << "Invalid bucket offset in" << m_fileName;
+            return false;
+        }
+
+        const uchar *bucket = m_data + bucketOffset;
+        if (!(qFromLittleEndian<quint32>(bucket + 44) & s_bucketUsed))
+            return false;
+
+        if (memcmp(bucket, hash, s_hashSize) != 0)
+            continue;
+
+        if (userInformation) {
+            // Compare without adding up, a corrupted offset must not wrap around
+            quint64 dataSize = static_cast<quint64>(m_size) - m_dataOffset;
+            quint64 offset = qFromLittleEndian<quint64>(bucket + 32);
+            quint32 length = qFromLittleEndian<quint32>(bucket + 40);
+            if (offset > dataSize || length > dataSize - offset || length > static_cast<quint32>(std::numeric_limits<int>::max())) {
+                qCWarning(dcTokenDatabase()) << "Invalid user information offset in" << m_fileName;
+                return false;
+            }
+
+            QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(m_data + m_dataOffset + offset), static_cast<int>(length));
+            QVariantMap userMap = QJsonDocument::fromJson(data).toVariant().toMap();
+            *userInformation = UserInformation(userMap.value("email").toString(),
+                                               userMap.value("cognitoUsername").toString(),
+                                               userMap.value("vendorId").toString(),
+                                               userMap.value("userPoolId").toString());
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+QByteArray TokenDatabase::hashToken(const QString &token)
+{
+    return QCryptographicHash::hash(token.toUtf8(), QCryptographicHash::Sha256);
+}
+
+bool TokenDatabase::writeDatabase(const QString &fileName, const QHash<QByteArray, UserInformation> &entries, QString *errorString)
+{
+    // Keep the load factor below 0.5
+    quint32 bucketCount = 16;
+    while (bucketCount < static_cast<quint32>(entries.count()) * 2)
+        bucketCount <<= 1;
+
+    QByteArray buckets(static_cast<int>(bucketCount) * s_bucketSize, '\0');
+    QByteArray data;
+
+    quint64 mask = bucketCount - 1;
+    foreach (const QByteArray &tokenHash, entries.keys()) {
+        if (tokenHash.size() != s_hashSize) {
+            if (errorString) *errorString = QString("Invalid token hash size %1.").arg(tokenHash.size());
+            return false;
+        }
+
+        UserInformation userInformation = entries.value(tokenHash);
+        QJsonObject userObject;
+        userObject.insert("email", userInformation.email());
+        userObject.insert("cognitoUsername", userInformation.cognitoUsername());
+        userObject.insert("vendorId", userInformation.vendorId());
+        userObject.insert("userPoolId", userInformation.userPoolId());
+        QByteArray userData = QJsonDocument(userObject).toJson(QJsonDocument::Compact);
+
+        quint64 index = qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(tokenHash.constData())) & mask;
+        uchar *bucket = reinterpret_cast<uchar *>(buckets.data()) + index * s_bucketSize;
+        while (qFromLittleEndian<quint32>(bucket + 44) & s_bucketUsed) {
+            index = (index + 1) & mask;
+            bucket = reinterpret_cast<uchar *>(buckets.data()) + index * s_bucketSize;
+        }
+
+        memcpy(bucket, tokenHash.constData(), s_hashSize);
+        qToLittleEndian<quint64>(static_cast<quint64>(data.size()), bucket + 32);
+        qToLittleEndian<quint32>(static_cast<quint32>(userData.size()), bucket + 40);
+        qToLittleEndian<quint32>(s_bucketUsed, bucket + 44);
+        data.append(userData);
+    }
+
+    QByteArray body = buckets + data;
+
+    QByteArray header(s_headerSize, '\0');
+    uchar *headerData = reinterpret_cast<uchar *>(header.data());
+    memcpy(headerData, s_magic, s_magicSize);
+    qToLittleEndian<quint32>(s_version, headerData + 8);
+    qToLittleEndian<quint32>(bucketCount, headerData + 12);
+    qToLittleEndian<quint32>(static_cast<quint32>(entries.count()), headerData + 16);
+    qToLittleEndian<quint64>(static_cast<quint64>(s_headerSize + buckets.size()), headerData + 24);
+    QByteArray checksum = QCryptographicHash::hash(body, QCryptographicHash::Sha256);
+    memcpy(headerData + 32, checksum.constData(), s_hashSize);
+
+    // Write into a temporary file and rename it, running servers never see a partial file
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorString) *errorString = file.errorString();
+        return false;
+    }
+
+    file.write(header);
+    file.write(body);
+    if (!file.commit()) {
+        if (errorString) *errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool TokenDatabase::validate()
+{
+    if (memcmp(m_data, s_magic, s_magicSize) != 0) {
+        m_errorString = QString("%1 is not a token database.").arg(m_fileName);
+        return false;
+    }
+
+    quint32 version = qFromLittleEndian<quint32>(m_data + 8);
+    if (version != s_version) {
+        m_errorString = QString("Unsupported token database version %1.").arg(version);
+        return false;
+    }
+
+    m_bucketCount = qFromLittleEndian<quint32>(m_data + 12);
+    m_entryCount = qFromLittleEndian<quint32>(m_data + 16);
+    m_dataOffset = qFromLittleEndian<quint64>(m_data + 24);
+
+    if (m_bucketCount == 0 || (m_bucketCount & (m_bucketCount - 1)) != 0 || m_entryCount >= m_bucketCount) {
+        m_errorString = QString("Invalid bucket count %1 for %2 entries.").arg(m_bucketCount).arg(m_entryCount);
+        return false;
+    }
+
+    if (m_dataOffset != static_cast<quint64>(s_headerSize) + static_cast<quint64>(m_bucketCount) * s_bucketSize || m_dataOffset > static_cast<quint64>(m_size)) {
+        m_errorString = QString("Invalid data offset in token database %1.").arg(m_fileName);
+        return false;
+    }
+
+    // The file may exceed the size of a QByteArray, hash it in chunks
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    qint64 position = s_headerSize;
+    while (position < m_size) {
+        int chunkSize = static_cast<int>(qMin<qint64>(m_size - position, 1024 * 1024));
+        hash.addData(reinterpret_cast<const char *>(m_data + position), chunkSize);
+        position += chunkSize;
+    }
+
+    QByteArray checksum = hash.result();
+    if (memcmp(checksum.constData(), m_data + 32, s_hashSize) != 0) {
+        m_errorString = QString("Checksum mismatch in token database %1.").arg(m_fileName);
+        return false;
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TOKENDATABASE_H
+#define TOKENDATABASE_H
+
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+#include "authentication/aws/userinformation.h"
+
+namespace remoteproxy {
+
+// Read only token database file. The file contains an open addressing hash table of
+// SHA-256 token hashes and gets memory mapped, so lookups do not require any parsing
+// or copying of the file content. The file has to be replaced atomically, never modified in place.
+//
+// Layout (little endian):
+//   Header  (64 bytes): magic "NRPTOKDB", version, bucket count, entry count, reserved, data offset, SHA-256 of the body
+//   Buckets (48 bytes each): token hash (32), data offset (8), data length (4), flags (4)
+//   Data: compact JSON objects containing the user information
+
+class TokenDatabase
+{
+public:
+    TokenDatabase();
+    ~TokenDatabase();
+
+    bool open(const QString &fileName);
+    void close();
+
+    bool isOpen() const;
+    QString fileName() const;
+    QString errorString() const;
+
+    int entryCount() const;
+    int bucketCount() const;
+
+    bool lookup(const QByteArray &tokenHash, UserInformation *userInformation = nullptr) const;
+
+    // Same hash as ProxyClient::tokenHash()
+    static QByteArray hashToken(const QString &token);
+    static bool writeDatabase(const QString &fileName, const QHash<QByteArray, UserInformation> &entries, QString *errorString = nullptr);
+
+private:
+    Q_DISABLE_COPY(TokenDatabase)
+
+    QString m_fileName;
+    QString m_errorString;
+
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+
+    quint32 m_bucketCount = 0;
+    quint32 m_entryCount = 0;
+    quint64 m_dataOffset = 0;
+
+    bool validate();
+
+};
+
+}
+
+#endif // TOKENDATABASE_H
@@ -0,0 +1,171 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "loggingcategories.h"
+#include "tokendatabaseauthenticator.h"
+#include "authentication/authenticationreply.h"
+
+#include <QFileInfo>
+
+namespace remoteproxy {
+
+TokenDatabaseAuthenticator::TokenDatabaseAuthenticator(const QString &fileName, QObject *parent) :
+    Authenticator(parent),
+    m_fileName(QFileInfo(fileName).absoluteFilePath())
+{
+    // Collect multiple change notifications before reloading
+    m_reloadTimer = new QTimer(this);
+    m_reloadTimer->setSingleShot(true);
+    m_reloadTimer->setInterval(200);
+    connect(m_reloadTimer, &QTimer::timeout, this, &TokenDatabaseAuthenticator::reload);
+
+    // Watch the directory too, replacing the file by renaming removes the file watch
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &TokenDatabaseAuthenticator::onFileChanged);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &TokenDatabaseAuthenticator::onFileChanged);
+    updateWatcher();
+
+    reload();
+}
+
+TokenDatabaseAuthenticator::~TokenDatabaseAuthenticator()
+{
+    delete m_loader;
+    delete m_database;
+}
+
+QString TokenDatabaseAuthenticator::name() const
+{
+    return "Token database authenticator";
+}
+
+QString TokenDatabaseAuthenticator::fileName() const
+{
+    return m_fileName;
+}
+
+bool TokenDatabaseAuthenticator::isLoaded() const
+{
+    return m_database != nullptr;
+}
+
+int TokenDatabaseAuthenticator::entryCount() const
+{
+    if (!m_database)
+        return 0;
+
+    return m_database->entryCount();
+}
+
+void TokenDatabaseAuthenticator::updateWatcher()
+{
+    QString directoryName = QFileInfo(m_fileName).absolutePath();
+    if (!m_watcher->directories().contains(directoryName))
+        m_watcher->addPath(directoryName);
+
+    if (!m_watcher->files().contains(m_fileName) && QFileInfo(m_fileName).exists())
+        m_watcher->addPath(m_fileName);
+}
+
+void TokenDatabaseAuthenticator::onFileChanged()
+{
+    m_reloadTimer->start();
+}
+
+void TokenDatabaseAuthenticator::onLoaderFinished()
+{
+    TokenDatabase *database = m_loader->takeDatabase();
+    QString errorString = m_loader->errorString();
+    m_loader->deleteLater();
+    m_loader = nullptr;
+
+    if (!database) {
+        // Keep using the current database
+        qCWarning(dcTokenDatabase()) << "Could not load token database:" << errorString;
+        emit databaseLoadingFailed(errorString);
+    } else {
+        qCDebug(dcTokenDatabase()) << "Loaded token database" << m_fileName << "with" << database->entryCount() << "entries";
+        delete m_database;
+        m_database = database;
+        emit databaseLoaded(m_database->entryCount());
+    }
+
+    // The file changed while loading
+    if (m_reloadPending) {
+        m_reloadPending = false;
+        reload();
+    }
+}
+
+void TokenDatabaseAuthenticator::reload()
+{
+    updateWatcher();
+
+    if (m_loader) {
+        m_reloadPending = true;
+        return;
+    }
+
+    if (!QFileInfo(m_fileName).exists()) {
+        qCWarning(dcTokenDatabase()) << "Token database" << m_fileName << "does not exist.";
+        return;
+    }
+
+    qCDebug(dcTokenDatabase()) << "Loading token database" << m_fileName;
+    m_loader = new TokenDatabaseLoader(m_fileName, this);
+    connect(m_loader, &TokenDatabaseLoader::finished, this, &TokenDatabaseAuthenticator::onLoaderFinished);
+    m_loader->start();
+}
+
+AuthenticationReply *TokenDatabaseAuthenticator::authenticate(ProxyClient *proxyClient)
+{
+    qCDebug(dcAuthentication()) << name() << "validate" << proxyClient;
+    AuthenticationReply *reply = createAuthenticationReply(proxyClient, proxyClient);
+
+    if (!m_database) {
+        qCWarning(dcAuthentication()) << name() << "There is no token database loaded.";
+        setReplyError(reply, AuthenticationErrorProxyError);
+        setReplyFinished(reply);
+        return reply;
+    }
+
+    UserInformation userInformation;
+    if (!m_database->lookup(proxyClient->tokenHash(), &userInformation)) {
+        qCDebug(dcAuthentication()) << name() << "Unknown token for" << proxyClient;
+        setReplyError(reply, AuthenticationErrorAuthenticationFailed);
+        setReplyFinished(reply);
+        return reply;
+    }
+
+    proxyClient->setUserName(userInformation.email());
+
+    setReplyError(reply, AuthenticationErrorNoError);
+    setReplyFinished(reply);
+    return reply;
+}
+
+}
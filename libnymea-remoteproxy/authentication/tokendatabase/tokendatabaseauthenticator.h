@@ -0,0 +1,81 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TOKENDATABASEAUTHENTICATOR_H
+#define TOKENDATABASEAUTHENTICATOR_H
+
+#include <QTimer>
+#include <QObject>
+#include <QFileSystemWatcher>
+
+#include "proxyclient.h"
+#include "tokendatabase.h"
+#include "tokendatabaseloader.h"
+#include "authentication/authenticator.h"
+
+namespace remoteproxy {
+
+class TokenDatabaseAuthenticator : public Authenticator
+{
+    Q_OBJECT
+public:
+    explicit TokenDatabaseAuthenticator(const QString &fileName, QObject *parent = nullptr);
+    ~TokenDatabaseAuthenticator() override;
+
+    QString name() const override;
+
+    QString fileName() const;
+    bool isLoaded() const;
+    int entryCount() const;
+
+private:
+    QString m_fileName;
+    TokenDatabase *m_database = nullptr;
+    TokenDatabaseLoader *m_loader = nullptr;
+    QFileSystemWatcher *m_watcher = nullptr;
+    QTimer *m_reloadTimer = nullptr;
+    bool m_reloadPending = false;
+
+    void updateWatcher();
+
+signals:
+    void databaseLoaded(int entryCount);
+    void databaseLoadingFailed(const QString &errorString);
+
+private slots:
+    void onFileChanged();
+    void onLoaderFinished();
+
+public slots:
+    void reload();
+    AuthenticationReply *authenticate(ProxyClient *proxyClient) override;
+
+};
+
+}
+
+#endif // TOKENDATABASEAUTHENTICATOR_H
@@ -0,0 +1,77 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "clusterauthentication.h"
+#include "securerandom.h"
+#include "loggingcategories.h"
+
+#include <QFile>
+#include <QMessageAuthenticationCode>
+
+namespace remoteproxy {
+
+QByteArray ClusterAuthentication::loadSecret(const QString &fileName)
+{
+    QFile secretFile(fileName);
+    if (!secretFile.open(QFile::ReadOnly)) {
+        qCWarning(dcCluster()) << "Could not open cluster secret file" << fileName << secretFile.errorString();
+        return QByteArray();
+    }
+
+    QByteArray secret = secretFile.readAll().trimmed();
+    if (secret.isEmpty())
+        qCWarning(dcCluster()) << "The cluster secret file" << fileName << "is empty";
+
+    return secret;
+}
+
+QByteArray ClusterAuthentication::createChallenge()
+{
+    return SecureRandom::bytes(32);
+}
+
+QByteArray ClusterAuthentication::response(const QByteArray &secret, Role role, const QByteArray &challenge)
+{
+    QByteArray message = (role == RoleAcceptor ? QByteArray("nymea-remoteproxy-cluster-acceptor") : QByteArray("nymea-remoteproxy-cluster-connector"));
+    return QMessageAuthenticationCode::hash(message + ':' + challenge, secret, QCryptographicHash::Sha256);
+}
+
+bool ClusterAuthentication::verifyResponse(const QByteArray &secret, Role role, const QByteArray &challenge, const QByteArray &response)
+{
+    // Never accept a missing challenge, and compare in constant time
+    QByteArray expected = ClusterAuthentication::response(secret, role, challenge);
+    if (secret.isEmpty() || challenge.isEmpty() || response.size() != expected.size())
+        return false;
+
+    char difference = 0;
+    for (int i = 0; i < expected.size(); i++)
+        difference |= static_cast<char>(expected.at(i) ^ response.at(i));
+
+    return difference == 0;
+}
+
+}
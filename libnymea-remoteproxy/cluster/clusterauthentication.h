@@ -0,0 +1,58 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CLUSTERAUTHENTICATION_H
+#define CLUSTERAUTHENTICATION_H
+
+#include <QString>
+#include <QByteArray>
+
+namespace remoteproxy {
+
+// Challenge response authentication of the cluster connections using the secret shared by all nodes
+class ClusterAuthentication
+{
+public:
+    // Both ends of a connection prove the knowledge of the secret, each using its own role.
+    // A response can therefore never be reflected to the peer which sent the challenge.
+    enum Role {
+        RoleAcceptor,
+        RoleConnector
+    };
+
+    // Returns an empty byte array if the file could not be read or contains no secret
+    static QByteArray loadSecret(const QString &fileName);
+
+    static QByteArray createChallenge();
+    static QByteArray response(const QByteArray &secret, Role role, const QByteArray &challenge);
+    static bool verifyResponse(const QByteArray &secret, Role role, const QByteArray &challenge, const QByteArray &response);
+
+};
+
+}
+
+#endif // CLUSTERAUTHENTICATION_H
@@ -0,0 +1,288 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "clusterclient.h"
+#include "clusterauthentication.h"
+#include "loggingcategories.h"
+
+#include <QTcpSocket>
+#include <QLocalSocket>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+
+namespace remoteproxy {
+
+ClusterClient::ClusterClient(const QString &nodeId, const QString &linkAddress, const QByteArray &secret, QObject *parent) :
+    QObject(parent),
+    m_nodeId(nodeId),
+    m_linkAddress(linkAddress),
+    m_secret(secret)
+{
+    m_reconnectTimer.setSingleShot(true);
+    m_reconnectTimer.setInterval(5000);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &ClusterClient::reconnect);
+}
+
+ClusterClient::~ClusterClient()
+{
+    disconnectCoordinator();
+}
+
+QString ClusterClient::nodeId() const
+{
+    return m_nodeId;
+}
+
+QString ClusterClient::linkAddress() const
+{
+    return m_linkAddress;
+}
+
+bool ClusterClient::isConnected() const
+{
+    return m_connected;
+}
+
+int ClusterClient::registrationCount() const
+{
+    return m_registrations.count();
+}
+
+void ClusterClient::connectCoordinator(const QUrl &coordinatorUrl)
+{
+    disconnectCoordinator();
+    m_coordinatorUrl = coordinatorUrl;
+    reconnect();
+}
+
+void ClusterClient::disconnectCoordinator()
+{
+    m_reconnectTimer.stop();
+    m_registrations.clear();
+
+    if (!m_connection)
+        return;
+
+    disconnect(m_connection, nullptr, this, nullptr);
+    m_connection->close();
+    m_connection->deleteLater();
+    m_connection = nullptr;
+    m_buffer.clear();
+    m_challenge.clear();
+
+    if (m_connected) {
+        m_connected = false;
+        emit connectedChanged(m_connected);
+    }
+}
+
+void ClusterClient::registerTunnel(const QString &tunnelHash)
+{
+    m_registrations.insert(tunnelHash);
+    if (!m_connected)
+        return;
+
+    QVariantMap message;
+    message.insert("command", "Register");
+    message.insert("tunnel", tunnelHash);
+    sendMessage(message);
+}
+
+void ClusterClient::unregisterTunnel(const QString &tunnelHash)
+{
+    if (!m_registrations.remove(tunnelHash) || !m_connected)
+        return;
+
+    QVariantMap message;
+    message.insert("command", "Unregister");
+    message.insert("tunnel", tunnelHash);
+    sendMessage(message);
+}
+
+QString ClusterClient::tunnelHash(const QString &tunnelIdentifier)
+{
+    // The coordinator never sees the token itself
+    return QString::fromLatin1(QCryptographicHash::hash(tunnelIdentifier.toUtf8(), QCryptographicHash::Sha256).toHex());
+}
+
+void ClusterClient::sendMessage(const QVariantMap &message)
+{
+    qCDebug(dcClusterTraffic()) << "Node --> sending" << message;
+    m_connection->write(QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void ClusterClient::processMessage(const QVariantMap &message)
+{
+    qCDebug(dcClusterTraffic()) << "Node <-- received" << message;
+
+    // Answer the challenge of the coordinator and send an own one
+    if (message.value("event").toString() == "Challenge") {
+        if (!m_challenge.isEmpty())
+            return;
+
+        QByteArray challenge = QByteArray::fromHex(message.value("challenge").toByteArray());
+        m_challenge = ClusterAuthentication::createChallenge();
+
+        QVariantMap helloMessage;
+        helloMessage.insert("command", "Hello");
+        helloMessage.insert("node", m_nodeId);
+        helloMessage.insert("address", m_linkAddress);
+        helloMessage.insert("response", QString::fromLatin1(ClusterAuthentication::response(m_secret, ClusterAuthentication::RoleConnector, challenge).toHex()));
+        helloMessage.insert("challenge", QString::fromLatin1(m_challenge.toHex()));
+        sendMessage(helloMessage);
+        return;
+    }
+
+    if (message.value("event").toString() == "Welcome") {
+        QByteArray response = QByteArray::fromHex(message.value("response").toByteArray());
+        if (m_connected || !ClusterAuthentication::verifyResponse(m_secret, ClusterAuthentication::RoleAcceptor, m_challenge, response)) {
+            qCWarning(dcCluster()) << "The cluster coordinator" << m_coordinatorUrl.toString() << "failed to authenticate. Closing the connection.";
+            m_connection->close();
+            return;
+        }
+
+        setAuthenticated();
+        return;
+    }
+
+    if (!m_connected) {
+        qCWarning(dcCluster()) << "Ignoring message from the unauthenticated cluster coordinator" << message;
+        return;
+    }
+
+    if (message.value("event").toString() == "Matched") {
+        QString tunnelHash = message.value("tunnel").toString();
+        if (!m_registrations.remove(tunnelHash))
+            return;
+
+        emit tunnelMatched(tunnelHash, message.value("node").toString(), message.value("address").toString());
+        return;
+    }
+
+    qCWarning(dcCluster()) << "Unknown message from cluster coordinator" << message;
+}
+
+void ClusterClient::setAuthenticated()
+{
+    qCDebug(dcCluster()) << "Joined the cluster of coordinator" << m_coordinatorUrl.toString() << "as node" << m_nodeId;
+    m_connected = true;
+
+    // Registrations made while the coordinator was not reachable
+    foreach (const QString &tunnelHash, m_registrations) {
+        QVariantMap registerMessage;
+        registerMessage.insert("command", "Register");
+        registerMessage.insert("tunnel", tunnelHash);
+        sendMessage(registerMessage);
+    }
+
+    emit connectedChanged(m_connected);
+}
+
+void ClusterClient::onConnected()
+{
+    // The node joins the cluster once both ends proved the knowledge of the secret
+    qCDebug(dcCluster()) << "Connected to cluster coordinator" << m_coordinatorUrl.toString() << "Waiting for the challenge.";
+}
+
+void ClusterClient::onDisconnected()
+{
+    QLocalSocket *localSocket = qobject_cast<QLocalSocket *>(m_connection);
+    if (localSocket && localSocket->state() != QLocalSocket::UnconnectedState)
+        return;
+
+    QTcpSocket *tcpSocket = qobject_cast<QTcpSocket *>(m_connection);
+    if (tcpSocket && tcpSocket->state() != QAbstractSocket::UnconnectedState)
+        return;
+
+    qCWarning(dcCluster()) << "Connection to cluster coordinator" << m_coordinatorUrl.toString() << "lost. Reconnecting in" << m_reconnectTimer.interval() << "[ms]";
+
+    disconnect(m_connection, nullptr, this, nullptr);
+    m_connection->deleteLater();
+    m_connection = nullptr;
+    m_buffer.clear();
+    m_challenge.clear();
+    m_reconnectTimer.start();
+
+    if (m_connected) {
+        m_connected = false;
+        emit connectedChanged(m_connected);
+    }
+}
+
+void ClusterClient::onReadyRead()
+{
+    m_buffer.append(m_connection->readAll());
+
+    int index = m_buffer.indexOf('\n');
+    while (index >= 0) {
+        QByteArray line = m_buffer.left(index);
+        m_buffer.remove(0, index + 1);
+
+        QJsonParseError error;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(line, &error);
+        if (error.error != QJsonParseError::NoError) {
+            qCWarning(dcCluster()) << "Failed to parse message from cluster coordinator:" << error.errorString();
+        } else {
+            processMessage(jsonDoc.toVariant().toMap());
+        }
+
+        index = m_buffer.indexOf('\n');
+    }
+}
+
+void ClusterClient::reconnect()
+{
+    if (m_connection)
+        return;
+
+    if (m_secret.isEmpty()) {
+        qCWarning(dcCluster()) << "There is no cluster secret. Refusing to connect to the cluster coordinator" << m_coordinatorUrl.toString();
+        return;
+    }
+
+    qCDebug(dcCluster()) << "Connecting to cluster coordinator" << m_coordinatorUrl.toString();
+
+    if (m_coordinatorUrl.scheme() == "unix") {
+        QLocalSocket *socket = new QLocalSocket(this);
+        connect(socket, &QLocalSocket::connected, this, &ClusterClient::onConnected);
+        connect(socket, &QLocalSocket::stateChanged, this, &ClusterClient::onDisconnected);
+        connect(socket, &QLocalSocket::readyRead, this, &ClusterClient::onReadyRead);
+        m_connection = socket;
+        socket->connectToServer(m_coordinatorUrl.path());
+    } else if (m_coordinatorUrl.scheme() == "tcp") {
+        QTcpSocket *socket = new QTcpSocket(this);
+        connect(socket, &QTcpSocket::connected, this, &ClusterClient::onConnected);
+        connect(socket, &QTcpSocket::stateChanged, this, &ClusterClient::onDisconnected);
+        connect(socket, &QTcpSocket::readyRead, this, &ClusterClient::onReadyRead);
+        m_connection = socket;
+        socket->connectToHost(m_coordinatorUrl.host(), static_cast<quint16>(m_coordinatorUrl.port()));
+    } else {
+        qCWarning(dcCluster()) << "Invalid cluster coordinator url" << m_coordinatorUrl.toString() << "Use unix:<path> or tcp://<host>:<port>.";
+    }
+}
+
+}
@@ -0,0 +1,96 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CLUSTERCLIENT_H
+#define CLUSTERCLIENT_H
+
+#include <QUrl>
+#include <QSet>
+#include <QTimer>
+#include <QObject>
+#include <QIODevice>
+#include <QVariantMap>
+
+namespace remoteproxy {
+
+class ClusterClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ClusterClient(const QString &nodeId, const QString &linkAddress, const QByteArray &secret, QObject *parent = nullptr);
+    ~ClusterClient();
+
+    QString nodeId() const;
+    QString linkAddress() const;
+
+    bool isConnected() const;
+    int registrationCount() const;
+
+    void connectCoordinator(const QUrl &coordinatorUrl);
+    void disconnectCoordinator();
+
+    // Register a client waiting for its tunnel partner in the cluster wide rendezvous directory
+    void registerTunnel(const QString &tunnelHash);
+    void unregisterTunnel(const QString &tunnelHash);
+
+    static QString tunnelHash(const QString &tunnelIdentifier);
+
+private:
+    QString m_nodeId;
+    QString m_linkAddress;
+    QByteArray m_secret;
+    QUrl m_coordinatorUrl;
+
+    QIODevice *m_connection = nullptr;
+    QTimer m_reconnectTimer;
+    bool m_connected = false;
+    QByteArray m_buffer;
+
+    // The challenge sent with the Hello, the coordinator has to answer it
+    QByteArray m_challenge;
+
+    QSet<QString> m_registrations;
+
+    void sendMessage(const QVariantMap &message);
+    void processMessage(const QVariantMap &message);
+    void setAuthenticated();
+
+signals:
+    void connectedChanged(bool connected);
+    void tunnelMatched(const QString &tunnelHash, const QString &nodeId, const QString &linkAddress);
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onReadyRead();
+    void reconnect();
+
+};
+
+}
+
+#endif // CLUSTERCLIENT_H
@@ -0,0 +1,302 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "clustercoordinator.h"
+#include "clusterauthentication.h"
+#include "loggingcategories.h"
+
+#include <QFile>
+#include <QTcpSocket>
+#include <QLocalSocket>
+#include <QJsonDocument>
+
+namespace remoteproxy {
+
+ClusterCoordinator::ClusterCoordinator(const QUrl &serverUrl, const QByteArray &secret, QObject *parent) :
+    QObject(parent),
+    m_serverUrl(serverUrl),
+    m_secret(secret)
+{
+
+}
+
+ClusterCoordinator::~ClusterCoordinator()
+{
+    stopServer();
+}
+
+QUrl ClusterCoordinator::serverUrl() const
+{
+    return m_serverUrl;
+}
+
+bool ClusterCoordinator::running() const
+{
+    if (m_localServer)
+        return m_localServer->isListening();
+
+    if (m_tcpServer)
+        return m_tcpServer->isListening();
+
+    return false;
+}
+
+int ClusterCoordinator::nodeCount() const
+{
+    return m_nodes.count();
+}
+
+int ClusterCoordinator::registrationCount() const
+{
+    return m_registrations.count();
+}
+
+int ClusterCoordinator::matchCount() const
+{
+    return m_matchCount;
+}
+
+void ClusterCoordinator::setupConnection(QIODevice *connection)
+{
+    m_buffers.insert(connection, QByteArray());
+    connect(connection, &QIODevice::readyRead, this, &ClusterCoordinator::onNodeReadyRead);
+
+    // The node has to answer the challenge in its Hello
+    QByteArray challenge = ClusterAuthentication::createChallenge();
+    m_challenges.insert(connection, challenge);
+
+    QVariantMap event;
+    event.insert("event", "Challenge");
+    event.insert("challenge", QString::fromLatin1(challenge.toHex()));
+    sendMessage(connection, event);
+}
+
+void ClusterCoordinator::sendMessage(QIODevice *connection, const QVariantMap &message)
+{
+    qCDebug(dcClusterTraffic()) << "Coordinator --> sending" << message;
+    connection->write(QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void ClusterCoordinator::processMessage(QIODevice *connection, const QVariantMap &message)
+{
+    qCDebug(dcClusterTraffic()) << "Coordinator <-- received" << message;
+
+    QString command = message.value("command").toString();
+    if (!m_nodes.contains(connection)) {
+        QByteArray response = QByteArray::fromHex(message.value("response").toByteArray());
+        QByteArray nodeChallenge = QByteArray::fromHex(message.value("challenge").toByteArray());
+        if (command != "Hello" || nodeChallenge.isEmpty()
+                || !ClusterAuthentication::verifyResponse(m_secret, ClusterAuthentication::RoleConnector, m_challenges.take(connection), response)) {
+            qCWarning(dcCluster()) << "Cluster node" << message.value("node").toString() << "failed to authenticate. Closing the connection.";
+            connection->close();
+            return;
+        }
+
+        QVariantMap node;
+        node.insert("node", message.value("node"));
+        node.insert("address", message.value("address"));
+        m_nodes.insert(connection, node);
+        qCDebug(dcCluster()) << "Node" << node.value("node").toString() << "joined the cluster using link address" << node.value("address").toString();
+
+        // Prove the knowledge of the secret to the node as well
+        QVariantMap event;
+        event.insert("event", "Welcome");
+        event.insert("response", QString::fromLatin1(ClusterAuthentication::response(m_secret, ClusterAuthentication::RoleAcceptor, nodeChallenge).toHex()));
+        sendMessage(connection, event);
+        return;
+    }
+
+    QString tunnelHash = message.value("tunnel").toString();
+    if (tunnelHash.isEmpty()) {
+        qCWarning(dcCluster()) << "Invalid message from cluster node" << m_nodes.value(connection).value("node").toString() << message;
+        return;
+    }
+
+    if (command == "Register") {
+        QIODevice *waitingConnection = m_registrations.value(tunnelHash);
+        if (!waitingConnection || waitingConnection == connection) {
+            m_registrations.insert(tunnelHash, connection);
+            return;
+        }
+
+        // The partner is waiting on an other node, the later client has to join it there
+        m_registrations.remove(tunnelHash);
+        m_matchCount++;
+
+        QVariantMap waitingNode = m_nodes.value(waitingConnection);
+        qCDebug(dcCluster()) << "Tunnel partners met between node" << waitingNode.value("node").toString()
+                             << "and" << m_nodes.value(connection).value("node").toString();
+
+        QVariantMap event;
+        event.insert("event", "Matched");
+        event.insert("tunnel", tunnelHash);
+        event.insert("node", waitingNode.value("node"));
+        event.insert("address", waitingNode.value("address"));
+        sendMessage(connection, event);
+        return;
+    }
+
+    if (command == "Unregister") {
+        if (m_registrations.value(tunnelHash) == connection)
+            m_registrations.remove(tunnelHash);
+
+        return;
+    }
+
+    qCWarning(dcCluster()) << "Unknown command from cluster node" << m_nodes.value(connection).value("node").toString() << command;
+}
+
+void ClusterCoordinator::onLocalConnection()
+{
+    QLocalSocket *connection = m_localServer->nextPendingConnection();
+    connect(connection, &QLocalSocket::disconnected, this, &ClusterCoordinator::onNodeDisconnected);
+    setupConnection(connection);
+}
+
+void ClusterCoordinator::onTcpConnection()
+{
+    QTcpSocket *connection = m_tcpServer->nextPendingConnection();
+    connect(connection, &QTcpSocket::disconnected, this, &ClusterCoordinator::onNodeDisconnected);
+    setupConnection(connection);
+}
+
+void ClusterCoordinator::onNodeReadyRead()
+{
+    QIODevice *connection = qobject_cast<QIODevice *>(sender());
+    QByteArray buffer = m_buffers.value(connection) + connection->readAll();
+
+    int index = buffer.indexOf('\n');
+    while (index >= 0) {
+        QByteArray line = buffer.left(index);
+        buffer.remove(0, index + 1);
+
+        QJsonParseError error;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(line, &error);
+        if (error.error != QJsonParseError::NoError) {
+            qCWarning(dcCluster()) << "Failed to parse message from cluster node:" << error.errorString();
+        } else {
+            processMessage(connection, jsonDoc.toVariant().toMap());
+        }
+
+        // Processing the message might have closed this connection
+        if (!m_buffers.contains(connection))
+            return;
+
+        index = buffer.indexOf('\n');
+    }
+
+    m_buffers.insert(connection, buffer);
+}
+
+void ClusterCoordinator::onNodeDisconnected()
+{
+    QIODevice *connection = qobject_cast<QIODevice *>(sender());
+    qCDebug(dcCluster()) << "Node" << m_nodes.value(connection).value("node").toString() << "left the cluster";
+
+    foreach (const QString &tunnelHash, m_registrations.keys(connection)) {
+        m_registrations.remove(tunnelHash);
+    }
+
+    m_nodes.remove(connection);
+    m_buffers.remove(connection);
+    m_challenges.remove(connection);
+    connection->deleteLater();
+}
+
+bool ClusterCoordinator::startServer()
+{
+    if (m_secret.isEmpty()) {
+        qCWarning(dcCluster()) << "There is no cluster secret. Refusing to start the cluster coordinator.";
+        return false;
+    }
+
+    qCDebug(dcCluster()) << "Starting cluster coordinator on" << m_serverUrl.toString();
+
+    if (m_serverUrl.scheme() == "unix") {
+        if (QFile::exists(m_serverUrl.path())) {
+            qCDebug(dcCluster()) << "Clean up old coordinator socket";
+            QFile::remove(m_serverUrl.path());
+        }
+
+        m_localServer = new QLocalServer(this);
+        m_localServer->setSocketOptions(QLocalServer::UserAccessOption | QLocalServer::GroupAccessOption);
+        if (!m_localServer->listen(m_serverUrl.path())) {
+            qCWarning(dcCluster()) << "Could not start cluster coordinator on" << m_serverUrl.toString() << m_localServer->errorString();
+            delete m_localServer;
+            m_localServer = nullptr;
+            return false;
+        }
+
+        connect(m_localServer, &QLocalServer::newConnection, this, &ClusterCoordinator::onLocalConnection);
+    } else if (m_serverUrl.scheme() == "tcp") {
+        m_tcpServer = new QTcpServer(this);
+        if (!m_tcpServer->listen(QHostAddress(m_serverUrl.host()), static_cast<quint16>(m_serverUrl.port()))) {
+            qCWarning(dcCluster()) << "Could not start cluster coordinator on" << m_serverUrl.toString() << m_tcpServer->errorString();
+            delete m_tcpServer;
+            m_tcpServer = nullptr;
+            return false;
+        }
+
+        connect(m_tcpServer, &QTcpServer::newConnection, this, &ClusterCoordinator::onTcpConnection);
+    } else {
+        qCWarning(dcCluster()) << "Invalid cluster coordinator url" << m_serverUrl.toString() << "Use unix:<path> or tcp://<host>:<port>.";
+        return false;
+    }
+
+    qCDebug(dcCluster()) << "Cluster coordinator started successfully on" << m_serverUrl.toString();
+    return true;
+}
+
+void ClusterCoordinator::stopServer()
+{
+    foreach (QIODevice *connection, m_buffers.keys()) {
+        disconnect(connection, nullptr, this, nullptr);
+        connection->close();
+        connection->deleteLater();
+    }
+
+    m_nodes.clear();
+    m_buffers.clear();
+    m_challenges.clear();
+    m_registrations.clear();
+
+    if (m_localServer) {
+        qCDebug(dcCluster()) << "Stop cluster coordinator" << m_serverUrl.toString();
+        m_localServer->close();
+        delete m_localServer;
+        m_localServer = nullptr;
+    }
+
+    if (m_tcpServer) {
+        qCDebug(dcCluster()) << "Stop cluster coordinator" << m_serverUrl.toString();
+        m_tcpServer->close();
+        delete m_tcpServer;
+        m_tcpServer = nullptr;
+    }
+}
+
+}
@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CLUSTERCOORDINATOR_H
+#define CLUSTERCOORDINATOR_H
+
+#include <QUrl>
+#include <QHash>
+#include <QObject>
+#include <QIODevice>
+#include <QTcpServer>
+#include <QLocalServer>
+#include <QVariantMap>
+
+namespace remoteproxy {
+
+class ClusterCoordinator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ClusterCoordinator(const QUrl &serverUrl, const QByteArray &secret, QObject *parent = nullptr);
+    ~ClusterCoordinator();
+
+    QUrl serverUrl() const;
+    bool running() const;
+
+    int nodeCount() const;
+    int registrationCount() const;
+    int matchCount() const;
+
+private:
+    QUrl m_serverUrl;
+    QByteArray m_secret;
+    QLocalServer *m_localServer = nullptr;
+    QTcpServer *m_tcpServer = nullptr;
+
+    // Node connection, node information. Only nodes which answered the challenge are listed.
+    QHash<QIODevice *, QVariantMap> m_nodes;
+    QHash<QIODevice *, QByteArray> m_buffers;
+    QHash<QIODevice *, QByteArray> m_challenges;
+
+    // Tunnel hash, node connection waiting for the partner
+    QHash<QString, QIODevice *> m_registrations;
+
+    int m_matchCount = 0;
+
+    void setupConnection(QIODevice *connection);
+    void sendMessage(QIODevice *connection, const QVariantMap &message);
+    void processMessage(QIODevice *connection, const QVariantMap &message);
+
+private slots:
+    void onLocalConnection();
+    void onTcpConnection();
+    void onNodeReadyRead();
+    void onNodeDisconnected();
+
+public slots:
+    bool startServer();
+    void stopServer();
+
+};
+
+}
+
+#endif // CLUSTERCOORDINATOR_H
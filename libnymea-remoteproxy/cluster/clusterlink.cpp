@@ -0,0 +1,403 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "clusterlink.h"
+#include "loggingcategories.h"
+
+#include <QDataStream>
+#include <QJsonDocument>
+#include <QMetaObject>
+
+namespace remoteproxy {
+
+ClusterLink::ClusterLink(const QHostAddress &host, quint16 port, const QByteArray &secret, QObject *parent) :
+    TransportInterface(parent),
+    m_host(host),
+    m_port(port),
+    m_secret(secret)
+{
+    m_serverName = "Cluster link";
+}
+
+ClusterLink::~ClusterLink()
+{
+    stopServer();
+}
+
+QHostAddress ClusterLink::host() const
+{
+    return m_host;
+}
+
+quint16 ClusterLink::port() const
+{
+    return m_port;
+}
+
+bool ClusterLink::running() const
+{
+    if (!m_server)
+        return false;
+
+    return m_server->isListening();
+}
+
+int ClusterLink::peerCount() const
+{
+    return m_authenticatedConnections.count();
+}
+
+int ClusterLink::remoteClientCount() const
+{
+    return m_remoteClients.count();
+}
+
+int ClusterLink::forwardedClientCount() const
+{
+    return m_forwardedClients.count();
+}
+
+void ClusterLink::sendData(const QUuid &clientId, const QByteArray &data)
+{
+    QTcpSocket *connection = m_remoteClients.value(clientId);
+    if (!connection) {
+        qCWarning(dcCluster()) << "Client" << clientId << "unknown to this transport";
+        return;
+    }
+
+    sendFrame(connection, FrameTypeData, clientId, data);
+}
+
+void ClusterLink::killClientConnection(const QUuid &clientId, const QString &killReason)
+{
+    QTcpSocket *connection = m_remoteClients.take(clientId);
+    if (!connection)
+        return;
+
+    qCDebug(dcCluster()) << "Closing remote client" << clientId.toString() << "Reason:" << killReason;
+    sendFrame(connection, FrameTypeClose, clientId, killReason.toUtf8());
+
+    // Like any other transport, report the disconnect from the event loop
+    QMetaObject::invokeMethod(this, "clientDisconnected", Qt::QueuedConnection, Q_ARG(QUuid, clientId));
+}
+
+void ClusterLink::openForward(const QString &linkAddress, const QUuid &clientId, const QVariantMap &identity)
+{
+    QTcpSocket *connection = peerConnection(linkAddress);
+    if (!connection) {
+        QMetaObject::invokeMethod(this, "forwardClosed", Qt::QueuedConnection, Q_ARG(QUuid, clientId));
+        return;
+    }
+
+    qCDebug(dcCluster()) << "Forward client" << clientId.toString() << "to cluster node" << linkAddress;
+    m_forwardedClients.insert(clientId, connection);
+    sendFrame(connection, FrameTypeOpen, clientId, QJsonDocument::fromVariant(identity).toJson(QJsonDocument::Compact));
+}
+
+void ClusterLink::forwardData(const QUuid &clientId, const QByteArray &data)
+{
+    QTcpSocket *connection = m_forwardedClients.value(clientId);
+    if (!connection)
+        return;
+
+    sendFrame(connection, FrameTypeData, clientId, data);
+}
+
+void ClusterLink::closeForward(const QUuid &clientId)
+{
+    QTcpSocket *connection = m_forwardedClients.take(clientId);
+    if (!connection)
+        return;
+
+    sendFrame(connection, FrameTypeClose, clientId, QByteArray());
+}
+
+QTcpSocket *ClusterLink::peerConnection(const QString &linkAddress)
+{
+    if (m_peers.contains(linkAddress))
+        return m_peers.value(linkAddress);
+
+    if (m_secret.isEmpty()) {
+        qCWarning(dcCluster()) << "There is no cluster secret. Not connecting to cluster node" << linkAddress;
+        return nullptr;
+    }
+
+    int separator = linkAddress.lastIndexOf(':');
+    QHostAddress address(linkAddress.left(separator));
+    bool valid = false;
+    quint16 port = linkAddress.mid(separator + 1).toUShort(&valid);
+    if (separator < 0 || address.isNull() || !valid) {
+        qCWarning(dcCluster()) << "Invalid cluster link address" << linkAddress;
+        return nullptr;
+    }
+
+    // Data written while connecting gets buffered by the socket
+    qCDebug(dcCluster()) << "Connecting to cluster node" << linkAddress;
+    QTcpSocket *connection = new QTcpSocket(this);
+    m_peers.insert(linkAddress, connection);
+    setupConnection(connection);
+    connection->connectToHost(address, port);
+    return connection;
+}
+
+void ClusterLink::setupConnection(QTcpSocket *connection)
+{
+    connection->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connect(connection, &QTcpSocket::readyRead, this, &ClusterLink::onReadyRead);
+    connect(connection, &QTcpSocket::stateChanged, this, &ClusterLink::onDisconnected);
+    m_buffers.insert(connection, QByteArray());
+
+    QByteArray challenge = ClusterAuthentication::createChallenge();
+    m_challenges.insert(connection, challenge);
+    sendFrame(connection, FrameTypeChallenge, QUuid(), challenge);
+}
+
+void ClusterLink::removeConnection(QTcpSocket *connection)
+{
+    m_peers.remove(m_peers.key(connection));
+    m_buffers.remove(connection);
+    m_challenges.remove(connection);
+    m_authenticatedConnections.remove(connection);
+    m_pendingFrames.remove(connection);
+}
+
+ClusterAuthentication::Role ClusterLink::role(QTcpSocket *connection) const
+{
+    // Outgoing connections are the ones to the link addresses of other nodes
+    return m_peers.key(connection).isEmpty() ? ClusterAuthentication::RoleAcceptor : ClusterAuthentication::RoleConnector;
+}
+
+void ClusterLink::sendFrame(QTcpSocket *connection, FrameType frameType, const QUuid &clientId, const QByteArray &payload)
+{
+    qCDebug(dcClusterTraffic()) << "--> Sending" << frameType << clientId.toString() << payload;
+
+    // Frame format: <quint32 size><quint8 type><QUuid clientId><QByteArray payload>
+    QByteArray frame;
+    QDataStream stream(&frame, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << static_cast<quint32>(0) << static_cast<quint8>(frameType) << clientId << payload;
+    stream.device()->seek(0);
+    stream << static_cast<quint32>(frame.size() - static_cast<int>(sizeof(quint32)));
+
+    // Client frames have to wait until the other node proved the knowledge of the secret
+    if (frameType <= FrameTypeClose && !m_authenticatedConnections.contains(connection)) {
+        m_pendingFrames[connection].append(frame);
+        return;
+    }
+
+    connection->write(frame);
+}
+
+void ClusterLink::processFrame(QTcpSocket *connection, FrameType frameType, const QUuid &clientId, const QByteArray &payload)
+{
+    qCDebug(dcClusterTraffic()) << "<-- Received" << frameType << clientId.toString() << payload;
+
+    if (frameType <= FrameTypeClose && !m_authenticatedConnections.contains(connection)) {
+        qCWarning(dcCluster()) << "Unauthenticated cluster node" << connection->peerAddress().toString() << "sent" << frameType << "Closing the connection.";
+        connection->abort();
+        return;
+    }
+
+    switch (frameType) {
+    case FrameTypeChallenge: {
+        ClusterAuthentication::Role ownRole = role(connection);
+        sendFrame(connection, FrameTypeResponse, QUuid(), ClusterAuthentication::response(m_secret, ownRole, payload));
+        break;
+    }
+    case FrameTypeResponse: {
+        ClusterAuthentication::Role peerRole = role(connection) == ClusterAuthentication::RoleAcceptor ? ClusterAuthentication::RoleConnector : ClusterAuthentication::RoleAcceptor;
+        if (!ClusterAuthentication::verifyResponse(m_secret, peerRole, m_challenges.take(connection), payload)) {
+            qCWarning(dcCluster()) << "Cluster node" << connection->peerAddress().toString() << "failed to authenticate. Closing the connection.";
+            connection->abort();
+            return;
+        }
+
+        qCDebug(dcCluster()) << "Cluster node" << connection->peerAddress().toString() << "authenticated";
+        m_authenticatedConnections.insert(connection);
+        foreach (const QByteArray &frame, m_pendingFrames.take(connection)) {
+            connection->write(frame);
+        }
+        break;
+    }
+    case FrameTypeOpen:
+        if (m_remoteClients.contains(clientId) || m_forwardedClients.contains(clientId)) {
+            qCWarning(dcCluster()) << "Remote client" << clientId.toString() << "is already known to this node";
+            return;
+        }
+
+        m_remoteClients.insert(clientId, connection);
+        emit clientConnected(clientId, connection->peerAddress());
+        emit remoteClientAttached(clientId, QJsonDocument::fromJson(payload).toVariant().toMap());
+        break;
+    case FrameTypeData:
+        if (m_remoteClients.value(clientId) == connection) {
+            emit dataAvailable(clientId, payload);
+        } else if (m_forwardedClients.value(clientId) == connection) {
+            emit forwardDataAvailable(clientId, payload);
+        } else {
+            qCDebug(dcCluster()) << "Dropping data for closed client" << clientId.toString();
+        }
+        break;
+    case FrameTypeClose:
+        if (m_remoteClients.value(clientId) == connection) {
+            m_remoteClients.remove(clientId);
+            emit clientDisconnected(clientId);
+        } else if (m_forwardedClients.value(clientId) == connection) {
+            m_forwardedClients.remove(clientId);
+            qCDebug(dcCluster()) << "Forwarded client" << clientId.toString() << "closed by cluster node:" << payload;
+            emit forwardClosed(clientId);
+        }
+        break;
+    }
+}
+
+void ClusterLink::onNewConnection()
+{
+    QTcpSocket *connection = m_server->nextPendingConnection();
+    qCDebug(dcCluster()) << "Cluster node connected from" << connection->peerAddress().toString();
+    setupConnection(connection);
+}
+
+void ClusterLink::onReadyRead()
+{
+    QTcpSocket *connection = qobject_cast<QTcpSocket *>(sender());
+    QByteArray buffer = m_buffers.value(connection) + connection->readAll();
+
+    // Parse all complete frames first, processing them might close this connection
+    QList<QVariantList> frames;
+    while (buffer.size() >= static_cast<int>(sizeof(quint32))) {
+        QDataStream headerStream(buffer);
+        quint32 frameSize = 0;
+        headerStream >> frameSize;
+        if (frameSize > 16 * 1024 * 1024) {
+            qCWarning(dcCluster()) << "Invalid frame size received from cluster node" << connection->peerAddress().toString();
+            connection->abort();
+            return;
+        }
+
+        if (static_cast<quint32>(buffer.size()) < sizeof(quint32) + frameSize)
+            break;
+
+        QDataStream stream(buffer.mid(static_cast<int>(sizeof(quint32)), static_cast<int>(frameSize)));
+        stream.setVersion(QDataStream::Qt_5_6);
+        quint8 frameType = 0;
+        QUuid clientId;
+        QByteArray payload;
+        stream >> frameType >> clientId >> payload;
+        buffer.remove(0, static_cast<int>(sizeof(quint32) + frameSize));
+
+        if (stream.status() != QDataStream::Ok || frameType > FrameTypeResponse) {
+            qCWarning(dcCluster()) << "Invalid frame received from cluster node" << connection->peerAddress().toString();
+            connection->abort();
+            return;
+        }
+
+        frames.append(QVariantList() << static_cast<uint>(frameType) << clientId << payload);
+    }
+
+    m_buffers.insert(connection, buffer);
+
+    foreach (const QVariantList &frame, frames) {
+        if (!m_buffers.contains(connection))
+            return;
+
+        processFrame(connection, static_cast<FrameType>(frame.at(0).toUInt()), frame.at(1).toUuid(), frame.at(2).toByteArray());
+    }
+}
+
+void ClusterLink::onDisconnected()
+{
+    QTcpSocket *connection = qobject_cast<QTcpSocket *>(sender());
+    if (connection->state() != QAbstractSocket::UnconnectedState)
+        return;
+
+    qCWarning(dcCluster()) << "Connection to cluster node" << connection->peerAddress().toString() << "closed";
+    disconnect(connection, nullptr, this, nullptr);
+    removeConnection(connection);
+
+    foreach (const QUuid &clientId, m_remoteClients.keys(connection)) {
+        m_remoteClients.remove(clientId);
+        emit clientDisconnected(clientId);
+    }
+
+    foreach (const QUuid &clientId, m_forwardedClients.keys(connection)) {
+        m_forwardedClients.remove(clientId);
+        emit forwardClosed(clientId);
+    }
+
+    connection->deleteLater();
+}
+
+bool ClusterLink::startServer()
+{
+    if (m_secret.isEmpty()) {
+        qCWarning(dcCluster()) << "There is no cluster secret. Refusing to start the cluster link.";
+        return false;
+    }
+
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &ClusterLink::onNewConnection);
+
+    qCDebug(dcCluster()) << "Starting cluster link on" << QString("%1:%2").arg(m_host.toString()).arg(m_port);
+    if (!m_server->listen(m_host, m_port)) {
+        qCWarning(dcCluster()) << "Cluster link could not listen on" << QString("%1:%2").arg(m_host.toString()).arg(m_port) << m_server->errorString();
+        delete m_server;
+        m_server = nullptr;
+        return false;
+    }
+
+    qCDebug(dcCluster()) << "Cluster link started successfully.";
+    return true;
+}
+
+bool ClusterLink::stopServer()
+{
+    foreach (QTcpSocket *connection, m_buffers.keys()) {
+        disconnect(connection, nullptr, this, nullptr);
+        connection->abort();
+        connection->deleteLater();
+    }
+
+    m_peers.clear();
+    m_buffers.clear();
+    m_challenges.clear();
+    m_authenticatedConnections.clear();
+    m_pendingFrames.clear();
+    m_remoteClients.clear();
+    m_forwardedClients.clear();
+
+    if (m_server) {
+        qCDebug(dcCluster()) << "Stop cluster link" << QString("%1:%2").arg(m_host.toString()).arg(m_port);
+        m_server->close();
+        delete m_server;
+        m_server = nullptr;
+    }
+
+    return true;
+}
+
+}
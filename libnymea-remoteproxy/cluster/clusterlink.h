@@ -0,0 +1,121 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CLUSTERLINK_H
+#define CLUSTERLINK_H
+
+#include <QSet>
+#include <QUuid>
+#include <QHash>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QVariantMap>
+
+#include "transportinterface.h"
+#include "clusterauthentication.h"
+
+namespace remoteproxy {
+
+class ClusterLink : public TransportInterface
+{
+    Q_OBJECT
+public:
+    enum FrameType {
+        FrameTypeOpen = 0,
+        FrameTypeData = 1,
+        FrameTypeClose = 2,
+        FrameTypeChallenge = 3,
+        FrameTypeResponse = 4
+    };
+    Q_ENUM(FrameType)
+
+    explicit ClusterLink(const QHostAddress &host, quint16 port, const QByteArray &secret, QObject *parent = nullptr);
+    ~ClusterLink() override;
+
+    QHostAddress host() const;
+    quint16 port() const;
+    bool running() const;
+
+    int peerCount() const;
+    int remoteClientCount() const;
+    int forwardedClientCount() const;
+
+    // Clients of other nodes joining a tunnel partner waiting on this node
+    void sendData(const QUuid &clientId, const QByteArray &data) override;
+    void killClientConnection(const QUuid &clientId, const QString &killReason) override;
+
+    // Clients of this node joining a tunnel partner waiting on an other node
+    void openForward(const QString &linkAddress, const QUuid &clientId, const QVariantMap &identity);
+    void forwardData(const QUuid &clientId, const QByteArray &data);
+    void closeForward(const QUuid &clientId);
+
+private:
+    QHostAddress m_host;
+    quint16 m_port = 0;
+    QByteArray m_secret;
+    QTcpServer *m_server = nullptr;
+
+    // Link address, outgoing connection to the node
+    QHash<QString, QTcpSocket *> m_peers;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+
+    // Both nodes of a link have to answer the challenge of the other one before any client frame gets accepted
+    QHash<QTcpSocket *, QByteArray> m_challenges;
+    QSet<QTcpSocket *> m_authenticatedConnections;
+    QHash<QTcpSocket *, QList<QByteArray>> m_pendingFrames;
+
+    // ClientId, link connection
+    QHash<QUuid, QTcpSocket *> m_remoteClients;
+    QHash<QUuid, QTcpSocket *> m_forwardedClients;
+
+    QTcpSocket *peerConnection(const QString &linkAddress);
+    void setupConnection(QTcpSocket *connection);
+    void removeConnection(QTcpSocket *connection);
+    ClusterAuthentication::Role role(QTcpSocket *connection) const;
+    void sendFrame(QTcpSocket *connection, FrameType frameType, const QUuid &clientId, const QByteArray &payload);
+    void processFrame(QTcpSocket *connection, FrameType frameType, const QUuid &clientId, const QByteArray &payload);
+
+signals:
+    void remoteClientAttached(const QUuid &clientId, const QVariantMap &identity);
+    void forwardDataAvailable(const QUuid &clientId, const QByteArray &data);
+    void forwardClosed(const QUuid &clientId);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+public slots:
+    bool startServer() override;
+    bool stopServer() override;
+
+};
+
+}
+
+#endif // CLUSTERLINK_H
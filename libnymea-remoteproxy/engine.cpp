@@ -28,6 +28,8 @@
 #include "engine.h"
 #include "loggingcategories.h"
 
+#include <QElapsedTimer>
+
 namespace remoteproxy {
 
 Engine *Engine::s_instance = nullptr;
@@ -71,24 +73,72 @@ void Engine::start(ProxyConfiguration *configuration)
     // Make sure an authenticator was registered
     Q_ASSERT_X(m_authenticator != nullptr, "Engine", "There is no authenticator registerd.");
 
+    m_authenticationScheduler = new AuthenticationScheduler(m_authenticator, this);
+    m_authenticationScheduler->reloadConfiguration();
     m_proxyServer = new ProxyServer(this);
     m_webSocketServer = new WebSocketServer(m_configuration->sslConfiguration(), this);
 
+    m_rateLimiter = new RateLimiter();
+    configureRateLimiter();
+
     QUrl websocketServerUrl;
     websocketServerUrl.setScheme("wss");
     websocketServerUrl.setHost(m_configuration->webSocketServerHost().toString());
     websocketServerUrl.setPort(m_configuration->webSocketServerPort());
 
     m_webSocketServer->setServerUrl(websocketServerUrl);
+    m_webSocketServer->setHandshakeThreads(m_configuration->handshakeThreads());
+    m_webSocketServer->setHandshakeTimeout(m_configuration->handshakeTimeout());
+    m_webSocketServer->setRateLimiter(m_rateLimiter);
 
     m_proxyServer->registerTransportInterface(m_webSocketServer);
 
+    // Plain connections from TLS terminating load balancers
+    if (m_configuration->plainWebSocketServerEnabled()) {
+        QUrl plainWebSocketServerUrl;
+        plainWebSocketServerUrl.setScheme("ws");
+        plainWebSocketServerUrl.setHost(m_configuration->plainWebSocketServerHost().toString());
+        plainWebSocketServerUrl.setPort(m_configuration->plainWebSocketServerPort());
+
+        m_plainWebSocketServer = new WebSocketServer(QSslConfiguration(), this);
+        m_plainWebSocketServer->setServerUrl(plainWebSocketServerUrl);
+        m_plainWebSocketServer->setProxyProtocolEnabled(true);
+        m_plainWebSocketServer->setTrustedProxies(m_configuration->trustedProxySubnets());
+        m_plainWebSocketServer->setRateLimiter(m_rateLimiter);
+        m_plainWebSocketServer->setProxyHeaderTimeout(m_configuration->proxyHeaderTimeout());
+        m_proxyServer->registerTransportInterface(m_plainWebSocketServer);
+    }
+
+    // Continue accepting on the listening socket of the server process we replace
+    if (m_takeoverEnabled && !m_configuration->handoverSocketFileName().isEmpty()) {
+        qintptr listeningDescriptor = HandoverServer::takeListeningSocket(m_configuration->handoverSocketFileName());
+        if (listeningDescriptor >= 0)
+            m_webSocketServer->setListeningDescriptor(listeningDescriptor);
+    }
+
+    // Meet tunnel partners connected to other nodes of the cluster, the nodes trust each other only knowing the secret
+    if (m_configuration->clusterEnabled() && m_configuration->clusterSecret().isEmpty()) {
+        qCWarning(dcEngine()) << "There is no cluster secret configured. Refusing to join the cluster.";
+    } else if (m_configuration->clusterEnabled()) {
+        QString linkAddress = QString("%1:%2").arg(m_configuration->clusterLinkHost().toString()).arg(m_configuration->clusterLinkPort());
+        m_clusterLink = new ClusterLink(m_configuration->clusterLinkHost(), m_configuration->clusterLinkPort(), m_configuration->clusterSecret(), this);
+        m_clusterClient = new ClusterClient(m_configuration->clusterNodeId(), linkAddress, m_configuration->clusterSecret(), this);
+        m_proxyServer->setCluster(m_clusterClient, m_clusterLink);
+        m_clusterClient->connectCoordinator(m_configuration->clusterCoordinatorUrl());
+    }
+
     qCDebug(dcEngine()) << "Starting proxy server";
     m_proxyServer->startServer();
 
     m_monitorServer = new MonitorServer(configuration->monitorSocketFileName(), this);
     m_monitorServer->startServer();
 
+    if (!m_configuration->handoverSocketFileName().isEmpty()) {
+        m_handoverServer = new HandoverServer(m_configuration->handoverSocketFileName(), this);
+        connect(m_handoverServer, &HandoverServer::listeningSocketHandedOver, this, &Engine::onListeningSocketHandedOver);
+        m_handoverServer->startServer();
+    }
+
     if (configuration->logEngineEnabled())
         m_logEngine->enable();
 
@@ -105,6 +155,73 @@ void Engine::stop()
     setRunning(false);
 }
 
+bool Engine::startDraining()
+{
+    if (!m_proxyServer || m_proxyServer->draining())
+        return false;
+
+    // Take this server out of rotation, the established tunnels may finish
+    qCDebug(dcEngine()) << "Start draining the server";
+    m_webSocketServer->stopListening();
+    if (m_plainWebSocketServer)
+        m_plainWebSocketServer->stopListening();
+
+    m_proxyServer->startDraining();
+    m_draining = true;
+    return true;
+}
+
+bool Engine::reloadConfiguration()
+{
+    if (!m_running || !m_configuration)
+        return false;
+
+    QElapsedTimer reloadTimer;
+    reloadTimer.start();
+    m_lastReloadTime = QDateTime::currentMSecsSinceEpoch();
+
+    // Validate the file first, the running configuration stays untouched on errors
+    qCDebug(dcEngine()) << "Reload configuration" << m_configuration->fileName();
+    ProxyConfiguration configuration;
+    if (!configuration.loadConfiguration(m_configuration->fileName())) {
+        m_reloadErrorString = configuration.errorString();
+    } else if (configuration.sslConfiguration().localCertificate().isNull()) {
+        m_reloadErrorString = QString("Invalid certificate file %1").arg(configuration.sslCertificateFileName());
+    } else if (configuration.sslConfiguration().privateKey().isNull()) {
+        m_reloadErrorString = QString("Invalid certificate key file %1").arg(configuration.sslCertificateKeyFileName());
+    } else {
+        m_reloadErrorString.clear();
+    }
+
+    if (!m_reloadErrorString.isEmpty()) {
+        m_reloadFailedCount++;
+        m_lastReloadDuration = reloadTimer.elapsed();
+        qCWarning(dcEngine()) << "Could not reload the configuration:" << m_reloadErrorString << "Keep running with the current configuration.";
+        return false;
+    }
+
+    // New clients pick up the new values, established tunnels and sessions continue
+    m_restartRequired = m_configuration->applyConfiguration(&configuration);
+    if (!m_restartRequired.isEmpty()) {
+        qCWarning(dcEngine()) << "Changed settings which require a restart:" << m_restartRequired.join(", ");
+    }
+
+    m_webSocketServer->setSslConfiguration(m_configuration->sslConfiguration());
+    m_webSocketServer->setHandshakeTimeout(m_configuration->handshakeTimeout());
+    if (m_plainWebSocketServer)
+        m_plainWebSocketServer->setProxyHeaderTimeout(m_configuration->proxyHeaderTimeout());
+
+    m_proxyServer->reloadConfiguration();
+    m_authenticationScheduler->reloadConfiguration();
+    configureRateLimiter();
+
+    m_reloadCount++;
+    m_lastReloadDuration = reloadTimer.elapsed();
+    qCDebug(dcEngine()) << "Configuration reloaded successfully in" << m_lastReloadDuration << "ms";
+    qCDebug(dcApplication()) << "Using configuration" << m_configuration;
+    return true;
+}
+
 bool Engine::running() const
 {
     return m_running;
@@ -115,6 +232,11 @@ bool Engine::developerMode() const
     return m_developerMode;
 }
 
+bool Engine::draining() const
+{
+    return m_draining;
+}
+
 QString Engine::serverName() const
 {
     return m_configuration->serverName();
@@ -138,6 +260,37 @@ void Engine::setDeveloperModeEnabled(bool enabled)
     m_developerMode = enabled;
 }
 
+void Engine::setTakeoverEnabled(bool enabled)
+{
+    m_takeoverEnabled = enabled;
+}
+
+QString Engine::reloadErrorString() const
+{
+    return m_reloadErrorString;
+}
+
+QVariantMap Engine::reloadStatistics() const
+{
+    QVariantMap reloadStatistics;
+    reloadStatistics.insert("count", m_reloadCount);
+    reloadStatistics.insert("failedCount", m_reloadFailedCount);
+    reloadStatistics.insert("lastReload", m_lastReloadTime);
+    reloadStatistics.insert("duration", m_lastReloadDuration);
+    reloadStatistics.insert("error", m_reloadErrorString);
+    reloadStatistics.insert("restartRequired", m_restartRequired);
+    return reloadStatistics;
+}
+
+QVariantMap Engine::eventLoopStatistics() const
+{
+    QVariantMap eventLoopStatistics;
+    eventLoopStatistics.insert("lag", m_lastEventLoopLag);
+    eventLoopStatistics.insert("averageLag", m_lastEventLoopAverageLag);
+    eventLoopStatistics.insert("maximumLag", m_eventLoopMaximumLag);
+    return eventLoopStatistics;
+}
+
 ProxyConfiguration *Engine::configuration() const
 {
     return m_configuration;
@@ -148,6 +301,11 @@ Authenticator *Engine::authenticator() const
     return m_authenticator;
 }
 
+AuthenticationScheduler *Engine::authenticationScheduler() const
+{
+    return m_authenticationScheduler;
+}
+
 ProxyServer *Engine::proxyServer() const
 {
     return m_proxyServer;
@@ -158,11 +316,36 @@ WebSocketServer *Engine::webSocketServer() const
     return m_webSocketServer;
 }
 
+WebSocketServer *Engine::plainWebSocketServer() const
+{
+    return m_plainWebSocketServer;
+}
+
+RateLimiter *Engine::rateLimiter() const
+{
+    return m_rateLimiter;
+}
+
 MonitorServer *Engine::monitorServer() const
 {
     return m_monitorServer;
 }
 
+HandoverServer *Engine::handoverServer() const
+{
+    return m_handoverServer;
+}
+
+ClusterClient *Engine::clusterClient() const
+{
+    return m_clusterClient;
+}
+
+ClusterLink *Engine::clusterLink() const
+{
+    return m_clusterLink;
+}
+
 LogEngine *Engine::logEngine() const
 {
     return m_logEngine;
@@ -176,6 +359,7 @@ Engine::Engine(QObject *parent) :
     m_timer = new QTimer(this);
     m_timer->setSingleShot(false);
     m_timer->setInterval(50);
+    m_timer->setTimerType(Qt::PreciseTimer);
 
     connect(m_timer, &QTimer::timeout, this, &Engine::onTimerTick);
 
@@ -194,19 +378,50 @@ QVariantMap Engine::createServerStatistic()
     monitorData.insert("serverVersion", SERVER_VERSION_STRING);
     monitorData.insert("apiVersion", API_VERSION_STRING);
     monitorData.insert("proxyStatistic", proxyServer()->currentStatistics());
+    monitorData.insert("authenticationStatistic", m_authenticationScheduler->currentStatistics());
+    monitorData.insert("tlsStatistic", m_webSocketServer->currentStatistics());
+    if (m_plainWebSocketServer)
+        monitorData.insert("proxyProtocolStatistic", m_plainWebSocketServer->currentStatistics());
+    monitorData.insert("rateLimitStatistic", m_rateLimiter->currentStatistics());
+    monitorData.insert("reloadStatistic", reloadStatistics());
+    monitorData.insert("eventLoopStatistic", eventLoopStatistics());
     return monitorData;
 }
 
+void Engine::configureRateLimiter()
+{
+    m_rateLimiter->setConnectionLimit(m_configuration->connectionRate(), m_configuration->connectionBurst());
+    m_rateLimiter->setSubnetConnectionLimit(m_configuration->subnetConnectionRate(), m_configuration->subnetConnectionBurst());
+    m_rateLimiter->setSubnetPrefixLengths(m_configuration->ipv4SubnetPrefix(), m_configuration->ipv6SubnetPrefix());
+    m_rateLimiter->setCallLimit(m_configuration->callRate(), m_configuration->callBurst());
+    m_rateLimiter->setMaximumSize(m_configuration->rateLimitMaximumBuckets());
+}
+
 void Engine::onTimerTick()
 {
     qint64 timestamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
     qint64 deltaTime = timestamp - m_lastTimeStamp;
     m_lastTimeStamp = timestamp;
 
+    // Anything beyond the interval is time this thread was busy with something else
+    qint64 lag = qMax<qint64>(0, deltaTime - m_timer->interval());
+    m_eventLoopLag = qMax(m_eventLoopLag, lag);
+    m_eventLoopLagTotal += lag;
+    m_eventLoopLagSamples++;
+
     m_currentTimeCounter += deltaTime;
     if (m_currentTimeCounter >= 1000) {
         // One second passed, do second tick
+        m_lastEventLoopLag = m_eventLoopLag;
+        m_lastEventLoopAverageLag = m_eventLoopLagTotal / m_eventLoopLagSamples;
+        m_eventLoopMaximumLag = qMax(m_eventLoopMaximumLag, m_eventLoopLag);
+        m_eventLoopLag = 0;
+        m_eventLoopLagTotal = 0;
+        m_eventLoopLagSamples = 0;
+
         m_proxyServer->tick();
+        m_authenticationScheduler->tick();
+        m_rateLimiter->expire();
 
         QVariantMap serverStatistics = createServerStatistic();
         m_monitorServer->updateClients(serverStatistics);
@@ -214,10 +429,23 @@ void Engine::onTimerTick()
                                    serverStatistics.value("proxyStatistic").toMap().value("clientCount").toInt(),
                                    serverStatistics.value("proxyStatistic").toMap().value("troughput").toInt());
 
+        // Done once the last client of this server has gone
+        if (m_draining && serverStatistics.value("proxyStatistic").toMap().value("clientCount").toInt() == 0) {
+            qCDebug(dcEngine()) << "Draining finished.";
+            m_draining = false;
+            emit drainFinished();
+        }
+
         m_currentTimeCounter = 0;
     }
 }
 
+void Engine::onListeningSocketHandedOver()
+{
+    qCDebug(dcEngine()) << "The new server process took over the listening socket. Draining the remaining connections.";
+    startDraining();
+}
+
 void Engine::clean()
 {
     if (m_monitorServer) {
@@ -226,6 +454,12 @@ void Engine::clean()
         m_monitorServer = nullptr;
     }
 
+    if (m_handoverServer) {
+        m_handoverServer->stopServer();
+        delete m_handoverServer;
+        m_handoverServer = nullptr;
+    }
+
     if (m_proxyServer) {
         m_proxyServer->stopServer();
         delete m_proxyServer;
@@ -237,9 +471,50 @@ void Engine::clean()
         m_webSocketServer = nullptr;
     }
 
+    if (m_plainWebSocketServer) {
+        delete m_plainWebSocketServer;
+        m_plainWebSocketServer = nullptr;
+    }
+
+    if (m_clusterClient) {
+        delete m_clusterClient;
+        m_clusterClient = nullptr;
+    }
+
+    if (m_clusterLink) {
+        delete m_clusterLink;
+        m_clusterLink = nullptr;
+    }
+
+    if (m_authenticationScheduler) {
+        delete m_authenticationScheduler;
+        m_authenticationScheduler = nullptr;
+    }
+
+    if (m_rateLimiter) {
+        delete m_rateLimiter;
+        m_rateLimiter = nullptr;
+    }
+
     if (m_configuration) {
         m_configuration = nullptr;
     }
+
+    m_draining = false;
+
+    m_eventLoopLag = 0;
+    m_eventLoopLagTotal = 0;
+    m_eventLoopLagSamples = 0;
+    m_lastEventLoopLag = 0;
+    m_lastEventLoopAverageLag = 0;
+    m_eventLoopMaximumLag = 0;
+
+    m_reloadCount = 0;
+    m_reloadFailedCount = 0;
+    m_lastReloadTime = 0;
+    m_lastReloadDuration = 0;
+    m_reloadErrorString.clear();
+    m_restartRequired.clear();
 }
 
 
@@ -251,6 +526,7 @@ void Engine::setRunning(bool running)
     qCDebug(dcEngine()) << "Engine is" << (running ? "now running." : "not running any more.");
 
     if (running) {
+        m_lastTimeStamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
         m_timer->start();
     } else {
         m_timer->stop();
@@ -37,10 +37,15 @@
 
 #include "logengine.h"
 #include "proxyserver.h"
+#include "ratelimiter.h"
 #include "monitorserver.h"
+#include "handoverserver.h"
 #include "websocketserver.h"
 #include "proxyconfiguration.h"
+#include "cluster/clusterlink.h"
+#include "cluster/clusterclient.h"
 #include "authentication/authenticator.h"
+#include "authentication/authenticationscheduler.h"
 
 namespace remoteproxy {
 
@@ -56,19 +61,33 @@ public:
     void start(ProxyConfiguration *configuration);
     void stop();
 
+    bool startDraining();
+    bool reloadConfiguration();
+
     bool running() const;
     bool developerMode() const;
+    bool draining() const;
 
     QString serverName() const;
+    QString reloadErrorString() const;
+    QVariantMap reloadStatistics() const;
+    QVariantMap eventLoopStatistics() const;
 
     void setAuthenticator(Authenticator *authenticator);
     void setDeveloperModeEnabled(bool enabled);
+    void setTakeoverEnabled(bool enabled);
 
     ProxyConfiguration *configuration() const;
     Authenticator *authenticator() const;
+    AuthenticationScheduler *authenticationScheduler() const;
     ProxyServer *proxyServer() const;
     WebSocketServer *webSocketServer() const;
+    WebSocketServer *plainWebSocketServer() const;
+    RateLimiter *rateLimiter() const;
     MonitorServer *monitorServer() const;
+    HandoverServer *handoverServer() const;
+    ClusterClient *clusterClient() const;
+    ClusterLink *clusterLink() const;
     LogEngine *logEngine() const;
 
 
@@ -82,23 +101,50 @@ private:
     int m_currentTimeCounter = 0;
     qint64 m_runTime = 0;
 
+    // Delay of the timer ticks, in milliseconds
+    qint64 m_eventLoopLag = 0;
+    qint64 m_eventLoopLagTotal = 0;
+    int m_eventLoopLagSamples = 0;
+    qint64 m_lastEventLoopLag = 0;
+    qint64 m_lastEventLoopAverageLag = 0;
+    qint64 m_eventLoopMaximumLag = 0;
+
     bool m_running = false;
     bool m_developerMode = false;
+    bool m_takeoverEnabled = false;
+    bool m_draining = false;
+
+    // Configuration reload
+    int m_reloadCount = 0;
+    int m_reloadFailedCount = 0;
+    qint64 m_lastReloadTime = 0;
+    qint64 m_lastReloadDuration = 0;
+    QString m_reloadErrorString;
+    QStringList m_restartRequired;
 
     ProxyConfiguration *m_configuration = nullptr;
     Authenticator *m_authenticator = nullptr;
+    AuthenticationScheduler *m_authenticationScheduler = nullptr;
     ProxyServer *m_proxyServer = nullptr;
     WebSocketServer *m_webSocketServer = nullptr;
+    WebSocketServer *m_plainWebSocketServer = nullptr;
+    RateLimiter *m_rateLimiter = nullptr;
     MonitorServer *m_monitorServer = nullptr;
+    HandoverServer *m_handoverServer = nullptr;
+    ClusterClient *m_clusterClient = nullptr;
+    ClusterLink *m_clusterLink = nullptr;
     LogEngine *m_logEngine = nullptr;
 
     QVariantMap createServerStatistic();
+    void configureRateLimiter();
 
 signals:
     void runningChanged(bool running);
+    void drainFinished();
 
 private slots:
     void onTimerTick();
+    void onListeningSocketHandedOver();
     void clean();
     void setRunning(bool running);
 
@@ -0,0 +1,264 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "engine.h"
+#include "handoverserver.h"
+#include "loggingcategories.h"
+
+#include <QFile>
+#include <QJsonDocument>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+namespace remoteproxy {
+
+HandoverServer::HandoverServer(const QString &serverName, QObject *parent) :
+    QObject(parent),
+    m_serverName(serverName)
+{
+
+}
+
+HandoverServer::~HandoverServer()
+{
+    stopServer();
+}
+
+bool HandoverServer::running() const
+{
+    if (!m_server)
+        return false;
+
+    return m_server->isListening();
+}
+
+bool HandoverServer::handedOver() const
+{
+    return m_handedOver;
+}
+
+qintptr HandoverServer::takeListeningSocket(const QString &serverName, QVariantMap *information, int timeout)
+{
+    QByteArray path = QFile::encodeName(serverName);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.isEmpty() || static_cast<size_t>(path.size()) >= sizeof(address.sun_path)) {
+        qCWarning(dcHandover()) << "Invalid handover socket" << serverName;
+        return -1;
+    }
+    memcpy(address.sun_path, path.constData(), static_cast<size_t>(path.size()));
+
+    int socketDescriptor = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socketDescriptor < 0) {
+        qCWarning(dcHandover()) << "Could not create handover socket:" << strerror(errno);
+        return -1;
+    }
+
+    // Do not wait forever for a server which does not answer
+    struct timeval receiveTimeout;
+    receiveTimeout.tv_sec = timeout / 1000;
+    receiveTimeout.tv_usec = (timeout % 1000) * 1000;
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &receiveTimeout, sizeof(receiveTimeout));
+
+    if (::connect(socketDescriptor, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) < 0) {
+        qCDebug(dcHandover()) << "There is no running server to take over from on" << serverName << strerror(errno);
+        ::close(socketDescriptor);
+        return -1;
+    }
+
+    qCDebug(dcHandover()) << "Waiting for the listening socket of the running server on" << serverName;
+
+    QByteArray payload(65536, 0);
+    struct iovec iov;
+    iov.iov_base = payload.data();
+    iov.iov_len = static_cast<size_t>(payload.size());
+
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received = ::recvmsg(socketDescriptor, &message, MSG_CMSG_CLOEXEC);
+    int receiveError = errno;
+    ::close(socketDescriptor);
+    if (received <= 0) {
+        qCWarning(dcHandover()) << "The running server did not hand over the listening socket:" << (received < 0 ? strerror(receiveError) : "connection closed");
+        return -1;
+    }
+
+    int descriptor = -1;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            memcpy(&descriptor, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+
+    if (descriptor < 0) {
+        qCWarning(dcHandover()) << "The handover message did not contain a socket descriptor.";
+        return -1;
+    }
+
+    payload.truncate(static_cast<int>(received));
+    QVariantMap handoverInformation = QJsonDocument::fromJson(payload).toVariant().toMap();
+    qCDebug(dcHandover()) << "Took over the listening socket from" << handoverInformation.value("serverName").toString()
+                          << handoverInformation.value("serverVersion").toString()
+                          << "which keeps serving" << handoverInformation.value("clientCount").toInt() << "clients";
+
+    if (information)
+        *information = handoverInformation;
+
+    return descriptor;
+}
+
+bool HandoverServer::sendDescriptor(qintptr socketDescriptor, qintptr descriptor, const QByteArray &payload)
+{
+    int fileDescriptor = static_cast<int>(descriptor);
+
+    struct iovec iov;
+    iov.iov_base = const_cast<char *>(payload.constData());
+    iov.iov_len = static_cast<size_t>(payload.size());
+
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fileDescriptor, sizeof(int));
+
+    ssize_t written = ::sendmsg(static_cast<int>(socketDescriptor), &message, MSG_NOSIGNAL);
+    if (written != static_cast<ssize_t>(payload.size())) {
+        qCWarning(dcHandover()) << "Could not send the listening socket to the new process:" << strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+void HandoverServer::onSuccessorConnected()
+{
+    QLocalSocket *socket = m_server->nextPendingConnection();
+    qintptr listeningDescriptor = Engine::instance()->webSocketServer()->listeningDescriptor();
+    if (m_handedOver || listeningDescriptor < 0) {
+        qCWarning(dcHandover()) << "A new process wants to take over, but there is no listening socket to hand over.";
+        socket->close();
+        socket->deleteLater();
+        return;
+    }
+
+    qCDebug(dcHandover()) << "A new process takes over the listening socket.";
+
+    // The new process creates the local sockets on the same paths once it has the listening socket.
+    // Close ours before, otherwise closing them later would remove the files of the new process.
+    stopServer();
+    Engine::instance()->monitorServer()->stopServer();
+
+    // Only the TLS listening socket moves, the new process opens the plain listener again
+    if (Engine::instance()->plainWebSocketServer())
+        Engine::instance()->plainWebSocketServer()->stopListening();
+
+    // TLS connections can not be moved to an other process, the established ones stay here and drain
+    QVariantMap proxyStatistic = Engine::instance()->proxyServer()->currentStatistics();
+    QVariantMap information;
+    information.insert("serverName", Engine::instance()->serverName());
+    information.insert("serverVersion", SERVER_VERSION_STRING);
+    information.insert("apiVersion", API_VERSION_STRING);
+    information.insert("clientCount", proxyStatistic.value("clientCount"));
+    information.insert("tunnelCount", proxyStatistic.value("tunnelCount"));
+
+    if (sendDescriptor(socket->socketDescriptor(), listeningDescriptor, QJsonDocument::fromVariant(information).toJson(QJsonDocument::Compact))) {
+        m_handedOver = true;
+        emit listeningSocketHandedOver();
+    } else {
+        // The listening socket stays here, keep serving as before
+        qCWarning(dcHandover()) << "The handover failed. Continue serving in this process.";
+        startServer();
+        Engine::instance()->monitorServer()->startServer();
+        if (Engine::instance()->plainWebSocketServer())
+            Engine::instance()->plainWebSocketServer()->resumeListening();
+    }
+
+    socket->close();
+    socket->deleteLater();
+}
+
+bool HandoverServer::startServer()
+{
+    qCDebug(dcHandover()) << "Starting handover server on" << m_serverName;
+
+    // The path belongs to this process now
+    if (QFile::exists(m_serverName)) {
+        qCDebug(dcHandover()) << "Clean up old handover socket";
+        QFile::remove(m_serverName);
+    }
+
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server->listen(m_serverName)) {
+        qCWarning(dcHandover()) << "Could not start handover server on" << m_serverName << m_server->errorString();
+        delete m_server;
+        m_server = nullptr;
+        return false;
+    }
+
+    connect(m_server, &QLocalServer::newConnection, this, &HandoverServer::onSuccessorConnected);
+    qCDebug(dcHandover()) << "Started successfully on" << m_serverName;
+    return true;
+}
+
+void HandoverServer::stopServer()
+{
+    if (!m_server)
+        return;
+
+    qCDebug(dcHandover()) << "Stop handover server" << m_serverName;
+    m_server->close();
+    m_server->deleteLater();
+    m_server = nullptr;
+}
+
+}
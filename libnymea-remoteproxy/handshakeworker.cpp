@@ -0,0 +1,154 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "handshakeworker.h"
+#include "loggingcategories.h"
+
+namespace remoteproxy {
+
+HandshakeWorker::HandshakeWorker(QThread *targetThread, QObject *parent) :
+    QObject(parent),
+    m_targetThread(targetThread)
+{
+    // Moves along with the worker into the handshake thread
+    m_timeoutTimer = new QTimer(this);
+    m_timeoutTimer->setInterval(250);
+    connect(m_timeoutTimer, &QTimer::timeout, this, &HandshakeWorker::onTimeoutTimerTimeout);
+}
+
+HandshakeWorker::~HandshakeWorker()
+{
+    foreach (QSslSocket *socket, m_pendingHandshakes.keys()) {
+        socket->abort();
+    }
+}
+
+void HandshakeWorker::failHandshake(QSslSocket *socket)
+{
+    if (!m_pendingHandshakes.contains(socket))
+        return;
+
+    m_pendingHandshakes.remove(socket);
+    m_handshakeTimeouts.remove(socket);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+    emit handshakeFailed();
+}
+
+void HandshakeWorker::onSocketEncrypted()
+{
+    QSslSocket *socket = static_cast<QSslSocket *>(sender());
+    if (!m_pendingHandshakes.contains(socket))
+        return;
+
+    // The socket is still processing the received data, move it once the call returned
+    socket->disconnect(this);
+    QMetaObject::invokeMethod(this, "handOverSocket", Qt::QueuedConnection, Q_ARG(QSslSocket *, socket));
+}
+
+void HandshakeWorker::onSocketSslErrors(const QList<QSslError> &errors)
+{
+    QSslSocket *socket = static_cast<QSslSocket *>(sender());
+    qCWarning(dcWebSocketServer()) << "TLS handshake with" << socket->peerAddress().toString() << "failed:" << errors;
+}
+
+void HandshakeWorker::onSocketError(QAbstractSocket::SocketError error)
+{
+    QSslSocket *socket = static_cast<QSslSocket *>(sender());
+    qCDebug(dcWebSocketServer()) << "TLS handshake with" << socket->peerAddress().toString() << "failed:" << error << socket->errorString();
+    failHandshake(socket);
+}
+
+void HandshakeWorker::onSocketDisconnected()
+{
+    failHandshake(static_cast<QSslSocket *>(sender()));
+}
+
+void HandshakeWorker::handOverSocket(QSslSocket *socket)
+{
+    if (socket->state() != QAbstractSocket::ConnectedState) {
+        failHandshake(socket);
+        return;
+    }
+
+    // Microseconds, a handshake takes a few milliseconds only
+    qint64 duration = m_pendingHandshakes.take(socket).nsecsElapsed() / 1000;
+    m_handshakeTimeouts.remove(socket);
+    qCDebug(dcWebSocketServer()) << "TLS handshake with" << socket->peerAddress().toString() << "finished in" << duration << "us";
+
+    // From now on the socket belongs to the target thread
+    socket->setParent(nullptr);
+    if (m_targetThread != thread())
+        socket->moveToThread(m_targetThread);
+
+    emit handshakeFinished(socket, duration);
+}
+
+void HandshakeWorker::onTimeoutTimerTimeout()
+{
+    // Clients which connect and never finish the handshake would hold the socket forever
+    foreach (QSslSocket *socket, m_pendingHandshakes.keys()) {
+        if (!m_pendingHandshakes.value(socket).hasExpired(m_handshakeTimeouts.value(socket)))
+            continue;
+
+        qCDebug(dcWebSocketServer()) << "TLS handshake with" << socket->peerAddress().toString() << "timed out.";
+        failHandshake(socket);
+    }
+
+    if (m_pendingHandshakes.isEmpty())
+        m_timeoutTimer->stop();
+}
+
+void HandshakeWorker::startHandshake(qintptr socketDescriptor, const QSslConfiguration &sslConfiguration, int handshakeTimeout)
+{
+    QSslSocket *socket = new QSslSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        qCWarning(dcWebSocketServer()) << "Could not accept the incoming connection:" << socket->errorString();
+        delete socket;
+        emit handshakeFailed();
+        return;
+    }
+
+    connect(socket, &QSslSocket::encrypted, this, &HandshakeWorker::onSocketEncrypted);
+    connect(socket, SIGNAL(sslErrors(QList<QSslError>)), this, SLOT(onSocketSslErrors(QList<QSslError>)));
+    connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onSocketError(QAbstractSocket::SocketError)));
+    connect(socket, &QSslSocket::disconnected, this, &HandshakeWorker::onSocketDisconnected);
+
+    // The handshake duration includes the round trips to the client
+    QElapsedTimer handshakeTimer;
+    handshakeTimer.start();
+    m_pendingHandshakes.insert(socket, handshakeTimer);
+    m_handshakeTimeouts.insert(socket, handshakeTimeout);
+    if (!m_timeoutTimer->isActive())
+        m_timeoutTimer->start();
+
+    socket->setSslConfiguration(sslConfiguration);
+    socket->startServerEncryption();
+}
+
+}
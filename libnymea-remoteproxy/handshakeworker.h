@@ -0,0 +1,76 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HANDSHAKEWORKER_H
+#define HANDSHAKEWORKER_H
+
+#include <QHash>
+#include <QTimer>
+#include <QThread>
+#include <QObject>
+#include <QSslSocket>
+#include <QElapsedTimer>
+#include <QSslConfiguration>
+
+namespace remoteproxy {
+
+class HandshakeWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // The encrypted sockets get moved to the target thread
+    explicit HandshakeWorker(QThread *targetThread, QObject *parent = nullptr);
+    ~HandshakeWorker() override;
+
+private:
+    QThread *m_targetThread = nullptr;
+    QHash<QSslSocket *, QElapsedTimer> m_pendingHandshakes;
+    QHash<QSslSocket *, int> m_handshakeTimeouts;
+    QTimer *m_timeoutTimer = nullptr;
+
+    void failHandshake(QSslSocket *socket);
+
+signals:
+    void handshakeFinished(QSslSocket *socket, qint64 duration);
+    void handshakeFailed();
+
+private slots:
+    void onSocketEncrypted();
+    void onSocketSslErrors(const QList<QSslError> &errors);
+    void onSocketError(QAbstractSocket::SocketError error);
+    void onSocketDisconnected();
+    void handOverSocket(QSslSocket *socket);
+    void onTimeoutTimerTimeout();
+
+public slots:
+    void startHandshake(qintptr socketDescriptor, const QSslConfiguration &sslConfiguration, int handshakeTimeout);
+
+};
+
+}
+
+#endif // HANDSHAKEWORKER_H
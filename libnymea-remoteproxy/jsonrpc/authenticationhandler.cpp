@@ -30,6 +30,7 @@
 #include "authenticationhandler.h"
 
 #include "engine.h"
+#include "cluster/rendezvoushash.h"
 
 namespace remoteproxy {
 
@@ -45,14 +46,59 @@ AuthenticationHandler::AuthenticationHandler(QObject *parent) :
                    "id the other tunnel client can understand. Once the authentication was successfull, you "
                    "can wait for the RemoteProxy.TunnelEstablished notification. If you send any data before "
                    "getting this notification, the server will close the connection. If the tunnel client does "
-                   "not show up within 10 seconds, the server will close the connection.");
+                   "not show up within 10 seconds, the server will close the connection. If multiplex is true, this "
+                   "connection will carry the connections of all clients authenticating with the same token as "
+                   "channels, until it gets closed. If standby is true, this connection will be parked in the standby "
+                   "pool of the token and used for the next client authenticating with this token. If the server "
+                   "issues session tickets, the response contains a sessionTicket which can be passed in later "
+                   "authentication requests using the same token in order to skip the verification of the token. "
+                   "If the tunnel belongs to an other node of the cluster, the server sends the RemoteProxy.Redirect "
+                   "notification followed by the AuthenticationErrorRedirected response and closes the connection. "
+                   "A draining server answers new tunnel clients with AuthenticationErrorBusy and the retryAfter "
+                   "hint in milliseconds.");
     params.insert("uuid", JsonTypes::basicTypeToString(JsonTypes::String));
     params.insert("name", JsonTypes::basicTypeToString(JsonTypes::String));
     params.insert("token", JsonTypes::basicTypeToString(JsonTypes::String));
     params.insert("o:nonce", JsonTypes::basicTypeToString(JsonTypes::String));
+    params.insert("o:multiplex", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    params.insert("o:standby", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    params.insert("o:sessionTicket", JsonTypes::basicTypeToString(JsonTypes::String));
     setParams("Authenticate", params);
     returns.insert("authenticationError", JsonTypes::authenticationErrorRef());
+    returns.insert("o:sessionTicket", JsonTypes::basicTypeToString(JsonTypes::String));
+    returns.insert("o:retryAfter", JsonTypes::basicTypeToString(JsonTypes::Int));
     setReturns("Authenticate", returns);
+
+    params.clear(); returns.clear();
+    setDescription("Connect", "Say hello and authenticate this connection in one call. This method behaves like "
+                   "Authenticate, but the response contains also the server information returned by RemoteProxy.Hello. "
+                   "A client using this method does not have to call RemoteProxy.Hello before authenticating.");
+    params.insert("uuid", JsonTypes::basicTypeToString(JsonTypes::String));
+    params.insert("name", JsonTypes::basicTypeToString(JsonTypes::String));
+    params.insert("token", JsonTypes::basicTypeToString(JsonTypes::String));
+    params.insert("o:nonce", JsonTypes::basicTypeToString(JsonTypes::String));
+    params.insert("o:multiplex", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    params.insert("o:standby", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    params.insert("o:sessionTicket", JsonTypes::basicTypeToString(JsonTypes::String));
+    setParams("Connect", params);
+    returns.insert("authenticationError", JsonTypes::authenticationErrorRef());
+    returns.insert("o:sessionTicket", JsonTypes::basicTypeToString(JsonTypes::String));
+    returns.insert("o:retryAfter", JsonTypes::basicTypeToString(JsonTypes::Int));
+    returns.insert("server", JsonTypes::basicTypeToString(JsonTypes::String));
+    returns.insert("name", JsonTypes::basicTypeToString(JsonTypes::String));
+    returns.insert("version", JsonTypes::basicTypeToString(JsonTypes::String));
+    returns.insert("apiVersion", JsonTypes::basicTypeToString(JsonTypes::String));
+    setReturns("Connect", returns);
+
+    params.clear(); returns.clear();
+    setDescription("Resume", "Resume a tunnel after the connection has been lost, using the resumptionTicket received "
+                   "with the RemoteProxy.TunnelEstablished notification. On success, any data following the response "
+                   "comes from the tunnel endpoint, starting with the data buffered while this client was gone. If the "
+                   "ticket is not valid, the server will close the connection immediatly after sending the error response.");
+    params.insert("ticket", JsonTypes::basicTypeToString(JsonTypes::String));
+    setParams("Resume", params);
+    returns.insert("authenticationError", JsonTypes::authenticationErrorRef());
+    setReturns("Resume", returns);
 }
 
 QString AuthenticationHandler::name() const
@@ -61,22 +107,81 @@ QString AuthenticationHandler::name() const
 }
 
 JsonReply *AuthenticationHandler::Authenticate(const QVariantMap &params, ProxyClient *proxyClient)
+{
+    return startAuthentication("Authenticate", params, proxyClient);
+}
+
+JsonReply *AuthenticationHandler::Connect(const QVariantMap &params, ProxyClient *proxyClient)
+{
+    return startAuthentication("Connect", params, proxyClient);
+}
+
+JsonReply *AuthenticationHandler::Resume(const QVariantMap &params, ProxyClient *proxyClient)
+{
+    qCDebug(dcJsonRpc()) << "Resume" << proxyClient;
+    JsonReply *jsonReply = createAsyncReply("Resume");
+
+    // The response has to be sent before the proxy server hands over the tunnel to this client
+    QMetaObject::invokeMethod(jsonReply, "finished", Qt::QueuedConnection);
+
+    bool resumed = Engine::instance()->proxyServer()->resumeTunnel(proxyClient, params.value("ticket").toString());
+    jsonReply->setSuccess(resumed);
+    jsonReply->setData(errorToReply(resumed ? Authenticator::AuthenticationErrorNoError : Authenticator::AuthenticationErrorAuthenticationFailed));
+    return jsonReply;
+}
+
+JsonReply *AuthenticationHandler::startAuthentication(const QString &method, const QVariantMap &params, ProxyClient *proxyClient)
 {
     QString uuid = params.value("uuid").toString();
     QString name = params.value("name").toString();
     QString token = params.value("token").toString();
     QString nonce = params.value("nonce").toString();
 
-    qCDebug(dcJsonRpc()) << "Authenticate:" << name << uuid << token << nonce;
-    JsonReply *jsonReply = createAsyncReply("Authenticate");
+    qCDebug(dcJsonRpc()) << method << name << uuid << token << nonce;
+    JsonReply *jsonReply = createAsyncReply(method);
 
     // Set the token for this proxy client
     proxyClient->setUuid(uuid);
     proxyClient->setName(name);
     proxyClient->setToken(token);
     proxyClient->setNonce(nonce);
+    proxyClient->setMultiplexed(params.value("multiplex", false).toBool());
+    proxyClient->setStandby(params.value("standby", false).toBool());
+    proxyClient->setSessionTicket(params.value("sessionTicket").toString());
+
+    // A draining server does not take new tunnels, the client should come back later on an other node
+    ProxyConfiguration *configuration = Engine::instance()->configuration();
+    if (!Engine::instance()->proxyServer()->admitClient(proxyClient)) {
+        QVariantMap data = errorToReply(Authenticator::AuthenticationErrorBusy);
+        data.insert("retryAfter", configuration->drainRetryAfter());
+        if (method == "Connect")
+            data.unite(serverInformation());
+
+        jsonReply->setSuccess(false);
+        jsonReply->setData(data);
+        QMetaObject::invokeMethod(jsonReply, "finished", Qt::QueuedConnection);
+        return jsonReply;
+    }
+
+    // Both clients of a tunnel have to meet on the owner node, the others redirect before authenticating.
+    // Multiplexed and standby connections pair by token only and stay on the node they are connected to.
+    if (!configuration->clusterMembers().isEmpty() && !proxyClient->isMultiplexed() && !proxyClient->isStandby()) {
+        QString ownerUrl = RendezvousHash::owner(configuration->clusterMembers(), proxyClient->tunnelIdentifier());
+        if (ownerUrl != configuration->clusterNodeUrl()) {
+            Engine::instance()->proxyServer()->redirectClient(proxyClient, ownerUrl);
+
+            QVariantMap data = errorToReply(Authenticator::AuthenticationErrorRedirected);
+            if (method == "Connect")
+                data.unite(serverInformation());
+
+            jsonReply->setSuccess(false);
+            jsonReply->setData(data);
+            QMetaObject::invokeMethod(jsonReply, "finished", Qt::QueuedConnection);
+            return jsonReply;
+        }
+    }
 
-    AuthenticationReply *authReply = Engine::instance()->authenticator()->authenticate(proxyClient);
+    AuthenticationReply *authReply = Engine::instance()->authenticationScheduler()->authenticate(proxyClient);
     connect(authReply, &AuthenticationReply::finished, this, &AuthenticationHandler::onAuthenticationFinished);
 
     m_runningAuthentications.insert(authReply, jsonReply);
@@ -92,6 +197,14 @@ void AuthenticationHandler::onAuthenticationFinished()
     qCDebug(dcJsonRpc()) << "Authentication response ready for" << authenticationReply->proxyClient() << authenticationReply->error();
     JsonReply *jsonReply = m_runningAuthentications.take(authenticationReply);
 
+    // The client disconnected meanwhile, the json rpc server drops the reply
+    if (!authenticationReply->proxyClient()) {
+        qCDebug(dcJsonRpc()) << "The client disconnected before the authentication finished";
+        jsonReply->setSuccess(false);
+        jsonReply->finished();
+        return;
+    }
+
     if (authenticationReply->error() != Authenticator::AuthenticationErrorNoError) {
         qCWarning(dcJsonRpc()) << "Authentication error occured" << authenticationReply->error();
         jsonReply->setSuccess(false);
@@ -103,7 +216,21 @@ void AuthenticationHandler::onAuthenticationFinished()
     // Set client authenticated
     authenticationReply->proxyClient()->setAuthenticated(authenticationReply->error() == Authenticator::AuthenticationErrorNoError);
 
-    jsonReply->setData(errorToReply(authenticationReply->error()));
+    QVariantMap data = errorToReply(authenticationReply->error());
+
+    // Hand out a fresh ticket for the next authentication of this client
+    SessionTicketManager *sessionTickets = Engine::instance()->authenticationScheduler()->sessionTickets();
+    if (authenticationReply->error() == Authenticator::AuthenticationErrorNoError && sessionTickets->isEnabled()) {
+        ProxyClient *proxyClient = authenticationReply->proxyClient();
+        QString sessionTicket = sessionTickets->createTicket(proxyClient->tokenHash(), proxyClient->userName());
+        if (!sessionTicket.isEmpty())
+            data.insert("sessionTicket", sessionTicket);
+    }
+
+    if (jsonReply->method() == "Connect")
+        data.unite(serverInformation());
+
+    jsonReply->setData(data);
     jsonReply->finished();
 }
 
@@ -45,10 +45,14 @@ public:
     QString name() const override;
 
     Q_INVOKABLE JsonReply *Authenticate(const QVariantMap &params, ProxyClient *proxyClient);
+    Q_INVOKABLE JsonReply *Connect(const QVariantMap &params, ProxyClient *proxyClient);
+    Q_INVOKABLE JsonReply *Resume(const QVariantMap &params, ProxyClient *proxyClient);
 
 private:
     QHash<AuthenticationReply *, JsonReply *> m_runningAuthentications;
 
+    JsonReply *startAuthentication(const QString &method, const QVariantMap &params, ProxyClient *proxyClient);
+
 private slots:
     void onAuthenticationFinished();
 
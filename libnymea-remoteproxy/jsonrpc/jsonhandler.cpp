@@ -30,6 +30,7 @@
 #include <QDebug>
 #include <QRegExp>
 
+#include "engine.h"
 #include "jsonreply.h"
 #include "jsontypes.h"
 #include "loggingcategories.h"
@@ -87,16 +88,14 @@ bool JsonHandler::hasMethod(const QString &methodName)
     return m_descriptions.contains(methodName) && m_params.contains(methodName) && m_returns.contains(methodName);
 }
 
-QPair<bool, QString> JsonHandler::validateParams(const QString &methodName, const QVariantMap &params)
+QPair<bool, QString> JsonHandler::validateParams(const QString &methodName, const QJsonObject &params) const
 {
-    QVariantMap paramTemplate = m_params.value(methodName);
-    return JsonTypes::validateMap(paramTemplate, params);
+    return m_paramsValidators.value(methodName).validate(params);
 }
 
-QPair<bool, QString> JsonHandler::validateReturns(const QString &methodName, const QVariantMap &returns)
+QPair<bool, QString> JsonHandler::validateReturns(const QString &methodName, const QVariantMap &returns) const
 {
-    QVariantMap returnsTemplate = m_returns.value(methodName);
-    return JsonTypes::validateMap(returnsTemplate, returns);
+    return m_returnsValidators.value(methodName).validate(QJsonObject::fromVariantMap(returns));
 }
 
 void JsonHandler::setDescription(const QString &methodName, const QString &description)
@@ -117,6 +116,7 @@ void JsonHandler::setParams(const QString &methodName, const QVariantMap &params
         QMetaMethod method = metaObject()->method(i);
         if (method.name() == methodName) {
             m_params.insert(methodName, params);
+            m_paramsValidators.insert(methodName, JsonValidator(params));
             return;
         }
     }
@@ -129,6 +129,7 @@ void JsonHandler::setReturns(const QString &methodName, const QVariantMap &retur
         QMetaMethod method = metaObject()->method(i);
         if (method.name() == methodName) {
             m_returns.insert(methodName, returns);
+            m_returnsValidators.insert(methodName, JsonValidator(returns));
             return;
         }
     }
@@ -142,6 +143,16 @@ QVariantMap JsonHandler::errorToReply(Authenticator::AuthenticationError error)
     return returns;
 }
 
+QVariantMap JsonHandler::serverInformation() const
+{
+    QVariantMap data;
+    data.insert("server", SERVER_NAME_STRING);
+    data.insert("name", Engine::instance()->serverName());
+    data.insert("version", SERVER_VERSION_STRING);
+    data.insert("apiVersion", API_VERSION_STRING);
+    return data;
+}
+
 JsonReply *JsonHandler::createReply(const QString &method, const QVariantMap &data) const
 {
     return JsonReply::createReply(const_cast<JsonHandler*>(this), method, data);
@@ -33,7 +33,9 @@
 #include <QObject>
 #include <QVariantMap>
 #include <QMetaMethod>
+#include <QJsonObject>
 
+#include "jsonvalidator.h"
 #include "authentication/authenticator.h"
 
 namespace remoteproxy {
@@ -51,13 +53,15 @@ public:
     QVariantMap introspect(const QMetaMethod::MethodType &type);
 
     bool hasMethod(const QString &methodName);
-    QPair<bool, QString> validateParams(const QString &methodName, const QVariantMap &params);
-    QPair<bool, QString> validateReturns(const QString &methodName, const QVariantMap &returns);
+    QPair<bool, QString> validateParams(const QString &methodName, const QJsonObject &params) const;
+    QPair<bool, QString> validateReturns(const QString &methodName, const QVariantMap &returns) const;
 
 private:
     QHash<QString, QString> m_descriptions;
     QHash<QString, QVariantMap> m_params;
     QHash<QString, QVariantMap> m_returns;
+    QHash<QString, JsonValidator> m_paramsValidators;
+    QHash<QString, JsonValidator> m_returnsValidators;
 
 signals:
     void asyncReply(int id, const QVariantMap &params);
@@ -68,6 +72,7 @@ protected:
     void setReturns(const QString &methodName, const QVariantMap &returns);
 
     QVariantMap errorToReply(Authenticator::AuthenticationError error) const;
+    QVariantMap serverInformation() const;
 
     JsonReply *createReply(const QString &method, const QVariantMap &data) const;
     JsonReply *createAsyncReply(const QString &method) const;
@@ -0,0 +1,218 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "jsonvalidator.h"
+#include "jsontypes.h"
+#include "loggingcategories.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+namespace remoteproxy {
+
+JsonValidator::JsonValidator()
+{
+    compileObject(QVariantMap());
+}
+
+JsonValidator::JsonValidator(const QVariantMap &templateMap)
+{
+    compileObject(templateMap);
+}
+
+QPair<bool, QString> JsonValidator::validate(const QJsonObject &object) const
+{
+    // The root object is always the first node
+    return validateObject(m_nodes.first(), object);
+}
+
+int JsonValidator::compile(const QVariant &templateVariant)
+{
+    switch (templateVariant.type()) {
+    case QVariant::Map:
+        return compileObject(templateVariant.toMap());
+    case QVariant::List: {
+        Q_ASSERT(templateVariant.toList().count() == 1);
+        int index = m_nodes.count();
+        m_nodes.append(Node());
+        m_nodes[index].type = NodeTypeList;
+        int element = compile(templateVariant.toList().first());
+        m_nodes[index].element = element;
+        return index;
+    }
+    default:
+        break;
+    }
+
+    Node node;
+    node.typeName = templateVariant.toString();
+    if (node.typeName == JsonTypes::basicTypeRef()) {
+        node.type = NodeTypeBasicType;
+    } else if (node.typeName == JsonTypes::authenticationErrorRef()) {
+        node.type = NodeTypeEnum;
+        foreach (const QVariant &value, JsonTypes::authenticationError()) {
+            node.enumValues.insert(value.toString());
+        }
+    } else if (node.typeName == JsonTypes::basicTypeToString(JsonTypes::Variant) || node.typeName == JsonTypes::basicTypeToString(JsonTypes::Object)) {
+        node.type = NodeTypeAny;
+    } else if (node.typeName == JsonTypes::basicTypeToString(QVariant::Uuid)) {
+        node.type = NodeTypeUuid;
+    } else if (node.typeName == JsonTypes::basicTypeToString(QVariant::String)
+               || node.typeName == JsonTypes::basicTypeToString(QVariant::Bool)
+               || node.typeName == JsonTypes::basicTypeToString(QVariant::Int)
+               || node.typeName == JsonTypes::basicTypeToString(QVariant::UInt)
+               || node.typeName == JsonTypes::basicTypeToString(QVariant::Double)) {
+        node.type = NodeTypeScalar;
+    } else {
+        Q_ASSERT_X(!node.typeName.startsWith("$ref:"), "JsonValidator", QString("Unhandled ref: %1").arg(node.typeName).toLatin1().data());
+        qCWarning(dcJsonRpc()) << "Unhandled template type" << node.typeName;
+        node.type = NodeTypeUnhandled;
+    }
+
+    m_nodes.append(node);
+    return m_nodes.count() - 1;
+}
+
+int JsonValidator::compileObject(const QVariantMap &templateMap)
+{
+    int index = m_nodes.count();
+    m_nodes.append(Node());
+
+    QVector<Field> fields;
+    foreach (const QString &key, templateMap.keys()) {
+        Field field;
+        field.optional = key.startsWith("o:");
+        field.key = field.optional ? key.mid(2) : key;
+        field.node = compile(templateMap.value(key));
+        fields.append(field);
+    }
+
+    m_nodes[index].type = NodeTypeObject;
+    m_nodes[index].fields = fields;
+    return index;
+}
+
+QPair<bool, QString> JsonValidator::validateObject(const Node &node, const QJsonObject &object) const
+{
+    // Make sure all values defined in the template are around
+    int knownKeys = 0;
+    foreach (const Field &field, node.fields) {
+        QJsonObject::const_iterator it = object.constFind(field.key);
+        if (it == object.constEnd()) {
+            if (field.optional)
+                continue;
+
+            qCWarning(dcJsonRpc()) << "*** missing key" << field.key;
+            return report(false, QString("Missing key %1 in %2").arg(field.key).arg(QString(QJsonDocument(object).toJson())));
+        }
+
+        knownKeys++;
+        QPair<bool, QString> result = validateValue(field.node, it.value());
+        if (!result.first)
+            return result;
+    }
+
+    if (knownKeys == object.count())
+        return report(true);
+
+    // Make sure there aren't any other parameters than the allowed ones
+    for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+        bool allowed = false;
+        foreach (const Field &field, node.fields) {
+            if (field.key == it.key()) {
+                allowed = true;
+                break;
+            }
+        }
+
+        if (!allowed) {
+            qCWarning(dcJsonRpc()) << "Forbidden param" << it.key() << "in params";
+            return report(false, QString("Forbidden key \"%1\" in %2").arg(it.key()).arg(QString(QJsonDocument(object).toJson())));
+        }
+    }
+
+    return report(true);
+}
+
+QPair<bool, QString> JsonValidator::validateValue(int nodeIndex, const QJsonValue &value) const
+{
+    const Node &node = m_nodes.at(nodeIndex);
+
+    // Keep the conversion rules of QVariant::canConvert for the values a JSON document can contain
+    switch (node.type) {
+    case NodeTypeAny:
+        return report(true);
+    case NodeTypeUuid:
+        if (!value.isString())
+            return report(false, QString("Param %1 is not a uuid.").arg(value.toVariant().toString()));
+
+        return report(true);
+    case NodeTypeScalar:
+        if (!value.isString() && !value.isDouble() && !value.isBool())
+            return report(false, QString("Param %1 is not a %2.").arg(value.toVariant().toString()).arg(node.typeName.toLower()));
+
+        return report(true);
+    case NodeTypeBasicType:
+        if (!value.isString() && !value.isDouble() && !value.isBool())
+            return report(false, QString("Error validating basic type %1.").arg(value.toVariant().toString()));
+
+        return report(true);
+    case NodeTypeEnum: {
+        QString enumValue = value.isString() ? value.toString() : value.toVariant().toString();
+        if (!node.enumValues.contains(enumValue)) {
+            QString errorMessage = QString("Value %1 not allowed in %2").arg(enumValue).arg(node.enumValues.toList().join(", "));
+            qCWarning(dcJsonRpc()) << errorMessage;
+            return report(false, errorMessage);
+        }
+        return report(true);
+    }
+    case NodeTypeObject:
+        return validateObject(node, value.toObject());
+    case NodeTypeList: {
+        QJsonArray array = value.toArray();
+        for (int i = 0; i < array.count(); i++) {
+            QPair<bool, QString> result = validateValue(node.element, array.at(i));
+            if (!result.first) {
+                qCWarning(dcJsonRpc()) << "List entry not matching template";
+                return result;
+            }
+        }
+        return report(true);
+    }
+    case NodeTypeUnhandled:
+        break;
+    }
+
+    return report(false, QString("Unhandled property type: %1 (expected: %2)").arg(value.toVariant().toString()).arg(node.typeName));
+}
+
+QPair<bool, QString> JsonValidator::report(bool status, const QString &message)
+{
+    return qMakePair<bool, QString>(status, message);
+}
+
+}
@@ -0,0 +1,94 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef JSONVALIDATOR_H
+#define JSONVALIDATOR_H
+
+#include <QSet>
+#include <QPair>
+#include <QVector>
+#include <QString>
+#include <QVariant>
+#include <QJsonValue>
+#include <QJsonObject>
+
+namespace remoteproxy {
+
+// Validates JSON objects against a params/returns template. The template gets compiled once
+// into a flat list of nodes, so the validation does not need to touch the template any more.
+class JsonValidator
+{
+public:
+    JsonValidator();
+    explicit JsonValidator(const QVariantMap &templateMap);
+
+    QPair<bool, QString> validate(const QJsonObject &object) const;
+
+private:
+    enum NodeType {
+        NodeTypeAny,
+        NodeTypeUuid,
+        NodeTypeScalar,
+        NodeTypeBasicType,
+        NodeTypeEnum,
+        NodeTypeObject,
+        NodeTypeList,
+        NodeTypeUnhandled
+    };
+
+    class Field
+    {
+    public:
+        QString key;
+        bool optional = false;
+        int node = -1;
+    };
+
+    class Node
+    {
+    public:
+        NodeType type = NodeTypeUnhandled;
+        QString typeName;
+        QVector<Field> fields;
+        int element = -1;
+        QSet<QString> enumValues;
+    };
+
+    QVector<Node> m_nodes;
+
+    int compile(const QVariant &templateVariant);
+    int compileObject(const QVariantMap &templateMap);
+
+    QPair<bool, QString> validateObject(const Node &node, const QJsonObject &object) const;
+    QPair<bool, QString> validateValue(int nodeIndex, const QJsonValue &value) const;
+
+    static QPair<bool, QString> report(bool status, const QString &message = QString());
+};
+
+}
+
+#endif // JSONVALIDATOR_H
@@ -30,6 +30,7 @@
 #include "loggingcategories.h"
 #include "jsonrpc/jsontypes.h"
 
+#include <QJsonObject>
 #include <QJsonDocument>
 #include <QJsonParseError>
 #include <QCoreApplication>
@@ -68,8 +69,26 @@ JsonRpcServer::JsonRpcServer(QObject *parent) :
                    "about the other tunnel client.");
     params.insert("uuid", JsonTypes::basicTypeToString(JsonTypes::String));
     params.insert("name", JsonTypes::basicTypeToString(JsonTypes::String));
+    params.insert("o:resumptionTicket", JsonTypes::basicTypeToString(JsonTypes::String));
     setParams("TunnelEstablished", params);
 
+    params.clear(); returns.clear();
+    setDescription("StandbyConsumed", "Emitted to a standby connection right before the tunnel to an arriving client gets "
+                   "established on it. The parameter informs about the amount of standby connections left in the pool "
+                   "of this token, so the daemon can top up the pool.");
+    params.insert("standbyCount", JsonTypes::basicTypeToString(JsonTypes::Int));
+    setParams("StandbyConsumed", params);
+
+    params.clear(); returns.clear();
+    setDescription("Redirect", "Emitted right before the response of an authentication request, if the tunnel belongs to an "
+                   "other node of the cluster. The response contains the AuthenticationErrorRedirected and the connection "
+                   "gets closed. The client has to authenticate again on the server with the given url.");
+    params.insert("url", JsonTypes::basicTypeToString(JsonTypes::String));
+    setParams("Redirect", params);
+
+    m_cacheableMethods.insert("RemoteProxy.Hello");
+    m_cacheableMethods.insert("RemoteProxy.Introspect");
+
     QMetaObject::invokeMethod(this, "setup", Qt::QueuedConnection);
 }
 
@@ -91,13 +110,7 @@ JsonReply *JsonRpcServer::Hello(const QVariantMap &params, ProxyClient *proxyCli
     Q_UNUSED(params)
     Q_UNUSED(proxyClient)
 
-    QVariantMap data;
-    data.insert("server", SERVER_NAME_STRING);
-    data.insert("name", Engine::instance()->serverName());
-    data.insert("version", SERVER_VERSION_STRING);
-    data.insert("apiVersion", API_VERSION_STRING);
-
-    return createReply("Hello", data);
+    return createReply("Hello", serverInformation());
 }
 
 JsonReply *JsonRpcServer::Introspect(const QVariantMap &params, ProxyClient *proxyClient) const
@@ -151,6 +164,14 @@ void JsonRpcServer::sendErrorResponse(ProxyClient *client, int commandId, const
     client->sendData(data);
 }
 
+void JsonRpcServer::sendCachedResponse(ProxyClient *client, int commandId, const QByteArray &cachedResponse)
+{
+    // The cached response is a serialized object without id, prepend the id of this request
+    QByteArray data = "{\"id\":" + QByteArray::number(commandId) + "," + cachedResponse.mid(1);
+    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
+    client->sendData(data);
+}
+
 QString JsonRpcServer::formatAssertion(const QString &targetNamespace, const QString &method, JsonHandler *handler, const QVariantMap &data) const
 {
     QJsonDocument doc = QJsonDocument::fromVariant(handler->introspect(QMetaMethod::Method).value(targetNamespace + "." + method));
@@ -165,12 +186,40 @@ void JsonRpcServer::registerHandler(JsonHandler *handler)
 {
     qCDebug(dcJsonRpc()) << "Register handler" << handler->name();
     m_handlers.insert(handler->name(), handler);
+    invalidateResponseCache();
+
+    // Resolve the API methods once, so incoming requests need only one lookup
+    for (int i = 0; i < handler->metaObject()->methodCount(); ++i) {
+        QMetaMethod metaMethod = handler->metaObject()->method(i);
+        if (metaMethod.methodType() != QMetaMethod::Method || !handler->hasMethod(metaMethod.name()))
+            continue;
+
+        // Skip the overloads moc creates for default arguments
+        if (metaMethod.parameterCount() != 2)
+            continue;
+
+        MethodEntry entry;
+        entry.handler = handler;
+        entry.method = metaMethod.name();
+        entry.metaMethod = metaMethod;
+        m_methods.insert(handler->name() + "." + entry.method, entry);
+    }
 }
 
 void JsonRpcServer::unregisterHandler(JsonHandler *handler)
 {
     qCDebug(dcJsonRpc()) << "Unregister handler" << handler->name();
     m_handlers.remove(handler->name());
+    invalidateResponseCache();
+
+    QHash<QString, MethodEntry>::iterator it = m_methods.begin();
+    while (it != m_methods.end()) {
+        if (it.value().handler == handler) {
+            it = m_methods.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 void JsonRpcServer::setup()
@@ -216,6 +265,11 @@ void JsonRpcServer::asyncReplyFinished()
     }
 }
 
+void JsonRpcServer::invalidateResponseCache()
+{
+    m_responseCache.clear();
+}
+
 void JsonRpcServer::registerClient(ProxyClient *proxyClient)
 {
     qCDebug(dcJsonRpc()) << "Register client" << proxyClient;
@@ -229,6 +283,11 @@ void JsonRpcServer::registerClient(ProxyClient *proxyClient)
 void JsonRpcServer::unregisterClient(ProxyClient *proxyClient)
 {
     qCDebug(dcJsonRpc()) << "Unregister client" << proxyClient;
+
+    // Pending async replies must not reach the client once it is gone
+    foreach (JsonReply *reply, m_asyncReplies.keys(proxyClient))
+        m_asyncReplies.remove(reply);
+
     if (!m_clients.contains(proxyClient)) {
         qCWarning(dcJsonRpc()) << "Client was not registered" << proxyClient;
         return;
@@ -254,10 +313,10 @@ void JsonRpcServer::processData(ProxyClient *proxyClient, const QByteArray &data
         return;
     }
 
-    QVariantMap message = jsonDoc.toVariant().toMap();
+    QJsonObject message = jsonDoc.object();
 
     bool success = false;
-    int commandId = message.value("id").toInt(&success);
+    int commandId = message.value("id").toVariant().toInt(&success);
     if (!success) {
         qCWarning(dcJsonRpc()) << "Error parsing command. Missing \"id\":" << message;
         sendErrorResponse(proxyClient, -1, "Error parsing command. Missing 'id'");
@@ -265,40 +324,53 @@ void JsonRpcServer::processData(ProxyClient *proxyClient, const QByteArray &data
         return;
     }
 
-    QStringList commandList = message.value("method").toString().split('.');
-    if (commandList.count() != 2) {
-        qCWarning(dcJsonRpc) << "Error parsing method.\nGot:" << message.value("method").toString() << "\nExpected: \"Namespace.method\"";
-        sendErrorResponse(proxyClient, commandId, QString("Error parsing method. Got: '%1'', Expected: 'Namespace.method'").arg(message.value("method").toString()));
-        proxyClient->killConnection("Invalid method passed.");
-        return;
-    }
-
-    QString targetNamespace = commandList.first();
-    QString method = commandList.last();
+    QString methodName = message.value("method").toString();
+    QHash<QString, MethodEntry>::const_iterator methodEntry = m_methods.constFind(methodName);
+    if (methodEntry == m_methods.constEnd()) {
+        // Unknown method, find out what is wrong for the error message
+        QStringList commandList = methodName.split('.');
+        if (commandList.count() != 2) {
+            qCWarning(dcJsonRpc) << "Error parsing method.\nGot:" << methodName << "\nExpected: \"Namespace.method\"";
+            sendErrorResponse(proxyClient, commandId, QString("Error parsing method. Got: '%1'', Expected: 'Namespace.method'").arg(methodName));
+            proxyClient->killConnection("Invalid method passed.");
+            return;
+        }
 
-    JsonHandler *handler = m_handlers.value(targetNamespace);
-    if (!handler) {
-        sendErrorResponse(proxyClient, commandId, "No such namespace");
-        proxyClient->killConnection("No such namespace.");
-        return;
-    }
+        if (!m_handlers.contains(commandList.first())) {
+            sendErrorResponse(proxyClient, commandId, "No such namespace");
+            proxyClient->killConnection("No such namespace.");
+            return;
+        }
 
-    if (!handler->hasMethod(method)) {
         sendErrorResponse(proxyClient, commandId, "No such method");
         proxyClient->killConnection("No such method.");
         return;
     }
 
-    QVariantMap params = message.value("params").toMap();
-    QPair<bool, QString> validationResult = handler->validateParams(method, params);
+    JsonHandler *handler = methodEntry.value().handler;
+    QString targetNamespace = handler->name();
+    QString method = methodEntry.value().method;
+
+    QJsonObject paramsObject = message.value("params").toObject();
+    QPair<bool, QString> validationResult = handler->validateParams(method, paramsObject);
     if (!validationResult.first) {
         sendErrorResponse(proxyClient, commandId,  "Invalid params: " + validationResult.second);
         proxyClient->killConnection("Invalid params passed.");
         return;
     }
 
-    JsonReply *reply;
-    QMetaObject::invokeMethod(handler, method.toLatin1().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params), Q_ARG(ProxyClient *, proxyClient));
+    if (m_cacheableMethods.contains(methodName)) {
+        QByteArray cachedResponse = m_responseCache.value(methodName);
+        if (!cachedResponse.isEmpty()) {
+            sendCachedResponse(proxyClient, commandId, cachedResponse);
+            return;
+        }
+    }
+
+    QVariantMap params = paramsObject.toVariantMap();
+
+    JsonReply *reply = nullptr;
+    methodEntry.value().metaMethod.invoke(handler, Qt::DirectConnection, Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params), Q_ARG(ProxyClient *, proxyClient));
     if (reply->type() == JsonReply::TypeAsync) {
         m_asyncReplies.insert(reply, proxyClient);
         reply->setClientId(proxyClient->clientId());
@@ -317,7 +389,16 @@ void JsonRpcServer::processData(ProxyClient *proxyClient, const QByteArray &data
 
         reply->setClientId(proxyClient->clientId());
         reply->setCommandId(commandId);
-        sendResponse(proxyClient, commandId, reply->data());
+        if (m_cacheableMethods.contains(methodName)) {
+            QVariantMap response;
+            response.insert("status", "success");
+            response.insert("params", reply->data());
+            QByteArray cachedResponse = QJsonDocument::fromVariant(response).toJson(QJsonDocument::Compact);
+            m_responseCache.insert(methodName, cachedResponse);
+            sendCachedResponse(proxyClient, commandId, cachedResponse);
+        } else {
+            sendResponse(proxyClient, commandId, reply->data());
+        }
         reply->deleteLater();
     }
 }
@@ -28,6 +28,7 @@
 #ifndef JSONRPCSERVER_H
 #define JSONRPCSERVER_H
 
+#include <QSet>
 #include <QObject>
 #include <QVariant>
 
@@ -53,15 +54,31 @@ public:
 
 signals:
     void TunnelEstablished(const QVariantMap &params);
+    void StandbyConsumed(const QVariantMap &params);
+    void Redirect(const QVariantMap &params);
 
 private:
+    class MethodEntry
+    {
+    public:
+        JsonHandler *handler = nullptr;
+        QString method;
+        QMetaMethod metaMethod;
+    };
+
     QHash<QString, JsonHandler *> m_handlers;
+    QHash<QString, MethodEntry> m_methods;
+
+    // Serialized responses of side effect free methods, without the id
+    QSet<QString> m_cacheableMethods;
+    QHash<QString, QByteArray> m_responseCache;
     QHash<JsonReply *, ProxyClient *> m_asyncReplies;
     QList<ProxyClient *> m_clients;
     int m_notificationId = 0;
 
     void sendResponse(ProxyClient *client, int commandId, const QVariantMap &params = QVariantMap());
     void sendErrorResponse(ProxyClient *client, int commandId, const QString &error);
+    void sendCachedResponse(ProxyClient *client, int commandId, const QByteArray &cachedResponse);
 
     QString formatAssertion(const QString &targetNamespace, const QString &method, JsonHandler *handler, const QVariantMap &data) const;
 
@@ -73,6 +90,8 @@ private slots:
     void asyncReplyFinished();
 
 public slots:
+    void invalidateResponseCache();
+
     // Client registration for JSON RPC traffic
     void registerClient(ProxyClient *proxyClient);
     void unregisterClient(ProxyClient *proxyClient);
@@ -8,24 +8,43 @@ HEADERS += \
     loggingcategories.h \
     transportinterface.h \
     websocketserver.h \
+    sslserver.h \
+    handshakeworker.h \
+    proxyprotocolserver.h \
+    ratelimiter.h \
+    securerandom.h \
     proxyclient.h \
     proxyserver.h \
     monitorserver.h \
+    handoverserver.h \
     proxyconfiguration.h \
     tunnelconnection.h \
     jsonrpcserver.h \
     jsonrpc/jsonhandler.h \
     jsonrpc/jsonreply.h \
     jsonrpc/jsontypes.h \
+    jsonrpc/jsonvalidator.h \
     jsonrpc/authenticationhandler.h \
     authentication/authenticator.h \
     authentication/authenticationreply.h \
+    authentication/authenticationscheduler.h \
+    authentication/authenticationcache.h \
+    authentication/sessionticketmanager.h \
     authentication/dummy/dummyauthenticator.h \
     authentication/aws/awsauthenticator.h \
     authentication/aws/userinformation.h \
     authentication/aws/authenticationprocess.h \
+    authentication/aws/authenticationbatchprocess.h \
     authentication/aws/sigv4utils.h \
     authentication/aws/awscredentialprovider.h \
+    authentication/tokendatabase/tokendatabase.h \
+    authentication/tokendatabase/tokendatabaseloader.h \
+    authentication/tokendatabase/tokendatabaseauthenticator.h \
+    cluster/clusterauthentication.h \
+    cluster/clustercoordinator.h \
+    cluster/clusterclient.h \
+    cluster/clusterlink.h \
+    cluster/rendezvoushash.h \
     logengine.h
 
 SOURCES += \
@@ -33,24 +52,43 @@ SOURCES += \
     loggingcategories.cpp \
     transportinterface.cpp \
     websocketserver.cpp \
+    sslserver.cpp \
+    handshakeworker.cpp \
+    proxyprotocolserver.cpp \
+    ratelimiter.cpp \
+    securerandom.cpp \
     proxyclient.cpp \
     proxyserver.cpp \
     monitorserver.cpp \
+    handoverserver.cpp \
     proxyconfiguration.cpp \
     tunnelconnection.cpp \
     jsonrpcserver.cpp \
     jsonrpc/jsonhandler.cpp \
     jsonrpc/jsonreply.cpp \
     jsonrpc/jsontypes.cpp \
+    jsonrpc/jsonvalidator.cpp \
     jsonrpc/authenticationhandler.cpp \
     authentication/authenticator.cpp \
     authentication/authenticationreply.cpp \
+    authentication/authenticationscheduler.cpp \
+    authentication/authenticationcache.cpp \
+    authentication/sessionticketmanager.cpp \
     authentication/dummy/dummyauthenticator.cpp \
     authentication/aws/awsauthenticator.cpp \
     authentication/aws/userinformation.cpp \
     authentication/aws/authenticationprocess.cpp \
+    authentication/aws/authenticationbatchprocess.cpp \
     authentication/aws/sigv4utils.cpp \
     authentication/aws/awscredentialprovider.cpp \
+    authentication/tokendatabase/tokendatabase.cpp \
+    authentication/tokendatabase/tokendatabaseloader.cpp \
+    authentication/tokendatabase/tokendatabaseauthenticator.cpp \
+    cluster/clusterauthentication.cpp \
+    cluster/clustercoordinator.cpp \
+    cluster/clusterclient.cpp \
+    cluster/clusterlink.cpp \
+    cluster/rendezvoushash.cpp \
     logengine.cpp
 
 
@@ -40,3 +40,7 @@ Q_LOGGING_CATEGORY(dcProxyServerTraffic, "ProxyServerTraffic")
 Q_LOGGING_CATEGORY(dcMonitorServer, "MonitorServer")
 Q_LOGGING_CATEGORY(dcAwsCredentialsProvider, "AwsCredentialsProvider")
 Q_LOGGING_CATEGORY(dcAwsCredentialsProviderTraffic, "AwsCredentialsProviderTraffic")
+Q_LOGGING_CATEGORY(dcTokenDatabase, "TokenDatabase")
+Q_LOGGING_CATEGORY(dcCluster, "Cluster")
+Q_LOGGING_CATEGORY(dcClusterTraffic, "ClusterTraffic")
+Q_LOGGING_CATEGORY(dcHandover, "Handover")
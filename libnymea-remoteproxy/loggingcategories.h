@@ -44,5 +44,9 @@ Q_DECLARE_LOGGING_CATEGORY(dcProxyServerTraffic)
 Q_DECLARE_LOGGING_CATEGORY(dcMonitorServer)
 Q_DECLARE_LOGGING_CATEGORY(dcAwsCredentialsProvider)
 Q_DECLARE_LOGGING_CATEGORY(dcAwsCredentialsProviderTraffic)
+Q_DECLARE_LOGGING_CATEGORY(dcTokenDatabase)
+Q_DECLARE_LOGGING_CATEGORY(dcCluster)
+Q_DECLARE_LOGGING_CATEGORY(dcClusterTraffic)
+Q_DECLARE_LOGGING_CATEGORY(dcHandover)
 
 #endif // LOGGINGCATEGORIES_H
@@ -64,7 +64,7 @@ void MonitorServer::onMonitorConnected()
 {
     QLocalSocket *clientConnection = m_server->nextPendingConnection();
     connect(clientConnection, &QLocalSocket::disconnected, this, &MonitorServer::onMonitorDisconnected);
-    connect(clientConnection, &QLocalSocket::readyRead, this, &MonitorServer::onMonitorDisconnected);
+    connect(clientConnection, &QLocalSocket::readyRead, this, &MonitorServer::onMonitorReadyRead);
     m_clients.append(clientConnection);
 
     qCDebug(dcMonitorServer()) << "New monitor connected.";
@@ -75,9 +75,64 @@ void MonitorServer::onMonitorDisconnected()
     qCDebug(dcMonitorServer()) << "Monitor disconnected.";
     QLocalSocket *clientConnection = static_cast<QLocalSocket *>(sender());
     m_clients.removeAll(clientConnection);
+    m_buffers.remove(clientConnection);
     clientConnection->deleteLater();
 }
 
+void MonitorServer::onMonitorReadyRead()
+{
+    QLocalSocket *clientConnection = static_cast<QLocalSocket *>(sender());
+    QByteArray &buffer = m_buffers[clientConnection];
+    buffer.append(clientConnection->readAll());
+
+    // One command per line
+    int index = buffer.indexOf('\n');
+    while (index >= 0) {
+        QByteArray line = buffer.left(index).trimmed();
+        buffer.remove(0, index + 1);
+        index = buffer.indexOf('\n');
+        if (line.isEmpty())
+            continue;
+
+        QJsonParseError error;
+        QVariantMap request = QJsonDocument::fromJson(line, &error).toVariant().toMap();
+        if (error.error != QJsonParseError::NoError) {
+            qCWarning(dcMonitorServer()) << "Invalid monitor command" << line << error.errorString();
+            QVariantMap response;
+            response.insert("success", false);
+            response.insert("error", "Invalid JSON: " + error.errorString());
+            sendMonitorData(clientConnection, response);
+            continue;
+        }
+
+        sendMonitorData(clientConnection, processCommand(request));
+    }
+}
+
+QVariantMap MonitorServer::processCommand(const QVariantMap &request)
+{
+    QString command = request.value("command").toString();
+    qCDebug(dcMonitorServer()) << "Monitor command" << command;
+
+    QVariantMap response;
+    response.insert("command", command);
+    if (command == "drain") {
+        response.insert("success", Engine::instance()->startDraining());
+        if (!response.value("success").toBool())
+            response.insert("error", "The server is already draining.");
+    } else if (command == "reload") {
+        response.insert("success", Engine::instance()->reloadConfiguration());
+        response.insert("reload", Engine::instance()->reloadStatistics());
+        if (!response.value("success").toBool())
+            response.insert("error", Engine::instance()->reloadErrorString());
+    } else {
+        response.insert("success", false);
+        response.insert("error", "Unknown command.");
+    }
+
+    return response;
+}
+
 void MonitorServer::startServer()
 {    
     qCDebug(dcMonitorServer()) << "Starting server on" << m_serverName;
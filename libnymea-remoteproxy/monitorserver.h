@@ -28,6 +28,7 @@
 #ifndef MONITORSERVER_H
 #define MONITORSERVER_H
 
+#include <QHash>
 #include <QTimer>
 #include <QObject>
 #include <QLocalServer>
@@ -48,12 +49,15 @@ private:
     QString m_serverName;
     QLocalServer *m_server = nullptr;
     QList<QLocalSocket *> m_clients;
+    QHash<QLocalSocket *, QByteArray> m_buffers;
 
     void sendMonitorData(QLocalSocket *clientConnection, const QVariantMap &dataMap);
+    QVariantMap processCommand(const QVariantMap &request);
 
 private slots:
     void onMonitorConnected();
     void onMonitorDisconnected();
+    void onMonitorReadyRead();
 
 public slots:
     void startServer();
@@ -29,6 +29,7 @@
 #include "proxyclient.h"
 
 #include <QDateTime>
+#include <QCryptographicHash>
 
 namespace remoteproxy {
 
@@ -75,7 +76,10 @@ void ProxyClient::setAuthenticated(bool isAuthenticated)
     m_authenticated = isAuthenticated;
     if (m_authenticated) {
         m_timer.stop();
-        m_timer.start(Engine::instance()->configuration()->aloneTimeout());
+
+        // A resumed client joins an existing tunnel and is not alone
+        if (!m_tunnelConnected)
+            m_timer.start(m_standby ? Engine::instance()->configuration()->standbyTimeout() : Engine::instance()->configuration()->aloneTimeout());
         emit authenticated();
     }
 }
@@ -142,6 +146,12 @@ QString ProxyClient::token() const
 void ProxyClient::setToken(const QString &token)
 {
     m_token = token;
+    m_tokenHash = QCryptographicHash::hash(m_token.toUtf8(), QCryptographicHash::Sha256);
+}
+
+QByteArray ProxyClient::tokenHash() const
+{
+    return m_tokenHash;
 }
 
 QString ProxyClient::nonce() const
@@ -154,6 +164,16 @@ void ProxyClient::setNonce(const QString &nonce)
     m_nonce = nonce;
 }
 
+QString ProxyClient::sessionTicket() const
+{
+    return m_sessionTicket;
+}
+
+void ProxyClient::setSessionTicket(const QString &sessionTicket)
+{
+    m_sessionTicket = sessionTicket;
+}
+
 quint64 ProxyClient::rxDataCount() const
 {
     return m_rxDataCount;
@@ -174,6 +194,138 @@ void ProxyClient::addTxDataCount(int dataCount)
     m_txDataCount += static_cast<quint64>(dataCount);
 }
 
+bool ProxyClient::isStandby() const
+{
+    return m_standby;
+}
+
+void ProxyClient::setStandby(bool standby)
+{
+    m_standby = standby;
+}
+
+bool ProxyClient::isMultiplexed() const
+{
+    return m_multiplexed;
+}
+
+void ProxyClient::setMultiplexed(bool multiplexed)
+{
+    m_multiplexed = multiplexed;
+}
+
+ProxyClient *ProxyClient::multiplexClient() const
+{
+    return m_multiplexClient;
+}
+
+quint32 ProxyClient::channelId() const
+{
+    return m_channelId;
+}
+
+void ProxyClient::setChannel(ProxyClient *multiplexClient, quint32 channelId)
+{
+    m_multiplexClient = multiplexClient;
+    m_channelId = channelId;
+}
+
+QList<ProxyClient *> ProxyClient::channels() const
+{
+    return m_channels.values();
+}
+
+ProxyClient *ProxyClient::channel(quint32 channelId) const
+{
+    return m_channels.value(channelId);
+}
+
+quint32 ProxyClient::addChannel(ProxyClient *channelClient)
+{
+    // Channel 0 is reserved for control messages
+    quint32 channelId = m_nextChannelId++;
+    if (m_nextChannelId == 0)
+        m_nextChannelId = 1;
+
+    m_channels.insert(channelId, channelClient);
+    return channelId;
+}
+
+void ProxyClient::removeChannel(quint32 channelId)
+{
+    m_channels.remove(channelId);
+}
+
+int ProxyClient::earlyDataSize() const
+{
+    return m_earlyDataSize;
+}
+
+int ProxyClient::earlyDataCount() const
+{
+    return m_earlyData.count();
+}
+
+void ProxyClient::appendEarlyData(const QByteArray &data)
+{
+    m_earlyData.append(data);
+    m_earlyDataSize += data.size();
+}
+
+QList<QByteArray> ProxyClient::takeEarlyData()
+{
+    QList<QByteArray> earlyData = m_earlyData;
+    m_earlyData.clear();
+    m_earlyDataSize = 0;
+    return earlyData;
+}
+
+QString ProxyClient::resumptionTicket() const
+{
+    return m_resumptionTicket;
+}
+
+void ProxyClient::setResumptionTicket(const QString &resumptionTicket)
+{
+    m_resumptionTicket = resumptionTicket;
+}
+
+bool ProxyClient::isSuspended() const
+{
+    return m_suspended;
+}
+
+void ProxyClient::setSuspended(bool suspended)
+{
+    m_suspended = suspended;
+    m_timer.stop();
+
+    // The transport connection is gone, give the client some time to resume the tunnel
+    if (m_suspended) {
+        m_interface = nullptr;
+        m_timer.start(Engine::instance()->configuration()->resumptionTimeout());
+    }
+}
+
+int ProxyClient::resumptionDataSize() const
+{
+    return m_resumptionDataSize;
+}
+
+void ProxyClient::appendResumptionData(const QByteArray &data)
+{
+    m_resumptionData.append(data);
+    m_resumptionDataSize += data.size();
+}
+
+QList<QByteArray> ProxyClient::takeResumptionData()
+{
+    QList<QByteArray> resumptionData = m_resumptionData;
+    m_resumptionData.clear();
+    m_resumptionDataSize = 0;
+    return resumptionData;
+}
+
 void ProxyClient::sendData(const QByteArray &data)
 {
     if (!m_interface)
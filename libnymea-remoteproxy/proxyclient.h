@@ -31,6 +31,7 @@
 #include <QUuid>
 #include <QDebug>
 #include <QObject>
+#include <QHash>
 #include <QTimer>
 #include <QHostAddress>
 
@@ -74,15 +75,55 @@ public:
     QString token() const;
     void setToken(const QString &token);
 
+    QByteArray tokenHash() const;
+
     QString nonce() const;
     void setNonce(const QString &nonce);
 
+    QString sessionTicket() const;
+    void setSessionTicket(const QString &sessionTicket);
+
     quint64 rxDataCount() const;
     void addRxDataCount(int dataCount);
 
     quint64 txDataCount() const;
     void addTxDataCount(int dataCount);
 
+    // Standby connection waiting for any client with this token
+    bool isStandby() const;
+    void setStandby(bool standby);
+
+    // Multiplexing
+    bool isMultiplexed() const;
+    void setMultiplexed(bool multiplexed);
+
+    ProxyClient *multiplexClient() const;
+    quint32 channelId() const;
+    void setChannel(ProxyClient *multiplexClient, quint32 channelId);
+
+    QList<ProxyClient *> channels() const;
+    ProxyClient *channel(quint32 channelId) const;
+    quint32 addChannel(ProxyClient *channelClient);
+    void removeChannel(quint32 channelId);
+
+    // Data received before the tunnel has been established
+    int earlyDataSize() const;
+    int earlyDataCount() const;
+    void appendEarlyData(const QByteArray &data);
+    QList<QByteArray> takeEarlyData();
+
+    // Tunnel resumption
+    QString resumptionTicket() const;
+    void setResumptionTicket(const QString &resumptionTicket);
+
+    bool isSuspended() const;
+    void setSuspended(bool suspended);
+
+    // Data received from the tunnel partner while suspended
+    int resumptionDataSize() const;
+    void appendResumptionData(const QByteArray &data);
+    QList<QByteArray> takeResumptionData();
+
     // Actions for this client
     void sendData(const QByteArray &data);
     void killConnection(const QString &reason);
@@ -101,13 +142,34 @@ private:
     QString m_uuid;
     QString m_name;
     QString m_token;
+    QByteArray m_tokenHash;
     QString m_nonce;
+    QString m_sessionTicket;
 
     QString m_userName;
 
     quint64 m_rxDataCount = 0;
     quint64 m_txDataCount = 0;
 
+    bool m_standby = false;
+
+    // The multiplexed connection this client is a channel of
+    ProxyClient *m_multiplexClient = nullptr;
+    quint32 m_channelId = 0;
+
+    // The channels of this multiplexed connection
+    bool m_multiplexed = false;
+    QHash<quint32, ProxyClient *> m_channels;
+    quint32 m_nextChannelId = 1;
+
+    QList<QByteArray> m_earlyData;
+    int m_earlyDataSize = 0;
+
+    QString m_resumptionTicket;
+    bool m_suspended = false;
+    QList<QByteArray> m_resumptionData;
+    int m_resumptionDataSize = 0;
+
 signals:
     void authenticated();
     void tunnelConnected();
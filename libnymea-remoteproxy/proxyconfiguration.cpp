@@ -27,11 +27,14 @@
 
 #include "loggingcategories.h"
 #include "proxyconfiguration.h"
+#include "cluster/clusterauthentication.h"
 
 #include <QFile>
 #include <QSslKey>
 #include <QFileInfo>
+#include <QSslCipher>
 #include <QSslCertificate>
+#include <QSslEllipticCurve>
 
 namespace remoteproxy {
 
@@ -44,9 +47,11 @@ ProxyConfiguration::ProxyConfiguration(QObject *parent) :
 bool ProxyConfiguration::loadConfiguration(const QString &fileName)
 {
     m_fileName = fileName;
+    m_errorString.clear();
     QFileInfo fileInfo(m_fileName);
     if (!fileInfo.exists()) {
         qCWarning(dcApplication()) << "Configuration: Could not find configuration file" << m_fileName;
+        m_errorString = QString("Could not find configuration file %1").arg(m_fileName);
         return false;
     }
 
@@ -62,18 +67,44 @@ bool ProxyConfiguration::loadConfiguration(const QString &fileName)
     setAuthenticationTimeout(settings.value("authenticationTimeout", 8000).toInt());
     setInactiveTimeout(settings.value("inactiveTimeout", 8000).toInt());
     setAloneTimeout(settings.value("aloneTimeout", 8000).toInt());
+    setEarlyDataSize(settings.value("earlyDataSize", 0).toInt());
+    setEarlyDataMessages(settings.value("earlyDataMessages", 16).toInt());
+    setStandbyPoolSize(settings.value("standbyPoolSize", 0).toInt());
+    setStandbyTimeout(settings.value("standbyTimeout", 300000).toInt());
+    setResumptionTimeout(settings.value("resumptionTimeout", 0).toInt());
+    setResumptionBufferSize(settings.value("resumptionBufferSize", 65536).toInt());
+    setHandoverSocketFileName(settings.value("handoverSocket", "/tmp/nymea-remoteproxy.handover").toString());
+    setDrainTimeout(settings.value("drainTimeout", 600000).toInt());
+    setDrainBatchSize(settings.value("drainBatchSize", 10).toInt());
+    setDrainRetryAfter(settings.value("drainRetryAfter", 10000).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("Authentication");
+    setMaximumConcurrentAuthentications(settings.value("maximumConcurrent", 50).toInt());
+    setAuthenticationQueueSize(settings.value("queueSize", 500).toInt());
+    setNegativeCacheTimeout(settings.value("negativeCacheTimeout", 30000).toInt());
+    setNegativeCacheMaximumTimeout(settings.value("negativeCacheMaximumTimeout", 600000).toInt());
+    setNegativeCacheSize(settings.value("negativeCacheSize", 10000).toInt());
+    setSessionTicketLifetime(settings.value("sessionTicketLifetime", 0).toInt());
+    setSessionTicketKeyFileName(settings.value("sessionTicketKeyFile", "").toString());
     settings.endGroup();
 
     settings.beginGroup("AWS");
     setAwsRegion(settings.value("region", "eu-west-1").toString());
     setAwsAuthorizerLambdaFunctionName(settings.value("authorizerLambdaFunction", "system-services-authorizer-dev-checkToken").toString());
     setAwsCredentialsUrl(QUrl(settings.value("awsCredentialsUrl", "http://169.254.169.254/latest/meta-data/iam/security-credentials/EC2-Remote-Connection-Proxy-Role").toString()));
+    setAwsAuthorizerEndpoint(QUrl(settings.value("authorizerEndpoint", "").toString()));
+    setAwsBatchInterval(settings.value("batchInterval", 0).toInt());
+    setAwsBatchSize(settings.value("batchSize", 20).toInt());
     settings.endGroup();
 
     settings.beginGroup("SSL");
     setSslCertificateFileName(settings.value("certificate", "/etc/ssl/certs/ssl-cert-snakeoil.pem").toString());
     setSslCertificateKeyFileName(settings.value("certificateKey", "/etc/ssl/private/ssl-cert-snakeoil.key").toString());
     setSslCertificateChainFileName(settings.value("certificateChain", "").toString());
+    setHandshakeThreads(settings.value("handshakeThreads", 0).toInt());
+    setHandshakeTimeout(settings.value("handshakeTimeout", 5000).toInt());
+    setSslProfile(settings.value("profile", "default").toString());
     settings.endGroup();
 
     settings.beginGroup("WebSocketServer");
@@ -86,15 +117,100 @@ bool ProxyConfiguration::loadConfiguration(const QString &fileName)
     setTcpServerPort(static_cast<quint16>(settings.value("port", 1213).toInt()));
     settings.endGroup();
 
+    settings.beginGroup("PlainWebSocketServer");
+    setPlainWebSocketServerEnabled(settings.value("enabled", false).toBool());
+    setPlainWebSocketServerHost(QHostAddress(settings.value("host", "127.0.0.1").toString()));
+    setPlainWebSocketServerPort(static_cast<quint16>(settings.value("port", 8080).toInt()));
+    setTrustedProxies(settings.value("trustedProxies", QStringList()).toStringList());
+    setProxyHeaderTimeout(settings.value("headerTimeout", 5000).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("RateLimit");
+    setConnectionRate(settings.value("connectionRate", 0).toDouble());
+    setConnectionBurst(settings.value("connectionBurst", 20).toInt());
+    setSubnetConnectionRate(settings.value("subnetConnectionRate", 0).toDouble());
+    setSubnetConnectionBurst(settings.value("subnetConnectionBurst", 200).toInt());
+    setIpv4SubnetPrefix(settings.value("ipv4SubnetPrefix", 24).toInt());
+    setIpv6SubnetPrefix(settings.value("ipv6SubnetPrefix", 64).toInt());
+    setCallRate(settings.value("callRate", 0).toDouble());
+    setCallBurst(settings.value("callBurst", 20).toInt());
+    setRateLimitMaximumBuckets(settings.value("maximumBuckets", 100000).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("Cluster");
+    setClusterEnabled(settings.value("enabled", false).toBool());
+    setClusterNodeId(settings.value("nodeId", serverName()).toString());
+    setClusterCoordinatorUrl(QUrl(settings.value("coordinator", "unix:/tmp/nymea-remoteproxy-cluster.sock").toString()));
+    setClusterLinkHost(QHostAddress(settings.value("linkHost", "127.0.0.1").toString()));
+    setClusterLinkPort(static_cast<quint16>(settings.value("linkPort", 1214).toInt()));
+    setClusterMembers(settings.value("members", QStringList()).toStringList());
+    setClusterNodeUrl(settings.value("nodeUrl", "").toString());
+    setClusterSecretFileName(settings.value("secretFile", "").toString());
+    settings.endGroup();
+
+    // The plain listener only accepts connections from known load balancers
+    foreach (const QString &trustedProxy, trustedProxies()) {
+        if (QHostAddress::parseSubnet(trustedProxy.trimmed()).first.isNull()) {
+            qCWarning(dcApplication()) << "Configuration: Invalid trusted proxy subnet" << trustedProxy;
+            m_errorString = QString("Invalid trusted proxy subnet %1").arg(trustedProxy);
+            return false;
+        }
+    }
+
+    if (ipv4SubnetPrefix() < 0 || ipv4SubnetPrefix() > 32 || ipv6SubnetPrefix() < 0 || ipv6SubnetPrefix() > 128) {
+        qCWarning(dcApplication()) << "Configuration: Invalid rate limit subnet prefix" << ipv4SubnetPrefix() << ipv6SubnetPrefix();
+        m_errorString = QString("Invalid rate limit subnet prefix %1 or %2").arg(ipv4SubnetPrefix()).arg(ipv6SubnetPrefix());
+        return false;
+    }
+
+    if (proxyHeaderTimeout() <= 0) {
+        qCWarning(dcApplication()) << "Configuration: Invalid PROXY protocol header timeout" << proxyHeaderTimeout();
+        m_errorString = QString("Invalid PROXY protocol header timeout %1").arg(proxyHeaderTimeout());
+        return false;
+    }
+
+    // Nodes of a cluster accept tunnel clients from each other, only the ones knowing the secret
+    setClusterSecret(QByteArray());
+    if (!clusterSecretFileName().isEmpty())
+        setClusterSecret(ClusterAuthentication::loadSecret(clusterSecretFileName()));
+
+    if (clusterEnabled() && clusterSecret().isEmpty()) {
+        qCWarning(dcApplication()) << "Configuration: The cluster requires a secret file";
+        m_errorString = "The cluster requires a secret file";
+        return false;
+    }
+
+    if (plainWebSocketServerEnabled() && trustedProxies().isEmpty()) {
+        qCWarning(dcApplication()) << "Configuration: The plain web socket server requires trusted proxies";
+        m_errorString = "The plain web socket server requires trusted proxies";
+        return false;
+    }
+
+    if (handshakeTimeout() <= 0) {
+        qCWarning(dcApplication()) << "Configuration: Invalid SSL handshake timeout" << handshakeTimeout();
+        m_errorString = QString("Invalid SSL handshake timeout %1").arg(handshakeTimeout());
+        return false;
+    }
+
+    if (!(QStringList() << "default" << "modern" << "strict").contains(sslProfile())) {
+        qCWarning(dcApplication()) << "Configuration: Invalid SSL profile" << sslProfile();
+        m_errorString = QString("Invalid SSL profile %1").arg(sslProfile());
+        return false;
+    }
+
     // Load SSL configuration
     QSslConfiguration sslConfiguration;
     sslConfiguration.setPeerVerifyMode(QSslSocket::VerifyNone);
     sslConfiguration.setProtocol(QSsl::TlsV1_2OrLater);
 
+    // Each connection gets its own TLS context, the server could never redeem its own session tickets
+    sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionTickets, true);
+
     // SSL certificate
     QFile certFile(sslCertificateFileName());
     if (!certFile.open(QIODevice::ReadOnly)) {
         qCWarning(dcApplication()) << "Could not open certificate file" << sslCertificateFileName() << certFile.errorString();
+        m_errorString = QString("Could not open certificate file %1: %2").arg(sslCertificateFileName()).arg(certFile.errorString());
         return false;
     }
     QSslCertificate certificate(&certFile, QSsl::Pem);
@@ -106,9 +222,12 @@ bool ProxyConfiguration::loadConfiguration(const QString &fileName)
     QFile certKeyFile(sslCertificateKeyFileName());
     if (!certKeyFile.open(QIODevice::ReadOnly)) {
         qCWarning(dcApplication()) << "Could not open certificate key file:" << sslCertificateKeyFileName() << certKeyFile.errorString();
+        m_errorString = QString("Could not open certificate key file %1: %2").arg(sslCertificateKeyFileName()).arg(certKeyFile.errorString());
         return false;
     }
-    QSslKey sslKey(&certKeyFile, QSsl::Rsa, QSsl::Pem, QSsl::PrivateKey);
+    // The key has the algorithm of the certificate, RSA or ECDSA
+    QSsl::KeyAlgorithm keyAlgorithm = certificate.publicKey().algorithm() == QSsl::Ec ? QSsl::Ec : QSsl::Rsa;
+    QSslKey sslKey(&certKeyFile, keyAlgorithm, QSsl::Pem, QSsl::PrivateKey);
     qCDebug(dcApplication()) << "Loaded successfully certificate key" << sslCertificateKeyFileName();
     certKeyFile.close();
     sslConfiguration.setPrivateKey(sslKey);
@@ -118,6 +237,7 @@ bool ProxyConfiguration::loadConfiguration(const QString &fileName)
         QFile certChainFile(sslCertificateChainFileName());
         if (!certChainFile.open(QIODevice::ReadOnly)) {
             qCWarning(dcApplication()) << "Could not open certificate chain file:" << sslCertificateChainFileName() << certChainFile.errorString();
+            m_errorString = QString("Could not open certificate chain file %1: %2").arg(sslCertificateChainFileName()).arg(certChainFile.errorString());
             return false;
         }
         QSslCertificate certificate(&certChainFile, QSsl::Pem);
@@ -126,6 +246,54 @@ bool ProxyConfiguration::loadConfiguration(const QString &fileName)
         qCDebug(dcApplication()) << "Loaded successfully certificate chain" << sslCertificateKeyFileName();
     }
 
+    // SSL performance profile, the default profile keeps the defaults of Qt and the SSL library
+    if (sslProfile() == "modern" || sslProfile() == "strict") {
+        // Forward secret AEAD ciphers only, the ones of the certificate type get used
+        QList<QSslCipher> ciphers;
+        QStringList cipherNames;
+        cipherNames << "TLS_AES_128_GCM_SHA256" << "TLS_CHACHA20_POLY1305_SHA256" << "TLS_AES_256_GCM_SHA384";
+        cipherNames << "ECDHE-ECDSA-AES128-GCM-SHA256" << "ECDHE-RSA-AES128-GCM-SHA256";
+        cipherNames << "ECDHE-ECDSA-CHACHA20-POLY1305" << "ECDHE-RSA-CHACHA20-POLY1305";
+        cipherNames << "ECDHE-ECDSA-AES256-GCM-SHA384" << "ECDHE-RSA-AES256-GCM-SHA384";
+        foreach (const QString &cipherName, cipherNames) {
+            QSslCipher cipher(cipherName);
+            if (!cipher.isNull())
+                ciphers.append(cipher);
+        }
+
+        if (ciphers.isEmpty()) {
+            qCWarning(dcApplication()) << "Configuration: The SSL library supports none of the ciphers of the SSL profile" << sslProfile();
+            m_errorString = QString("The SSL library supports none of the ciphers of the SSL profile %1").arg(sslProfile());
+            return false;
+        }
+        sslConfiguration.setCiphers(ciphers);
+
+        // X25519 first, it is the fastest key exchange and supported by all recent clients
+        QVector<QSslEllipticCurve> curves;
+        foreach (const QString &curveName, QStringList() << "X25519" << "prime256v1" << "secp384r1") {
+            QSslEllipticCurve curve = QSslEllipticCurve::fromShortName(curveName);
+            if (curve.isValid())
+                curves.append(curve);
+        }
+        sslConfiguration.setEllipticCurves(curves);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+        // All remaining ciphers are fine, let the client choose. Clients without AES hardware support
+        // prefer ChaCha20, which is a lot faster for them than AES in software.
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableServerCipherPreference, true);
+#endif
+    }
+
+    if (sslProfile() == "strict") {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+        sslConfiguration.setProtocol(QSsl::TlsV1_3OrLater);
+#else
+        qCWarning(dcApplication()) << "Configuration: The strict SSL profile requires Qt 5.12 or newer";
+        m_errorString = "The strict SSL profile requires Qt 5.12 or newer";
+        return false;
+#endif
+    }
+
     m_sslConfiguration = sslConfiguration;
 
     return true;
@@ -136,6 +304,112 @@ QString ProxyConfiguration::fileName() const
     return m_fileName;
 }
 
+QString ProxyConfiguration::errorString() const
+{
+    return m_errorString;
+}
+
+QStringList ProxyConfiguration::applyConfiguration(const ProxyConfiguration *configuration)
+{
+    // Settings bound to sockets, files or objects created in Engine::start() only take effect on restart
+    QStringList restartRequired;
+    if (configuration->writeLogFile() != writeLogFile() || configuration->logFileName() != logFileName())
+        restartRequired.append("ProxyServer/logFile");
+
+    if (configuration->logEngineEnabled() != logEngineEnabled())
+        restartRequired.append("ProxyServer/logEngineEnabled");
+
+    if (configuration->monitorSocketFileName() != monitorSocketFileName())
+        restartRequired.append("ProxyServer/monitorSocket");
+
+    if (configuration->handoverSocketFileName() != handoverSocketFileName())
+        restartRequired.append("ProxyServer/handoverSocket");
+
+    if (configuration->awsCredentialsUrl() != awsCredentialsUrl())
+        restartRequired.append("AWS/awsCredentialsUrl");
+
+    if (configuration->handshakeThreads() != handshakeThreads())
+        restartRequired.append("SSL/handshakeThreads");
+
+    if (configuration->webSocketServerHost() != webSocketServerHost() || configuration->webSocketServerPort() != webSocketServerPort())
+        restartRequired.append("WebSocketServer");
+
+    if (configuration->tcpServerHost() != tcpServerHost() || configuration->tcpServerPort() != tcpServerPort())
+        restartRequired.append("TcpServer");
+
+    if (configuration->plainWebSocketServerEnabled() != plainWebSocketServerEnabled()
+            || configuration->plainWebSocketServerHost() != plainWebSocketServerHost()
+            || configuration->plainWebSocketServerPort() != plainWebSocketServerPort()
+            || configuration->trustedProxies() != trustedProxies())
+        restartRequired.append("PlainWebSocketServer");
+
+    if (configuration->clusterEnabled() != clusterEnabled() || configuration->clusterNodeId() != clusterNodeId()
+            || configuration->clusterCoordinatorUrl() != clusterCoordinatorUrl()
+            || configuration->clusterLinkHost() != clusterLinkHost() || configuration->clusterLinkPort() != clusterLinkPort()
+            || configuration->clusterSecret() != clusterSecret())
+        restartRequired.append("Cluster");
+
+    // ProxyServer
+    setServerName(configuration->serverName());
+    setJsonRpcTimeout(configuration->jsonRpcTimeout());
+    setAuthenticationTimeout(configuration->authenticationTimeout());
+    setInactiveTimeout(configuration->inactiveTimeout());
+    setAloneTimeout(configuration->aloneTimeout());
+    setEarlyDataSize(configuration->earlyDataSize());
+    setEarlyDataMessages(configuration->earlyDataMessages());
+    setStandbyPoolSize(configuration->standbyPoolSize());
+    setStandbyTimeout(configuration->standbyTimeout());
+    setResumptionTimeout(configuration->resumptionTimeout());
+    setResumptionBufferSize(configuration->resumptionBufferSize());
+    setDrainTimeout(configuration->drainTimeout());
+    setDrainBatchSize(configuration->drainBatchSize());
+    setDrainRetryAfter(configuration->drainRetryAfter());
+
+    // Authentication
+    setMaximumConcurrentAuthentications(configuration->maximumConcurrentAuthentications());
+    setAuthenticationQueueSize(configuration->authenticationQueueSize());
+    setNegativeCacheTimeout(configuration->negativeCacheTimeout());
+    setNegativeCacheMaximumTimeout(configuration->negativeCacheMaximumTimeout());
+    setNegativeCacheSize(configuration->negativeCacheSize());
+    setSessionTicketLifetime(configuration->sessionTicketLifetime());
+    setSessionTicketKeyFileName(configuration->sessionTicketKeyFileName());
+
+    // AWS
+    setAwsRegion(configuration->awsRegion());
+    setAwsAuthorizerLambdaFunctionName(configuration->awsAuthorizerLambdaFunctionName());
+    setAwsAuthorizerEndpoint(configuration->awsAuthorizerEndpoint());
+    setAwsBatchInterval(configuration->awsBatchInterval());
+    setAwsBatchSize(configuration->awsBatchSize());
+
+    // Ssl
+    setSslCertificateFileName(configuration->sslCertificateFileName());
+    setSslCertificateKeyFileName(configuration->sslCertificateKeyFileName());
+    setSslCertificateChainFileName(configuration->sslCertificateChainFileName());
+    setHandshakeTimeout(configuration->handshakeTimeout());
+    setSslProfile(configuration->sslProfile());
+    m_sslConfiguration = configuration->sslConfiguration();
+
+    // PlainWebSocketServer
+    setProxyHeaderTimeout(configuration->proxyHeaderTimeout());
+
+    // RateLimit
+    setConnectionRate(configuration->connectionRate());
+    setConnectionBurst(configuration->connectionBurst());
+    setSubnetConnectionRate(configuration->subnetConnectionRate());
+    setSubnetConnectionBurst(configuration->subnetConnectionBurst());
+    setIpv4SubnetPrefix(configuration->ipv4SubnetPrefix());
+    setIpv6SubnetPrefix(configuration->ipv6SubnetPrefix());
+    setCallRate(configuration->callRate());
+    setCallBurst(configuration->callBurst());
+    setRateLimitMaximumBuckets(configuration->rateLimitMaximumBuckets());
+
+    // Cluster
+    setClusterMembers(configuration->clusterMembers());
+    setClusterNodeUrl(configuration->clusterNodeUrl());
+
+    return restartRequired;
+}
+
 QString ProxyConfiguration::serverName() const
 {
     return m_serverName;
@@ -226,6 +500,176 @@ void ProxyConfiguration::setAloneTimeout(int timeout)
     m_aloneTimeout = timeout;
 }
 
+int ProxyConfiguration::earlyDataSize() const
+{
+    return m_earlyDataSize;
+}
+
+void ProxyConfiguration::setEarlyDataSize(int size)
+{
+    m_earlyDataSize = size;
+}
+
+int ProxyConfiguration::earlyDataMessages() const
+{
+    return m_earlyDataMessages;
+}
+
+void ProxyConfiguration::setEarlyDataMessages(int messages)
+{
+    m_earlyDataMessages = messages;
+}
+
+int ProxyConfiguration::standbyPoolSize() const
+{
+    return m_standbyPoolSize;
+}
+
+void ProxyConfiguration::setStandbyPoolSize(int size)
+{
+    m_standbyPoolSize = size;
+}
+
+int ProxyConfiguration::standbyTimeout() const
+{
+    return m_standbyTimeout;
+}
+
+void ProxyConfiguration::setStandbyTimeout(int timeout)
+{
+    m_standbyTimeout = timeout;
+}
+
+int ProxyConfiguration::resumptionTimeout() const
+{
+    return m_resumptionTimeout;
+}
+
+void ProxyConfiguration::setResumptionTimeout(int timeout)
+{
+    m_resumptionTimeout = timeout;
+}
+
+int ProxyConfiguration::resumptionBufferSize() const
+{
+    return m_resumptionBufferSize;
+}
+
+void ProxyConfiguration::setResumptionBufferSize(int size)
+{
+    m_resumptionBufferSize = size;
+}
+
+QString ProxyConfiguration::handoverSocketFileName() const
+{
+    return m_handoverSocketFileName;
+}
+
+void ProxyConfiguration::setHandoverSocketFileName(const QString &fileName)
+{
+    m_handoverSocketFileName = fileName;
+}
+
+int ProxyConfiguration::drainTimeout() const
+{
+    return m_drainTimeout;
+}
+
+void ProxyConfiguration::setDrainTimeout(int timeout)
+{
+    m_drainTimeout = timeout;
+}
+
+int ProxyConfiguration::drainBatchSize() const
+{
+    return m_drainBatchSize;
+}
+
+void ProxyConfiguration::setDrainBatchSize(int size)
+{
+    m_drainBatchSize = size;
+}
+
+int ProxyConfiguration::drainRetryAfter() const
+{
+    return m_drainRetryAfter;
+}
+
+void ProxyConfiguration::setDrainRetryAfter(int retryAfter)
+{
+    m_drainRetryAfter = retryAfter;
+}
+
+int ProxyConfiguration::maximumConcurrentAuthentications() const
+{
+    return m_maximumConcurrentAuthentications;
+}
+
+void ProxyConfiguration::setMaximumConcurrentAuthentications(int maximumConcurrentAuthentications)
+{
+    m_maximumConcurrentAuthentications = maximumConcurrentAuthentications;
+}
+
+int ProxyConfiguration::authenticationQueueSize() const
+{
+    return m_authenticationQueueSize;
+}
+
+void ProxyConfiguration::setAuthenticationQueueSize(int queueSize)
+{
+    m_authenticationQueueSize = queueSize;
+}
+
+int ProxyConfiguration::negativeCacheTimeout() const
+{
+    return m_negativeCacheTimeout;
+}
+
+void ProxyConfiguration::setNegativeCacheTimeout(int timeout)
+{
+    m_negativeCacheTimeout = timeout;
+}
+
+int ProxyConfiguration::negativeCacheMaximumTimeout() const
+{
+    return m_negativeCacheMaximumTimeout;
+}
+
+void ProxyConfiguration::setNegativeCacheMaximumTimeout(int timeout)
+{
+    m_negativeCacheMaximumTimeout = timeout;
+}
+
+int ProxyConfiguration::negativeCacheSize() const
+{
+    return m_negativeCacheSize;
+}
+
+void ProxyConfiguration::setNegativeCacheSize(int size)
+{
+    m_negativeCacheSize = size;
+}
+
+int ProxyConfiguration::sessionTicketLifetime() const
+{
+    return m_sessionTicketLifetime;
+}
+
+void ProxyConfiguration::setSessionTicketLifetime(int lifetime)
+{
+    m_sessionTicketLifetime = lifetime;
+}
+
+QString ProxyConfiguration::sessionTicketKeyFileName() const
+{
+    return m_sessionTicketKeyFileName;
+}
+
+void ProxyConfiguration::setSessionTicketKeyFileName(const QString &fileName)
+{
+    m_sessionTicketKeyFileName = fileName;
+}
+
 QString ProxyConfiguration::awsRegion() const
 {
     return m_awsRegion;
@@ -256,6 +700,36 @@ void ProxyConfiguration::setAwsCredentialsUrl(const QUrl &url)
     m_awsCredentialsUrl = url;
 }
 
+QUrl ProxyConfiguration::awsAuthorizerEndpoint() const
+{
+    return m_awsAuthorizerEndpoint;
+}
+
+void ProxyConfiguration::setAwsAuthorizerEndpoint(const QUrl &url)
+{
+    m_awsAuthorizerEndpoint = url;
+}
+
+int ProxyConfiguration::awsBatchInterval() const
+{
+    return m_awsBatchInterval;
+}
+
+void ProxyConfiguration::setAwsBatchInterval(int interval)
+{
+    m_awsBatchInterval = interval;
+}
+
+int ProxyConfiguration::awsBatchSize() const
+{
+    return m_awsBatchSize;
+}
+
+void ProxyConfiguration::setAwsBatchSize(int size)
+{
+    m_awsBatchSize = size;
+}
+
 QString ProxyConfiguration::sslCertificateFileName() const
 {
     return m_sslCertificateFileName;
@@ -286,6 +760,36 @@ void ProxyConfiguration::setSslCertificateChainFileName(const QString &fileName)
     m_sslCertificateChainFileName = fileName;
 }
 
+int ProxyConfiguration::handshakeThreads() const
+{
+    return m_handshakeThreads;
+}
+
+void ProxyConfiguration::setHandshakeThreads(int threads)
+{
+    m_handshakeThreads = threads;
+}
+
+int ProxyConfiguration::handshakeTimeout() const
+{
+    return m_handshakeTimeout;
+}
+
+void ProxyConfiguration::setHandshakeTimeout(int timeout)
+{
+    m_handshakeTimeout = timeout;
+}
+
+QString ProxyConfiguration::sslProfile() const
+{
+    return m_sslProfile;
+}
+
+void ProxyConfiguration::setSslProfile(const QString &profile)
+{
+    m_sslProfile = profile;
+}
+
 QSslConfiguration ProxyConfiguration::sslConfiguration() const
 {
     return m_sslConfiguration;
@@ -331,6 +835,252 @@ void ProxyConfiguration::setTcpServerPort(quint16 port)
     m_tcpServerPort = port;
 }
 
+bool ProxyConfiguration::plainWebSocketServerEnabled() const
+{
+    return m_plainWebSocketServerEnabled;
+}
+
+void ProxyConfiguration::setPlainWebSocketServerEnabled(bool enabled)
+{
+    m_plainWebSocketServerEnabled = enabled;
+}
+
+QHostAddress ProxyConfiguration::plainWebSocketServerHost() const
+{
+    return m_plainWebSocketServerHost;
+}
+
+void ProxyConfiguration::setPlainWebSocketServerHost(const QHostAddress &address)
+{
+    m_plainWebSocketServerHost = address;
+}
+
+quint16 ProxyConfiguration::plainWebSocketServerPort() const
+{
+    return m_plainWebSocketServerPort;
+}
+
+void ProxyConfiguration::setPlainWebSocketServerPort(quint16 port)
+{
+    m_plainWebSocketServerPort = port;
+}
+
+QStringList ProxyConfiguration::trustedProxies() const
+{
+    return m_trustedProxies;
+}
+
+void ProxyConfiguration::setTrustedProxies(const QStringList &trustedProxies)
+{
+    m_trustedProxies = trustedProxies;
+}
+
+int ProxyConfiguration::proxyHeaderTimeout() const
+{
+    return m_proxyHeaderTimeout;
+}
+
+void ProxyConfiguration::setProxyHeaderTimeout(int timeout)
+{
+    m_proxyHeaderTimeout = timeout;
+}
+
+QList<QPair<QHostAddress, int>> ProxyConfiguration::trustedProxySubnets() const
+{
+    QList<QPair<QHostAddress, int>> subnets;
+    foreach (const QString &trustedProxy, m_trustedProxies) {
+        QPair<QHostAddress, int> subnet = QHostAddress::parseSubnet(trustedProxy.trimmed());
+        if (!subnet.first.isNull())
+            subnets.append(subnet);
+    }
+
+    return subnets;
+}
+
+double ProxyConfiguration::connectionRate() const
+{
+    return m_connectionRate;
+}
+
+void ProxyConfiguration::setConnectionRate(double rate)
+{
+    m_connectionRate = rate;
+}
+
+int ProxyConfiguration::connectionBurst() const
+{
+    return m_connectionBurst;
+}
+
+void ProxyConfiguration::setConnectionBurst(int burst)
+{
+    m_connectionBurst = burst;
+}
+
+double ProxyConfiguration::subnetConnectionRate() const
+{
+    return m_subnetConnectionRate;
+}
+
+void ProxyConfiguration::setSubnetConnectionRate(double rate)
+{
+    m_subnetConnectionRate = rate;
+}
+
+int ProxyConfiguration::subnetConnectionBurst() const
+{
+    return m_subnetConnectionBurst;
+}
+
+void ProxyConfiguration::setSubnetConnectionBurst(int burst)
+{
+    m_subnetConnectionBurst = burst;
+}
+
+int ProxyConfiguration::ipv4SubnetPrefix() const
+{
+    return m_ipv4SubnetPrefix;
+}
+
+void ProxyConfiguration::setIpv4SubnetPrefix(int prefixLength)
+{
+    m_ipv4SubnetPrefix = prefixLength;
+}
+
+int ProxyConfiguration::ipv6SubnetPrefix() const
+{
+    return m_ipv6SubnetPrefix;
+}
+
+void ProxyConfiguration::setIpv6SubnetPrefix(int prefixLength)
+{
+    m_ipv6SubnetPrefix = prefixLength;
+}
+
+double ProxyConfiguration::callRate() const
+{
+    return m_callRate;
+}
+
+void ProxyConfiguration::setCallRate(double rate)
+{
+    m_callRate = rate;
+}
+
+int ProxyConfiguration::callBurst() const
+{
+    return m_callBurst;
+}
+
+void ProxyConfiguration::setCallBurst(int burst)
+{
+    m_callBurst = burst;
+}
+
+int ProxyConfiguration::rateLimitMaximumBuckets() const
+{
+    return m_rateLimitMaximumBuckets;
+}
+
+void ProxyConfiguration::setRateLimitMaximumBuckets(int maximumBuckets)
+{
+    m_rateLimitMaximumBuckets = maximumBuckets;
+}
+
+bool ProxyConfiguration::clusterEnabled() const
+{
+    return m_clusterEnabled;
+}
+
+void ProxyConfiguration::setClusterEnabled(bool enabled)
+{
+    m_clusterEnabled = enabled;
+}
+
+QString ProxyConfiguration::clusterNodeId() const
+{
+    return m_clusterNodeId;
+}
+
+void ProxyConfiguration::setClusterNodeId(const QString &nodeId)
+{
+    m_clusterNodeId = nodeId;
+}
+
+QUrl ProxyConfiguration::clusterCoordinatorUrl() const
+{
+    return m_clusterCoordinatorUrl;
+}
+
+void ProxyConfiguration::setClusterCoordinatorUrl(const QUrl &url)
+{
+    m_clusterCoordinatorUrl = url;
+}
+
+QHostAddress ProxyConfiguration::clusterLinkHost() const
+{
+    return m_clusterLinkHost;
+}
+
+void ProxyConfiguration::setClusterLinkHost(const QHostAddress &address)
+{
+    m_clusterLinkHost = address;
+}
+
+quint16 ProxyConfiguration::clusterLinkPort() const
+{
+    return m_clusterLinkPort;
+}
+
+void ProxyConfiguration::setClusterLinkPort(quint16 port)
+{
+    m_clusterLinkPort = port;
+}
+
+QStringList ProxyConfiguration::clusterMembers() const
+{
+    return m_clusterMembers;
+}
+
+void ProxyConfiguration::setClusterMembers(const QStringList &members)
+{
+    m_clusterMembers.clear();
+    foreach (const QString &member, members) {
+        if (!member.trimmed().isEmpty())
+            m_clusterMembers.append(member.trimmed());
+    }
+}
+
+QString ProxyConfiguration::clusterNodeUrl() const
+{
+    return m_clusterNodeUrl;
+}
+
+void ProxyConfiguration::setClusterNodeUrl(const QString &nodeUrl)
+{
+    m_clusterNodeUrl = nodeUrl;
+}
+
+QString ProxyConfiguration::clusterSecretFileName() const
+{
+    return m_clusterSecretFileName;
+}
+
+void ProxyConfiguration::setClusterSecretFileName(const QString &fileName)
+{
+    m_clusterSecretFileName = fileName;
+}
+
+QByteArray ProxyConfiguration::clusterSecret() const
+{
+    return m_clusterSecret;
+}
+
+void ProxyConfiguration::setClusterSecret(const QByteArray &secret)
+{
+    m_clusterSecret = secret;
+}
+
 QDebug operator<<(QDebug debug, ProxyConfiguration *configuration)
 {
     debug.nospace() << endl << "========== ProxyConfiguration ==========" << endl;
@@ -344,14 +1094,38 @@ QDebug operator<<(QDebug debug, ProxyConfiguration *configuration)
     debug.nospace() << "  - Authentication timeout:" << configuration->authenticationTimeout() << " [ms]" << endl;
     debug.nospace() << "  - Inactive timeout:" << configuration->inactiveTimeout() << " [ms]" << endl;
     debug.nospace() << "  - Alone timeout:" << configuration->aloneTimeout() << " [ms]" << endl;
+    debug.nospace() << "  - Early data size:" << configuration->earlyDataSize() << " [B]" << endl;
+    debug.nospace() << "  - Early data messages:" << configuration->earlyDataMessages() << endl;
+    debug.nospace() << "  - Standby pool size:" << configuration->standbyPoolSize() << endl;
+    debug.nospace() << "  - Standby timeout:" << configuration->standbyTimeout() << " [ms]" << endl;
+    debug.nospace() << "  - Resumption timeout:" << configuration->resumptionTimeout() << " [ms]" << endl;
+    debug.nospace() << "  - Resumption buffer size:" << configuration->resumptionBufferSize() << " [B]" << endl;
+    debug.nospace() << "  - Handover socket:" << configuration->handoverSocketFileName() << endl;
+    debug.nospace() << "  - Drain timeout:" << configuration->drainTimeout() << " [ms]" << endl;
+    debug.nospace() << "  - Drain batch size:" << configuration->drainBatchSize() << endl;
+    debug.nospace() << "  - Drain retry after:" << configuration->drainRetryAfter() << " [ms]" << endl;
+    debug.nospace() << "Authentication configuration" << endl;
+    debug.nospace() << "  - Maximum concurrent authentications:" << configuration->maximumConcurrentAuthentications() << endl;
+    debug.nospace() << "  - Queue size:" << configuration->authenticationQueueSize() << endl;
+    debug.nospace() << "  - Negative cache timeout:" << configuration->negativeCacheTimeout() << " [ms]" << endl;
+    debug.nospace() << "  - Negative cache maximum timeout:" << configuration->negativeCacheMaximumTimeout() << " [ms]" << endl;
+    debug.nospace() << "  - Negative cache size:" << configuration->negativeCacheSize() << endl;
+    debug.nospace() << "  - Session ticket lifetime:" << configuration->sessionTicketLifetime() << " [ms]" << endl;
+    debug.nospace() << "  - Session ticket key file:" << configuration->sessionTicketKeyFileName() << endl;
     debug.nospace() << "AWS configuration" << endl;
     debug.nospace() << "  - Region:" << configuration->awsRegion() << endl;
     debug.nospace() << "  - Authorizer lambda function:" << configuration->awsAuthorizerLambdaFunctionName() << endl;
     debug.nospace() << "  - Credentials URL:" << configuration->awsCredentialsUrl().toString() << endl;
+    debug.nospace() << "  - Authorizer endpoint:" << configuration->awsAuthorizerEndpoint().toString() << endl;
+    debug.nospace() << "  - Batch interval:" << configuration->awsBatchInterval() << " [ms]" << endl;
+    debug.nospace() << "  - Batch size:" << configuration->awsBatchSize() << endl;
     debug.nospace() << "SSL configuration" << endl;
     debug.nospace() << "  - Certificate:" << configuration->sslCertificateFileName() << endl;
     debug.nospace() << "  - Certificate key:" << configuration->sslCertificateKeyFileName() << endl;
     debug.nospace() << "  - Certificate chain:" << configuration->sslCertificateChainFileName() << endl;
+    debug.nospace() << "  - Handshake threads:" << configuration->handshakeThreads() << endl;
+    debug.nospace() << "  - Handshake timeout:" << configuration->handshakeTimeout() << " [ms]" << endl;
+    debug.nospace() << "  - Profile:" << configuration->sslProfile() << endl;
     debug.nospace() << "  - SSL certificate information:" << endl;
     debug.nospace() << "      Common name:" << configuration->sslConfiguration().localCertificate().subjectInfo(QSslCertificate::CommonName) << endl;
     debug.nospace() << "      Organisation:" << configuration->sslConfiguration().localCertificate().subjectInfo(QSslCertificate::Organization) << endl;
@@ -374,6 +1148,31 @@ QDebug operator<<(QDebug debug, ProxyConfiguration *configuration)
     debug.nospace() << "TcpServer" << endl;
     debug.nospace() << "  - Host:" << configuration->tcpServerHost().toString() << endl;
     debug.nospace() << "  - Port:" << configuration->tcpServerPort() << endl;
+    debug.nospace() << "PlainWebSocketServer configuration" << endl;
+    debug.nospace() << "  - Enabled:" << configuration->plainWebSocketServerEnabled() << endl;
+    debug.nospace() << "  - Host:" << configuration->plainWebSocketServerHost().toString() << endl;
+    debug.nospace() << "  - Port:" << configuration->plainWebSocketServerPort() << endl;
+    debug.nospace() << "  - Trusted proxies:" << configuration->trustedProxies().join(", ") << endl;
+    debug.nospace() << "  - Header timeout:" << configuration->proxyHeaderTimeout() << " [ms]" << endl;
+    debug.nospace() << "RateLimit configuration" << endl;
+    debug.nospace() << "  - Connection rate:" << configuration->connectionRate() << endl;
+    debug.nospace() << "  - Connection burst:" << configuration->connectionBurst() << endl;
+    debug.nospace() << "  - Subnet connection rate:" << configuration->subnetConnectionRate() << endl;
+    debug.nospace() << "  - Subnet connection burst:" << configuration->subnetConnectionBurst() << endl;
+    debug.nospace() << "  - IPv4 subnet prefix:" << configuration->ipv4SubnetPrefix() << endl;
+    debug.nospace() << "  - IPv6 subnet prefix:" << configuration->ipv6SubnetPrefix() << endl;
+    debug.nospace() << "  - Call rate:" << configuration->callRate() << endl;
+    debug.nospace() << "  - Call burst:" << configuration->callBurst() << endl;
+    debug.nospace() << "  - Maximum buckets:" << configuration->rateLimitMaximumBuckets() << endl;
+    debug.nospace() << "Cluster configuration" << endl;
+    debug.nospace() << "  - Enabled:" << configuration->clusterEnabled() << endl;
+    debug.nospace() << "  - Node id:" << configuration->clusterNodeId() << endl;
+    debug.nospace() << "  - Coordinator:" << configuration->clusterCoordinatorUrl().toString() << endl;
+    debug.nospace() << "  - Link host:" << configuration->clusterLinkHost().toString() << endl;
+    debug.nospace() << "  - Link port:" << configuration->clusterLinkPort() << endl;
+    debug.nospace() << "  - Members:" << configuration->clusterMembers() << endl;
+    debug.nospace() << "  - Node url:" << configuration->clusterNodeUrl() << endl;
+    debug.nospace() << "  - Secret file:" << configuration->clusterSecretFileName() << endl;
     debug.nospace() << "========== ProxyConfiguration ==========";
     return debug;
 }
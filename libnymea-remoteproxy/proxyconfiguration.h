@@ -45,6 +45,10 @@ public:
     bool loadConfiguration(const QString &fileName);
 
     QString fileName() const;
+    QString errorString() const;
+
+    // Take over all settings which can change at runtime, returns the changed settings requiring a restart
+    QStringList applyConfiguration(const ProxyConfiguration *configuration);
 
     // ProxyServer
     QString serverName() const;
@@ -74,6 +78,58 @@ public:
     int aloneTimeout() const;
     void setAloneTimeout(int timeout);
 
+    int earlyDataSize() const;
+    void setEarlyDataSize(int size);
+
+    int earlyDataMessages() const;
+    void setEarlyDataMessages(int messages);
+
+    int standbyPoolSize() const;
+    void setStandbyPoolSize(int size);
+
+    int standbyTimeout() const;
+    void setStandbyTimeout(int timeout);
+
+    int resumptionTimeout() const;
+    void setResumptionTimeout(int timeout);
+
+    int resumptionBufferSize() const;
+    void setResumptionBufferSize(int size);
+
+    QString handoverSocketFileName() const;
+    void setHandoverSocketFileName(const QString &fileName);
+
+    int drainTimeout() const;
+    void setDrainTimeout(int timeout);
+
+    int drainBatchSize() const;
+    void setDrainBatchSize(int size);
+
+    int drainRetryAfter() const;
+    void setDrainRetryAfter(int retryAfter);
+
+    // Authentication
+    int maximumConcurrentAuthentications() const;
+    void setMaximumConcurrentAuthentications(int maximumConcurrentAuthentications);
+
+    int authenticationQueueSize() const;
+    void setAuthenticationQueueSize(int queueSize);
+
+    int negativeCacheTimeout() const;
+    void setNegativeCacheTimeout(int timeout);
+
+    int negativeCacheMaximumTimeout() const;
+    void setNegativeCacheMaximumTimeout(int timeout);
+
+    int negativeCacheSize() const;
+    void setNegativeCacheSize(int size);
+
+    int sessionTicketLifetime() const;
+    void setSessionTicketLifetime(int lifetime);
+
+    QString sessionTicketKeyFileName() const;
+    void setSessionTicketKeyFileName(const QString &fileName);
+
     // AWS
     QString awsRegion() const;
     void setAwsRegion(const QString &region);
@@ -84,6 +140,15 @@ public:
     QUrl awsCredentialsUrl() const;
     void setAwsCredentialsUrl(const QUrl &url);
 
+    QUrl awsAuthorizerEndpoint() const;
+    void setAwsAuthorizerEndpoint(const QUrl &url);
+
+    int awsBatchInterval() const;
+    void setAwsBatchInterval(int interval);
+
+    int awsBatchSize() const;
+    void setAwsBatchSize(int size);
+
     // Ssl
     QString sslCertificateFileName() const;
     void setSslCertificateFileName(const QString &fileName);
@@ -94,6 +159,15 @@ public:
     QString sslCertificateChainFileName() const;
     void setSslCertificateChainFileName(const QString &fileName);
 
+    int handshakeThreads() const;
+    void setHandshakeThreads(int threads);
+
+    int handshakeTimeout() const;
+    void setHandshakeTimeout(int timeout);
+
+    QString sslProfile() const;
+    void setSslProfile(const QString &profile);
+
     QSslConfiguration sslConfiguration() const;
 
     // WebSocketServer
@@ -110,9 +184,84 @@ public:
     quint16 tcpServerPort() const;
     void setTcpServerPort(quint16 port);
 
+    // PlainWebSocketServer
+    bool plainWebSocketServerEnabled() const;
+    void setPlainWebSocketServerEnabled(bool enabled);
+
+    QHostAddress plainWebSocketServerHost() const;
+    void setPlainWebSocketServerHost(const QHostAddress &address);
+
+    quint16 plainWebSocketServerPort() const;
+    void setPlainWebSocketServerPort(quint16 port);
+
+    QStringList trustedProxies() const;
+    void setTrustedProxies(const QStringList &trustedProxies);
+
+    int proxyHeaderTimeout() const;
+    void setProxyHeaderTimeout(int timeout);
+    QList<QPair<QHostAddress, int>> trustedProxySubnets() const;
+
+    // RateLimit
+    double connectionRate() const;
+    void setConnectionRate(double rate);
+
+    int connectionBurst() const;
+    void setConnectionBurst(int burst);
+
+    double subnetConnectionRate() const;
+    void setSubnetConnectionRate(double rate);
+
+    int subnetConnectionBurst() const;
+    void setSubnetConnectionBurst(int burst);
+
+    int ipv4SubnetPrefix() const;
+    void setIpv4SubnetPrefix(int prefixLength);
+
+    int ipv6SubnetPrefix() const;
+    void setIpv6SubnetPrefix(int prefixLength);
+
+    double callRate() const;
+    void setCallRate(double rate);
+
+    int callBurst() const;
+    void setCallBurst(int burst);
+
+    int rateLimitMaximumBuckets() const;
+    void setRateLimitMaximumBuckets(int maximumBuckets);
+
+    // Cluster
+    bool clusterEnabled() const;
+    void setClusterEnabled(bool enabled);
+
+    QString clusterNodeId() const;
+    void setClusterNodeId(const QString &nodeId);
+
+    QUrl clusterCoordinatorUrl() const;
+    void setClusterCoordinatorUrl(const QUrl &url);
+
+    QHostAddress clusterLinkHost() const;
+    void setClusterLinkHost(const QHostAddress &address);
+
+    quint16 clusterLinkPort() const;
+    void setClusterLinkPort(quint16 port);
+
+    QStringList clusterMembers() const;
+    void setClusterMembers(const QStringList &members);
+
+    QString clusterNodeUrl() const;
+    void setClusterNodeUrl(const QString &nodeUrl);
+
+    // The secret shared by all nodes and the coordinator, read from the secret file
+    QString clusterSecretFileName() const;
+    void setClusterSecretFileName(const QString &fileName);
+
+    QByteArray clusterSecret() const;
+    void setClusterSecret(const QByteArray &secret);
+
 private:
     // ProxyServer
     QString m_fileName;
+    QString m_errorString;
     QString m_serverName;
     bool m_writeLogFile = false;
     QString m_logFileName = "/var/log/nymea-remoteproxy.log";
@@ -123,16 +272,41 @@ private:
     int m_authenticationTimeout = 8000;
     int m_inactiveTimeout = 8000;
     int m_aloneTimeout = 8000;
+    int m_earlyDataSize = 0;
+    int m_earlyDataMessages = 16;
+    int m_standbyPoolSize = 0;
+    int m_standbyTimeout = 300000;
+    int m_resumptionTimeout = 0;
+    int m_resumptionBufferSize = 65536;
+    QString m_handoverSocketFileName;
+    int m_drainTimeout = 600000;
+    int m_drainBatchSize = 10;
+    int m_drainRetryAfter = 10000;
+
+    // Authentication
+    int m_maximumConcurrentAuthentications = 50;
+    int m_authenticationQueueSize = 500;
+    int m_negativeCacheTimeout = 30000;
+    int m_negativeCacheMaximumTimeout = 600000;
+    int m_negativeCacheSize = 10000;
+    int m_sessionTicketLifetime = 0;
+    QString m_sessionTicketKeyFileName;
 
     // AWS
     QString m_awsRegion;
     QString m_awsAuthorizerLambdaFunctionName;
     QUrl m_awsCredentialsUrl;
+    QUrl m_awsAuthorizerEndpoint;
+    int m_awsBatchInterval = 0;
+    int m_awsBatchSize = 20;
 
     // Ssl
     QString m_sslCertificateFileName = "/etc/ssl/certs/ssl-cert-snakeoil.pem";
     QString m_sslCertificateKeyFileName = "/etc/ssl/private/ssl-cert-snakeoil.key";
     QString m_sslCertificateChainFileName;
+    int m_handshakeThreads = 0;
+    int m_handshakeTimeout = 5000;
+    QString m_sslProfile = "default";
     QSslConfiguration m_sslConfiguration;
 
     // WebSocketServer
@@ -143,6 +317,35 @@ private:
     QHostAddress m_tcpServerHost = QHostAddress::LocalHost;
     quint16 m_tcpServerPort = 1213;
 
+    // PlainWebSocketServer
+    bool m_plainWebSocketServerEnabled = false;
+    QHostAddress m_plainWebSocketServerHost = QHostAddress::LocalHost;
+    quint16 m_plainWebSocketServerPort = 8080;
+    QStringList m_trustedProxies;
+    int m_proxyHeaderTimeout = 5000;
+
+    // RateLimit
+    double m_connectionRate = 0;
+    int m_connectionBurst = 20;
+    double m_subnetConnectionRate = 0;
+    int m_subnetConnectionBurst = 200;
+    int m_ipv4SubnetPrefix = 24;
+    int m_ipv6SubnetPrefix = 64;
+    double m_callRate = 0;
+    int m_callBurst = 20;
+    int m_rateLimitMaximumBuckets = 100000;
+
+    // Cluster
+    bool m_clusterEnabled = false;
+    QString m_clusterNodeId;
+    QUrl m_clusterCoordinatorUrl;
+    QHostAddress m_clusterLinkHost = QHostAddress::LocalHost;
+    quint16 m_clusterLinkPort = 1214;
+    QStringList m_clusterMembers;
+    QString m_clusterNodeUrl;
+    QString m_clusterSecretFileName;
+    QByteArray m_clusterSecret;
+
 };
 
 QDebug operator<< (QDebug debug, ProxyConfiguration *configuration);
@@ -0,0 +1,289 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "proxyprotocolserver.h"
+#include "loggingcategories.h"
+
+#include <QtEndian>
+
+namespace remoteproxy {
+
+ProxyProtocolServer::ProxyProtocolServer(QObject *parent) :
+    QTcpServer(parent)
+{
+    qRegisterMetaType<QTcpSocket *>("QTcpSocket *");
+
+    m_timeoutTimer = new QTimer(this);
+    m_timeoutTimer->setInterval(250);
+    connect(m_timeoutTimer, &QTimer::timeout, this, &ProxyProtocolServer::onTimeoutTimerTimeout);
+}
+
+ProxyProtocolServer::~ProxyProtocolServer()
+{
+    foreach (QTcpSocket *socket, m_pendingSockets.keys()) {
+        socket->abort();
+    }
+}
+
+QList<QPair<QHostAddress, int>> ProxyProtocolServer::trustedProxies() const
+{
+    return m_trustedProxies;
+}
+
+void ProxyProtocolServer::setTrustedProxies(const QList<QPair<QHostAddress, int>> &trustedProxies)
+{
+    m_trustedProxies = trustedProxies;
+}
+
+int ProxyProtocolServer::headerTimeout() const
+{
+    return m_headerTimeout;
+}
+
+void ProxyProtocolServer::setHeaderTimeout(int headerTimeout)
+{
+    m_headerTimeout = headerTimeout;
+}
+
+void ProxyProtocolServer::setRateLimiter(RateLimiter *rateLimiter)
+{
+    m_rateLimiter = rateLimiter;
+}
+
+QVariantMap ProxyProtocolServer::currentStatistics() const
+{
+    QVariantMap statistics;
+    statistics.insert("acceptedCount", m_acceptedCount);
+    statistics.insert("untrustedCount", m_untrustedCount);
+    statistics.insert("invalidHeaderCount", m_invalidHeaderCount);
+    statistics.insert("headerTimeoutCount", m_headerTimeoutCount);
+    statistics.insert("pendingConnections", m_pendingSockets.count());
+    return statistics;
+}
+
+ProxyProtocolServer::HeaderResult ProxyProtocolServer::parseHeader(const QByteArray &data, int *headerLength, QHostAddress *clientAddress, quint16 *clientPort)
+{
+    // A null client address means the header does not carry one, e.g. health checks of the load balancer
+    *headerLength = 0;
+    *clientAddress = QHostAddress();
+    *clientPort = 0;
+
+    if (data.isEmpty())
+        return HeaderResultIncomplete;
+
+    // Version 2: binary header with a 12 byte signature
+    QByteArray signature("\r\n\r\n\0\r\nQUIT\n", 12);
+    int prefixLength = qMin(data.size(), signature.size());
+    if (data.left(prefixLength) == signature.left(prefixLength)) {
+        if (data.size() < 16)
+            return HeaderResultIncomplete;
+
+        quint8 versionCommand = static_cast<quint8>(data.at(12));
+        quint8 family = static_cast<quint8>(data.at(13));
+        int length = qFromBigEndian<quint16>(reinterpret_cast<const uchar *>(data.constData() + 14));
+        if ((versionCommand & 0xF0) != 0x20)
+            return HeaderResultInvalid;
+
+        if (data.size() < 16 + length)
+            return HeaderResultIncomplete;
+
+        *headerLength = 16 + length;
+        quint8 command = versionCommand & 0x0F;
+        if (command == 0x00)
+            return HeaderResultValid;
+
+        if (command != 0x01)
+            return HeaderResultInvalid;
+
+        const uchar *addresses = reinterpret_cast<const uchar *>(data.constData() + 16);
+        if (family == 0x11 && length >= 12) {
+            // TCP over IPv4: source, destination, source port, destination port
+            *clientAddress = QHostAddress(qFromBigEndian<quint32>(addresses));
+            *clientPort = qFromBigEndian<quint16>(addresses + 8);
+        } else if (family == 0x21 && length >= 36) {
+            // TCP over IPv6
+            *clientAddress = QHostAddress(addresses);
+            *clientPort = qFromBigEndian<quint16>(addresses + 32);
+        }
+
+        return HeaderResultValid;
+    }
+
+    // Version 1: one text line of at most 107 bytes, e.g. "PROXY TCP4 192.0.2.1 192.0.2.2 56324 443\r\n"
+    QByteArray prefix("PROXY ");
+    prefixLength = qMin(data.size(), prefix.size());
+    if (data.left(prefixLength) != prefix.left(prefixLength))
+        return HeaderResultInvalid;
+
+    int lineEnd = data.indexOf("\r\n");
+    if (lineEnd < 0)
+        return data.size() < 107 ? HeaderResultIncomplete : HeaderResultInvalid;
+
+    if (lineEnd + 2 > 107)
+        return HeaderResultInvalid;
+
+    *headerLength = lineEnd + 2;
+    QList<QByteArray> fields = data.left(lineEnd).split(' ');
+    if (fields.count() >= 2 && fields.at(1) == "UNKNOWN")
+        return HeaderResultValid;
+
+    if (fields.count() != 6)
+        return HeaderResultInvalid;
+
+    QHostAddress address(QString::fromLatin1(fields.at(2)));
+    bool portValid = false;
+    uint port = fields.at(4).toUInt(&portValid);
+    if (!portValid || port > 65535)
+        return HeaderResultInvalid;
+
+    if (!(fields.at(1) == "TCP4" && address.protocol() == QAbstractSocket::IPv4Protocol)
+            && !(fields.at(1) == "TCP6" && address.protocol() == QAbstractSocket::IPv6Protocol))
+        return HeaderResultInvalid;
+
+    *clientAddress = address;
+    *clientPort = static_cast<quint16>(port);
+    return HeaderResultValid;
+}
+
+void ProxyProtocolServer::incomingConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        qCWarning(dcWebSocketServer()) << "Could not accept the incoming connection:" << socket->errorString();
+        delete socket;
+        return;
+    }
+
+    // Everybody else could pretend any client address
+    if (!isTrusted(socket->peerAddress())) {
+        qCWarning(dcWebSocketServer()) << "Rejecting connection from untrusted proxy" << socket->peerAddress().toString();
+        m_untrustedCount++;
+        socket->abort();
+        socket->deleteLater();
+        return;
+    }
+
+    QElapsedTimer headerTimer;
+    headerTimer.start();
+    m_pendingSockets.insert(socket, headerTimer);
+    connect(socket, &QTcpSocket::readyRead, this, &ProxyProtocolServer::onSocketReadyRead);
+    connect(socket, &QTcpSocket::disconnected, this, &ProxyProtocolServer::onSocketDisconnected);
+    if (!m_timeoutTimer->isActive())
+        m_timeoutTimer->start();
+}
+
+bool ProxyProtocolServer::isTrusted(const QHostAddress &address) const
+{
+    // Compare IPv4 mapped IPv6 addresses as IPv4
+    QHostAddress peerAddress = address;
+    bool isIPv4 = false;
+    quint32 ipv4Address = address.toIPv4Address(&isIPv4);
+    if (isIPv4)
+        peerAddress = QHostAddress(ipv4Address);
+
+    for (int i = 0; i < m_trustedProxies.count(); i++) {
+        if (peerAddress.isInSubnet(m_trustedProxies.at(i)))
+            return true;
+    }
+
+    return false;
+}
+
+void ProxyProtocolServer::rejectSocket(QTcpSocket *socket)
+{
+    m_pendingSockets.remove(socket);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
+
+void ProxyProtocolServer::onSocketReadyRead()
+{
+    QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+    if (!m_pendingSockets.contains(socket))
+        return;
+
+    int headerLength = 0;
+    QHostAddress clientAddress;
+    quint16 clientPort = 0;
+    switch (parseHeader(socket->peek(socket->bytesAvailable()), &headerLength, &clientAddress, &clientPort)) {
+    case HeaderResultIncomplete:
+        return;
+    case HeaderResultInvalid:
+        qCWarning(dcWebSocketServer()) << "Invalid PROXY protocol header from" << socket->peerAddress().toString();
+        m_invalidHeaderCount++;
+        rejectSocket(socket);
+        return;
+    case HeaderResultValid:
+        break;
+    }
+
+    socket->read(headerLength);
+    if (clientAddress.isNull())
+        clientAddress = socket->peerAddress();
+
+    // The load balancer itself is trusted, the limits apply to the client behind it
+    if (m_rateLimiter && !m_rateLimiter->allowConnection(clientAddress)) {
+        qCDebug(dcWebSocketServer()) << "Rate limit exceeded, closing the connection from" << clientAddress.toString() << "via proxy" << socket->peerAddress().toString();
+        rejectSocket(socket);
+        return;
+    }
+
+    qCDebug(dcWebSocketServer()) << "Connection from" << clientAddress.toString() << clientPort << "via proxy" << socket->peerAddress().toString();
+    m_acceptedCount++;
+    m_pendingSockets.remove(socket);
+    socket->disconnect(this);
+    emit proxiedConnection(socket, clientAddress);
+}
+
+void ProxyProtocolServer::onSocketDisconnected()
+{
+    QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+    if (!m_pendingSockets.contains(socket))
+        return;
+
+    m_pendingSockets.remove(socket);
+    socket->deleteLater();
+}
+
+void ProxyProtocolServer::onTimeoutTimerTimeout()
+{
+    // Connections which never send a complete header would stay pending forever
+    foreach (QTcpSocket *socket, m_pendingSockets.keys()) {
+        if (!m_pendingSockets.value(socket).hasExpired(m_headerTimeout))
+            continue;
+
+        qCDebug(dcWebSocketServer()) << "No PROXY protocol header from" << socket->peerAddress().toString() << "in time.";
+        m_headerTimeoutCount++;
+        rejectSocket(socket);
+    }
+
+    if (m_pendingSockets.isEmpty())
+        m_timeoutTimer->stop();
+}
+
+}
@@ -0,0 +1,106 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PROXYPROTOCOLSERVER_H
+#define PROXYPROTOCOLSERVER_H
+
+#include <QHash>
+#include <QPair>
+#include <QList>
+#include <QTimer>
+#include <QObject>
+#include <QTcpSocket>
+#include <QTcpServer>
+#include <QVariantMap>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+#include "ratelimiter.h"
+
+namespace remoteproxy {
+
+// Accepts plain connections from trusted load balancers, which announce the real client address
+// with a PROXY protocol (version 1 or 2) header
+class ProxyProtocolServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit ProxyProtocolServer(QObject *parent = nullptr);
+    ~ProxyProtocolServer() override;
+
+    QList<QPair<QHostAddress, int>> trustedProxies() const;
+    void setTrustedProxies(const QList<QPair<QHostAddress, int>> &trustedProxies);
+
+    // Milliseconds a proxy may take to send the header before the connection gets closed
+    int headerTimeout() const;
+    void setHeaderTimeout(int headerTimeout);
+
+    // Connections exceeding the rate limit of their client address get closed
+    void setRateLimiter(RateLimiter *rateLimiter);
+
+    QVariantMap currentStatistics() const;
+
+    enum HeaderResult {
+        HeaderResultIncomplete,
+        HeaderResultInvalid,
+        HeaderResultValid
+    };
+
+    static HeaderResult parseHeader(const QByteArray &data, int *headerLength, QHostAddress *clientAddress, quint16 *clientPort);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    QList<QPair<QHostAddress, int>> m_trustedProxies;
+    RateLimiter *m_rateLimiter = nullptr;
+    QHash<QTcpSocket *, QElapsedTimer> m_pendingSockets;
+    QTimer *m_timeoutTimer = nullptr;
+    int m_headerTimeout = 5000;
+
+    // Statistics
+    int m_acceptedCount = 0;
+    int m_untrustedCount = 0;
+    int m_invalidHeaderCount = 0;
+    int m_headerTimeoutCount = 0;
+
+    bool isTrusted(const QHostAddress &address) const;
+    void rejectSocket(QTcpSocket *socket);
+
+signals:
+    void proxiedConnection(QTcpSocket *socket, const QHostAddress &clientAddress);
+
+private slots:
+    void onSocketReadyRead();
+    void onSocketDisconnected();
+    void onTimeoutTimerTimeout();
+
+};
+
+}
+
+#endif // PROXYPROTOCOLSERVER_H
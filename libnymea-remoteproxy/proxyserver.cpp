@@ -27,9 +27,11 @@
 
 #include "engine.h"
 #include "proxyserver.h"
+#include "securerandom.h"
 #include "loggingcategories.h"
 
 #include <QSettings>
+#include <QDateTime>
 #include <QMetaObject>
 #include <QVariantList>
 #include <QJsonDocument>
@@ -54,6 +56,11 @@ bool ProxyServer::running() const
     return m_running;
 }
 
+bool ProxyServer::draining() const
+{
+    return m_draining;
+}
+
 void ProxyServer::registerTransportInterface(TransportInterface *interface)
 {
     qCDebug(dcProxyServer()) << "Register transport interface" << interface->serverName();
@@ -70,12 +77,54 @@ void ProxyServer::registerTransportInterface(TransportInterface *interface)
     m_transportInterfaces.append(interface);
 }
 
+void ProxyServer::setCluster(ClusterClient *clusterClient, ClusterLink *clusterLink)
+{
+    qCDebug(dcProxyServer()) << "Join cluster as node" << clusterClient->nodeId();
+
+    m_clusterClient = clusterClient;
+    m_clusterLink = clusterLink;
+
+    connect(m_clusterClient, &ClusterClient::tunnelMatched, this, &ProxyServer::onClusterTunnelMatched);
+    connect(m_clusterLink, &ClusterLink::remoteClientAttached, this, &ProxyServer::onClusterClientAttached);
+    connect(m_clusterLink, &ClusterLink::forwardDataAvailable, this, &ProxyServer::onClusterForwardDataAvailable);
+    connect(m_clusterLink, &ClusterLink::forwardClosed, this, &ProxyServer::onClusterForwardClosed);
+
+    registerTransportInterface(m_clusterLink);
+}
+
 QVariantMap ProxyServer::currentStatistics()
 {
     QVariantMap statisticsMap;
     statisticsMap.insert("clientCount", m_proxyClients.count());
     statisticsMap.insert("tunnelCount", m_tunnels.count());
+    statisticsMap.insert("multiplexedCount", m_multiplexedClients.count());
     statisticsMap.insert("troughput", m_troughput);
+    statisticsMap.insert("earlyDataOverflowCount", m_earlyDataOverflowCount);
+
+    int standbyCount = 0;
+    foreach (const QList<ProxyClient *> &standbyClients, m_standbyClients.values()) {
+        standbyCount += standbyClients.count();
+    }
+
+    statisticsMap.insert("standbyCount", standbyCount);
+    statisticsMap.insert("standbyHits", m_standbyHits);
+    statisticsMap.insert("standbyMisses", m_standbyMisses);
+    statisticsMap.insert("suspendedCount", m_resumptionTickets.count() + m_pendingResumptions.count());
+    statisticsMap.insert("resumedCount", m_resumedCount);
+    statisticsMap.insert("clusterRegistrations", m_clusterRegistrations.count());
+    statisticsMap.insert("clusterMatches", m_clusterMatchCount);
+    statisticsMap.insert("forwardedCount", m_forwardedClients.count());
+    statisticsMap.insert("redirectCount", m_redirectCount);
+    statisticsMap.insert("remoteCount", m_clusterLink ? m_clusterLink->remoteClientCount() : 0);
+    statisticsMap.insert("standbyHitRate", m_standbyHits + m_standbyMisses > 0 ? 100.0 * m_standbyHits / (m_standbyHits + m_standbyMisses) : 0.0);
+
+    QVariantMap drainStatisticsMap;
+    drainStatisticsMap.insert("active", m_draining);
+    drainStatisticsMap.insert("duration", m_draining ? QDateTime::currentMSecsSinceEpoch() - m_drainStartTime : 0);
+    drainStatisticsMap.insert("remainingTunnels", m_tunnels.count() + m_multiplexedClients.count());
+    drainStatisticsMap.insert("rejectedCount", m_drainRejectedCount);
+    drainStatisticsMap.insert("closedCount", m_drainClosedCount);
+    statisticsMap.insert("drain", drainStatisticsMap);
 
     QVariantMap totalStatisticsMap;
     totalStatisticsMap.insert("totalClientCount", m_totalClientCount);
@@ -92,6 +141,9 @@ QVariantMap ProxyServer::currentStatistics()
         clientMap.insert("timestamp", client->creationTime());
         clientMap.insert("authenticated", client->isAuthenticated());
         clientMap.insert("tunnelConnected", client->isTunnelConnected());
+        clientMap.insert("multiplexed", client->isMultiplexed());
+        clientMap.insert("channelId", client->channelId());
+        clientMap.insert("standby", client->isStandby());
         clientMap.insert("name", client->name());
         clientMap.insert("userName", client->userName());
         clientMap.insert("uuid", client->uuid());
@@ -140,9 +192,10 @@ void ProxyServer::saveStatistics()
     QSettings settings;
     settings.beginGroup("Statistics");
     settings.setValue("totalClientCount", m_totalClientCount);
-    settings.value("totalTunnelCount", m_totalTunnelCount);
-    settings.value("totalTraffic", m_totalTraffic);
+    settings.setValue("totalTunnelCount", m_totalTunnelCount);
+    settings.setValue("totalTraffic", m_totalTraffic);
     settings.endGroup();
+    m_statisticsChanged = false;
 }
 
 ProxyClient *ProxyServer::getRemoteClient(ProxyClient *proxyClient)
@@ -180,6 +233,14 @@ void ProxyServer::establishTunnel(ProxyClient *firstClient, ProxyClient *secondC
     notificationParamsSecond.insert("name", tunnel.clientOne()->name());
     notificationParamsSecond.insert("uuid", tunnel.clientOne()->uuid());
 
+    // Hand out tickets for resuming this tunnel after a transient disconnect
+    if (Engine::instance()->configuration()->resumptionTimeout() > 0) {
+        firstClient->setResumptionTicket(createResumptionTicket());
+        secondClient->setResumptionTicket(createResumptionTicket());
+        notificationParamsFirst.insert("resumptionTicket", tunnel.clientOne()->resumptionTicket());
+        notificationParamsSecond.insert("resumptionTicket", tunnel.clientTwo()->resumptionTicket());
+    }
+
     // Make sure the proxy is the first one who knows that the tunnel is connected
     firstClient->setTunnelConnected(true);
     secondClient->setTunnelConnected(true);
@@ -187,7 +248,7 @@ void ProxyServer::establishTunnel(ProxyClient *firstClient, ProxyClient *secondC
     qCDebug(dcProxyServer()) << tunnel;
 
     m_totalTunnelCount += 1;
-    saveStatistics();
+    m_statisticsChanged = true;
 
     // Notify the clients in the next event loop
     QMetaObject::invokeMethod(m_jsonRpcServer, QString("sendNotification").toLatin1().data(), Qt::QueuedConnection,
@@ -201,6 +262,286 @@ void ProxyServer::establishTunnel(ProxyClient *firstClient, ProxyClient *secondC
                               Q_ARG(QString, "TunnelEstablished"),
                               Q_ARG(QVariantMap, notificationParamsSecond),
                               Q_ARG(ProxyClient *, tunnel.clientTwo()));
+
+    // Forward the data sent before the tunnel existed right after the notifications
+    QMetaObject::invokeMethod(this, "flushEarlyData", Qt::QueuedConnection, Q_ARG(QString, tunnel.tunnelIdentifier()));
+}
+
+void ProxyServer::pipeData(ProxyClient *proxyClient, ProxyClient *remoteClient, const QByteArray &data)
+{
+    // Calculate server statisitcs
+    m_troughputCounter += data.count();
+    proxyClient->addRxDataCount(data.count());
+    remoteClient->addTxDataCount(data.count());
+
+    // Writing the settings file for every message would dominate the relay path, the tick persists them
+    m_totalTraffic += data.count();
+    m_statisticsChanged = true;
+
+    qCDebug(dcProxyServerTraffic()) << "Pipe tunnel data:";
+    qCDebug(dcProxyServerTraffic()) << "    --> from" << proxyClient;
+    qCDebug(dcProxyServerTraffic()) << "    --> to" << remoteClient;
+    qCDebug(dcProxyServerTraffic()) << "    --> data:" << qUtf8Printable(data);
+
+    remoteClient->sendData(data);
+}
+
+void ProxyServer::attachChannel(ProxyClient *multiplexClient, ProxyClient *channelClient)
+{
+    quint32 channelId = multiplexClient->addChannel(channelClient);
+    qCDebug(dcProxyServer()) << "Attach" << channelClient << "as channel" << channelId << "to" << multiplexClient;
+
+    channelClient->setChannel(multiplexClient, channelId);
+    channelClient->setTunnelConnected(true);
+
+    m_totalTunnelCount += 1;
+    m_statisticsChanged = true;
+
+    QVariantMap message;
+    message.insert("event", "ChannelOpened");
+    message.insert("channel", channelId);
+    message.insert("name", channelClient->name());
+    message.insert("uuid", channelClient->uuid());
+    sendControlMessage(multiplexClient, message);
+
+    QVariantMap notificationParams;
+    notificationParams.insert("name", multiplexClient->name());
+    notificationParams.insert("uuid", multiplexClient->uuid());
+    QMetaObject::invokeMethod(m_jsonRpcServer, QString("sendNotification").toLatin1().data(), Qt::QueuedConnection,
+                              Q_ARG(QString, m_jsonRpcServer->name()),
+                              Q_ARG(QString, "TunnelEstablished"),
+                              Q_ARG(QVariantMap, notificationParams),
+                              Q_ARG(ProxyClient *, channelClient));
+
+    // The multiplexed connection knows the channel already, the early data can be forwarded right away
+    foreach (const QByteArray &data, channelClient->takeEarlyData()) {
+        pipeData(channelClient, multiplexClient, QByteArray::number(channelId) + ':' + data);
+    }
+}
+
+void ProxyServer::processMultiplexedData(ProxyClient *multiplexClient, const QByteArray &data)
+{
+    // Frame format: <channel>:<payload>
+    int separator = data.indexOf(':');
+    bool valid = false;
+    quint32 channelId = data.left(separator).toUInt(&valid);
+    if (separator < 0 || !valid) {
+        qCWarning(dcProxyServer()) << "Invalid frame received from multiplexed connection" << multiplexClient;
+        multiplexClient->killConnection("Invalid multiplexed frame.");
+        return;
+    }
+
+    QByteArray payload = data.mid(separator + 1);
+    if (channelId != 0) {
+        ProxyClient *channelClient = multiplexClient->channel(channelId);
+        if (!channelClient) {
+            qCDebug(dcProxyServer()) << "Dropping data for closed channel" << channelId << "of" << multiplexClient;
+            return;
+        }
+
+        pipeData(multiplexClient, channelClient, payload);
+        return;
+    }
+
+    // Channel 0 carries the control messages
+    QVariantMap message = QJsonDocument::fromJson(payload).toVariant().toMap();
+    if (message.value("command").toString() == "CloseChannel") {
+        ProxyClient *channelClient = multiplexClient->channel(message.value("channel").toUInt());
+        if (channelClient) {
+            channelClient->killConnection("Channel closed by the multiplexed connection.");
+        }
+        return;
+    }
+
+    qCWarning(dcProxyServer()) << "Unknown control message from multiplexed connection" << multiplexClient << payload;
+}
+
+void ProxyServer::sendControlMessage(ProxyClient *multiplexClient, const QVariantMap &message)
+{
+    multiplexClient->sendData("0:" + QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact));
+}
+
+QString ProxyServer::createResumptionTicket() const
+{
+    // The ticket is a bearer credential for taking over the tunnel, an empty one disables the resumption
+    return QString::fromLatin1(SecureRandom::bytes(32).toHex());
+}
+
+void ProxyServer::suspendClient(ProxyClient *proxyClient)
+{
+    qCDebug(dcProxyServer()) << "Suspend" << proxyClient << "for" << Engine::instance()->configuration()->resumptionTimeout() << "ms";
+    proxyClient->setSuspended(true);
+    m_resumptionTickets.insert(proxyClient->resumptionTicket(), proxyClient);
+}
+
+void ProxyServer::removeSuspendedClient(ProxyClient *suspendedClient)
+{
+    m_resumptionTickets.remove(suspendedClient->resumptionTicket());
+    m_pendingResumptions.remove(m_pendingResumptions.key(suspendedClient));
+    suspendedClient->deleteLater();
+}
+
+void ProxyServer::registerWaitingClient(ProxyClient *proxyClient)
+{
+    // Clients of other nodes only join partners waiting on this node
+    if (!m_clusterClient || proxyClient->interface() == m_clusterLink)
+        return;
+
+    QString tunnelHash = ClusterClient::tunnelHash(proxyClient->tunnelIdentifier());
+    m_clusterRegistrations.insert(tunnelHash, proxyClient);
+    m_clusterClient->registerTunnel(tunnelHash);
+}
+
+void ProxyServer::unregisterWaitingClient(ProxyClient *proxyClient)
+{
+    if (!m_clusterClient)
+        return;
+
+    QString tunnelHash = ClusterClient::tunnelHash(proxyClient->tunnelIdentifier());
+    if (m_clusterRegistrations.value(tunnelHash) != proxyClient)
+        return;
+
+    m_clusterRegistrations.remove(tunnelHash);
+    m_clusterClient->unregisterTunnel(tunnelHash);
+}
+
+bool ProxyServer::resumeTunnel(ProxyClient *proxyClient, const QString &resumptionTicket)
+{
+    ProxyClient *suspendedClient = m_resumptionTickets.take(resumptionTicket);
+    if (!suspendedClient) {
+        qCWarning(dcProxyServer()) << "Invalid resumption ticket from" << proxyClient;
+        return false;
+    }
+
+    // Take over the tunnel once the response has been sent to the client
+    qCDebug(dcProxyServer()) << "Resume tunnel of" << suspendedClient << "with" << proxyClient;
+    m_pendingResumptions.insert(proxyClient->clientId(), suspendedClient);
+    QMetaObject::invokeMethod(this, "completeResumption", Qt::QueuedConnection, Q_ARG(QUuid, proxyClient->clientId()));
+    return true;
+}
+
+void ProxyServer::redirectClient(ProxyClient *proxyClient, const QString &url)
+{
+    qCDebug(dcProxyServer()) << "Redirect" << proxyClient << "to the owner of the tunnel" << url;
+    m_redirectCount++;
+
+    // The notification has to arrive before the authentication response
+    QVariantMap notificationParams;
+    notificationParams.insert("url", url);
+    m_jsonRpcServer->sendNotification(m_jsonRpcServer->name(), "Redirect", notificationParams, proxyClient);
+}
+
+bool ProxyServer::admitClient(ProxyClient *proxyClient)
+{
+    if (!m_draining)
+        return true;
+
+    // Channels of an existing multiplexed connection belong to a tunnel already there
+    if (!proxyClient->isMultiplexed() && !proxyClient->isStandby() && m_multiplexedClients.contains(proxyClient->token()))
+        return true;
+
+    qCDebug(dcProxyServer()) << "Server is draining. Rejecting new tunnel client" << proxyClient;
+    m_drainRejectedCount++;
+    return false;
+}
+
+void ProxyServer::reloadConfiguration()
+{
+    // Cached responses like Hello contain values from the previous configuration
+    qCDebug(dcProxyServer()) << "Configuration reloaded. Invalidate cached responses.";
+    m_jsonRpcServer->invalidateResponseCache();
+}
+
+void ProxyServer::startDraining()
+{
+    if (m_draining)
+        return;
+
+    qCDebug(dcProxyServer()) << "Start draining." << m_tunnels.count() << "tunnels stay until they get closed.";
+    m_draining = true;
+    m_drainStartTime = QDateTime::currentMSecsSinceEpoch();
+
+    // Clients without a tunnel reconnect and meet their partner on the new server
+    QList<ProxyClient *> waitingClients = m_authenticatedClients.values() + m_authenticatedClientsNonce.values();
+    foreach (const QList<ProxyClient *> &standbyClients, m_standbyClients.values()) {
+        waitingClients.append(standbyClients);
+    }
+
+    foreach (ProxyClient *proxyClient, waitingClients) {
+        proxyClient->killConnection("Server draining.");
+    }
+}
+
+void ProxyServer::closeDrainingTunnels()
+{
+    // Give the tunnels the time to finish by themselves, then close the rest a few per second
+    ProxyConfiguration *configuration = Engine::instance()->configuration();
+    if (QDateTime::currentMSecsSinceEpoch() - m_drainStartTime < configuration->drainTimeout())
+        return;
+
+    QList<ProxyClient *> drainingClients;
+    foreach (const TunnelConnection &tunnel, m_tunnels.values()) {
+        drainingClients.append(tunnel.clientOne()->isSuspended() ? tunnel.clientTwo() : tunnel.clientOne());
+    }
+    drainingClients.append(m_multiplexedClients.values());
+
+    int closedCount = 0;
+    foreach (ProxyClient *proxyClient, drainingClients) {
+        if (closedCount >= configuration->drainBatchSize())
+            break;
+
+        if (m_drainClosedClients.contains(proxyClient))
+            continue;
+
+        // Closing one end closes the whole tunnel
+        qCDebug(dcProxyServer()) << "Drain timeout exceeded. Closing" << proxyClient;
+        m_drainClosedClients.insert(proxyClient);
+        proxyClient->killConnection("Server drained.");
+        m_drainClosedCount++;
+        closedCount++;
+    }
+}
+
+bool ProxyServer::takeStandbyClient(ProxyClient *proxyClient)
+{
+    if (!m_standbyClients.contains(proxyClient->token()))
+        return false;
+
+    // A partner waiting for this client explicitly takes precedence over the standby pool
+    if (proxyClient->nonce().isEmpty() ? m_authenticatedClients.contains(proxyClient->token()) : m_authenticatedClientsNonce.contains(proxyClient->nonce()))
+        return false;
+
+    QList<ProxyClient *> &standbyClients = m_standbyClients[proxyClient->token()];
+    if (standbyClients.isEmpty()) {
+        qCDebug(dcProxyServer()) << "No standby connection available for" << proxyClient;
+        m_standbyMisses++;
+        return false;
+    }
+
+    ProxyClient *standbyClient = standbyClients.takeFirst();
+    if (standbyClient->uuid() == proxyClient->uuid()) {
+        qCWarning(dcProxyServer()) << "The client has the same uuid as the standby connection. This is not allowed.";
+        standbyClients.prepend(standbyClient);
+        proxyClient->killConnection("Duplicated client UUID.");
+        return true;
+    }
+
+    qCDebug(dcProxyServer()) << "Pair" << proxyClient << "with standby connection" << standbyClient;
+    m_standbyHits++;
+
+    // Use the nonce of the standby connection so both share the tunnel identifier
+    proxyClient->setNonce(standbyClient->nonce());
+
+    QVariantMap notificationParams;
+    notificationParams.insert("standbyCount", standbyClients.count());
+    QMetaObject::invokeMethod(m_jsonRpcServer, QString("sendNotification").toLatin1().data(), Qt::QueuedConnection,
+                              Q_ARG(QString, m_jsonRpcServer->name()),
+                              Q_ARG(QString, "StandbyConsumed"),
+                              Q_ARG(QVariantMap, notificationParams),
+                              Q_ARG(ProxyClient *, standbyClient));
+
+    establishTunnel(standbyClient, proxyClient);
+    return true;
 }
 
 void ProxyServer::onClientConnected(const QUuid &clientId, const QHostAddress &address)
@@ -214,7 +555,7 @@ void ProxyServer::onClientConnected(const QUuid &clientId, const QHostAddress &a
     connect(proxyClient, &ProxyClient::timeoutOccured, this, &ProxyServer::onProxyClientTimeoutOccured);
 
     m_totalClientCount += 1;
-    saveStatistics();
+    m_statisticsChanged = true;
 
     m_proxyClients.insert(clientId, proxyClient);
     m_jsonRpcServer->registerClient(proxyClient);
@@ -237,17 +578,68 @@ void ProxyServer::onClientDisconnected(const QUuid &clientId)
             m_authenticatedClientsNonce.remove(proxyClient->nonce());
         }
 
+        unregisterWaitingClient(proxyClient);
+
+        // Close the forwarded tunnel on the node of the partner
+        if (m_forwardedClients.remove(clientId) > 0) {
+            m_clusterLink->closeForward(clientId);
+        }
+
         // Unregister from json rpc server
         m_jsonRpcServer->unregisterClient(proxyClient);
 
+        // Remove from the standby pool. Tokens keep their pool entry once consumed, so misses can be counted.
+        if (proxyClient->isStandby() && m_standbyClients.contains(proxyClient->token())) {
+            m_standbyClients[proxyClient->token()].removeAll(proxyClient);
+            if (m_standbyClients.value(proxyClient->token()).isEmpty() && !proxyClient->isTunnelConnected())
+                m_standbyClients.remove(proxyClient->token());
+        }
+
+        // Close the channel on the multiplexed connection
+        if (proxyClient->multiplexClient()) {
+            ProxyClient *multiplexClient = proxyClient->multiplexClient();
+            multiplexClient->removeChannel(proxyClient->channelId());
+
+            QVariantMap message;
+            message.insert("event", "ChannelClosed");
+            message.insert("channel", proxyClient->channelId());
+            sendControlMessage(multiplexClient, message);
+        }
+
+        // Close all channels of a multiplexed connection
+        if (proxyClient->isMultiplexed()) {
+            if (m_multiplexedClients.value(proxyClient->token()) == proxyClient)
+                m_multiplexedClients.remove(proxyClient->token());
+
+            foreach (ProxyClient *channelClient, proxyClient->channels()) {
+                channelClient->setChannel(nullptr, channelClient->channelId());
+                channelClient->killConnection("Multiplexed connection disconnected.");
+            }
+        }
+
+        // A pending resumption stays suspended until it times out
+        if (m_pendingResumptions.contains(clientId)) {
+            ProxyClient *suspendedClient = m_pendingResumptions.take(clientId);
+            m_resumptionTickets.insert(suspendedClient->resumptionTicket(), suspendedClient);
+        }
+
         // Check if
         if (m_tunnels.contains(proxyClient->tunnelIdentifier())) {
+            ProxyClient *remoteClient = getRemoteClient(proxyClient);
+
+            // Keep the tunnel alive for a while, the client might resume it with the ticket
+            if (remoteClient && !remoteClient->isSuspended() && !proxyClient->resumptionTicket().isEmpty() && !m_draining
+                    && interface != m_clusterLink && Engine::instance()->configuration()->resumptionTimeout() > 0) {
+                suspendClient(proxyClient);
+                return;
+            }
 
             // There is a tunnel connection for this client, remove the tunnel and disconnect also the other client
-            ProxyClient *remoteClient = getRemoteClient(proxyClient);
             TunnelConnection tunnelConnection = m_tunnels.take(proxyClient->tunnelIdentifier());
             Engine::instance()->logEngine()->logTunnel(tunnelConnection);
-            if (remoteClient) {
+            if (remoteClient && remoteClient->isSuspended()) {
+                removeSuspendedClient(remoteClient);
+            } else if (remoteClient) {
                 remoteClient->killConnection("Tunnel client disconnected");
             }
         }
@@ -267,14 +659,62 @@ void ProxyServer::onClientDataAvailable(const QUuid &clientId, const QByteArray
 
     // If this client is not authenticated yet, and not tunnel connected, pipe the traffic into the json rpc server
     if (!proxyClient->isAuthenticated() && !proxyClient->isTunnelConnected()) {
+        // Unauthenticated calls are cheap to send but not to answer, limit them per client address
+        RateLimiter *rateLimiter = Engine::instance()->rateLimiter();
+        if (rateLimiter && !rateLimiter->allowCall(proxyClient->peerAddress())) {
+            qCWarning(dcProxyServer()) << "Call rate limit exceeded by" << proxyClient;
+            proxyClient->killConnection("Call rate limit exceeded.");
+            return;
+        }
+
         qCDebug(dcProxyServerTraffic()) << "Client data available" << proxyClient << qUtf8Printable(data);
         m_jsonRpcServer->processData(proxyClient, data);
         return;
     }
 
+    // The tunnel partner of this client is connected to an other node of the cluster
+    if (m_forwardedClients.contains(clientId)) {
+        m_troughputCounter += data.count();
+        proxyClient->addRxDataCount(data.count());
+        m_totalTraffic += data.count();
+        qCDebug(dcProxyServerTraffic()) << "Forward tunnel data from" << proxyClient << qUtf8Printable(data);
+        m_clusterLink->forwardData(clientId, data);
+        return;
+    }
+
+    // A multiplexed connection sends frames for its channels
+    if (proxyClient->isMultiplexed() && proxyClient->isAuthenticated()) {
+        processMultiplexedData(proxyClient, data);
+        return;
+    }
+
+    // A channel of a multiplexed connection
+    if (proxyClient->channelId() != 0 && proxyClient->isTunnelConnected()) {
+        if (proxyClient->multiplexClient())
+            pipeData(proxyClient, proxyClient->multiplexClient(), QByteArray::number(proxyClient->channelId()) + ':' + data);
+
+        return;
+    }
+
     // If the client is authenticated, but no tunnel created yet, kill the connection since no addition call is allowed until
-    // the tunne is fully established.
+    // the tunne is fully established. If early data is enabled, buffer the data within the configured limits instead.
     if (proxyClient->isAuthenticated() && !proxyClient->isTunnelConnected()) {
+        int earlyDataSize = Engine::instance()->configuration()->earlyDataSize();
+        if (earlyDataSize > 0) {
+            if (proxyClient->earlyDataSize() + data.count() <= earlyDataSize
+                    && proxyClient->earlyDataCount() < Engine::instance()->configuration()->earlyDataMessages()) {
+                qCDebug(dcProxyServerTraffic()) << "Buffering early data from" << proxyClient << qUtf8Printable(data);
+                proxyClient->appendEarlyData(data);
+                return;
+            }
+
+            qCWarning(dcProxyServer()) << "Early data limit exceeded by" << proxyClient;
+            m_earlyDataOverflowCount++;
+            m_jsonRpcServer->unregisterClient(proxyClient);
+            proxyClient->killConnection("Early data limit exceeded.");
+            return;
+        }
+
         qCWarning(dcProxyServer()) << "An authenticated client sent data without tunnel connection. This is not allowed.";
         m_jsonRpcServer->unregisterClient(proxyClient);
         // The client is authenticated and tries to send data, this is not allowed.
@@ -287,20 +727,26 @@ void ProxyServer::onClientDataAvailable(const QUuid &clientId, const QByteArray
         Q_ASSERT_X(remoteClient, "ProxyServer", "Tunnel existing but not tunnel client available");
         Q_ASSERT_X(m_tunnels.contains(proxyClient->tunnelIdentifier()), "ProxyServer", "Tunnel connect but not existing");
 
-        // Calculate server statisitcs
-        m_troughputCounter += data.count();
-        proxyClient->addRxDataCount(data.count());
-        remoteClient->addTxDataCount(data.count());
+        // Keep the order if buffered early data is still waiting to be forwarded
+        if (proxyClient->earlyDataCount() > 0) {
+            proxyClient->appendEarlyData(data);
+            return;
+        }
 
-        m_totalTraffic += data.count();
-        saveStatistics();
+        // Buffer the data until the partner resumes the tunnel
+        if (remoteClient->isSuspended()) {
+            if (remoteClient->resumptionDataSize() + data.count() > Engine::instance()->configuration()->resumptionBufferSize()) {
+                qCWarning(dcProxyServer()) << "Resumption buffer of" << remoteClient << "exceeded";
+                proxyClient->killConnection("Resumption buffer exceeded.");
+                return;
+            }
 
-        qCDebug(dcProxyServerTraffic()) << "Pipe tunnel data:";
-        qCDebug(dcProxyServerTraffic()) << "    --> from" << proxyClient;
-        qCDebug(dcProxyServerTraffic()) << "    --> to" << remoteClient;
-        qCDebug(dcProxyServerTraffic()) << "    --> data:" << qUtf8Printable(data);
+            qCDebug(dcProxyServerTraffic()) << "Buffering data for suspended" << remoteClient << qUtf8Printable(data);
+            remoteClient->appendResumptionData(data);
+            return;
+        }
 
-        remoteClient->sendData(data);
+        pipeData(proxyClient, remoteClient, data);
     }
 }
 
@@ -312,6 +758,60 @@ void ProxyServer::onProxyClientAuthenticated()
 
     //FIXME: limit the amount of connection with one token
 
+    // A resumed client joined its tunnel already
+    if (proxyClient->isTunnelConnected())
+        return;
+
+    // The authentication might have been started before the server started draining
+    if (!admitClient(proxyClient)) {
+        proxyClient->killConnection("Server draining.");
+        return;
+    }
+
+    // A multiplexed connection waits for the other clients using this token
+    if (proxyClient->isMultiplexed()) {
+        if (m_multiplexedClients.contains(proxyClient->token())) {
+            qCWarning(dcProxyServer()) << "There is already a multiplexed connection for this token.";
+            proxyClient->killConnection("Multiplexed connection already exists for this token.");
+            return;
+        }
+
+        m_multiplexedClients.insert(proxyClient->token(), proxyClient);
+        proxyClient->setTunnelConnected(true);
+        return;
+    }
+
+    if (m_multiplexedClients.contains(proxyClient->token())) {
+        ProxyClient *multiplexClient = m_multiplexedClients.value(proxyClient->token());
+        if (multiplexClient->uuid() == proxyClient->uuid()) {
+            qCWarning(dcProxyServer()) << "The client has the same uuid as the multiplexed connection. This is not allowed.";
+            proxyClient->killConnection("Duplicated client UUID.");
+            return;
+        }
+
+        attachChannel(multiplexClient, proxyClient);
+        return;
+    }
+
+    // A standby connection waits in the pool for the next client using this token
+    if (proxyClient->isStandby()) {
+        if (m_standbyClients.value(proxyClient->token()).count() >= Engine::instance()->configuration()->standbyPoolSize()) {
+            qCWarning(dcProxyServer()) << "The standby pool for this token is full.";
+            proxyClient->killConnection("Standby pool full.");
+            return;
+        }
+
+        if (proxyClient->nonce().isEmpty())
+            proxyClient->setNonce(QUuid::createUuid().toString());
+
+        qCDebug(dcProxyServer()) << "Add standby connection" << proxyClient;
+        m_standbyClients[proxyClient->token()].append(proxyClient);
+        return;
+    }
+
+    if (takeStandbyClient(proxyClient))
+        return;
+
     // Check if we already have a tunnel with this identifier
     if (m_tunnels.contains(proxyClient->tunnelIdentifier())) {
         qCWarning(dcProxyServer()) << "There is already a tunnel with this token and nonce. The client has to take a new nonce or a new token.";
@@ -328,6 +828,7 @@ void ProxyServer::onProxyClientAuthenticated()
 
             // Found a client with this token
             ProxyClient *tunnelPartner = m_authenticatedClients.take(proxyClient->token());
+            unregisterWaitingClient(tunnelPartner);
 
             // Check if the two clients show up with the same uuid to prevent connection loops
             if (tunnelPartner->uuid() == proxyClient->uuid()) {
@@ -342,12 +843,14 @@ void ProxyServer::onProxyClientAuthenticated()
         } else {
             // Append and wait for the other client
             m_authenticatedClients.insert(proxyClient->token(), proxyClient);
+            registerWaitingClient(proxyClient);
         }
     } else {
         // The client passed a nonce, let's hash with that to prevent cross connections
         if (m_authenticatedClientsNonce.keys().contains(proxyClient->nonce())) {
             // Found a client with this nonce
             ProxyClient *tunnelPartner = m_authenticatedClientsNonce.take(proxyClient->nonce());
+            unregisterWaitingClient(tunnelPartner);
 
             // Check if the two clients show up with the same uuid to prevent connection loops
             if (tunnelPartner->uuid() == proxyClient->uuid()) {
@@ -361,6 +864,7 @@ void ProxyServer::onProxyClientAuthenticated()
             establishTunnel(tunnelPartner, proxyClient);
         } else {
             m_authenticatedClientsNonce.insert(proxyClient->nonce(), proxyClient);
+            registerWaitingClient(proxyClient);
         }
     }
 }
@@ -369,9 +873,164 @@ void ProxyServer::onProxyClientTimeoutOccured()
 {
     ProxyClient *proxyClient = static_cast<ProxyClient *>(sender());
     qCDebug(dcProxyServer()) << "Timeout occured for" << proxyClient;
+
+    // The suspended client did not come back, tear down the tunnel
+    if (proxyClient->isSuspended()) {
+        if (m_tunnels.contains(proxyClient->tunnelIdentifier())) {
+            ProxyClient *remoteClient = getRemoteClient(proxyClient);
+            TunnelConnection tunnelConnection = m_tunnels.take(proxyClient->tunnelIdentifier());
+            Engine::instance()->logEngine()->logTunnel(tunnelConnection);
+            if (remoteClient) {
+                remoteClient->killConnection("Tunnel client did not resume the tunnel.");
+            }
+        }
+
+        removeSuspendedClient(proxyClient);
+        return;
+    }
+
     proxyClient->killConnection("Proxy timeout occuret");
 }
 
+void ProxyServer::flushEarlyData(const QString &tunnelIdentifier)
+{
+    if (!m_tunnels.contains(tunnelIdentifier))
+        return;
+
+    TunnelConnection tunnel = m_tunnels.value(tunnelIdentifier);
+    foreach (const QByteArray &data, tunnel.clientOne()->takeEarlyData()) {
+        pipeData(tunnel.clientOne(), tunnel.clientTwo(), data);
+    }
+
+    foreach (const QByteArray &data, tunnel.clientTwo()->takeEarlyData()) {
+        pipeData(tunnel.clientTwo(), tunnel.clientOne(), data);
+    }
+}
+
+void ProxyServer::completeResumption(const QUuid &clientId)
+{
+    ProxyClient *proxyClient = m_proxyClients.value(clientId);
+    if (!proxyClient)
+        return;
+
+    ProxyClient *suspendedClient = m_pendingResumptions.take(clientId);
+    if (!suspendedClient) {
+        qCWarning(dcProxyServer()) << "The tunnel resumed by" << proxyClient << "does not exist any more.";
+        proxyClient->killConnection("Tunnel does not exist any more.");
+        return;
+    }
+
+    ProxyClient *remoteClient = getRemoteClient(suspendedClient);
+    if (!remoteClient) {
+        qCWarning(dcProxyServer()) << "The tunnel of" << suspendedClient << "does not exist any more.";
+        removeSuspendedClient(suspendedClient);
+        proxyClient->killConnection("Tunnel does not exist any more.");
+        return;
+    }
+
+    // The new connection takes over the identity of the suspended client
+    proxyClient->setUuid(suspendedClient->uuid());
+    proxyClient->setName(suspendedClient->name());
+    proxyClient->setToken(suspendedClient->token());
+    proxyClient->setNonce(suspendedClient->nonce());
+    proxyClient->setUserName(suspendedClient->userName());
+    proxyClient->setResumptionTicket(suspendedClient->resumptionTicket());
+    proxyClient->setTunnelConnected(true);
+    proxyClient->setAuthenticated(true);
+
+    TunnelConnection tunnel = m_tunnels.value(suspendedClient->tunnelIdentifier());
+    if (tunnel.clientOne() == suspendedClient) {
+        m_tunnels.insert(tunnel.tunnelIdentifier(), TunnelConnection(proxyClient, remoteClient));
+    } else {
+        m_tunnels.insert(tunnel.tunnelIdentifier(), TunnelConnection(remoteClient, proxyClient));
+    }
+
+    m_resumedCount++;
+    qCDebug(dcProxyServer()) << "Tunnel resumed" << m_tunnels.value(proxyClient->tunnelIdentifier());
+
+    foreach (const QByteArray &data, suspendedClient->takeResumptionData()) {
+        pipeData(remoteClient, proxyClient, data);
+    }
+
+    removeSuspendedClient(suspendedClient);
+}
+
+void ProxyServer::onClusterTunnelMatched(const QString &tunnelHash, const QString &nodeId, const QString &linkAddress)
+{
+    ProxyClient *proxyClient = m_clusterRegistrations.take(tunnelHash);
+    if (!proxyClient)
+        return;
+
+    // The partner waits on the other node, from now on this client is only a pipe to that node
+    if (m_authenticatedClients.value(proxyClient->token()) == proxyClient)
+        m_authenticatedClients.remove(proxyClient->token());
+
+    if (m_authenticatedClientsNonce.value(proxyClient->nonce()) == proxyClient)
+        m_authenticatedClientsNonce.remove(proxyClient->nonce());
+
+    qCDebug(dcProxyServer()) << "Tunnel partner of" << proxyClient << "is waiting on cluster node" << nodeId << linkAddress;
+    m_clusterMatchCount++;
+
+    QVariantMap identity;
+    identity.insert("uuid", proxyClient->uuid());
+    identity.insert("name", proxyClient->name());
+    identity.insert("token", proxyClient->token());
+    identity.insert("nonce", proxyClient->nonce());
+    identity.insert("userName", proxyClient->userName());
+
+    m_forwardedClients.insert(proxyClient->clientId(), proxyClient);
+    proxyClient->setTunnelConnected(true);
+    m_clusterLink->openForward(linkAddress, proxyClient->clientId(), identity);
+
+    foreach (const QByteArray &data, proxyClient->takeEarlyData()) {
+        m_clusterLink->forwardData(proxyClient->clientId(), data);
+    }
+}
+
+void ProxyServer::onClusterClientAttached(const QUuid &clientId, const QVariantMap &identity)
+{
+    ProxyClient *proxyClient = m_proxyClients.value(clientId);
+    if (!proxyClient)
+        return;
+
+    // The client has been authenticated by the node it is connected to
+    proxyClient->setUuid(identity.value("uuid").toString());
+    proxyClient->setName(identity.value("name").toString());
+    proxyClient->setToken(identity.value("token").toString());
+    proxyClient->setNonce(identity.value("nonce").toString());
+    proxyClient->setUserName(identity.value("userName").toString());
+
+    bool partnerWaiting = proxyClient->nonce().isEmpty() ? m_authenticatedClients.contains(proxyClient->token()) : m_authenticatedClientsNonce.contains(proxyClient->nonce());
+    if (!partnerWaiting) {
+        qCWarning(dcProxyServer()) << "The tunnel partner of the remote" << proxyClient << "is not waiting on this node any more.";
+        proxyClient->killConnection("Tunnel partner not available.");
+        return;
+    }
+
+    qCDebug(dcProxyServer()) << "Remote client joined its tunnel partner" << proxyClient;
+    proxyClient->setAuthenticated(true);
+}
+
+void ProxyServer::onClusterForwardDataAvailable(const QUuid &clientId, const QByteArray &data)
+{
+    ProxyClient *proxyClient = m_forwardedClients.value(clientId);
+    if (!proxyClient)
+        return;
+
+    proxyClient->addTxDataCount(data.count());
+    qCDebug(dcProxyServerTraffic()) << "Forward tunnel data to" << proxyClient << qUtf8Printable(data);
+    proxyClient->sendData(data);
+}
+
+void ProxyServer::onClusterForwardClosed(const QUuid &clientId)
+{
+    ProxyClient *proxyClient = m_forwardedClients.take(clientId);
+    if (!proxyClient)
+        return;
+
+    proxyClient->killConnection("Tunnel client on cluster node disconnected");
+}
+
 void ProxyServer::startServer()
 {
     qCDebug(dcProxyServer()) << "Start proxy server.";
@@ -387,6 +1046,10 @@ void ProxyServer::stopServer()
     foreach (TransportInterface *interface, m_transportInterfaces) {
         interface->stopServer();
     }
+
+    if (m_statisticsChanged)
+        saveStatistics();
+
     setRunning(false);
 }
 
@@ -394,6 +1057,12 @@ void ProxyServer::tick()
 {
     m_troughput = m_troughputCounter;
     m_troughputCounter = 0;
+
+    if (m_statisticsChanged)
+        saveStatistics();
+
+    if (m_draining)
+        closeDrainingTunnels();
 }
 
 }
@@ -29,6 +29,7 @@
 #define PROXYSERVER_H
 
 #include <QUuid>
+#include <QSet>
 #include <QHash>
 #include <QObject>
 
@@ -36,6 +37,8 @@
 #include "jsonrpcserver.h"
 #include "tunnelconnection.h"
 #include "transportinterface.h"
+#include "cluster/clusterlink.h"
+#include "cluster/clusterclient.h"
 
 namespace remoteproxy {
 
@@ -47,15 +50,27 @@ public:
     ~ProxyServer();
 
     bool running() const;
+    bool draining() const;
     void registerTransportInterface(TransportInterface *interface);
+    void setCluster(ClusterClient *clusterClient, ClusterLink *clusterLink);
 
     QVariantMap currentStatistics();
 
+    bool resumeTunnel(ProxyClient *proxyClient, const QString &resumptionTicket);
+    void redirectClient(ProxyClient *proxyClient, const QString &url);
+
+    bool admitClient(ProxyClient *proxyClient);
+    void startDraining();
+
+    void reloadConfiguration();
+
 private:
     JsonRpcServer *m_jsonRpcServer = nullptr;
     QList<TransportInterface *> m_transportInterfaces;
 
     bool m_running = false;
+    bool m_draining = false;
+    qint64 m_drainStartTime = 0;
 
     // Transport ClientId, ProxyClient
     QHash<QUuid, ProxyClient *> m_proxyClients;
@@ -69,14 +84,46 @@ private:
     // Token, Tunnel
     QHash<QString, TunnelConnection> m_tunnels;
 
+    // Token, multiplexed ProxyClient
+    QHash<QString, ProxyClient *> m_multiplexedClients;
+
+    // Token, standby ProxyClients
+    QHash<QString, QList<ProxyClient *> > m_standbyClients;
+
+    // Resumption ticket, suspended ProxyClient
+    QHash<QString, ProxyClient *> m_resumptionTickets;
+
+    // Transport ClientId of the resuming client, suspended ProxyClient
+    QHash<QUuid, ProxyClient *> m_pendingResumptions;
+
+    // Cluster rendezvous
+    ClusterClient *m_clusterClient = nullptr;
+    ClusterLink *m_clusterLink = nullptr;
+
+    // Tunnel hash, ProxyClient registered in the cluster while waiting for the partner
+    QHash<QString, ProxyClient *> m_clusterRegistrations;
+
+    // Transport ClientId, ProxyClient forwarded to the node of its tunnel partner
+    QHash<QUuid, ProxyClient *> m_forwardedClients;
+
     // Statistic measurments
     int m_troughput = 0;
     int m_troughputCounter = 0;
+    int m_earlyDataOverflowCount = 0;
+    int m_standbyHits = 0;
+    int m_standbyMisses = 0;
+    int m_resumedCount = 0;
+    int m_clusterMatchCount = 0;
+    int m_redirectCount = 0;
+    int m_drainRejectedCount = 0;
+    int m_drainClosedCount = 0;
+    QSet<ProxyClient *> m_drainClosedClients;
 
     // Persistent statistics
     int m_totalClientCount = 0;
     int m_totalTunnelCount = 0;
     int m_totalTraffic = 0;
+    bool m_statisticsChanged = false;
 
 
     // Set private properties
@@ -89,6 +136,21 @@ private:
     // Helper methods
     ProxyClient *getRemoteClient(ProxyClient *proxyClient);
     void establishTunnel(ProxyClient *firstClient, ProxyClient *secondClient);
+    void pipeData(ProxyClient *proxyClient, ProxyClient *remoteClient, const QByteArray &data);
+
+    void attachChannel(ProxyClient *multiplexClient, ProxyClient *channelClient);
+    void processMultiplexedData(ProxyClient *multiplexClient, const QByteArray &data);
+    void sendControlMessage(ProxyClient *multiplexClient, const QVariantMap &message);
+
+    bool takeStandbyClient(ProxyClient *proxyClient);
+    void closeDrainingTunnels();
+
+    QString createResumptionTicket() const;
+    void suspendClient(ProxyClient *proxyClient);
+    void removeSuspendedClient(ProxyClient *suspendedClient);
+
+    void registerWaitingClient(ProxyClient *proxyClient);
+    void unregisterWaitingClient(ProxyClient *proxyClient);
 
 signals:
     void runningChanged();
@@ -101,6 +163,14 @@ private slots:
     void onProxyClientAuthenticated();
     void onProxyClientTimeoutOccured();
 
+    void flushEarlyData(const QString &tunnelIdentifier);
+    void completeResumption(const QUuid &clientId);
+
+    void onClusterTunnelMatched(const QString &tunnelHash, const QString &nodeId, const QString &linkAddress);
+    void onClusterClientAttached(const QUuid &clientId, const QVariantMap &identity);
+    void onClusterForwardDataAvailable(const QUuid &clientId, const QByteArray &data);
+    void onClusterForwardClosed(const QUuid &clientId);
+
 public slots:
     void startServer();
     void stopServer();
@@ -0,0 +1,209 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ratelimiter.h"
+
+namespace remoteproxy {
+
+RateLimiter::RateLimiter()
+{
+    m_clock.start();
+}
+
+void RateLimiter::setConnectionLimit(double rate, int burst)
+{
+    m_connectionLimit.rate = rate;
+    m_connectionLimit.burst = qMax(1, burst);
+}
+
+void RateLimiter::setSubnetConnectionLimit(double rate, int burst)
+{
+    m_subnetConnectionLimit.rate = rate;
+    m_subnetConnectionLimit.burst = qMax(1, burst);
+}
+
+void RateLimiter::setSubnetPrefixLengths(int ipv4PrefixLength, int ipv6PrefixLength)
+{
+    if (ipv4PrefixLength != m_ipv4PrefixLength || ipv6PrefixLength != m_ipv6PrefixLength)
+        m_subnetBuckets.clear();
+
+    m_ipv4PrefixLength = ipv4PrefixLength;
+    m_ipv6PrefixLength = ipv6PrefixLength;
+}
+
+void RateLimiter::setCallLimit(double rate, int burst)
+{
+    m_callLimit.rate = rate;
+    m_callLimit.burst = qMax(1, burst);
+}
+
+int RateLimiter::maximumSize() const
+{
+    return m_maximumSize;
+}
+
+void RateLimiter::setMaximumSize(int maximumSize)
+{
+    m_maximumSize = maximumSize;
+}
+
+bool RateLimiter::allowConnection(const QHostAddress &address)
+{
+    if (!takeToken(m_connectionBuckets, addressKey(address, 32, 128), m_connectionLimit)) {
+        m_rejectedConnectionCount++;
+        return false;
+    }
+
+    if (!takeToken(m_subnetBuckets, addressKey(address, m_ipv4PrefixLength, m_ipv6PrefixLength), m_subnetConnectionLimit)) {
+        m_rejectedSubnetConnectionCount++;
+        return false;
+    }
+
+    return true;
+}
+
+bool RateLimiter::allowCall(const QHostAddress &address)
+{
+    if (!takeToken(m_callBuckets, addressKey(address, 32, 128), m_callLimit)) {
+        m_rejectedCallCount++;
+        return false;
+    }
+
+    return true;
+}
+
+void RateLimiter::expire()
+{
+    expireBuckets(m_connectionBuckets, m_connectionLimit);
+    expireBuckets(m_subnetBuckets, m_subnetConnectionLimit);
+    expireBuckets(m_callBuckets, m_callLimit);
+}
+
+void RateLimiter::clear()
+{
+    m_connectionBuckets.clear();
+    m_subnetBuckets.clear();
+    m_callBuckets.clear();
+}
+
+int RateLimiter::count() const
+{
+    return m_connectionBuckets.count() + m_subnetBuckets.count() + m_callBuckets.count();
+}
+
+QVariantMap RateLimiter::currentStatistics() const
+{
+    QVariantMap statisticsMap;
+    statisticsMap.insert("connectionBuckets", m_connectionBuckets.count());
+    statisticsMap.insert("subnetBuckets", m_subnetBuckets.count());
+    statisticsMap.insert("callBuckets", m_callBuckets.count());
+    statisticsMap.insert("rejectedConnectionCount", m_rejectedConnectionCount);
+    statisticsMap.insert("rejectedSubnetConnectionCount", m_rejectedSubnetConnectionCount);
+    statisticsMap.insert("rejectedCallCount", m_rejectedCallCount);
+    statisticsMap.insert("evictionCount", m_evictionCount);
+    return statisticsMap;
+}
+
+RateLimiter::AddressKey RateLimiter::addressKey(const QHostAddress &address, int ipv4PrefixLength, int ipv6PrefixLength) const
+{
+    bool isIPv4 = false;
+    quint32 ipv4Address = address.toIPv4Address(&isIPv4);
+    if (isIPv4) {
+        quint32 mask = 0;
+        if (ipv4PrefixLength >= 32) {
+            mask = 0xFFFFFFFF;
+        } else if (ipv4PrefixLength > 0) {
+            mask = ~((static_cast<quint32>(1) << (32 - ipv4PrefixLength)) - 1);
+        }
+
+        return AddressKey(0, Q_UINT64_C(0x0000FFFF00000000) | (ipv4Address & mask));
+    }
+
+    Q_IPV6ADDR ipv6Address = address.toIPv6Address();
+    quint64 high = 0;
+    quint64 low = 0;
+    for (int i = 0; i < 8; i++) {
+        high = (high << 8) | ipv6Address[i];
+        low = (low << 8) | ipv6Address[i + 8];
+    }
+
+    int highPrefixLength = qBound(0, ipv6PrefixLength, 64);
+    int lowPrefixLength = qBound(0, ipv6PrefixLength - 64, 64);
+    high &= highPrefixLength == 0 ? 0 : ~Q_UINT64_C(0) << (64 - highPrefixLength);
+    low &= lowPrefixLength == 0 ? 0 : ~Q_UINT64_C(0) << (64 - lowPrefixLength);
+    return AddressKey(high, low);
+}
+
+bool RateLimiter::takeToken(BucketHash &buckets, const AddressKey &key, const Limit &limit)
+{
+    if (limit.rate <= 0)
+        return true;
+
+    qint64 now = m_clock.elapsed();
+    BucketHash::iterator bucket = buckets.find(key);
+    if (bucket == buckets.end()) {
+        // Keep the memory bounded, an evicted bucket starts full again
+        if (m_maximumSize > 0 && buckets.count() >= m_maximumSize) {
+            buckets.erase(buckets.begin());
+            m_evictionCount++;
+        }
+
+        TokenBucket newBucket;
+        newBucket.tokens = limit.burst;
+        newBucket.timestamp = now;
+        bucket = buckets.insert(key, newBucket);
+    } else {
+        bucket->tokens = static_cast<float>(qMin<double>(limit.burst, bucket->tokens + (now - bucket->timestamp) * limit.rate / 1000));
+        bucket->timestamp = now;
+    }
+
+    if (bucket->tokens < 1)
+        return false;
+
+    bucket->tokens -= 1;
+    return true;
+}
+
+void RateLimiter::expireBuckets(BucketHash &buckets, const Limit &limit)
+{
+    if (limit.rate <= 0) {
+        buckets.clear();
+        return;
+    }
+
+    qint64 now = m_clock.elapsed();
+    BucketHash::iterator bucket = buckets.begin();
+    while (bucket != buckets.end()) {
+        if (bucket->tokens + (now - bucket->timestamp) * limit.rate / 1000 >= limit.burst) {
+            bucket = buckets.erase(bucket);
+        } else {
+            ++bucket;
+        }
+    }
+}
+
+}
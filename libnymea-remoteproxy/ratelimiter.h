@@ -0,0 +1,109 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QHash>
+#include <QPair>
+#include <QVariantMap>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+namespace remoteproxy {
+
+// Token buckets per client address and per subnet. Each connection or call takes one token,
+// the buckets refill with the configured rate up to the burst size. A rate of 0 disables a limit.
+class RateLimiter
+{
+public:
+    RateLimiter();
+
+    void setConnectionLimit(double rate, int burst);
+    void setSubnetConnectionLimit(double rate, int burst);
+    void setSubnetPrefixLengths(int ipv4PrefixLength, int ipv6PrefixLength);
+    void setCallLimit(double rate, int burst);
+
+    int maximumSize() const;
+    void setMaximumSize(int maximumSize);
+
+    bool allowConnection(const QHostAddress &address);
+    bool allowCall(const QHostAddress &address);
+
+    // Forget the buckets which are full again, they behave like new ones
+    void expire();
+    void clear();
+
+    int count() const;
+    QVariantMap currentStatistics() const;
+
+private:
+    class Limit
+    {
+    public:
+        double rate = 0;
+        int burst = 0;
+    };
+
+    class TokenBucket
+    {
+    public:
+        float tokens = 0;
+        qint64 timestamp = 0;
+    };
+
+    // The address as IPv6, IPv4 addresses mapped, masked to the prefix length
+    typedef QPair<quint64, quint64> AddressKey;
+    typedef QHash<AddressKey, TokenBucket> BucketHash;
+
+    QElapsedTimer m_clock;
+    BucketHash m_connectionBuckets;
+    BucketHash m_subnetBuckets;
+    BucketHash m_callBuckets;
+
+    Limit m_connectionLimit;
+    Limit m_subnetConnectionLimit;
+    Limit m_callLimit;
+    int m_ipv4PrefixLength = 24;
+    int m_ipv6PrefixLength = 64;
+    int m_maximumSize = 100000;
+
+    // Statistics
+    quint64 m_rejectedConnectionCount = 0;
+    quint64 m_rejectedSubnetConnectionCount = 0;
+    quint64 m_rejectedCallCount = 0;
+    quint64 m_evictionCount = 0;
+
+    AddressKey addressKey(const QHostAddress &address, int ipv4PrefixLength, int ipv6PrefixLength) const;
+    bool takeToken(BucketHash &buckets, const AddressKey &key, const Limit &limit);
+    void expireBuckets(BucketHash &buckets, const Limit &limit);
+
+};
+
+}
+
+#endif // RATELIMITER_H
@@ -0,0 +1,59 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "securerandom.h"
+#include "loggingcategories.h"
+
+#include <QFile>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QVector>
+#include <QRandomGenerator>
+#endif
+
+#include <string.h>
+
+namespace remoteproxy {
+
+QByteArray SecureRandom::bytes(int count)
+{
+    QByteArray bytes(count, 0);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    QVector<quint32> values((count + 3) / 4);
+    QRandomGenerator::system()->fillRange(values.data(), values.count());
+    memcpy(bytes.data(), values.constData(), static_cast<size_t>(count));
+#else
+    QFile randomFile("/dev/urandom");
+    if (!randomFile.open(QFile::ReadOnly) || randomFile.read(bytes.data(), count) != count) {
+        qCWarning(dcApplication()) << "Could not read random bytes from" << randomFile.fileName() << randomFile.errorString();
+        return QByteArray();
+    }
+#endif
+    return bytes;
+}
+
+}
@@ -0,0 +1,157 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "sslserver.h"
+#include "loggingcategories.h"
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace remoteproxy {
+
+static QHostAddress socketPeerAddress(qintptr socketDescriptor)
+{
+    sockaddr_storage address;
+    socklen_t addressLength = sizeof(address);
+    if (getpeername(static_cast<int>(socketDescriptor), reinterpret_cast<sockaddr *>(&address), &addressLength) < 0)
+        return QHostAddress();
+
+    return QHostAddress(reinterpret_cast<sockaddr *>(&address));
+}
+
+SslServer::SslServer(const QSslConfiguration &sslConfiguration, int handshakeThreads, QObject *parent) :
+    QTcpServer(parent),
+    m_sslConfiguration(sslConfiguration)
+{
+    qRegisterMetaType<qintptr>("qintptr");
+    qRegisterMetaType<QSslSocket *>("QSslSocket *");
+    qRegisterMetaType<QSslConfiguration>();
+
+    if (handshakeThreads <= 0) {
+        m_workers.append(new HandshakeWorker(thread(), this));
+    } else {
+        // Slow handshakes must not block relaying data in this thread
+        qCDebug(dcWebSocketServer()) << "Running the TLS handshakes in" << handshakeThreads << "threads";
+        for (int i = 0; i < handshakeThreads; i++) {
+            QThread *handshakeThread = new QThread(this);
+            HandshakeWorker *worker = new HandshakeWorker(thread());
+            worker->moveToThread(handshakeThread);
+            connect(handshakeThread, &QThread::finished, worker, &HandshakeWorker::deleteLater);
+            handshakeThread->start();
+            m_threads.append(handshakeThread);
+            m_workers.append(worker);
+        }
+    }
+
+    foreach (HandshakeWorker *worker, m_workers) {
+        connect(worker, &HandshakeWorker::handshakeFinished, this, &SslServer::onHandshakeFinished);
+        connect(worker, &HandshakeWorker::handshakeFailed, this, &SslServer::onHandshakeFailed);
+    }
+}
+
+SslServer::~SslServer()
+{
+    foreach (QThread *handshakeThread, m_threads) {
+        handshakeThread->quit();
+        handshakeThread->wait();
+    }
+}
+
+QSslConfiguration SslServer::sslConfiguration() const
+{
+    return m_sslConfiguration;
+}
+
+void SslServer::setSslConfiguration(const QSslConfiguration &sslConfiguration)
+{
+    m_sslConfiguration = sslConfiguration;
+}
+
+int SslServer::handshakeTimeout() const
+{
+    return m_handshakeTimeout;
+}
+
+void SslServer::setHandshakeTimeout(int handshakeTimeout)
+{
+    m_handshakeTimeout = handshakeTimeout;
+}
+
+void SslServer::setRateLimiter(RateLimiter *rateLimiter)
+{
+    m_rateLimiter = rateLimiter;
+}
+
+QVariantMap SslServer::currentStatistics() const
+{
+    QVariantMap statistics;
+    statistics.insert("handshakeThreads", m_threads.count());
+    statistics.insert("handshakeCount", m_handshakeCount);
+    statistics.insert("handshakeFailedCount", m_handshakeFailedCount);
+    statistics.insert("pendingHandshakes", m_pendingHandshakeCount);
+    statistics.insert("averageHandshakeDuration", m_handshakeCount > 0 ? m_handshakeTotalDuration / m_handshakeCount : 0);
+    statistics.insert("maximumHandshakeDuration", m_handshakeMaximumDuration);
+    return statistics;
+}
+
+void SslServer::incomingConnection(qintptr socketDescriptor)
+{
+    // A single source must not use up the handshake capacity, so check it before any TLS work
+    if (m_rateLimiter) {
+        QHostAddress address = socketPeerAddress(socketDescriptor);
+        if (!address.isNull() && !m_rateLimiter->allowConnection(address)) {
+            qCDebug(dcWebSocketServer()) << "Rate limit exceeded, closing the connection from" << address.toString();
+            ::close(static_cast<int>(socketDescriptor));
+            return;
+        }
+    }
+
+    // Each handshake gets a copy of the current configuration, so a reload is safe meanwhile
+    HandshakeWorker *worker = m_workers.at(m_nextWorker);
+    m_nextWorker = (m_nextWorker + 1) % m_workers.count();
+    m_pendingHandshakeCount++;
+    QMetaObject::invokeMethod(worker, "startHandshake", Qt::QueuedConnection, Q_ARG(qintptr, socketDescriptor), Q_ARG(QSslConfiguration, m_sslConfiguration), Q_ARG(int, m_handshakeTimeout));
+}
+
+void SslServer::onHandshakeFinished(QSslSocket *socket, qint64 duration)
+{
+    m_pendingHandshakeCount--;
+    m_handshakeCount++;
+    m_handshakeTotalDuration += duration;
+    m_handshakeMaximumDuration = qMax(m_handshakeMaximumDuration, duration);
+
+    socket->setParent(this);
+    emit encryptedConnection(socket);
+}
+
+void SslServer::onHandshakeFailed()
+{
+    m_pendingHandshakeCount--;
+    m_handshakeFailedCount++;
+}
+
+}
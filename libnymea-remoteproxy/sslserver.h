@@ -0,0 +1,93 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SSLSERVER_H
+#define SSLSERVER_H
+
+#include <QList>
+#include <QObject>
+#include <QThread>
+#include <QSslSocket>
+#include <QTcpServer>
+#include <QVariantMap>
+#include <QSslConfiguration>
+
+#include "ratelimiter.h"
+#include "handshakeworker.h"
+
+namespace remoteproxy {
+
+class SslServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    // Without handshake threads the handshakes run in the thread of the server
+    explicit SslServer(const QSslConfiguration &sslConfiguration, int handshakeThreads = 0, QObject *parent = nullptr);
+    ~SslServer() override;
+
+    QSslConfiguration sslConfiguration() const;
+    void setSslConfiguration(const QSslConfiguration &sslConfiguration);
+
+    // Milliseconds a client may take for the handshake before the connection gets closed
+    int handshakeTimeout() const;
+    void setHandshakeTimeout(int handshakeTimeout);
+
+    // Connections exceeding the rate limit get closed before the handshake
+    void setRateLimiter(RateLimiter *rateLimiter);
+
+    QVariantMap currentStatistics() const;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    QSslConfiguration m_sslConfiguration;
+    RateLimiter *m_rateLimiter = nullptr;
+    int m_handshakeTimeout = 5000;
+    QList<QThread *> m_threads;
+    QList<HandshakeWorker *> m_workers;
+    int m_nextWorker = 0;
+
+    // Statistics
+    int m_handshakeCount = 0;
+    int m_handshakeFailedCount = 0;
+    int m_pendingHandshakeCount = 0;
+    qint64 m_handshakeTotalDuration = 0;
+    qint64 m_handshakeMaximumDuration = 0;
+
+signals:
+    void encryptedConnection(QSslSocket *socket);
+
+private slots:
+    void onHandshakeFinished(QSslSocket *socket, qint64 duration);
+    void onHandshakeFailed();
+
+};
+
+}
+
+#endif // SSLSERVER_H
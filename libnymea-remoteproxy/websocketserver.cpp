@@ -30,6 +30,8 @@
 
 #include <QCoreApplication>
 
+#include <unistd.h>
+
 namespace remoteproxy {
 
 WebSocketServer::WebSocketServer(const QSslConfiguration &sslConfiguration, QObject *parent) :
@@ -56,10 +58,17 @@ void WebSocketServer::setServerUrl(const QUrl &serverUrl)
 
 bool WebSocketServer::running() const
 {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    if (!m_listeningServer)
+        return false;
+
+    return m_listeningServer->isListening();
+#else
     if (!m_server)
         return false;
 
     return m_server->isListening();
+#endif
 }
 
 QSslConfiguration WebSocketServer::sslConfiguration() const
@@ -67,6 +76,148 @@ QSslConfiguration WebSocketServer::sslConfiguration() const
     return m_sslConfiguration;
 }
 
+void WebSocketServer::setSslConfiguration(const QSslConfiguration &sslConfiguration)
+{
+    m_sslConfiguration = sslConfiguration;
+
+    // Only new handshakes use the new configuration, established sessions stay untouched
+    qCDebug(dcWebSocketServer()) << "Using new SSL configuration for new connections on" << serverUrl().toString();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    if (m_sslServer)
+        m_sslServer->setSslConfiguration(m_sslConfiguration);
+#else
+    if (m_server)
+        m_server->setSslConfiguration(m_sslConfiguration);
+#endif
+}
+
+int WebSocketServer::handshakeThreads() const
+{
+    return m_handshakeThreads;
+}
+
+void WebSocketServer::setHandshakeThreads(int handshakeThreads)
+{
+    m_handshakeThreads = handshakeThreads;
+}
+
+int WebSocketServer::handshakeTimeout() const
+{
+    return m_handshakeTimeout;
+}
+
+void WebSocketServer::setHandshakeTimeout(int handshakeTimeout)
+{
+    m_handshakeTimeout = handshakeTimeout;
+    if (m_sslServer)
+        m_sslServer->setHandshakeTimeout(m_handshakeTimeout);
+}
+
+bool WebSocketServer::proxyProtocolEnabled() const
+{
+    return m_proxyProtocolEnabled;
+}
+
+void WebSocketServer::setProxyProtocolEnabled(bool enabled)
+{
+    m_proxyProtocolEnabled = enabled;
+}
+
+QList<QPair<QHostAddress, int>> WebSocketServer::trustedProxies() const
+{
+    return m_trustedProxies;
+}
+
+void WebSocketServer::setTrustedProxies(const QList<QPair<QHostAddress, int>> &trustedProxies)
+{
+    m_trustedProxies = trustedProxies;
+}
+
+int WebSocketServer::proxyHeaderTimeout() const
+{
+    return m_proxyHeaderTimeout;
+}
+
+void WebSocketServer::setProxyHeaderTimeout(int proxyHeaderTimeout)
+{
+    m_proxyHeaderTimeout = proxyHeaderTimeout;
+    if (m_proxyProtocolServer)
+        m_proxyProtocolServer->setHeaderTimeout(m_proxyHeaderTimeout);
+}
+
+void WebSocketServer::setRateLimiter(RateLimiter *rateLimiter)
+{
+    m_rateLimiter = rateLimiter;
+}
+
+qintptr WebSocketServer::listeningDescriptor() const
+{
+    if (!running())
+        return -1;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    return m_listeningServer->socketDescriptor();
+#else
+    return m_server->socketDescriptor();
+#endif
+}
+
+void WebSocketServer::setListeningDescriptor(qintptr descriptor)
+{
+    m_listeningDescriptor = descriptor;
+}
+
+void WebSocketServer::stopListening()
+{
+    if (!running())
+        return;
+
+    // Stop accepting new connections, the connected clients stay
+    qCDebug(dcWebSocketServer()) << "Stop listening on" << serverUrl().toString() << "Keeping" << m_clientList.count() << "clients connected.";
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    m_listeningServer->close();
+#else
+    m_server->close();
+#endif
+}
+
+bool WebSocketServer::resumeListening()
+{
+    if (running())
+        return true;
+
+    // Accept new connections again on the server objects kept by stopListening
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    if (!m_listeningServer)
+        return false;
+
+    bool listening = m_listeningServer->listen(QHostAddress(m_serverUrl.host()), static_cast<quint16>(serverUrl().port()));
+#else
+    if (!m_server)
+        return false;
+
+    bool listening = m_server->listen(QHostAddress(m_serverUrl.host()), static_cast<quint16>(serverUrl().port()));
+#endif
+    if (!listening) {
+        qCWarning(dcWebSocketServer()) << "Could not listen again on" << serverUrl().toString();
+        return false;
+    }
+
+    qCDebug(dcWebSocketServer()) << "Listening again on" << serverUrl().toString();
+    return true;
+}
+
+QVariantMap WebSocketServer::currentStatistics() const
+{
+    if (m_proxyProtocolServer)
+        return m_proxyProtocolServer->currentStatistics();
+
+    if (m_sslServer)
+        return m_sslServer->currentStatistics();
+
+    return QVariantMap();
+}
+
 void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
 {
     QWebSocket *client = nullptr;
@@ -102,25 +253,83 @@ void WebSocketServer::onClientConnected()
         return;
     }
 
+    // Behind a load balancer, the client address came with the PROXY protocol header
+    QHostAddress clientAddress = client->peerAddress();
+    QString connectionKey = QString("%1:%2").arg(client->peerAddress().toString()).arg(client->peerPort());
+    if (m_proxiedAddresses.contains(connectionKey))
+        clientAddress = m_proxiedAddresses.take(connectionKey);
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 9, 0)
+    // Without our own acceptor the limit can only be checked after the TLS handshake
+    if (m_rateLimiter && !m_rateLimiter->allowConnection(clientAddress)) {
+        qCDebug(dcWebSocketServer()) << "Rate limit exceeded, closing the connection from" << clientAddress.toString();
+        client->abort();
+        client->deleteLater();
+        return;
+    }
+#endif
+
     // Create new uuid for this connection
     QUuid clientId = QUuid::createUuid();
-    qCDebug(dcWebSocketServer()) << "New client connected:" << client << client->peerAddress().toString() << clientId.toString();
+    qCDebug(dcWebSocketServer()) << "New client connected:" << client << clientAddress.toString() << clientId.toString();
 
     // Append the new client to the client list
     m_clientList.insert(clientId, client);
+    m_clientIds.insert(client, clientId);
 
     connect(client, SIGNAL(binaryMessageReceived(QByteArray)), this, SLOT(onBinaryMessageReceived(QByteArray)));
     connect(client, SIGNAL(textMessageReceived(QString)), this, SLOT(onTextMessageReceived(QString)));
     connect(client, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onClientError(QAbstractSocket::SocketError)));
     connect(client, SIGNAL(disconnected()), this, SLOT(onClientDisconnected()));
 
-    emit clientConnected(clientId, client->peerAddress());
+    emit clientConnected(clientId, clientAddress);
+}
+
+void WebSocketServer::onEncryptedConnection(QSslSocket *socket)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    // Continue with the websocket handshake on the encrypted connection
+    m_server->handleConnection(socket);
+
+    // Data received before the socket arrived in this thread does not get announced again
+    if (socket->bytesAvailable() > 0)
+        QMetaObject::invokeMethod(socket, "readyRead", Qt::QueuedConnection);
+#else
+    socket->abort();
+    socket->deleteLater();
+#endif
+}
+
+void WebSocketServer::onProxiedConnection(QTcpSocket *socket, const QHostAddress &clientAddress)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    // The websocket created for this connection has the same peer address and port
+    m_proxiedAddresses.insert(QString("%1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort()), clientAddress);
+    connect(socket, &QTcpSocket::disconnected, this, &WebSocketServer::onProxiedSocketDisconnected);
+
+    m_server->handleConnection(socket);
+
+    // The request might have arrived together with the PROXY protocol header
+    if (socket->bytesAvailable() > 0)
+        QMetaObject::invokeMethod(socket, "readyRead", Qt::QueuedConnection);
+#else
+    Q_UNUSED(clientAddress)
+    socket->abort();
+    socket->deleteLater();
+#endif
+}
+
+void WebSocketServer::onProxiedSocketDisconnected()
+{
+    // Forget the connections which never became a websocket
+    QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+    m_proxiedAddresses.remove(QString("%1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort()));
 }
 
 void WebSocketServer::onClientDisconnected()
 {
     QWebSocket *client = static_cast<QWebSocket *>(sender());
-    QUuid clientId = m_clientList.key(client);
+    QUuid clientId = m_clientIds.take(client);
 
     qCDebug(dcWebSocketServer()) << "Client disconnected:" << client << client->peerAddress().toString() << clientId.toString() << client->closeReason();
 
@@ -135,7 +344,8 @@ void WebSocketServer::onTextMessageReceived(const QString &message)
 {
     QWebSocket *client = static_cast<QWebSocket *>(sender());
     qCDebug(dcWebSocketServerTraffic()) << "Text message from" << client->peerAddress().toString() << ":" << message;
-    emit dataAvailable(m_clientList.key(client), message.toUtf8());
+    // The reverse lookup keeps the relay path constant with the number of connected clients
+    emit dataAvailable(m_clientIds.value(client), message.toUtf8());
 }
 
 void WebSocketServer::onBinaryMessageReceived(const QByteArray &data)
@@ -154,7 +364,11 @@ void WebSocketServer::onClientError(QAbstractSocket::SocketError error)
 
 void WebSocketServer::onAcceptError(QAbstractSocket::SocketError error)
 {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    qCWarning(dcWebSocketServer()) << "Server accept error occurred:" << error << m_listeningServer->errorString();
+#else
     qCWarning(dcWebSocketServer()) << "Server accept error occurred:" << error << m_server->errorString();
+#endif
 }
 
 void WebSocketServer::onServerError(QWebSocketProtocol::CloseCode closeCode)
@@ -164,16 +378,69 @@ void WebSocketServer::onServerError(QWebSocketProtocol::CloseCode closeCode)
 
 bool WebSocketServer::startServer()
 {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    // The TLS handshakes or PROXY protocol headers get handled by our own acceptor, the websocket server only upgrades the connections
+    m_server = new QWebSocketServer(QCoreApplication::applicationName(), QWebSocketServer::NonSecureMode, this);
+    if (m_proxyProtocolEnabled) {
+        m_proxyProtocolServer = new ProxyProtocolServer(this);
+        m_proxyProtocolServer->setTrustedProxies(m_trustedProxies);
+        m_proxyProtocolServer->setRateLimiter(m_rateLimiter);
+        m_proxyProtocolServer->setHeaderTimeout(m_proxyHeaderTimeout);
+        connect (m_proxyProtocolServer, &ProxyProtocolServer::proxiedConnection, this, &WebSocketServer::onProxiedConnection);
+        m_listeningServer = m_proxyProtocolServer;
+    } else {
+        m_sslServer = new SslServer(sslConfiguration(), m_handshakeThreads, this);
+        m_sslServer->setRateLimiter(m_rateLimiter);
+        m_sslServer->setHandshakeTimeout(m_handshakeTimeout);
+        connect (m_sslServer, &SslServer::encryptedConnection, this, &WebSocketServer::onEncryptedConnection);
+        m_listeningServer = m_sslServer;
+    }
+    connect (m_listeningServer, &QTcpServer::acceptError, this, &WebSocketServer::onAcceptError);
+#else
+    if (m_proxyProtocolEnabled) {
+        qCWarning(dcWebSocketServer()) << "The PROXY protocol requires Qt 5.9 or newer.";
+        return false;
+    }
+
     m_server = new QWebSocketServer(QCoreApplication::applicationName(), QWebSocketServer::SecureMode, this);
     m_server->setSslConfiguration(sslConfiguration());
+    connect (m_server, &QWebSocketServer::acceptError, this, &WebSocketServer::onAcceptError);
+#endif
 
     connect (m_server, &QWebSocketServer::newConnection, this, &WebSocketServer::onClientConnected);
-    connect (m_server, &QWebSocketServer::acceptError, this, &WebSocketServer::onAcceptError);
     connect (m_server, &QWebSocketServer::serverError, this, &WebSocketServer::onServerError);
 
+    // Continue on the listening socket taken over from the previous server process
+    if (m_listeningDescriptor >= 0) {
+        qCDebug(dcWebSocketServer()) << "Starting server" << m_server->serverName() << serverUrl().toString() << "on the listening socket taken over";
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+        bool success = m_listeningServer->setSocketDescriptor(m_listeningDescriptor);
+#else
+        bool success = m_server->setSocketDescriptor(static_cast<int>(m_listeningDescriptor));
+#endif
+        if (success) {
+            m_listeningDescriptor = -1;
+            qCDebug(dcWebSocketServer()) << "Server started successfully.";
+            return true;
+        }
+
+        ::close(static_cast<int>(m_listeningDescriptor));
+        m_listeningDescriptor = -1;
+        qCWarning(dcWebSocketServer()) << "Could not use the listening socket taken over. Listening on a new one.";
+    }
+
     qCDebug(dcWebSocketServer()) << "Starting server" << m_server->serverName() << serverUrl().toString();
-    if (!m_server->listen(QHostAddress(m_serverUrl.host()), static_cast<quint16>(serverUrl().port()))) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    bool listening = m_listeningServer->listen(QHostAddress(m_serverUrl.host()), static_cast<quint16>(serverUrl().port()));
+#else
+    bool listening = m_server->listen(QHostAddress(m_serverUrl.host()), static_cast<quint16>(serverUrl().port()));
+#endif
+    if (!listening) {
         qCWarning(dcWebSocketServer()) << "Server" << m_server->serverName() << "could not listen on" << serverUrl().toString();
+        delete m_listeningServer;
+        m_listeningServer = nullptr;
+        m_sslServer = nullptr;
+        m_proxyProtocolServer = nullptr;
         delete  m_server;
         m_server = nullptr;
         return false;
@@ -190,7 +457,17 @@ bool WebSocketServer::stopServer()
         client->close(QWebSocketProtocol::CloseCodeNormal, "Stop server");
     }
 
-    // Delete the server object
+    // Delete the server objects, including the connections still in the TLS handshake
+    if (m_listeningServer) {
+        m_listeningServer->close();
+        delete m_listeningServer;
+        m_listeningServer = nullptr;
+        m_sslServer = nullptr;
+        m_proxyProtocolServer = nullptr;
+    }
+
+    m_proxiedAddresses.clear();
+
     if (m_server) {
         qCDebug(dcWebSocketServer()) << "Stop server" << m_server->serverName() << serverUrl().toString();
         m_server->close();
@@ -35,6 +35,9 @@
 #include <QWebSocketServer>
 #include <QSslConfiguration>
 
+#include "sslserver.h"
+#include "ratelimiter.h"
+#include "proxyprotocolserver.h"
 #include "transportinterface.h"
 
 namespace remoteproxy {
@@ -52,6 +55,36 @@ public:
     bool running() const;
 
     QSslConfiguration sslConfiguration() const;
+    void setSslConfiguration(const QSslConfiguration &sslConfiguration);
+
+    int handshakeThreads() const;
+    void setHandshakeThreads(int handshakeThreads);
+
+    // Connections which do not finish the TLS handshake in time get closed
+    int handshakeTimeout() const;
+    void setHandshakeTimeout(int handshakeTimeout);
+
+    // Plain listener behind TLS terminating load balancers
+    bool proxyProtocolEnabled() const;
+    void setProxyProtocolEnabled(bool enabled);
+
+    QList<QPair<QHostAddress, int>> trustedProxies() const;
+    void setTrustedProxies(const QList<QPair<QHostAddress, int>> &trustedProxies);
+
+    // Connections which do not send the PROXY protocol header in time get closed
+    int proxyHeaderTimeout() const;
+    void setProxyHeaderTimeout(int proxyHeaderTimeout);
+
+    // Per address and subnet limits for new connections, owned by the caller
+    void setRateLimiter(RateLimiter *rateLimiter);
+
+    // Listening socket handover between an old and a new server process
+    qintptr listeningDescriptor() const;
+    void setListeningDescriptor(qintptr descriptor);
+    void stopListening();
+    bool resumeListening();
+
+    QVariantMap currentStatistics() const;
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void killClientConnection(const QUuid &clientId, const QString &killReason) override;
@@ -59,13 +92,28 @@ public:
 private:
     QUrl m_serverUrl;
     QWebSocketServer *m_server = nullptr;
+    SslServer *m_sslServer = nullptr;
+    ProxyProtocolServer *m_proxyProtocolServer = nullptr;
+    QTcpServer *m_listeningServer = nullptr;
     QSslConfiguration m_sslConfiguration;
     bool m_enabled = false;
+    int m_handshakeThreads = 0;
+    int m_handshakeTimeout = 5000;
+    int m_proxyHeaderTimeout = 5000;
+    RateLimiter *m_rateLimiter = nullptr;
+    bool m_proxyProtocolEnabled = false;
+    QList<QPair<QHostAddress, int>> m_trustedProxies;
+    QHash<QString, QHostAddress> m_proxiedAddresses;
+    qintptr m_listeningDescriptor = -1;
 
     QHash<QUuid, QWebSocket *> m_clientList;
+    QHash<QWebSocket *, QUuid> m_clientIds;
 
 private slots:
     void onClientConnected();
+    void onEncryptedConnection(QSslSocket *socket);
+    void onProxiedConnection(QTcpSocket *socket, const QHostAddress &clientAddress);
+    void onProxiedSocketDisconnected();
     void onClientDisconnected();
     void onTextMessageReceived(const QString &message);
     void onBinaryMessageReceived(const QByteArray &data);
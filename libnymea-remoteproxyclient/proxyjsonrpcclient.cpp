@@ -51,13 +51,16 @@ JsonReply *JsonRpcClient::callHello()
     return reply;
 }
 
-JsonReply *JsonRpcClient::callAuthenticate(const QUuid &clientUuid, const QString &clientName, const QString &token, const QString &nonce)
+JsonReply *JsonRpcClient::callAuthenticate(const QUuid &clientUuid, const QString &clientName, const QString &token, const QString &nonce, bool multiplex, bool standby, const QString &sessionTicket)
 {
     QVariantMap params;
     params.insert("name", clientName);
     params.insert("uuid", clientUuid.toString());
     params.insert("token", token);
     if (!nonce.isEmpty()) params.insert("nonce", nonce);
+    if (multiplex) params.insert("multiplex", true);
+    if (standby) params.insert("standby", true);
+    if (!sessionTicket.isEmpty()) params.insert("sessionTicket", sessionTicket);
 
     JsonReply *reply = new JsonReply(m_commandId, "Authentication", "Authenticate", params, this);
     qCDebug(dcRemoteProxyClientJsonRpc()) << "Calling" << QString("%1.%2").arg(reply->nameSpace()).arg(reply->method());
@@ -66,6 +69,36 @@ JsonReply *JsonRpcClient::callAuthenticate(const QUuid &clientUuid, const QStrin
     return reply;
 }
 
+JsonReply *JsonRpcClient::callConnect(const QUuid &clientUuid, const QString &clientName, const QString &token, const QString &nonce, bool multiplex, bool standby, const QString &sessionTicket)
+{
+    QVariantMap params;
+    params.insert("name", clientName);
+    params.insert("uuid", clientUuid.toString());
+    params.insert("token", token);
+    if (!nonce.isEmpty()) params.insert("nonce", nonce);
+    if (multiplex) params.insert("multiplex", true);
+    if (standby) params.insert("standby", true);
+    if (!sessionTicket.isEmpty()) params.insert("sessionTicket", sessionTicket);
+
+    JsonReply *reply = new JsonReply(m_commandId, "Authentication", "Connect", params, this);
+    qCDebug(dcRemoteProxyClientJsonRpc()) << "Calling" << QString("%1.%2").arg(reply->nameSpace()).arg(reply->method());
+    sendRequest(reply->requestMap());
+    m_replies.insert(m_commandId, reply);
+    return reply;
+}
+
+JsonReply *JsonRpcClient::callResume(const QString &resumptionTicket)
+{
+    QVariantMap params;
+    params.insert("ticket", resumptionTicket);
+
+    JsonReply *reply = new JsonReply(m_commandId, "Authentication", "Resume", params, this);
+    qCDebug(dcRemoteProxyClientJsonRpc()) << "Calling" << QString("%1.%2").arg(reply->nameSpace()).arg(reply->method());
+    sendRequest(reply->requestMap());
+    m_replies.insert(m_commandId, reply);
+    return reply;
+}
+
 void JsonRpcClient::sendRequest(const QVariantMap &request)
 {
     QByteArray data = QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact);
@@ -114,7 +147,11 @@ void JsonRpcClient::processData(const QByteArray &data)
         if (nameSpace == "RemoteProxy" && notificationName == "TunnelEstablished") {
             QString clientName = notificationParams.value("name").toString();
             QString clientUuid = notificationParams.value("uuid").toString();
-            emit tunnelEstablished(clientName, clientUuid);
+            emit tunnelEstablished(clientName, clientUuid, notificationParams.value("resumptionTicket").toString());
+        } else if (nameSpace == "RemoteProxy" && notificationName == "StandbyConsumed") {
+            emit standbyConsumed(notificationParams.value("standbyCount").toInt());
+        } else if (nameSpace == "RemoteProxy" && notificationName == "Redirect") {
+            emit redirected(QUrl(notificationParams.value("url").toString()));
         }
     }
 }
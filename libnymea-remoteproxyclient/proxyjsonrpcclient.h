@@ -28,6 +28,7 @@
 #ifndef JSONRPCCLIENT_H
 #define JSONRPCCLIENT_H
 
+#include <QUrl>
 #include <QUuid>
 #include <QObject>
 #include <QVariantMap>
@@ -48,7 +49,9 @@ public:
     explicit JsonRpcClient(ProxyConnection *connection, QObject *parent = nullptr);
 
     JsonReply *callHello();
-    JsonReply *callAuthenticate(const QUuid &clientUuid, const QString &clientName, const QString &token, const QString &nonce);
+    JsonReply *callAuthenticate(const QUuid &clientUuid, const QString &clientName, const QString &token, const QString &nonce, bool multiplex = false, bool standby = false, const QString &sessionTicket = QString());
+    JsonReply *callConnect(const QUuid &clientUuid, const QString &clientName, const QString &token, const QString &nonce, bool multiplex = false, bool standby = false, const QString &sessionTicket = QString());
+    JsonReply *callResume(const QString &resumptionTicket);
 
 private:
     ProxyConnection *m_connection = nullptr;
@@ -60,7 +63,9 @@ private:
     void sendRequest(const QVariantMap &request);
 
 signals:
-    void tunnelEstablished(const QString clientName, const QString &clientUuid);
+    void tunnelEstablished(const QString clientName, const QString &clientUuid, const QString &resumptionTicket);
+    void standbyConsumed(int standbyCount);
+    void redirected(const QUrl &url);
 
 public slots:
     void processData(const QByteArray &data);
@@ -30,17 +30,26 @@
 #include "websocketconnection.h"
 #include "remoteproxyconnection.h"
 
+#include <QJsonDocument>
+#include <QVersionNumber>
+
 Q_LOGGING_CATEGORY(dcRemoteProxyClientConnection, "RemoteProxyClientConnection")
 Q_LOGGING_CATEGORY(dcRemoteProxyClientConnectionTraffic, "RemoteProxyClientConnectionTraffic")
 
 namespace remoteproxyclient {
 
+QHash<QString, QString> RemoteProxyConnection::s_serverApiVersions;
+QHash<QString, QString> RemoteProxyConnection::s_sessionTickets;
+
 RemoteProxyConnection::RemoteProxyConnection(const QUuid &clientUuid, const QString &clientName, QObject *parent) :
     QObject(parent),
     m_clientUuid(clientUuid),
     m_clientName(clientName)
 {
-
+    // Give up resuming a lost tunnel after this time
+    m_resumptionTimer.setSingleShot(true);
+    m_resumptionTimer.setInterval(10000);
+    connect(&m_resumptionTimer, &QTimer::timeout, this, &RemoteProxyConnection::stopResumption);
 }
 
 RemoteProxyConnection::~RemoteProxyConnection()
@@ -60,11 +69,14 @@ QAbstractSocket::SocketError RemoteProxyConnection::error() const
 
 void RemoteProxyConnection::ignoreSslErrors()
 {
+    // Remember the decision for the connections created on resumption and redirects
+    m_ignoreAllSslErrors = true;
     m_connection->ignoreSslErrors();
 }
 
 void RemoteProxyConnection::ignoreSslErrors(const QList<QSslError> &errors)
 {
+    m_ignoredSslErrors = errors;
     m_connection->ignoreSslErrors(errors);
 }
 
@@ -128,6 +140,154 @@ QString RemoteProxyConnection::tunnelPartnerUuid() const
     return m_tunnelPartnerUuid;
 }
 
+bool RemoteProxyConnection::isMultiplexed() const
+{
+    return m_multiplexed;
+}
+
+bool RemoteProxyConnection::isStandby() const
+{
+    return m_standby;
+}
+
+void RemoteProxyConnection::processMultiplexedData(const QByteArray &data)
+{
+    // Frame format: <channel>:<payload>
+    int separator = data.indexOf(':');
+    bool valid = false;
+    quint32 channelId = data.left(separator).toUInt(&valid);
+    if (separator < 0 || !valid) {
+        qCWarning(dcRemoteProxyClientConnection()) << "Invalid multiplexed frame received" << data;
+        return;
+    }
+
+    QByteArray payload = data.mid(separator + 1);
+    if (channelId != 0) {
+        emit channelDataReady(channelId, payload);
+        return;
+    }
+
+    // Channel 0 carries the control messages
+    QVariantMap message = QJsonDocument::fromJson(payload).toVariant().toMap();
+    QString event = message.value("event").toString();
+    if (event == "ChannelOpened") {
+        qCDebug(dcRemoteProxyClientConnection()) << "Channel opened" << message.value("channel").toUInt() << message.value("name").toString();
+        emit channelOpened(message.value("channel").toUInt(), message.value("name").toString(), message.value("uuid").toString());
+    } else if (event == "ChannelClosed") {
+        qCDebug(dcRemoteProxyClientConnection()) << "Channel closed" << message.value("channel").toUInt();
+        emit channelClosed(message.value("channel").toUInt());
+    } else {
+        qCWarning(dcRemoteProxyClientConnection()) << "Unhandled control message" << payload;
+    }
+}
+
+bool RemoteProxyConnection::serverSupportsConnect() const
+{
+    // Authentication.Connect is available since API version 0.4
+    QString apiVersion = s_serverApiVersions.value(m_serverUrl.toString());
+    if (apiVersion.isEmpty())
+        return false;
+
+    return QVersionNumber::fromString(apiVersion) >= QVersionNumber(0, 4);
+}
+
+void RemoteProxyConnection::setServerInformation(const QVariantMap &serverInformation)
+{
+    m_serverName = serverInformation.value("server").toString();
+    m_proxyServerName = serverInformation.value("name").toString();
+    m_proxyServerVersion = serverInformation.value("version").toString();
+    m_proxyServerApiVersion = serverInformation.value("apiVersion").toString();
+
+    s_serverApiVersions.insert(m_serverUrl.toString(), m_proxyServerApiVersion);
+}
+
+void RemoteProxyConnection::startResumption()
+{
+    qCDebug(dcRemoteProxyClientConnection()) << "Connection lost. Trying to resume the tunnel.";
+    m_resuming = true;
+    m_resumptionTimer.start();
+
+    m_connection->disconnect(this);
+    m_connection->deleteLater();
+    m_jsonClient->deleteLater();
+
+    createConnection();
+    m_connection->connectServer(m_serverUrl);
+}
+
+void RemoteProxyConnection::stopResumption()
+{
+    if (!m_resuming)
+        return;
+
+    qCWarning(dcRemoteProxyClientConnection()) << "Could not resume the tunnel.";
+    m_resumptionTicket = QString();
+    cleanUp();
+}
+
+void RemoteProxyConnection::startRedirect()
+{
+    qCDebug(dcRemoteProxyClientConnection()) << "Following redirect to" << m_redirectUrl.toString();
+    m_redirecting = true;
+    m_redirectCount++;
+
+    m_connection->disconnect(this);
+    m_connection->deleteLater();
+    m_jsonClient->deleteLater();
+
+    m_serverUrl = m_redirectUrl;
+    m_redirectUrl = QUrl();
+    m_serverName = QString();
+    m_proxyServerName = QString();
+    m_proxyServerVersion = QString();
+    m_proxyServerApiVersion = QString();
+
+    createConnection();
+    m_connection->connectServer(m_serverUrl);
+}
+
+void RemoteProxyConnection::sendAuthenticationRequest()
+{
+    QString sessionTicket = s_sessionTickets.value(m_token);
+    JsonReply *reply = nullptr;
+    if (m_proxyServerApiVersion.isEmpty()) {
+        reply = m_jsonClient->callConnect(m_clientUuid, m_clientName, m_token, m_nonce, m_multiplexed, m_standby, sessionTicket);
+    } else {
+        reply = m_jsonClient->callAuthenticate(m_clientUuid, m_clientName, m_token, m_nonce, m_multiplexed, m_standby, sessionTicket);
+    }
+    connect(reply, &JsonReply::finished, this, &RemoteProxyConnection::onAuthenticateFinished);
+}
+
+void RemoteProxyConnection::createConnection()
+{
+    switch (m_connectionType) {
+    case ConnectionTypeWebSocket:
+        m_connection = qobject_cast<ProxyConnection *>(new WebSocketConnection(this));
+        break;
+    case ConnectionTypeTcpSocket:
+        // FIXME:
+        //m_connection = qobject_cast<ProxyConnection *>(new WebSocketConnection(this));
+        break;
+    }
+
+    connect(m_connection, &ProxyConnection::connectedChanged, this, &RemoteProxyConnection::onConnectionChanged);
+    connect(m_connection, &ProxyConnection::dataReceived, this, &RemoteProxyConnection::onConnectionDataAvailable);
+    connect(m_connection, &ProxyConnection::errorOccured, this, &RemoteProxyConnection::onConnectionSocketError);
+    connect(m_connection, &ProxyConnection::stateChanged, this, &RemoteProxyConnection::onConnectionStateChanged);
+    connect(m_connection, &ProxyConnection::sslErrors, this, &RemoteProxyConnection::sslErrors);
+
+    if (m_ignoreAllSslErrors) {
+        m_connection->ignoreSslErrors();
+    } else if (!m_ignoredSslErrors.isEmpty()) {
+        m_connection->ignoreSslErrors(m_ignoredSslErrors);
+    }
+
+    m_jsonClient = new JsonRpcClient(m_connection, this);
+    connect(m_jsonClient, &JsonRpcClient::tunnelEstablished, this, &RemoteProxyConnection::onTunnelEstablished);
+    connect(m_jsonClient, &JsonRpcClient::standbyConsumed, this, &RemoteProxyConnection::standbyConsumed);
+    connect(m_jsonClient, &JsonRpcClient::redirected, this, &RemoteProxyConnection::onRedirected);
+}
+
 void RemoteProxyConnection::cleanUp()
 {
     if (m_jsonClient) {
@@ -144,6 +304,14 @@ void RemoteProxyConnection::cleanUp()
     m_proxyServerName = QString();
     m_proxyServerVersion = QString();
     m_proxyServerApiVersion = QString();
+    m_multiplexed = false;
+    m_standby = false;
+    m_resumptionTicket = QString();
+    m_resuming = false;
+    m_resumptionTimer.stop();
+    m_resumptionData.clear();
+    m_redirectUrl = QUrl();
+    m_redirecting = false;
 
     setState(StateDisconnected);
 }
@@ -188,13 +356,49 @@ void RemoteProxyConnection::setError(QAbstractSocket::SocketError error)
 
 void RemoteProxyConnection::onConnectionChanged(bool isConnected)
 {
+    if (isConnected && m_resuming) {
+        qCDebug(dcRemoteProxyClientConnection()) << "Connected to proxy server. Resuming the tunnel.";
+        JsonReply *reply = m_jsonClient->callResume(m_resumptionTicket);
+        connect(reply, &JsonReply::finished, this, &RemoteProxyConnection::onResumeFinished);
+        return;
+    }
+
+    // The user of this connection is still authenticating
+    if (m_redirecting) {
+        if (!isConnected) {
+            qCWarning(dcRemoteProxyClientConnection()) << "Could not connect to the redirected server" << m_serverUrl.toString();
+            cleanUp();
+            return;
+        }
+
+        qCDebug(dcRemoteProxyClientConnection()) << "Connected to redirected proxy server. Authenticating again.";
+        if (serverSupportsConnect()) {
+            sendAuthenticationRequest();
+        } else {
+            JsonReply *reply = m_jsonClient->callHello();
+            connect(reply, &JsonReply::finished, this, &RemoteProxyConnection::onHelloFinished);
+        }
+        return;
+    }
+
     if (isConnected) {
         qCDebug(dcRemoteProxyClientConnection()) << "Connected to proxy server.";
         setState(StateConnected);
 
+        // The server information will be delivered with the authentication response
+        if (serverSupportsConnect()) {
+            qCDebug(dcRemoteProxyClientConnection()) << "The server supports Authentication.Connect. Skipping the Hello call.";
+            setState(StateReady);
+            return;
+        }
+
         setState(StateInitializing);
         JsonReply *reply = m_jsonClient->callHello();
         connect(reply, &JsonReply::finished, this, &RemoteProxyConnection::onHelloFinished);
+    } else if (m_resuming) {
+        stopResumption();
+    } else if (m_state == StateRemoteConnected && !m_resumptionTicket.isEmpty()) {
+        startResumption();
     } else {
         qCDebug(dcRemoteProxyClientConnection()) << "Disconnected from proxy server.";
         setState(StateDisconnected);
@@ -204,6 +408,11 @@ void RemoteProxyConnection::onConnectionChanged(bool isConnected)
 
 void RemoteProxyConnection::onConnectionDataAvailable(const QByteArray &data)
 {
+    if (m_resuming) {
+        m_jsonClient->processData(data);
+        return;
+    }
+
     switch (m_state) {
     case StateHostLookup:
     case StateConnecting:
@@ -211,9 +420,15 @@ void RemoteProxyConnection::onConnectionDataAvailable(const QByteArray &data)
     case StateInitializing:
     case StateReady:
     case StateAuthenticating:
-    case StateAuthenticated:
         m_jsonClient->processData(data);
         break;
+    case StateAuthenticated:
+        if (m_multiplexed) {
+            processMultiplexedData(data);
+        } else {
+            m_jsonClient->processData(data);
+        }
+        break;
     case StateRemoteConnected:
         // Remote data arrived
         emit dataReady(data);
@@ -226,11 +441,20 @@ void RemoteProxyConnection::onConnectionDataAvailable(const QByteArray &data)
 
 void RemoteProxyConnection::onConnectionSocketError(QAbstractSocket::SocketError error)
 {
+    if (m_resuming) {
+        stopResumption();
+        return;
+    }
+
     setError(error);
 }
 
 void RemoteProxyConnection::onConnectionStateChanged(QAbstractSocket::SocketState state)
 {
+    // The tunnel stays up for the user of this connection while it can be resumed
+    if (m_resuming || m_redirecting || (m_state == StateRemoteConnected && !m_resumptionTicket.isEmpty()))
+        return;
+
     switch (state) {
     case QAbstractSocket::UnconnectedState:
         setState(StateDisconnected);
@@ -267,14 +491,11 @@ void RemoteProxyConnection::onHelloFinished()
         return;
     }
 
-    QVariantMap responseParams = response.value("params").toMap();
-
-    // TODO: verify success
-
-    m_serverName = responseParams.value("server").toString();
-    m_proxyServerName = responseParams.value("name").toString();
-    m_proxyServerVersion = responseParams.value("version").toString();
-    m_proxyServerApiVersion = responseParams.value("apiVersion").toString();
+    setServerInformation(response.value("params").toMap());
+    if (m_redirecting) {
+        sendAuthenticationRequest();
+        return;
+    }
 
     setState(StateReady);
 }
@@ -287,26 +508,88 @@ void RemoteProxyConnection::onAuthenticateFinished()
     QVariantMap response = reply->response();
     qCDebug(dcRemoteProxyClientConnectionTraffic()) << "Authentication response ready" << reply->commandId() << response;
 
+    if (reply->method() == "Connect") {
+        if (response.value("status").toString() != "success") {
+            // The server does not know the method any more, use Hello next time
+            qCWarning(dcRemoteProxyClientConnection()) << "Combined connect request failed" << response.value("error").toString();
+            s_serverApiVersions.remove(m_serverUrl.toString());
+        } else {
+            setServerInformation(response.value("params").toMap());
+        }
+    }
+
     QVariantMap responseParams = response.value("params").toMap();
+    m_redirecting = false;
+    if (responseParams.value("authenticationError").toString() == "AuthenticationErrorRedirected" && m_redirectUrl.isValid()) {
+        if (m_redirectCount < 3) {
+            startRedirect();
+            return;
+        }
+
+        qCWarning(dcRemoteProxyClientConnection()) << "Too many redirects. Giving up.";
+    }
+
     if (responseParams.value("authenticationError").toString() != "AuthenticationErrorNoError") {
         qCWarning(dcRemoteProxyClientConnection()) << "Authentication request finished with error" << responseParams.value("authenticationError").toString();
+        s_sessionTickets.remove(m_token);
         setError(QAbstractSocket::ProxyConnectionRefusedError);
         m_connection->disconnectServer();
     } else {
         qCDebug(dcRemoteProxyClientConnection()) << "Successfully authenticated.";
+        if (responseParams.contains("sessionTicket"))
+            s_sessionTickets.insert(m_token, responseParams.value("sessionTicket").toString());
+
         setState(StateAuthenticated);
         emit authenticated();
     }
 }
 
-void RemoteProxyConnection::onTunnelEstablished(const QString &clientName, const QString &clientUuid)
+void RemoteProxyConnection::onTunnelEstablished(const QString &clientName, const QString &clientUuid, const QString &resumptionTicket)
 {
     qCDebug(dcRemoteProxyClientConnection()) << "Remote connection established successfully with" << clientName << clientUuid;
     m_tunnelPartnerName = clientName;
     m_tunnelPartnerUuid = clientUuid;
+    m_resumptionTicket = resumptionTicket;
     setState(StateRemoteConnected);
 }
 
+void RemoteProxyConnection::onResumeFinished()
+{
+    JsonReply *reply = static_cast<JsonReply *>(sender());
+    reply->deleteLater();
+
+    QVariantMap response = reply->response();
+    qCDebug(dcRemoteProxyClientConnectionTraffic()) << "Resume response ready" << reply->commandId() << response;
+
+    if (response.value("params").toMap().value("authenticationError").toString() != "AuthenticationErrorNoError") {
+        qCWarning(dcRemoteProxyClientConnection()) << "The server refused to resume the tunnel" << response;
+        stopResumption();
+        return;
+    }
+
+    qCDebug(dcRemoteProxyClientConnection()) << "Tunnel resumed successfully.";
+    m_resuming = false;
+    m_resumptionTimer.stop();
+
+    foreach (const QByteArray &data, m_resumptionData) {
+        m_connection->sendData(data);
+    }
+    m_resumptionData.clear();
+}
+
+void RemoteProxyConnection::onRedirected(const QUrl &url)
+{
+    // Never follow a redirect to a weaker transport than the one in use
+    if (url.scheme() != "wss" || url.scheme() != m_serverUrl.scheme() || url.host().isEmpty()) {
+        qCWarning(dcRemoteProxyClientConnection()) << "The server redirects this connection to an invalid url" << url.toString() << "Ignoring the redirect.";
+        m_redirectUrl = QUrl();
+        return;
+    }
+
+    qCDebug(dcRemoteProxyClientConnection()) << "The server redirects this connection to" << url.toString();
+    m_redirectUrl = url;
+}
+
 bool RemoteProxyConnection::connectServer(const QUrl &url)
 {
     if (url.scheme() != "wss") {
@@ -318,27 +601,11 @@ bool RemoteProxyConnection::connectServer(const QUrl &url)
     m_serverUrl = url;
     m_connectionType = ConnectionTypeWebSocket;
     m_error = QAbstractSocket::UnknownSocketError;
+    m_ignoreAllSslErrors = false;
+    m_ignoredSslErrors.clear();
 
     cleanUp();
-
-    switch (m_connectionType) {
-    case ConnectionTypeWebSocket:
-        m_connection = qobject_cast<ProxyConnection *>(new WebSocketConnection(this));
-        break;
-    case ConnectionTypeTcpSocket:
-        // FIXME:
-        //m_connection = qobject_cast<ProxyConnection *>(new WebSocketConnection(this));
-        break;
-    }
-
-    connect(m_connection, &ProxyConnection::connectedChanged, this, &RemoteProxyConnection::onConnectionChanged);
-    connect(m_connection, &ProxyConnection::dataReceived, this, &RemoteProxyConnection::onConnectionDataAvailable);
-    connect(m_connection, &ProxyConnection::errorOccured, this, &RemoteProxyConnection::onConnectionSocketError);
-    connect(m_connection, &ProxyConnection::stateChanged, this, &RemoteProxyConnection::onConnectionStateChanged);
-    connect(m_connection, &ProxyConnection::sslErrors, this, &RemoteProxyConnection::sslErrors);
-
-    m_jsonClient = new JsonRpcClient(m_connection, this);
-    connect(m_jsonClient, &JsonRpcClient::tunnelEstablished, this, &RemoteProxyConnection::onTunnelEstablished);
+    createConnection();
 
     qCDebug(dcRemoteProxyClientConnection()) << "Connecting to" << m_serverUrl.toString();
     m_connection->connectServer(m_serverUrl);
@@ -354,15 +621,48 @@ bool RemoteProxyConnection::authenticate(const QString &token, const QString &no
     }
 
     setState(StateAuthenticating);
+    m_token = token;
+    m_nonce = nonce;
+    m_redirectCount = 0;
 
     qCDebug(dcRemoteProxyClientConnection()) << "Start authentication using token" << token << nonce;
-    JsonReply *reply = m_jsonClient->callAuthenticate(m_clientUuid, m_clientName, token, nonce);
-    connect(reply, &JsonReply::finished, this, &RemoteProxyConnection::onAuthenticateFinished);
+    sendAuthenticationRequest();
+    return true;
+}
+
+bool RemoteProxyConnection::authenticateMultiplexed(const QString &token)
+{
+    // All clients authenticating with this token will show up as channels of this connection
+    m_multiplexed = true;
+    if (!authenticate(token)) {
+        m_multiplexed = false;
+        return false;
+    }
+
+    return true;
+}
+
+bool RemoteProxyConnection::authenticateStandby(const QString &token)
+{
+    // This connection waits on the server for the next client authenticating with this token
+    m_standby = true;
+    if (!authenticate(token)) {
+        m_standby = false;
+        return false;
+    }
+
     return true;
 }
 
 void RemoteProxyConnection::disconnectServer()
 {
+    // A disconnect on purpose must not resume the tunnel
+    m_resumptionTicket = QString();
+    if (m_resuming) {
+        stopResumption();
+        return;
+    }
+
     if (m_connection) {
         qCDebug(dcRemoteProxyClientConnection()) << "Disconnecting from" << m_connection->serverUrl().toString();
         m_connection->disconnectServer();
@@ -381,9 +681,40 @@ bool RemoteProxyConnection::sendData(const QByteArray &data)
         return false;
     }
 
+    // Send the data once the tunnel has been resumed
+    if (m_resuming) {
+        m_resumptionData.append(data);
+        return true;
+    }
+
     m_connection->sendData(data);
     return true;
 }
 
+bool RemoteProxyConnection::sendChannelData(quint32 channelId, const QByteArray &data)
+{
+    if (!m_multiplexed || !isAuthenticated() || channelId == 0) {
+        qCWarning(dcRemoteProxyClientConnection()) << "Could not send channel data. This is not an authenticated multiplexed connection.";
+        return false;
+    }
+
+    m_connection->sendData(QByteArray::number(channelId) + ':' + data);
+    return true;
+}
+
+bool RemoteProxyConnection::closeChannel(quint32 channelId)
+{
+    if (!m_multiplexed || !isAuthenticated()) {
+        qCWarning(dcRemoteProxyClientConnection()) << "Could not close channel. This is not an authenticated multiplexed connection.";
+        return false;
+    }
+
+    QVariantMap message;
+    message.insert("command", "CloseChannel");
+    message.insert("channel", channelId);
+    m_connection->sendData("0:" + QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact));
+    return true;
+}
+
 
 }
@@ -30,6 +30,7 @@
 
 #include <QUuid>
 #include <QDebug>
+#include <QTimer>
 #include <QObject>
 #include <QHostInfo>
 #include <QWebSocket>
@@ -93,6 +94,9 @@ public:
     QString tunnelPartnerName() const;
     QString tunnelPartnerUuid() const;
 
+    bool isMultiplexed() const;
+    bool isStandby() const;
+
 private:
     ConnectionType m_connectionType = ConnectionTypeWebSocket;
     QUuid m_clientUuid;
@@ -104,6 +108,8 @@ private:
     QAbstractSocket::SocketError m_error = QAbstractSocket::UnknownSocketError;
 
     bool m_insecureConnection = false;
+    bool m_ignoreAllSslErrors = false;
+    QList<QSslError> m_ignoredSslErrors;
     bool m_remoteConnected = false;
 
     JsonRpcClient *m_jsonClient = nullptr;
@@ -119,6 +125,44 @@ private:
     QString m_tunnelPartnerName;
     QString m_tunnelPartnerUuid;
 
+    // Multiplexing
+    bool m_multiplexed = false;
+
+    // Standby
+    bool m_standby = false;
+
+    // Tunnel resumption
+    QString m_resumptionTicket;
+    bool m_resuming = false;
+    QTimer m_resumptionTimer;
+    QList<QByteArray> m_resumptionData;
+
+    void startResumption();
+    void stopResumption();
+
+    void processMultiplexedData(const QByteArray &data);
+
+    // Redirects to the cluster node owning the tunnel
+    QUrl m_redirectUrl;
+    bool m_redirecting = false;
+    int m_redirectCount = 0;
+
+    void startRedirect();
+
+    // API versions of the servers this process talked to already
+    static QHash<QString, QString> s_serverApiVersions;
+
+    // Token, session ticket for skipping the token verification next time
+    static QHash<QString, QString> s_sessionTickets;
+    QString m_token;
+    QString m_nonce;
+
+    void sendAuthenticationRequest();
+
+    bool serverSupportsConnect() const;
+    void setServerInformation(const QVariantMap &serverInformation);
+
+    void createConnection();
     void cleanUp();
 
     void setState(State state);
@@ -137,6 +181,12 @@ signals:
 
     void dataReady(const QByteArray &data);
 
+    void standbyConsumed(int standbyCount);
+
+    void channelOpened(quint32 channelId, const QString &clientName, const QString &clientUuid);
+    void channelClosed(quint32 channelId);
+    void channelDataReady(quint32 channelId, const QByteArray &data);
+
 private slots:
     void onConnectionChanged(bool isConnected);
     void onConnectionDataAvailable(const QByteArray &data);
@@ -145,13 +195,20 @@ private slots:
 
     void onHelloFinished();
     void onAuthenticateFinished();
-    void onTunnelEstablished(const QString &clientName, const QString &clientUuid);
+    void onTunnelEstablished(const QString &clientName, const QString &clientUuid, const QString &resumptionTicket);
+    void onResumeFinished();
+    void onRedirected(const QUrl &url);
 
 public slots:
     bool connectServer(const QUrl &url);
     bool authenticate(const QString &token, const QString &nonce = QString());
+    bool authenticateMultiplexed(const QString &token);
+    bool authenticateStandby(const QString &token);
     void disconnectServer();
     bool sendData(const QByteArray &data);
+
+    bool sendChannelData(quint32 channelId, const QByteArray &data);
+    bool closeChannel(quint32 channelId);
 };
 
 }
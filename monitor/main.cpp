@@ -57,6 +57,14 @@ int main(int argc, char *argv[])
     QCommandLineOption socketOption(QStringList() << "s" << "socket", "The socket descriptor for the nymea-remoteproxy monitor socket. Default is /tmp/nymea-remoteproxy-monitor.sock", "socket");
     socketOption.setDefaultValue("/tmp/nymea-remoteproxy-monitor.sock");
     parser.addOption(socketOption);
+
+    QCommandLineOption drainOption(QStringList() << "drain", "Take the server out of rotation. The server stops accepting new connections "
+                                                             "and tunnels, and closes the remaining tunnels once the drain timeout expired.");
+    parser.addOption(drainOption);
+
+    QCommandLineOption reloadOption(QStringList() << "reload", "Reload the configuration and certificates of the server. "
+                                                               "Established tunnels stay connected, new connections use the new configuration.");
+    parser.addOption(reloadOption);
     parser.process(application);
 
     // Check socket file
@@ -71,7 +79,14 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
-    Monitor monitor(parser.value(socketOption));
+    QString command;
+    if (parser.isSet(drainOption)) {
+        command = "drain";
+    } else if (parser.isSet(reloadOption)) {
+        command = "reload";
+    }
+
+    Monitor monitor(parser.value(socketOption), command);
 
     return application.exec();
 }
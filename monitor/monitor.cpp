@@ -27,7 +27,9 @@
 
 #include "monitor.h"
 
-Monitor::Monitor(const QString &serverName, QObject *parent) : QObject(parent)
+Monitor::Monitor(const QString &serverName, const QString &command, QObject *parent) :
+    QObject(parent),
+    m_command(command)
 {
     m_monitorClient = new MonitorClient(serverName, this);
     connect(m_monitorClient, &MonitorClient::connected, this, &Monitor::onConnected);
@@ -38,12 +40,47 @@ Monitor::Monitor(const QString &serverName, QObject *parent) : QObject(parent)
 
 void Monitor::onConnected()
 {
+    // Send the command and wait for the result instead of showing the live data
+    if (!m_command.isEmpty()) {
+        connect(m_monitorClient, &MonitorClient::dataReady, this, &Monitor::onCommandDataReady);
+        m_monitorClient->sendCommand(m_command);
+        return;
+    }
+
     m_terminal = new TerminalWindow(this);
     connect(m_monitorClient, &MonitorClient::dataReady, m_terminal, &TerminalWindow::refreshWindow);
 }
 
+void Monitor::onCommandDataReady(const QVariantMap &data)
+{
+    // Skip the live data sent meanwhile
+    if (data.value("command").toString() != m_command)
+        return;
+
+    if (!data.value("success").toBool()) {
+        qWarning() << "Command" << m_command << "failed:" << data.value("error").toString();
+        exit(1);
+    }
+
+    if (data.contains("reload")) {
+        QVariantMap reloadStatistics = data.value("reload").toMap();
+        qDebug() << "Configuration reloaded in" << reloadStatistics.value("duration").toInt() << "ms";
+        if (!reloadStatistics.value("restartRequired").toStringList().isEmpty()) {
+            qWarning() << "Changed settings which require a restart:" << reloadStatistics.value("restartRequired").toStringList().join(", ");
+        }
+    }
+
+    qDebug() << "Command" << m_command << "finished successfully.";
+    exit(0);
+}
+
 void Monitor::onDisconnected()
 {
+    if (!m_command.isEmpty()) {
+        qWarning() << "Monitor disconnected before the command" << m_command << "finished.";
+        exit(1);
+    }
+
     if (!m_terminal)
         return;
 
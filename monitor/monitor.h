@@ -37,15 +37,17 @@ class Monitor : public QObject
 {
     Q_OBJECT
 public:
-    explicit Monitor(const QString &serverName, QObject *parent = nullptr);
+    explicit Monitor(const QString &serverName, const QString &command = QString(), QObject *parent = nullptr);
 
 private:
     TerminalWindow *m_terminal = nullptr;
     MonitorClient *m_monitorClient = nullptr;
+    QString m_command;
 
 private slots:
     void onConnected();
     void onDisconnected();
+    void onCommandDataReady(const QVariantMap &data);
 
 };
 
@@ -55,20 +55,28 @@ void MonitorClient::onDisconnected()
 
 void MonitorClient::onReadyRead()
 {
-    QByteArray data = m_socket->readAll();
+    m_buffer.append(m_socket->readAll());
 
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
+    // The server sends one JSON object per line
+    int index = m_buffer.indexOf('\n');
+    while (index >= 0) {
+        QByteArray data = m_buffer.left(index);
+        m_buffer.remove(0, index + 1);
+        index = m_buffer.indexOf('\n');
 
-    if(error.error != QJsonParseError::NoError) {
-        qWarning() << "Failed to parse JSON data" << data << ":" << error.errorString();
-        return;
-    }
+        QJsonParseError error;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
+
+        if(error.error != QJsonParseError::NoError) {
+            qWarning() << "Failed to parse JSON data" << data << ":" << error.errorString();
+            continue;
+        }
 
-    //qDebug() << qUtf8Printable(jsonDoc.toJson(QJsonDocument::Indented));
+        //qDebug() << qUtf8Printable(jsonDoc.toJson(QJsonDocument::Indented));
 
-    QVariantMap dataMap = jsonDoc.toVariant().toMap();
-    emit dataReady(dataMap);
+        QVariantMap dataMap = jsonDoc.toVariant().toMap();
+        emit dataReady(dataMap);
+    }
 }
 
 void MonitorClient::onErrorOccured(QLocalSocket::LocalSocketError socketError)
@@ -79,10 +87,18 @@ void MonitorClient::onErrorOccured(QLocalSocket::LocalSocketError socketError)
 
 void MonitorClient::connectMonitor()
 {    
-    m_socket->connectToServer(m_serverName, QLocalSocket::ReadOnly);
+    m_socket->connectToServer(m_serverName, QLocalSocket::ReadWrite);
 }
 
 void MonitorClient::disconnectMonitor()
 {
     m_socket->close();
 }
+
+void MonitorClient::sendCommand(const QString &command)
+{
+    QVariantMap request;
+    request.insert("command", command);
+    m_socket->write(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact) + '\n');
+    m_socket->flush();
+}
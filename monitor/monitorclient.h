@@ -42,6 +42,7 @@ public:
 private:
     QString m_serverName;
     QLocalSocket *m_socket = nullptr;
+    QByteArray m_buffer;
 
 signals:
     void connected();
@@ -57,6 +58,7 @@ private slots:
 public slots:
     void connectMonitor();
     void disconnectMonitor();
+    void sendCommand(const QString &command);
 
 };
 
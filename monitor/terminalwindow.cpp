@@ -168,7 +168,7 @@ void TerminalWindow::drawWindowBorder(WINDOW *window)
 
 void TerminalWindow::paintHeader()
 {
-    QString headerString = QString(" Server: %1 (%2) | API: %3 | Clients: %4, %5 | Tunnels: %6, %7 | %8 | %9 | %10")
+    QString headerString = QString(" Server: %1 (%2) | API: %3 | Clients: %4, %5 | Tunnels: %6, %7 | Standby: %8 (%9 %) | %10 | %11 | %12")
             .arg(m_dataMap.value("serverName", "-").toString())
             .arg(m_dataMap.value("serverVersion", "-").toString())
             .arg(m_dataMap.value("apiVersion", "-").toString())
@@ -176,6 +176,8 @@ void TerminalWindow::paintHeader()
             .arg(m_dataMap.value("proxyStatistic").toMap().value("total").toMap().value("totalClientCount").toInt())
             .arg(m_dataMap.value("proxyStatistic").toMap().value("tunnelCount", 0).toInt())
             .arg(m_dataMap.value("proxyStatistic").toMap().value("total").toMap().value("totalTunnelCount").toInt())
+            .arg(m_dataMap.value("proxyStatistic").toMap().value("standbyCount", 0).toInt())
+            .arg(m_dataMap.value("proxyStatistic").toMap().value("standbyHitRate", 0).toDouble(), 0, 'f', 1)
             .arg(humanReadableTraffic(m_dataMap.value("proxyStatistic").toMap().value("troughput", 0).toInt()) + " / s", - 13)
             .arg(humanReadableTraffic(m_dataMap.value("proxyStatistic").toMap().value("total").toMap().value("totalTraffic").toInt()), - 10)
             .arg((m_view == ViewClients ? "-- Clients --" : "-- Tunnels --"));
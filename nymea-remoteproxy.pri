@@ -4,7 +4,7 @@ QT -= gui
 # Define versions
 SERVER_NAME=nymea-remoteproxy
 API_VERSION_MAJOR=0
-API_VERSION_MINOR=3
+API_VERSION_MINOR=4
 SERVER_VERSION=0.1.7
 
 DEFINES += SERVER_NAME_STRING=\\\"$${SERVER_NAME}\\\" \
@@ -1,7 +1,7 @@
 include(nymea-remoteproxy.pri)
 
 TEMPLATE=subdirs
-SUBDIRS += server client libnymea-remoteproxy libnymea-remoteproxyclient 
+SUBDIRS += server client tokendb libnymea-remoteproxy libnymea-remoteproxyclient 
 
 !disabletests {
     SUBDIRS+=tests
@@ -13,6 +13,7 @@ SUBDIRS += server client libnymea-remoteproxy libnymea-remoteproxyclient
 
 server.depends = libnymea-remoteproxy
 client.depends = libnymea-remoteproxyclient
+tokendb.depends = libnymea-remoteproxy
 tests.depends = libnymea-remoteproxy libnymea-remoteproxyclient
 
 message("----------------------------------------------------------")
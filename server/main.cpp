@@ -48,8 +48,11 @@
 #include "loggingcategories.h"
 #include "proxyconfiguration.h"
 #include "remoteproxyserverapplication.h"
+#include "cluster/clustercoordinator.h"
+#include "cluster/clusterauthentication.h"
 #include "authentication/aws/awsauthenticator.h"
 #include "authentication/dummy/dummyauthenticator.h"
+#include "authentication/tokendatabase/tokendatabaseauthenticator.h"
 
 using namespace remoteproxy;
 
@@ -127,6 +130,9 @@ int main(int argc, char *argv[])
     s_loggingFilters.insert("ProxyServer", true);
     s_loggingFilters.insert("MonitorServer", true);
     s_loggingFilters.insert("AwsCredentialsProvider", true);
+    s_loggingFilters.insert("TokenDatabase", true);
+    s_loggingFilters.insert("Cluster", true);
+    s_loggingFilters.insert("Handover", true);
 
     // Only with verbose enabled
     s_loggingFilters.insert("JsonRpcTraffic", false);
@@ -134,6 +140,7 @@ int main(int argc, char *argv[])
     s_loggingFilters.insert("AuthenticationProcess", false);
     s_loggingFilters.insert("WebSocketServerTraffic", false);
     s_loggingFilters.insert("AwsCredentialsProviderTraffic", false);
+    s_loggingFilters.insert("ClusterTraffic", false);
 
     QString configFile = "/etc/nymea/nymea-remoteproxy.conf";
 
@@ -161,6 +168,10 @@ int main(int argc, char *argv[])
     QCommandLineOption mockAuthenticatorOption(QStringList() << "m" << "mock-authenticator", "Start the server using a mock authenticator which returns always true.");
     parser.addOption(mockAuthenticatorOption);
 
+    QCommandLineOption tokenDatabaseOption(QStringList() << "t" << "token-database", "Start the server using the token database authenticator with the given "
+                                                                                    "database file. The file can be created using nymea-remoteproxy-tokendb.", "database");
+    parser.addOption(tokenDatabaseOption);
+
     QCommandLineOption configOption(QStringList() << "c" <<"configuration", "The path to the proxy server configuration file. The default is " + configFile, "configuration");
     configOption.setDefaultValue(configFile);
     parser.addOption(configOption);
@@ -168,8 +179,46 @@ int main(int argc, char *argv[])
     QCommandLineOption verboseOption(QStringList() << "verbose", "Print more verbose.");
     parser.addOption(verboseOption);
 
+    QCommandLineOption coordinatorOption(QStringList() << "cluster-coordinator", "Run only the cluster rendezvous coordinator on the given url, "
+                                                                                 "unix:<path> or tcp://<host>:<port>.", "url");
+    parser.addOption(coordinatorOption);
+
+    QCommandLineOption clusterSecretOption(QStringList() << "cluster-secret-file", "The file containing the secret shared by the cluster coordinator "
+                                                                                   "and all nodes. Required for running the cluster coordinator.", "file");
+    parser.addOption(clusterSecretOption);
+
+    QCommandLineOption takeoverOption(QStringList() << "takeover", "Take over the listening socket from the server process running with the same "
+                                                                   "handover socket. The old process keeps serving its tunnels until they are closed.");
+    parser.addOption(takeoverOption);
+
     parser.process(application);
 
+    // The coordinator runs as separate process and needs no proxy configuration
+    if (parser.isSet(coordinatorOption)) {
+        if (parser.isSet(verboseOption))
+            s_loggingFilters["ClusterTraffic"] = true;
+
+        QLoggingCategory::installFilter(loggingCategoryFilter);
+
+        // Only nodes knowing the secret may join the cluster
+        QByteArray clusterSecret;
+        if (parser.isSet(clusterSecretOption))
+            clusterSecret = ClusterAuthentication::loadSecret(parser.value(clusterSecretOption));
+
+        if (clusterSecret.isEmpty()) {
+            qCCritical(dcApplication()) << "The cluster coordinator requires a secret. Pass a secret file using --cluster-secret-file.";
+            exit(-1);
+        }
+
+        ClusterCoordinator *coordinator = new ClusterCoordinator(QUrl(parser.value(coordinatorOption)), clusterSecret, &application);
+        if (!coordinator->startServer()) {
+            qCCritical(dcApplication()) << "Could not start the cluster coordinator on" << parser.value(coordinatorOption);
+            exit(-1);
+        }
+
+        return application.exec();
+    }
+
     // Create a default configuration
     ProxyConfiguration *configuration = new ProxyConfiguration(nullptr);
     if (parser.isSet(configOption))
@@ -192,6 +241,7 @@ int main(int argc, char *argv[])
         s_loggingFilters["AuthenticationProcess"] = true;
         s_loggingFilters["WebSocketServerTraffic"] = true;
         s_loggingFilters["AwsCredentialsProviderTraffic"] = true;
+        s_loggingFilters["ClusterTraffic"] = true;
     }
     QLoggingCategory::installFilter(loggingCategoryFilter);
 
@@ -223,6 +273,12 @@ int main(int argc, char *argv[])
         exit(-1);
     }
 
+    // Verify plain web socket server configuration
+    if (configuration->plainWebSocketServerEnabled() && configuration->plainWebSocketServerHost().isNull()) {
+        qCCritical(dcApplication()) << "Invalid plain web socket host address passed.";
+        exit(-1);
+    }
+
     // Verify SSL configuration
     if (configuration->sslConfiguration().isNull()) {
         qCCritical(dcApplication()) << "No SSL configuration specified. The server does not suppoert insecure connections.";
@@ -246,6 +302,8 @@ int main(int argc, char *argv[])
     Authenticator *authenticator = nullptr;
     if (parser.isSet(mockAuthenticatorOption)) {
         authenticator = qobject_cast<Authenticator *>(new DummyAuthenticator(nullptr));
+    } else if (parser.isSet(tokenDatabaseOption)) {
+        authenticator = qobject_cast<Authenticator *>(new TokenDatabaseAuthenticator(parser.value(tokenDatabaseOption), nullptr));
     } else {
         // Create default authenticator
         authenticator = qobject_cast<Authenticator *>(new AwsAuthenticator(configuration->awsCredentialsUrl(), nullptr));
@@ -254,7 +312,11 @@ int main(int argc, char *argv[])
     // Configure and start the engines
     Engine::instance()->setAuthenticator(authenticator);
     Engine::instance()->setDeveloperModeEnabled(parser.isSet(developmentOption));
+    Engine::instance()->setTakeoverEnabled(parser.isSet(takeoverOption));
     Engine::instance()->start(configuration);
 
+    // After handing over the listening socket, this process quits once the remaining tunnels are closed
+    QObject::connect(Engine::instance(), &Engine::drainFinished, &application, &RemoteProxyServerApplication::onDrainFinished, Qt::QueuedConnection);
+
     return application.exec();
 }
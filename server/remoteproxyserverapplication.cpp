@@ -29,11 +29,13 @@
 #include "loggingcategories.h"
 #include "engine.h"
 
+#include <errno.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <cxxabi.h>
 
@@ -52,9 +54,6 @@ static void catchUnixSignals(const std::vector<int>& quitSignals, const std::vec
         case SIGTERM:
             qCDebug(dcApplication()) << "Cought SIGTERM quit signal...";
             break;
-        case SIGHUP:
-            qCDebug(dcApplication()) << "Cought SIGHUP quit signal...";
-            break;
         case SIGSEGV: {
             qCDebug(dcApplication()) << "Cought SIGSEGV signal. Segmentation fault!";
             exit(1);
@@ -79,8 +78,59 @@ static void catchUnixSignals(const std::vector<int>& quitSignals, const std::vec
         signal(sig, handler);
 }
 
+// Qt can not be used inside a signal handler, the reload runs once the event loop sees the pipe
+static int s_reloadSignalPipe[2] = { -1, -1 };
+
+static void catchReloadSignal(int sig)
+{
+    Q_UNUSED(sig)
+    char data = 1;
+    ssize_t written = ::write(s_reloadSignalPipe[0], &data, sizeof(data));
+    Q_UNUSED(written)
+}
+
 RemoteProxyServerApplication::RemoteProxyServerApplication(int &argc, char **argv) :
     QCoreApplication(argc, argv)
 {
-    catchUnixSignals({SIGQUIT, SIGINT, SIGTERM, SIGHUP, SIGSEGV});
+    catchUnixSignals({SIGQUIT, SIGINT, SIGTERM, SIGSEGV});
+
+    // SIGHUP reloads the configuration
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, s_reloadSignalPipe) != 0) {
+        qCWarning(dcApplication()) << "Could not create the reload signal pipe:" << strerror(errno);
+        return;
+    }
+
+    m_reloadSignalNotifier = new QSocketNotifier(s_reloadSignalPipe[1], QSocketNotifier::Read, this);
+    connect(m_reloadSignalNotifier, &QSocketNotifier::activated, this, &RemoteProxyServerApplication::onReloadSignal);
+    signal(SIGHUP, catchReloadSignal);
+}
+
+void RemoteProxyServerApplication::onReloadSignal()
+{
+    m_reloadSignalNotifier->setEnabled(false);
+    char data;
+    ssize_t bytesRead = ::read(s_reloadSignalPipe[1], &data, sizeof(data));
+    Q_UNUSED(bytesRead)
+    m_reloadSignalNotifier->setEnabled(true);
+
+    qCDebug(dcApplication()) << "Cought SIGHUP reload signal...";
+    if (!Engine::exists() || !Engine::instance()->running())
+        return;
+
+    Engine::instance()->reloadConfiguration();
+}
+
+void RemoteProxyServerApplication::onDrainFinished()
+{
+    // A drained server stays out of rotation until it gets stopped, unless a new process took over
+    HandoverServer *handoverServer = Engine::instance()->handoverServer();
+    if (!handoverServer || !handoverServer->handedOver())
+        return;
+
+    qCDebug(dcApplication()) << "==========================================================";
+    qCDebug(dcApplication()) << "All connections drained. Shutting down nymea-remoteproxy";
+    qCDebug(dcApplication()) << "==========================================================";
+
+    Engine::instance()->destroy();
+    quit();
 }
@@ -38,9 +38,17 @@ class RemoteProxyServerApplication : public QCoreApplication
 public:
     explicit RemoteProxyServerApplication(int &argc, char **argv);
 
+private:
+    QSocketNotifier *m_reloadSignalNotifier = nullptr;
+
 signals:
 
+private slots:
+    void onReloadSignal();
+
 public slots:
+    void onDrainFinished();
+
 };
 
 #endif // REMOTEPROXYSERVERAPPLICATION_H
@@ -29,13 +29,52 @@
 
 #include "engine.h"
 #include "loggingcategories.h"
+#include "jsonrpc/authenticationhandler.h"
+#include "authentication/sessionticketmanager.h"
+#include "authentication/aws/awscredentialprovider.h"
+#include "cluster/clustercoordinator.h"
+#include "cluster/rendezvoushash.h"
+#include "handoverserver.h"
+#include "proxyprotocolserver.h"
+#include "ratelimiter.h"
 #include "remoteproxyconnection.h"
 
+#include <QFile>
+#include <QThread>
 #include <QMetaType>
+#include <QSettings>
+#include <QLocalSocket>
 #include <QSignalSpy>
 #include <QWebSocket>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QCryptographicHash>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QWebSocketServer>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QNetworkAccessManager>
+#include <QSslSocket>
+#include <QSslCipher>
+#include <QSslEllipticCurve>
+
+#include <ctime>
+#include <unistd.h>
+
+// Takes over the listening socket like a new server process, blocking until the engine answers
+class TakeoverThread : public QThread
+{
+public:
+    QString serverName;
+    QVariantMap information;
+    qintptr descriptor = -1;
+
+protected:
+    void run() override {
+        descriptor = HandoverServer::takeListeningSocket(serverName, &information);
+    }
+};
 
 RemoteProxyOfflineTests::RemoteProxyOfflineTests(QObject *parent) :
     BaseTest(parent)
@@ -203,6 +242,7 @@ void RemoteProxyOfflineTests::configuration()
 
     ProxyConfiguration configuration;
     QCOMPARE(configuration.loadConfiguration(fileName), success);
+    QCOMPARE(configuration.errorString().isEmpty(), success);
 }
 
 void RemoteProxyOfflineTests::serverPortBlocked()
@@ -312,6 +352,13 @@ void RemoteProxyOfflineTests::getHello()
     QCOMPARE(response.value("params").toMap().value("version").toString(), QString(SERVER_VERSION_STRING));
     QCOMPARE(response.value("params").toMap().value("apiVersion").toString(), QString(API_VERSION_STRING));
 
+    // The second call gets served from the response cache
+    int commandId = m_commandCounter;
+    QVariantMap cachedResponse = invokeApiCall("RemoteProxy.Hello").toMap();
+    QCOMPARE(cachedResponse.value("id").toInt(), commandId);
+    QCOMPARE(cachedResponse.value("status").toString(), QString("success"));
+    QCOMPARE(cachedResponse.value("params"), response.value("params"));
+
     // Clean up
     stopServer();
 }
@@ -1017,4 +1064,2177 @@ void RemoteProxyOfflineTests::authenticationReplyConnection()
     stopServer();
 }
 
+void RemoteProxyOfflineTests::authenticationScheduler()
+{
+    // Start the server
+    startServer();
+
+    // Allow one running and one queued authentication
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(300);
+
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+    m_configuration->setInactiveTimeout(3000);
+    m_configuration->setMaximumConcurrentAuthentications(1);
+    m_configuration->setAuthenticationQueueSize(1);
+
+    QList<QWebSocket *> sockets;
+    QList<QSignalSpy *> dataSpies;
+    for (int i = 0; i < 3; i++) {
+        QWebSocket *socket = new QWebSocket("proxy-testclient", QWebSocketProtocol::Version13);
+        connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+        QSignalSpy spyConnection(socket, SIGNAL(connected()));
+        socket->open(Engine::instance()->webSocketServer()->serverUrl());
+        spyConnection.wait();
+        QVERIFY(spyConnection.count() == 1);
+
+        sockets.append(socket);
+        dataSpies.append(new QSignalSpy(socket, SIGNAL(textMessageReceived(QString))));
+    }
+
+    // Send all authentication requests at once
+    for (int i = 0; i < sockets.count(); i++) {
+        QVariantMap params;
+        params.insert("uuid", QUuid::createUuid().toString());
+        params.insert("name", QString("Scheduled client %1").arg(i));
+        params.insert("token", QString("token %1").arg(i));
+
+        QVariantMap request;
+        request.insert("id", i);
+        request.insert("method", "Authentication.Authenticate");
+        request.insert("params", params);
+        sockets.at(i)->sendTextMessage(QString(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact)));
+    }
+
+    int successCount = 0;
+    int busyCount = 0;
+    for (int i = 0; i < sockets.count(); i++) {
+        if (dataSpies.at(i)->isEmpty())
+            dataSpies.at(i)->wait();
+
+        QVERIFY(dataSpies.at(i)->count() == 1);
+        QVariantMap response = QJsonDocument::fromJson(dataSpies.at(i)->at(0).at(0).toByteArray()).toVariant().toMap();
+        QString error = response.value("params").toMap().value("authenticationError").toString();
+        if (error == JsonTypes::authenticationErrorToString(Authenticator::AuthenticationErrorNoError)) {
+            successCount++;
+        } else if (error == JsonTypes::authenticationErrorToString(Authenticator::AuthenticationErrorBusy)) {
+            busyCount++;
+        }
+    }
+
+    QCOMPARE(successCount, 2);
+    QCOMPARE(busyCount, 1);
+
+    QVariantMap statistics = Engine::instance()->authenticationScheduler()->currentStatistics();
+    QCOMPARE(statistics.value("rejected").toInt(), 1);
+    QCOMPARE(statistics.value("queued").toInt(), 0);
+
+    qDeleteAll(dataSpies);
+    foreach (QWebSocket *socket, sockets) {
+        socket->close();
+        socket->deleteLater();
+    }
+
+    // Clean up
+    m_configuration->setMaximumConcurrentAuthentications(50);
+    m_configuration->setAuthenticationQueueSize(500);
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::authenticationSchedulerDisconnect()
+{
+    // Start the server
+    startServer();
+
+    // The client disconnects while the authenticator is still working on it
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(1000);
+    m_configuration->setAuthenticationTimeout(3000);
+    m_configuration->setMaximumConcurrentAuthentications(1);
+
+    for (int i = 0; i < 2; i++) {
+        QWebSocket *socket = new QWebSocket("proxy-testclient", QWebSocketProtocol::Version13);
+        connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+        QSignalSpy spyConnection(socket, SIGNAL(connected()));
+        socket->open(Engine::instance()->webSocketServer()->serverUrl());
+        QTRY_COMPARE(spyConnection.count(), 1);
+
+        QVariantMap params;
+        params.insert("uuid", QUuid::createUuid().toString());
+        params.insert("name", "Disconnecting client");
+        params.insert("token", "token");
+
+        QVariantMap request;
+        request.insert("id", i);
+        request.insert("method", "Authentication.Authenticate");
+        request.insert("params", params);
+        socket->sendTextMessage(QString(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact)));
+        QTRY_COMPARE(Engine::instance()->authenticationScheduler()->runningCount(), 1);
+
+        // The slot gets released, otherwise the second round could never start an authentication
+        socket->abort();
+        socket->deleteLater();
+        QTRY_COMPARE(Engine::instance()->authenticationScheduler()->runningCount(), 0);
+    }
+
+    QCOMPARE(Engine::instance()->authenticationScheduler()->queuedCount(), 0);
+
+    // Clean up
+    m_configuration->setMaximumConcurrentAuthentications(50);
+    m_configuration->setAuthenticationTimeout(1500);
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::tokenDatabase()
+{
+    QTemporaryDir temporaryDir;
+    QVERIFY(temporaryDir.isValid());
+    QString databaseFileName = temporaryDir.path() + "/tokens.db";
+
+    // Create the database
+    QHash<QByteArray, UserInformation> entries;
+    for (int i = 0; i < 100; i++) {
+        entries.insert(TokenDatabase::hashToken(QString("token-%1").arg(i)), UserInformation(QString("user%1@example.com").arg(i), QString("user-%1").arg(i)));
+    }
+    QVERIFY(TokenDatabase::writeDatabase(databaseFileName, entries));
+
+    // Verify lookups
+    TokenDatabase database;
+    QVERIFY2(database.open(databaseFileName), database.errorString().toLatin1().data());
+    QCOMPARE(database.entryCount(), 100);
+    for (int i = 0; i < 100; i++) {
+        UserInformation userInformation;
+        QVERIFY(database.lookup(TokenDatabase::hashToken(QString("token-%1").arg(i)), &userInformation));
+        QCOMPARE(userInformation.email(), QString("user%1@example.com").arg(i));
+        QCOMPARE(userInformation.cognitoUsername(), QString("user-%1").arg(i));
+    }
+    QVERIFY(!database.lookup(TokenDatabase::hashToken("unknown token")));
+    database.close();
+
+    // Corrupted files must be rejected
+    QString corruptedFileName = temporaryDir.path() + "/corrupted.db";
+    QVERIFY(QFile::copy(databaseFileName, corruptedFileName));
+    QFile corruptedFile(corruptedFileName);
+    QVERIFY(corruptedFile.open(QIODevice::ReadWrite));
+    corruptedFile.seek(corruptedFile.size() - 2);
+    corruptedFile.write("XX");
+    corruptedFile.close();
+    QVERIFY(!database.open(corruptedFileName));
+
+    // User information outside of the file must not be read, even with a valid checksum
+    QFile databaseFile(databaseFileName);
+    QVERIFY(databaseFile.open(QIODevice::ReadOnly));
+    QByteArray databaseData = databaseFile.readAll();
+    databaseFile.close();
+    QByteArray tokenHash = TokenDatabase::hashToken("token-0");
+    int bucketPosition = databaseData.indexOf(tokenHash);
+    QVERIFY(bucketPosition > 0);
+    qToLittleEndian<quint64>(Q_UINT64_C(0xFFFFFFFFFFFFFFF0), reinterpret_cast<uchar *>(databaseData.data()) + bucketPosition + 32);
+    databaseData.replace(32, 32, QCryptographicHash::hash(databaseData.mid(64), QCryptographicHash::Sha256));
+
+    QString invalidOffsetFileName = temporaryDir.path() + "/invalid-offset.db";
+    QFile invalidOffsetFile(invalidOffsetFileName);
+    QVERIFY(invalidOffsetFile.open(QIODevice::WriteOnly));
+    invalidOffsetFile.write(databaseData);
+    invalidOffsetFile.close();
+
+    QVERIFY2(database.open(invalidOffsetFileName), database.errorString().toLatin1().data());
+    UserInformation invalidUserInformation;
+    QVERIFY(!database.lookup(tokenHash, &invalidUserInformation));
+    QVERIFY(database.lookup(TokenDatabase::hashToken("token-1"), &invalidUserInformation));
+    database.close();
+
+    // Use the authenticator in the engine
+    TokenDatabaseAuthenticator *authenticator = new TokenDatabaseAuthenticator(databaseFileName, this);
+    QSignalSpy loadedSpy(authenticator, &TokenDatabaseAuthenticator::databaseLoaded);
+    loadedSpy.wait();
+    QVERIFY(loadedSpy.count() == 1);
+    QVERIFY(authenticator->isLoaded());
+
+    m_authenticator = authenticator;
+    restartEngine();
+    startServer();
+
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+
+    QVariantMap params;
+    params.insert("uuid", QUuid::createUuid().toString());
+    params.insert("name", "Token database client");
+    params.insert("token", "token-42");
+    verifyAuthenticationError(invokeApiCall("Authentication.Authenticate", params));
+
+    params.insert("token", "token-1000");
+    verifyAuthenticationError(invokeApiCall("Authentication.Authenticate", params), Authenticator::AuthenticationErrorAuthenticationFailed);
+
+    // Replace the database and make sure it gets reloaded
+    entries.insert(TokenDatabase::hashToken("token-1000"), UserInformation("new@example.com"));
+    QVERIFY(TokenDatabase::writeDatabase(databaseFileName, entries));
+    if (loadedSpy.count() < 2)
+        loadedSpy.wait();
+    QVERIFY(loadedSpy.count() >= 2);
+    QCOMPARE(authenticator->entryCount(), 101);
+
+    verifyAuthenticationError(invokeApiCall("Authentication.Authenticate", params));
+
+    // Clean up
+    stopServer();
+    m_authenticator = m_mockAuthenticator;
+    restartEngine();
+    authenticator->deleteLater();
+}
+
+void RemoteProxyOfflineTests::negativeAuthenticationCache()
+{
+    // Bounded size and exponential extension
+    AuthenticationCache cache;
+    cache.setTimeout(100);
+    cache.setMaximumTimeout(1000);
+    cache.setMaximumSize(2);
+
+    cache.addFailure("one");
+    cache.addFailure("two");
+    QVERIFY(cache.isBlocked("one"));
+    QVERIFY(cache.isBlocked("two"));
+
+    cache.addFailure("three");
+    QCOMPARE(cache.count(), 2);
+    QVERIFY(!cache.isBlocked("one"));
+    QCOMPARE(cache.currentStatistics().value("evictions").toInt(), 1);
+
+    cache.addFailure("two");
+    QTest::qWait(150);
+    QVERIFY(!cache.isBlocked("three"));
+    QVERIFY(cache.isBlocked("two"));
+
+    cache.remove("two");
+    QVERIFY(!cache.isBlocked("two"));
+
+    // Repeated attempts using a rejected token get rejected by the proxy
+    startServer();
+
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+
+    m_mockAuthenticator->setExpectedAuthenticationError(Authenticator::AuthenticationErrorAuthenticationFailed);
+    m_mockAuthenticator->setTimeoutDuration(100);
+
+    QVariantMap params;
+    params.insert("uuid", QUuid::createUuid().toString());
+    params.insert("name", "Retrying test client");
+    params.insert("token", "expired token");
+    verifyAuthenticationError(invokeApiCall("Authentication.Authenticate", params), Authenticator::AuthenticationErrorAuthenticationFailed);
+
+    // The authenticator would accept the token now, but the result is still cached
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    verifyAuthenticationError(invokeApiCall("Authentication.Authenticate", params), Authenticator::AuthenticationErrorAuthenticationFailed);
+
+    QVariantMap statistics = Engine::instance()->authenticationScheduler()->currentStatistics().value("negativeCache").toMap();
+    QCOMPARE(statistics.value("entries").toInt(), 1);
+    QCOMPARE(statistics.value("hits").toInt(), 1);
+
+    // Other tokens are not affected
+    params.insert("token", "valid token");
+    verifyAuthenticationError(invokeApiCall("Authentication.Authenticate", params));
+
+    // Clean up
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::awsBatchAuthentication()
+{
+    MockAuthorizerServer *authorizerServer = new MockAuthorizerServer(this);
+    QVERIFY(authorizerServer->isListening());
+
+    m_configuration->setAwsAuthorizerEndpoint(authorizerServer->url());
+    m_configuration->setAwsBatchInterval(300);
+    m_configuration->setAwsBatchSize(10);
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+    m_configuration->setInactiveTimeout(3000);
+
+    AwsAuthenticator *authenticator = new AwsAuthenticator(authorizerServer->credentialsUrl(), this);
+    QTRY_VERIFY(authenticator->isReady());
+
+    m_authenticator = authenticator;
+    restartEngine();
+    startServer();
+
+    QStringList tokens = { "valid-token-1", "valid-token-2", "valid-token-3", "valid-token-4", "invalid-token" };
+
+    QList<QWebSocket *> sockets;
+    QList<QSignalSpy *> dataSpies;
+    for (int i = 0; i < tokens.count(); i++) {
+        QWebSocket *socket = new QWebSocket("proxy-testclient", QWebSocketProtocol::Version13);
+        connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+        QSignalSpy spyConnection(socket, SIGNAL(connected()));
+        socket->open(Engine::instance()->webSocketServer()->serverUrl());
+        spyConnection.wait();
+        QVERIFY(spyConnection.count() == 1);
+
+        sockets.append(socket);
+        dataSpies.append(new QSignalSpy(socket, SIGNAL(textMessageReceived(QString))));
+    }
+
+    // All requests of the burst should end up in one lambda invocation
+    for (int i = 0; i < sockets.count(); i++) {
+        QVariantMap params;
+        params.insert("uuid", QUuid::createUuid().toString());
+        params.insert("name", QString("Batched client %1").arg(i));
+        params.insert("token", tokens.at(i));
+
+        QVariantMap request;
+        request.insert("id", i);
+        request.insert("method", "Authentication.Authenticate");
+        request.insert("params", params);
+        sockets.at(i)->sendTextMessage(QString(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact)));
+    }
+
+    for (int i = 0; i < sockets.count(); i++) {
+        if (dataSpies.at(i)->isEmpty())
+            dataSpies.at(i)->wait();
+
+        QVERIFY(dataSpies.at(i)->count() == 1);
+        QVariant response = QJsonDocument::fromJson(dataSpies.at(i)->at(0).at(0).toByteArray()).toVariant();
+        if (tokens.at(i).startsWith("valid")) {
+            verifyAuthenticationError(response);
+        } else {
+            verifyAuthenticationError(response, Authenticator::AuthenticationErrorAuthenticationFailed);
+        }
+    }
+
+    QCOMPARE(authorizerServer->invocationCount(), 1);
+    QCOMPARE(authorizerServer->batchSizes(), QList<int>() << tokens.count());
+
+    qDeleteAll(dataSpies);
+    foreach (QWebSocket *socket, sockets) {
+        socket->close();
+        socket->deleteLater();
+    }
+
+    // Clean up
+    m_configuration->setAwsAuthorizerEndpoint(QUrl());
+    m_configuration->setAwsBatchInterval(0);
+    stopServer();
+    m_authenticator = m_mockAuthenticator;
+    restartEngine();
+    authenticator->deleteLater();
+    authorizerServer->deleteLater();
+}
+
+void RemoteProxyOfflineTests::awsCredentialRefresh()
+{
+    MockAuthorizerServer credentialsServer;
+    QVERIFY(credentialsServer.isListening());
+    credentialsServer.setCredentialsLifetime(4);
+
+    QNetworkAccessManager networkManager;
+    AwsCredentialProvider provider(&networkManager, credentialsServer.credentialsUrl());
+    provider.setRefreshMargin(1000);
+    provider.setRefreshJitter(500);
+    provider.setRetryIntervals(200, 800);
+
+    QSignalSpy credentialsChangedSpy(&provider, &AwsCredentialProvider::credentialsChanged);
+    provider.enable();
+    QTRY_COMPARE(credentialsChangedSpy.count(), 1);
+    QVERIFY(provider.isValid());
+    QCOMPARE(provider.accessKey(), QString("test-access-key"));
+
+    // The refresh happens the margin minus up to the jitter before the expiration
+    qint64 expiration = provider.expirationTime().toMSecsSinceEpoch();
+    credentialsServer.setCredentialsFailing(true);
+    QTRY_COMPARE_WITH_TIMEOUT(credentialsServer.credentialsRequestTimes().count(), 2, 5000);
+    qint64 refreshTime = credentialsServer.credentialsRequestTimes().at(1);
+    QVERIFY2(refreshTime >= expiration - 1000 - 500 - 100, QString("Refreshed %1 ms before the expiration").arg(expiration - refreshTime).toLatin1().data());
+    QVERIFY2(refreshTime <= expiration - 1000 + 100, QString("Refreshed %1 ms before the expiration").arg(expiration - refreshTime).toLatin1().data());
+
+    // Failed refreshes get retried with an exponential backoff, the current credentials stay in use
+    QTRY_COMPARE_WITH_TIMEOUT(credentialsServer.credentialsRequestTimes().count(), 4, 3000);
+    QList<qint64> requestTimes = credentialsServer.credentialsRequestTimes();
+    qint64 firstRetry = requestTimes.at(2) - requestTimes.at(1);
+    qint64 secondRetry = requestTimes.at(3) - requestTimes.at(2);
+    QVERIFY2(firstRetry >= 200 - 50 && firstRetry <= 300 + 100, QString("First retry after %1 ms").arg(firstRetry).toLatin1().data());
+    QVERIFY2(secondRetry >= 400 - 50 && secondRetry <= 600 + 100, QString("Second retry after %1 ms").arg(secondRetry).toLatin1().data());
+    QCOMPARE(credentialsChangedSpy.count(), 1);
+    if (QDateTime::currentMSecsSinceEpoch() < expiration)
+        QVERIFY(provider.isValid());
+
+    // Expired credentials are not valid any more
+    QTRY_VERIFY_WITH_TIMEOUT(!provider.isValid(), 3000);
+    QVERIFY(QDateTime::currentMSecsSinceEpoch() >= expiration);
+    QCOMPARE(provider.accessKey(), QString("test-access-key"));
+
+    // The retries continue and pick up new credentials once the endpoint works again
+    credentialsServer.setCredentialsFailing(false);
+    QTRY_COMPARE_WITH_TIMEOUT(credentialsChangedSpy.count(), 2, 3000);
+    QVERIFY(provider.isValid());
+    QVERIFY(provider.expirationTime().toMSecsSinceEpoch() > expiration);
+
+    provider.disable();
+    QVERIFY(!provider.isValid());
+}
+
+void RemoteProxyOfflineTests::jsonValidator()
+{
+    AuthenticationHandler handler;
+
+    QJsonObject params;
+    params.insert("uuid", QUuid::createUuid().toString());
+    params.insert("name", "Validated client");
+    params.insert("token", "token");
+    QVERIFY(handler.validateParams("Authenticate", params).first);
+
+    params.insert("nonce", "nonce");
+    QVERIFY(handler.validateParams("Authenticate", params).first);
+
+    QJsonObject forbiddenParams = params;
+    forbiddenParams.insert("foo", "bar");
+    QVERIFY(!handler.validateParams("Authenticate", forbiddenParams).first);
+
+    // Scalars convert to String like QVariant::canConvert does
+    QJsonObject scalarParams = params;
+    scalarParams.insert("name", 42);
+    QVERIFY(handler.validateParams("Authenticate", scalarParams).first);
+
+    QJsonObject invalidParams = params;
+    invalidParams.insert("uuid", QJsonArray() << QUuid::createUuid().toString());
+    QVERIFY(!handler.validateParams("Authenticate", invalidParams).first);
+
+    invalidParams = params;
+    invalidParams.insert("token", QJsonObject());
+    QVERIFY(!handler.validateParams("Authenticate", invalidParams).first);
+
+    invalidParams = params;
+    invalidParams.remove("token");
+    QVERIFY(!handler.validateParams("Authenticate", invalidParams).first);
+
+    QVariantMap returns;
+    returns.insert("authenticationError", JsonTypes::authenticationErrorToString(Authenticator::AuthenticationErrorBusy));
+    QVERIFY(handler.validateReturns("Authenticate", returns).first);
+    returns.insert("authenticationError", "AuthenticationErrorUnknownValue");
+    QVERIFY(!handler.validateReturns("Authenticate", returns).first);
+
+    QBENCHMARK {
+        handler.validateParams("Authenticate", params);
+    }
+}
+
+void RemoteProxyOfflineTests::authenticationConnect()
+{
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+
+    QVariantMap params;
+    params.insert("uuid", QUuid::createUuid().toString());
+    params.insert("name", "Connecting client");
+    params.insert("token", "token");
+
+    QVariantMap response = invokeApiCall("Authentication.Connect", params).toMap();
+    verifyAuthenticationError(response);
+    QCOMPARE(response.value("params").toMap().value("name").toString(), Engine::instance()->configuration()->serverName());
+    QCOMPARE(response.value("params").toMap().value("server").toString(), QString(SERVER_NAME_STRING));
+    QCOMPARE(response.value("params").toMap().value("version").toString(), QString(SERVER_VERSION_STRING));
+    QCOMPARE(response.value("params").toMap().value("apiVersion").toString(), QString(API_VERSION_STRING));
+
+    // The client library skips the Hello call once it knows the server supports the combined call
+    for (int i = 0; i < 2; i++) {
+        RemoteProxyConnection *connection = new RemoteProxyConnection(QUuid::createUuid(), "Test client", this);
+        connect(connection, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+        QSignalSpy readySpy(connection, &RemoteProxyConnection::ready);
+        QVERIFY(connection->connectServer(m_serverUrl));
+        readySpy.wait();
+        QVERIFY(readySpy.count() == 1);
+
+        // The server is known by now, so the Hello call has been skipped
+        if (i > 0)
+            QVERIFY(connection->proxyServerApiVersion().isEmpty());
+
+        QSignalSpy authenticatedSpy(connection, &RemoteProxyConnection::authenticated);
+        QVERIFY(connection->authenticate(m_testToken));
+        authenticatedSpy.wait();
+        QVERIFY(authenticatedSpy.count() == 1);
+        QCOMPARE(connection->proxyServerApiVersion(), QString(API_VERSION_STRING));
+
+        connection->disconnectServer();
+        connection->deleteLater();
+    }
+
+    // Clean up
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::earlyData()
+{
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+    m_configuration->setInactiveTimeout(3000);
+    m_configuration->setAloneTimeout(3000);
+    m_configuration->setEarlyDataSize(64);
+    m_configuration->setEarlyDataMessages(2);
+
+    QString nonce = QUuid::createUuid().toString();
+
+    QList<QWebSocket *> sockets;
+    QList<QSignalSpy *> dataSpies;
+    for (int i = 0; i < 3; i++) {
+        QWebSocket *socket = new QWebSocket("proxy-testclient", QWebSocketProtocol::Version13);
+        connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+        QSignalSpy spyConnection(socket, SIGNAL(connected()));
+        socket->open(Engine::instance()->webSocketServer()->serverUrl());
+        spyConnection.wait();
+        QVERIFY(spyConnection.count() == 1);
+
+        sockets.append(socket);
+        dataSpies.append(new QSignalSpy(socket, SIGNAL(textMessageReceived(QString))));
+    }
+
+    // Authenticate the sockets, the last one uses a different nonce and gets no partner
+    for (int i = 0; i < sockets.count(); i++) {
+        QVariantMap params;
+        params.insert("uuid", QUuid::createUuid().toString());
+        params.insert("name", QString("Early data client %1").arg(i));
+        params.insert("token", "early data token");
+        params.insert("nonce", i < 2 ? nonce : QUuid::createUuid().toString());
+
+        QVariantMap request;
+        request.insert("id", i);
+        request.insert("method", "Authentication.Authenticate");
+        request.insert("params", params);
+        sockets.at(i)->sendTextMessage(QString(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact)));
+
+        dataSpies.at(i)->wait();
+        QVERIFY(dataSpies.at(i)->count() == 1);
+        verifyAuthenticationError(QJsonDocument::fromJson(dataSpies.at(i)->at(0).at(0).toByteArray()).toVariant());
+
+        // The first client starts talking right away
+        if (i == 0) {
+            sockets.at(0)->sendTextMessage("early one");
+            sockets.at(0)->sendTextMessage("early two");
+        }
+    }
+
+    // The partner receives the notification followed by the early data
+    QTRY_VERIFY(dataSpies.at(1)->count() == 4);
+    QVariantMap notification = QJsonDocument::fromJson(dataSpies.at(1)->at(1).at(0).toByteArray()).toVariant().toMap();
+    QCOMPARE(notification.value("notification").toString(), QString("RemoteProxy.TunnelEstablished"));
+    QCOMPARE(dataSpies.at(1)->at(2).at(0).toString(), QString("early one\n"));
+    QCOMPARE(dataSpies.at(1)->at(3).at(0).toString(), QString("early two\n"));
+
+    // Exceeding the limit disconnects the client
+    QSignalSpy disconnectedSpy(sockets.at(2), SIGNAL(disconnected()));
+    sockets.at(2)->sendTextMessage(QString(65, 'x'));
+    disconnectedSpy.wait();
+    QVERIFY(disconnectedSpy.count() == 1);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("earlyDataOverflowCount").toInt(), 1);
+
+    qDeleteAll(dataSpies);
+    foreach (QWebSocket *socket, sockets) {
+        socket->close();
+        socket->deleteLater();
+    }
+
+    // Clean up
+    m_configuration->setEarlyDataSize(0);
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::multiplexedTunnels()
+{
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+
+    // The daemon keeps one connection for all clients
+    RemoteProxyConnection *daemon = new RemoteProxyConnection(QUuid::createUuid(), "Daemon", this);
+    connect(daemon, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+    QSignalSpy daemonReadySpy(daemon, &RemoteProxyConnection::ready);
+    QVERIFY(daemon->connectServer(m_serverUrl));
+    daemonReadySpy.wait();
+    QVERIFY(daemonReadySpy.count() == 1);
+
+    QSignalSpy daemonAuthenticatedSpy(daemon, &RemoteProxyConnection::authenticated);
+    QVERIFY(daemon->authenticateMultiplexed(m_testToken));
+    daemonAuthenticatedSpy.wait();
+    QVERIFY(daemonAuthenticatedSpy.count() == 1);
+    QVERIFY(daemon->isMultiplexed());
+
+    QSignalSpy channelOpenedSpy(daemon, &RemoteProxyConnection::channelOpened);
+    QSignalSpy channelClosedSpy(daemon, &RemoteProxyConnection::channelClosed);
+    QSignalSpy channelDataSpy(daemon, &RemoteProxyConnection::channelDataReady);
+
+    // Connect two clients using the same token
+    QList<RemoteProxyConnection *> clients;
+    for (int i = 0; i < 2; i++) {
+        RemoteProxyConnection *client = new RemoteProxyConnection(QUuid::createUuid(), QString("Client %1").arg(i), this);
+        connect(client, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+        QSignalSpy readySpy(client, &RemoteProxyConnection::ready);
+        QVERIFY(client->connectServer(m_serverUrl));
+        readySpy.wait();
+        QVERIFY(readySpy.count() == 1);
+
+        QSignalSpy remoteConnectionEstablishedSpy(client, &RemoteProxyConnection::remoteConnectionEstablished);
+        QVERIFY(client->authenticate(m_testToken));
+        remoteConnectionEstablishedSpy.wait();
+        QVERIFY(remoteConnectionEstablishedSpy.count() == 1);
+        QCOMPARE(client->tunnelPartnerName(), QString("Daemon"));
+
+        clients.append(client);
+    }
+
+    QTRY_VERIFY(channelOpenedSpy.count() == 2);
+    QCOMPARE(channelOpenedSpy.at(0).at(0).toUInt(), 1u);
+    QCOMPARE(channelOpenedSpy.at(0).at(1).toString(), QString("Client 0"));
+    QCOMPARE(channelOpenedSpy.at(1).at(0).toUInt(), 2u);
+    QCOMPARE(channelOpenedSpy.at(1).at(1).toString(), QString("Client 1"));
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("multiplexedCount").toInt(), 1);
+
+    // Client to daemon
+    QVERIFY(clients.at(1)->sendData("Hello daemon"));
+    channelDataSpy.wait();
+    QVERIFY(channelDataSpy.count() == 1);
+    QCOMPARE(channelDataSpy.at(0).at(0).toUInt(), 2u);
+    QCOMPARE(channelDataSpy.at(0).at(1).toByteArray(), QByteArray("Hello daemon\n"));
+
+    // Daemon to client
+    QSignalSpy clientDataSpy(clients.at(0), &RemoteProxyConnection::dataReady);
+    QVERIFY(daemon->sendChannelData(1, "Hello client"));
+    clientDataSpy.wait();
+    QVERIFY(clientDataSpy.count() == 1);
+    QCOMPARE(clientDataSpy.at(0).at(0).toByteArray(), QByteArray("Hello client\n"));
+
+    // Closing a channel disconnects the client
+    QSignalSpy firstDisconnectedSpy(clients.at(0), &RemoteProxyConnection::disconnected);
+    QVERIFY(daemon->closeChannel(1));
+    firstDisconnectedSpy.wait();
+    QVERIFY(firstDisconnectedSpy.count() == 1);
+    QTRY_VERIFY(channelClosedSpy.count() == 1);
+    QCOMPARE(channelClosedSpy.at(0).at(0).toUInt(), 1u);
+
+    // Closing the daemon connection disconnects all remaining clients
+    QSignalSpy secondDisconnectedSpy(clients.at(1), &RemoteProxyConnection::disconnected);
+    daemon->disconnectServer();
+    secondDisconnectedSpy.wait();
+    QVERIFY(secondDisconnectedSpy.count() == 1);
+
+    qDeleteAll(clients);
+    daemon->deleteLater();
+
+    // Clean up
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::standbyPool()
+{
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+    m_configuration->setAloneTimeout(3000);
+    m_configuration->setStandbyPoolSize(2);
+
+    // Park standby connections, the last one exceeds the pool size
+    QList<RemoteProxyConnection *> standbyConnections;
+    for (int i = 0; i < 3; i++) {
+        RemoteProxyConnection *connection = new RemoteProxyConnection(QUuid::createUuid(), QString("Standby %1").arg(i), this);
+        connect(connection, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+        QSignalSpy readySpy(connection, &RemoteProxyConnection::ready);
+        QVERIFY(connection->connectServer(m_serverUrl));
+        readySpy.wait();
+        QVERIFY(readySpy.count() == 1);
+
+        QSignalSpy authenticatedSpy(connection, &RemoteProxyConnection::authenticated);
+        QSignalSpy disconnectedSpy(connection, &RemoteProxyConnection::disconnected);
+        QVERIFY(connection->authenticateStandby(m_testToken));
+        if (i < 2) {
+            authenticatedSpy.wait();
+            QVERIFY(authenticatedSpy.count() == 1);
+        } else {
+            disconnectedSpy.wait();
+            QVERIFY(disconnectedSpy.count() == 1);
+        }
+
+        standbyConnections.append(connection);
+    }
+
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("standbyCount").toInt(), 2);
+
+    // Arriving clients get paired with the standby connections in order, the last one finds an empty pool
+    QList<RemoteProxyConnection *> clients;
+    for (int i = 0; i < 3; i++) {
+        RemoteProxyConnection *client = new RemoteProxyConnection(QUuid::createUuid(), QString("Client %1").arg(i), this);
+        connect(client, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+        QSignalSpy readySpy(client, &RemoteProxyConnection::ready);
+        QVERIFY(client->connectServer(m_serverUrl));
+        readySpy.wait();
+        QVERIFY(readySpy.count() == 1);
+
+        if (i < 2) {
+            QSignalSpy standbyConsumedSpy(standbyConnections.at(i), &RemoteProxyConnection::standbyConsumed);
+            QSignalSpy standbyEstablishedSpy(standbyConnections.at(i), &RemoteProxyConnection::remoteConnectionEstablished);
+            QSignalSpy remoteConnectionEstablishedSpy(client, &RemoteProxyConnection::remoteConnectionEstablished);
+            QVERIFY(client->authenticate(m_testToken));
+            remoteConnectionEstablishedSpy.wait();
+            QVERIFY(remoteConnectionEstablishedSpy.count() == 1);
+            QCOMPARE(client->tunnelPartnerName(), QString("Standby %1").arg(i));
+
+            QTRY_VERIFY(standbyEstablishedSpy.count() == 1);
+            QVERIFY(standbyConsumedSpy.count() == 1);
+            QCOMPARE(standbyConsumedSpy.at(0).at(0).toInt(), 1 - i);
+        } else {
+            QSignalSpy authenticatedSpy(client, &RemoteProxyConnection::authenticated);
+            QVERIFY(client->authenticate(m_testToken));
+            authenticatedSpy.wait();
+            QVERIFY(authenticatedSpy.count() == 1);
+        }
+
+        clients.append(client);
+    }
+
+    // Send data through a tunnel created from the pool
+    QSignalSpy dataSpy(standbyConnections.at(0), &RemoteProxyConnection::dataReady);
+    QVERIFY(clients.at(0)->sendData("Hello daemon"));
+    dataSpy.wait();
+    QVERIFY(dataSpy.count() == 1);
+    QCOMPARE(dataSpy.at(0).at(0).toByteArray(), QByteArray("Hello daemon\n"));
+
+    QVariantMap statistics = Engine::instance()->proxyServer()->currentStatistics();
+    QCOMPARE(statistics.value("standbyCount").toInt(), 0);
+    QCOMPARE(statistics.value("standbyHits").toInt(), 2);
+    QCOMPARE(statistics.value("standbyMisses").toInt(), 1);
+
+    foreach (RemoteProxyConnection *connection, standbyConnections + clients) {
+        connection->disconnectServer();
+        connection->deleteLater();
+    }
+
+    // Clean up
+    m_configuration->setStandbyPoolSize(0);
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::tunnelResumption()
+{
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+    m_configuration->setResumptionTimeout(3000);
+    m_configuration->setResumptionBufferSize(1024);
+
+    QString nonce = QUuid::createUuid().toString();
+
+    RemoteProxyConnection *connectionOne = new RemoteProxyConnection(QUuid::createUuid(), "Resuming client", this);
+    connect(connectionOne, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+    RemoteProxyConnection *connectionTwo = new RemoteProxyConnection(QUuid::createUuid(), "Waiting client", this);
+    connect(connectionTwo, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+    QSignalSpy remoteConnectionEstablishedOne(connectionOne, &RemoteProxyConnection::remoteConnectionEstablished);
+    QSignalSpy remoteConnectionEstablishedTwo(connectionTwo, &RemoteProxyConnection::remoteConnectionEstablished);
+    foreach (RemoteProxyConnection *connection, QList<RemoteProxyConnection *>() << connectionOne << connectionTwo) {
+        QSignalSpy readySpy(connection, &RemoteProxyConnection::ready);
+        QVERIFY(connection->connectServer(m_serverUrl));
+        readySpy.wait();
+        QVERIFY(readySpy.count() == 1);
+
+        QSignalSpy authenticatedSpy(connection, &RemoteProxyConnection::authenticated);
+        QVERIFY(connection->authenticate(m_testToken, nonce));
+        authenticatedSpy.wait();
+        QVERIFY(authenticatedSpy.count() == 1);
+    }
+
+    QTRY_VERIFY(remoteConnectionEstablishedOne.count() == 1);
+    QTRY_VERIFY(remoteConnectionEstablishedTwo.count() == 1);
+
+    // Drop the connection of the first client on the server side
+    QString clientId;
+    foreach (const QVariant &clientVariant, Engine::instance()->proxyServer()->currentStatistics().value("clients").toList()) {
+        if (clientVariant.toMap().value("name").toString() == "Resuming client") {
+            clientId = clientVariant.toMap().value("id").toString();
+        }
+    }
+    QVERIFY(!clientId.isEmpty());
+
+    QSignalSpy disconnectedOneSpy(connectionOne, &RemoteProxyConnection::disconnected);
+    QSignalSpy disconnectedTwoSpy(connectionTwo, &RemoteProxyConnection::disconnected);
+    QSignalSpy dataOneSpy(connectionOne, &RemoteProxyConnection::dataReady);
+    Engine::instance()->webSocketServer()->killClientConnection(QUuid(clientId), "Transient disconnect");
+    QTRY_VERIFY(Engine::instance()->proxyServer()->currentStatistics().value("suspendedCount").toInt() == 1);
+
+    // The partner keeps talking while the first client is gone
+    QVERIFY(connectionTwo->sendData("While you were gone"));
+    dataOneSpy.wait();
+    QVERIFY(dataOneSpy.count() == 1);
+    QCOMPARE(dataOneSpy.at(0).at(0).toByteArray(), QByteArray("While you were gone\n"));
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("resumedCount").toInt(), 1);
+
+    // The tunnel continues in both directions
+    QSignalSpy dataTwoSpy(connectionTwo, &RemoteProxyConnection::dataReady);
+    QVERIFY(connectionOne->sendData("I am back"));
+    dataTwoSpy.wait();
+    QVERIFY(dataTwoSpy.count() == 1);
+    QCOMPARE(dataTwoSpy.at(0).at(0).toByteArray(), QByteArray("I am back\n"));
+
+    QVERIFY(disconnectedOneSpy.isEmpty());
+    QVERIFY(disconnectedTwoSpy.isEmpty());
+    QVERIFY(connectionOne->isRemoteConnected());
+
+    // An unknown ticket gets rejected
+    QVariantMap params;
+    params.insert("ticket", "invalid");
+    verifyAuthenticationError(invokeApiCall("Authentication.Resume", params), Authenticator::AuthenticationErrorAuthenticationFailed);
+
+    // The partner gets disconnected once the resumption timeout is over
+    connectionOne->disconnectServer();
+    QTRY_VERIFY_WITH_TIMEOUT(disconnectedTwoSpy.count() == 1, 6000);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("suspendedCount").toInt(), 0);
+
+    connectionOne->deleteLater();
+    connectionTwo->deleteLater();
+
+    // Clean up
+    m_configuration->setResumptionTimeout(0);
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::sessionTickets()
+{
+    // Write a key file shared by all nodes
+    QTemporaryDir temporaryDir;
+    QVERIFY(temporaryDir.isValid());
+    QString keyFileName = temporaryDir.filePath("sessiontickets.keys");
+    QFile keyFile(keyFileName);
+    QVERIFY(keyFile.open(QFile::WriteOnly));
+    keyFile.write("# Session ticket keys\n");
+    keyFile.write("test:" + QByteArray(32, 'k').toBase64() + "\n");
+    keyFile.close();
+
+    // The session ticket settings get applied on start
+    m_configuration->setSessionTicketLifetime(60000);
+    m_configuration->setSessionTicketKeyFileName(keyFileName);
+
+    // Start the server
+    startServer();
+    QCOMPARE(Engine::instance()->authenticationScheduler()->sessionTickets()->keyCount(), 1);
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+
+    QVariantMap params;
+    params.insert("uuid", QUuid::createUuid().toString());
+    params.insert("name", "Ticket client");
+    params.insert("token", "ticket token");
+
+    QVariantMap response = invokeApiCall("Authentication.Authenticate", params).toMap();
+    verifyAuthenticationError(response);
+    QString sessionTicket = response.value("params").toMap().value("sessionTicket").toString();
+    QVERIFY(!sessionTicket.isEmpty());
+
+    // The ticket is accepted even though the authenticator would reject the token now
+    m_mockAuthenticator->setExpectedAuthenticationError(Authenticator::AuthenticationErrorAuthenticationFailed);
+    params.insert("sessionTicket", sessionTicket);
+    response = invokeApiCall("Authentication.Authenticate", params).toMap();
+    verifyAuthenticationError(response);
+    QVERIFY(!response.value("params").toMap().value("sessionTicket").toString().isEmpty());
+
+    // A ticket is bound to the token it has been issued for
+    params.insert("token", "other token");
+    verifyAuthenticationError(invokeApiCall("Authentication.Authenticate", params), Authenticator::AuthenticationErrorAuthenticationFailed);
+
+    // Tampered tickets get rejected
+    params.insert("token", "ticket token");
+    params.insert("sessionTicket", QString(sessionTicket).replace(sessionTicket.indexOf('.') - 2, 1, sessionTicket.at(sessionTicket.indexOf('.') - 2) == 'A' ? "B" : "A"));
+    verifyAuthenticationError(invokeApiCall("Authentication.Authenticate", params), Authenticator::AuthenticationErrorAuthenticationFailed);
+
+    QVariantMap statistics = Engine::instance()->authenticationScheduler()->currentStatistics().value("sessionTickets").toMap();
+    QCOMPARE(statistics.value("accepted").toInt(), 1);
+    QCOMPARE(statistics.value("rejected").toInt(), 2);
+
+    // An other node using the same key file accepts the ticket
+    SessionTicketManager otherNode;
+    otherNode.setLifetime(60000);
+    otherNode.setKeyFileName(keyFileName);
+    QCOMPARE(otherNode.keyCount(), 1);
+    QString userName;
+    QVERIFY(otherNode.verifyTicket(sessionTicket, QCryptographicHash::hash(QByteArray("ticket token"), QCryptographicHash::Sha256), &userName));
+    QVERIFY(!otherNode.verifyTicket(sessionTicket, QCryptographicHash::hash(QByteArray("other token"), QCryptographicHash::Sha256)));
+
+    // A node with its own generated key does not
+    SessionTicketManager foreignNode;
+    foreignNode.setLifetime(60000);
+    foreignNode.setKeyFileName(QString());
+    QCOMPARE(foreignNode.keyCount(), 1);
+    QVERIFY(!foreignNode.verifyTicket(sessionTicket, QCryptographicHash::hash(QByteArray("ticket token"), QCryptographicHash::Sha256)));
+
+    // Clean up
+    m_configuration->setSessionTicketLifetime(0);
+    m_configuration->setSessionTicketKeyFileName(QString());
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::clusterRendezvous()
+{
+    QTemporaryDir temporaryDir;
+    QVERIFY(temporaryDir.isValid());
+
+    // Nothing starts without a secret
+    QByteArray secret("test cluster secret");
+    QUrl coordinatorUrl("unix:" + temporaryDir.filePath("cluster.sock"));
+    ClusterCoordinator insecureCoordinator(coordinatorUrl, QByteArray());
+    QVERIFY(!insecureCoordinator.startServer());
+
+    ClusterLink insecureLink(QHostAddress::LocalHost, 1224, QByteArray());
+    QVERIFY(!insecureLink.startServer());
+
+    // Start the coordinator of the cluster
+    ClusterCoordinator coordinator(coordinatorUrl, secret);
+    QVERIFY(coordinator.startServer());
+
+    // The engine of this test is the first node
+    m_configuration->setClusterEnabled(true);
+    m_configuration->setClusterSecret(secret);
+    m_configuration->setClusterNodeId("node-one");
+    m_configuration->setClusterCoordinatorUrl(coordinatorUrl);
+    m_configuration->setClusterLinkHost(QHostAddress::LocalHost);
+    m_configuration->setClusterLinkPort(1214);
+
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+
+    QVERIFY(Engine::instance()->clusterLink()->running());
+    QTRY_VERIFY(Engine::instance()->clusterClient()->isConnected());
+
+    // The second node
+    ClusterClient otherNode("node-two", "127.0.0.1:1224", secret);
+    ClusterLink otherLink(QHostAddress::LocalHost, 1224, secret);
+    otherNode.connectCoordinator(coordinatorUrl);
+    QTRY_VERIFY(otherNode.isConnected());
+    QTRY_COMPARE(coordinator.nodeCount(), 2);
+
+    // Nodes using an other secret can neither join the cluster nor forward clients
+    ClusterClient foreignNode("node-foreign", "127.0.0.1:1234", "wrong secret");
+    QSignalSpy foreignConnectedSpy(&foreignNode, &ClusterClient::connectedChanged);
+    foreignNode.connectCoordinator(coordinatorUrl);
+    QVERIFY(!foreignConnectedSpy.wait(500));
+    QVERIFY(!foreignNode.isConnected());
+    QCOMPARE(coordinator.nodeCount(), 2);
+    foreignNode.disconnectCoordinator();
+
+    ClusterLink foreignLink(QHostAddress::LocalHost, 1234, "wrong secret");
+    QSignalSpy foreignClosedSpy(&foreignLink, &ClusterLink::forwardClosed);
+    QVariantMap foreignIdentity;
+    foreignIdentity.insert("uuid", QUuid::createUuid().toString());
+    foreignIdentity.insert("name", "Foreign client");
+    foreignIdentity.insert("token", m_testToken);
+    foreignIdentity.insert("nonce", QUuid::createUuid().toString());
+    foreignLink.openForward("127.0.0.1:1214", QUuid::createUuid(), foreignIdentity);
+    QTRY_COMPARE(foreignClosedSpy.count(), 1);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("remoteCount").toInt(), 0);
+    QCOMPARE(Engine::instance()->clusterLink()->peerCount(), 0);
+
+    // The first client waits on this node
+    QString nonce = QUuid::createUuid().toString();
+    RemoteProxyConnection *connection = new RemoteProxyConnection(QUuid::createUuid(), "Waiting client", this);
+    connect(connection, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+    QSignalSpy readySpy(connection, &RemoteProxyConnection::ready);
+    QVERIFY(connection->connectServer(m_serverUrl));
+    readySpy.wait();
+    QVERIFY(readySpy.count() == 1);
+
+    QSignalSpy authenticatedSpy(connection, &RemoteProxyConnection::authenticated);
+    QVERIFY(connection->authenticate(m_testToken, nonce));
+    authenticatedSpy.wait();
+    QVERIFY(authenticatedSpy.count() == 1);
+
+    QTRY_COMPARE(coordinator.registrationCount(), 1);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("clusterRegistrations").toInt(), 1);
+
+    // The partner shows up on the second node
+    QSignalSpy matchedSpy(&otherNode, &ClusterClient::tunnelMatched);
+    otherNode.registerTunnel(ClusterClient::tunnelHash(m_testToken + nonce));
+    QTRY_COMPARE(matchedSpy.count(), 1);
+    QCOMPARE(matchedSpy.at(0).at(1).toString(), QString("node-one"));
+    QCOMPARE(matchedSpy.at(0).at(2).toString(), QString("127.0.0.1:1214"));
+    QCOMPARE(coordinator.registrationCount(), 0);
+    QCOMPARE(coordinator.matchCount(), 1);
+
+    // The second node forwards its client to the node of the waiting client
+    QUuid remoteClientId = QUuid::createUuid();
+    QString remoteUuid = QUuid::createUuid().toString();
+    QVariantMap identity;
+    identity.insert("uuid", remoteUuid);
+    identity.insert("name", "Remote client");
+    identity.insert("token", m_testToken);
+    identity.insert("nonce", nonce);
+
+    QSignalSpy remoteConnectionEstablishedSpy(connection, &RemoteProxyConnection::remoteConnectionEstablished);
+    QSignalSpy forwardDataSpy(&otherLink, &ClusterLink::forwardDataAvailable);
+    otherLink.openForward(matchedSpy.at(0).at(2).toString(), remoteClientId, identity);
+    QTRY_COMPARE(remoteConnectionEstablishedSpy.count(), 1);
+    QCOMPARE(connection->tunnelPartnerName(), QString("Remote client"));
+    QCOMPARE(connection->tunnelPartnerUuid(), remoteUuid);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("remoteCount").toInt(), 1);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("tunnelCount").toInt(), 1);
+
+    // The forwarded client receives the notification of the first node
+    QTRY_COMPARE(forwardDataSpy.count(), 1);
+    QVariantMap notification = QJsonDocument::fromJson(forwardDataSpy.at(0).at(1).toByteArray()).toVariant().toMap();
+    QCOMPARE(notification.value("notification").toString(), QString("RemoteProxy.TunnelEstablished"));
+    QCOMPARE(notification.value("params").toMap().value("name").toString(), QString("Waiting client"));
+
+    // Data flows in both directions
+    QVERIFY(connection->sendData("Hello second node"));
+    QTRY_COMPARE(forwardDataSpy.count(), 2);
+    QCOMPARE(forwardDataSpy.at(1).at(1).toByteArray().trimmed(), QByteArray("Hello second node"));
+
+    QSignalSpy dataSpy(connection, &RemoteProxyConnection::dataReady);
+    otherLink.forwardData(remoteClientId, "Hello first node");
+    dataSpy.wait();
+    QVERIFY(dataSpy.count() == 1);
+    QCOMPARE(dataSpy.at(0).at(0).toByteArray(), QByteArray("Hello first node\n"));
+
+    // Closing the forwarded client closes the tunnel
+    QSignalSpy disconnectedSpy(connection, &RemoteProxyConnection::disconnected);
+    otherLink.closeForward(remoteClientId);
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+    QTRY_COMPARE(Engine::instance()->proxyServer()->currentStatistics().value("remoteCount").toInt(), 0);
+
+    // The other way around, the partner waits on the second node
+    QVERIFY(otherLink.startServer());
+    nonce = QUuid::createUuid().toString();
+    otherNode.registerTunnel(ClusterClient::tunnelHash(m_testToken + nonce));
+    QTRY_COMPARE(coordinator.registrationCount(), 1);
+
+    QSignalSpy remoteClientSpy(&otherLink, &ClusterLink::remoteClientAttached);
+    QSignalSpy remoteDataSpy(&otherLink, &ClusterLink::dataAvailable);
+
+    RemoteProxyConnection *forwardedConnection = new RemoteProxyConnection(QUuid::createUuid(), "Forwarded client", this);
+    connect(forwardedConnection, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+    QSignalSpy forwardedReadySpy(forwardedConnection, &RemoteProxyConnection::ready);
+    QVERIFY(forwardedConnection->connectServer(m_serverUrl));
+    forwardedReadySpy.wait();
+    QVERIFY(forwardedReadySpy.count() == 1);
+
+    QSignalSpy forwardedAuthenticatedSpy(forwardedConnection, &RemoteProxyConnection::authenticated);
+    QVERIFY(forwardedConnection->authenticate(m_testToken, nonce));
+    forwardedAuthenticatedSpy.wait();
+    QVERIFY(forwardedAuthenticatedSpy.count() == 1);
+
+    QTRY_COMPARE(remoteClientSpy.count(), 1);
+    QUuid forwardedClientId = remoteClientSpy.at(0).at(0).toUuid();
+    QCOMPARE(remoteClientSpy.at(0).at(1).toMap().value("name").toString(), QString("Forwarded client"));
+    QCOMPARE(remoteClientSpy.at(0).at(1).toMap().value("nonce").toString(), nonce);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("forwardedCount").toInt(), 1);
+    QCOMPARE(coordinator.registrationCount(), 0);
+
+    // The second node establishes the tunnel
+    QVariantMap tunnelParams;
+    tunnelParams.insert("name", "Waiting remote client");
+    tunnelParams.insert("uuid", QUuid::createUuid().toString());
+    notification.clear();
+    notification.insert("id", 0);
+    notification.insert("notification", "RemoteProxy.TunnelEstablished");
+    notification.insert("params", tunnelParams);
+
+    QSignalSpy forwardedEstablishedSpy(forwardedConnection, &RemoteProxyConnection::remoteConnectionEstablished);
+    otherLink.sendData(forwardedClientId, QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact));
+    QTRY_COMPARE(forwardedEstablishedSpy.count(), 1);
+    QCOMPARE(forwardedConnection->tunnelPartnerName(), QString("Waiting remote client"));
+
+    QVERIFY(forwardedConnection->sendData("Hello waiting remote client"));
+    QTRY_COMPARE(remoteDataSpy.count(), 1);
+    QCOMPARE(remoteDataSpy.at(0).at(1).toByteArray().trimmed(), QByteArray("Hello waiting remote client"));
+
+    // The second node closes the tunnel
+    QSignalSpy forwardedDisconnectedSpy(forwardedConnection, &RemoteProxyConnection::disconnected);
+    otherLink.killClientConnection(forwardedClientId, "Tunnel client disconnected");
+    QTRY_COMPARE(forwardedDisconnectedSpy.count(), 1);
+    QTRY_COMPARE(Engine::instance()->proxyServer()->currentStatistics().value("forwardedCount").toInt(), 0);
+
+    // Clean up
+    connection->deleteLater();
+    forwardedConnection->deleteLater();
+    otherNode.disconnectCoordinator();
+    otherLink.stopServer();
+    stopServer();
+    m_configuration->setClusterEnabled(false);
+    m_configuration->setClusterSecret(QByteArray());
+}
+
+void RemoteProxyOfflineTests::clusterRedirect()
+{
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+    m_configuration->setAuthenticationTimeout(2000);
+    m_configuration->setJsonRpcTimeout(3000);
+
+    // This node owns only a part of the tunnels, the other node is reachable using a different url
+    QString nodeUrl = m_serverUrl.toString();
+    QString otherNodeUrl = m_serverUrl.toString() + "/other";
+    QStringList members = QStringList() << nodeUrl << otherNodeUrl;
+    m_configuration->setClusterMembers(members);
+    m_configuration->setClusterNodeUrl(nodeUrl);
+
+    QString ownNonce;
+    QString otherNonce;
+    while (ownNonce.isEmpty() || otherNonce.isEmpty()) {
+        QString nonce = QUuid::createUuid().toString();
+        if (RendezvousHash::owner(members, m_testToken + nonce) == nodeUrl) {
+            ownNonce = nonce;
+        } else {
+            otherNonce = nonce;
+        }
+    }
+
+    // Tunnels owned by this node get authenticated as usual
+    QVariantMap params;
+    params.insert("uuid", QUuid::createUuid().toString());
+    params.insert("name", "Redirect client");
+    params.insert("token", m_testToken);
+    params.insert("nonce", ownNonce);
+    verifyAuthenticationError(invokeApiCall("Authentication.Authenticate", params));
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("redirectCount").toInt(), 0);
+
+    // Tunnels of the other node get redirected
+    QWebSocket *socket = new QWebSocket("redirect-testclient", QWebSocketProtocol::Version13);
+    connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+    QSignalSpy connectedSpy(socket, &QWebSocket::connected);
+    socket->open(m_serverUrl);
+    QTRY_COMPARE(connectedSpy.count(), 1);
+
+    QSignalSpy dataSpy(socket, &QWebSocket::textMessageReceived);
+    QSignalSpy disconnectedSpy(socket, &QWebSocket::disconnected);
+
+    params.insert("nonce", otherNonce);
+    QVariantMap request;
+    request.insert("id", 1);
+    request.insert("method", "Authentication.Authenticate");
+    request.insert("params", params);
+    socket->sendTextMessage(QString::fromUtf8(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact)));
+    QTRY_COMPARE(dataSpy.count(), 2);
+
+    QVariantMap notification = QJsonDocument::fromJson(dataSpy.at(0).at(0).toString().toUtf8()).toVariant().toMap();
+    QCOMPARE(notification.value("notification").toString(), QString("RemoteProxy.Redirect"));
+    QCOMPARE(notification.value("params").toMap().value("url").toString(), otherNodeUrl);
+    verifyAuthenticationError(QJsonDocument::fromJson(dataSpy.at(1).at(0).toString().toUtf8()).toVariant(), Authenticator::AuthenticationErrorRedirected);
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("redirectCount").toInt(), 1);
+    socket->deleteLater();
+
+    // The client follows the redirects, since this node never owns the tunnel it gives up after 3 redirects
+    RemoteProxyConnection *connection = new RemoteProxyConnection(QUuid::createUuid(), "Redirected client", this);
+    connect(connection, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+    QSignalSpy readySpy(connection, &RemoteProxyConnection::ready);
+    QVERIFY(connection->connectServer(m_serverUrl));
+    readySpy.wait();
+    QVERIFY(readySpy.count() == 1);
+
+    QSignalSpy authenticatedSpy(connection, &RemoteProxyConnection::authenticated);
+    QSignalSpy errorSpy(connection, &RemoteProxyConnection::errorOccured);
+    QSignalSpy clientDisconnectedSpy(connection, &RemoteProxyConnection::disconnected);
+    QVERIFY(connection->authenticate(m_testToken, otherNonce));
+    QTRY_COMPARE(clientDisconnectedSpy.count(), 1);
+    QCOMPARE(authenticatedSpy.count(), 0);
+    QVERIFY(errorSpy.count() >= 1);
+    QCOMPARE(connection->serverUrl().toString(), otherNodeUrl);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("redirectCount").toInt(), 5);
+
+    // Clean up
+    connection->deleteLater();
+    m_configuration->setClusterMembers(QStringList());
+    m_configuration->setClusterNodeUrl(QString());
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::socketHandover()
+{
+    QTemporaryDir temporaryDir;
+    QVERIFY(temporaryDir.isValid());
+    m_configuration->setHandoverSocketFileName(temporaryDir.filePath("handover.sock"));
+    m_configuration->setDrainTimeout(60000);
+
+    // Start the server
+    startServer();
+    QVERIFY(Engine::instance()->handoverServer()->running());
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+
+    // A tunnel established before the handover
+    RemoteProxyConnection *connectionOne = new RemoteProxyConnection(QUuid::createUuid(), "Tunnel client one", this);
+    connect(connectionOne, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+    RemoteProxyConnection *connectionTwo = new RemoteProxyConnection(QUuid::createUuid(), "Tunnel client two", this);
+    connect(connectionTwo, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+    QSignalSpy connectionOneReadySpy(connectionOne, &RemoteProxyConnection::ready);
+    QVERIFY(connectionOne->connectServer(m_serverUrl));
+    connectionOneReadySpy.wait();
+    QVERIFY(connectionOneReadySpy.count() == 1);
+
+    QSignalSpy connectionTwoReadySpy(connectionTwo, &RemoteProxyConnection::ready);
+    QVERIFY(connectionTwo->connectServer(m_serverUrl));
+    connectionTwoReadySpy.wait();
+    QVERIFY(connectionTwoReadySpy.count() == 1);
+
+    QString nonce = QUuid::createUuid().toString();
+    QSignalSpy remoteConnectionEstablishedOne(connectionOne, &RemoteProxyConnection::remoteConnectionEstablished);
+    QSignalSpy remoteConnectionEstablishedTwo(connectionTwo, &RemoteProxyConnection::remoteConnectionEstablished);
+    QVERIFY(connectionOne->authenticate(m_testToken, nonce));
+    QVERIFY(connectionTwo->authenticate(m_testToken, nonce));
+    QTRY_COMPARE(remoteConnectionEstablishedOne.count(), 1);
+    QTRY_COMPARE(remoteConnectionEstablishedTwo.count(), 1);
+
+    // A client still waiting for its tunnel partner
+    RemoteProxyConnection *waitingConnection = new RemoteProxyConnection(QUuid::createUuid(), "Waiting client", this);
+    connect(waitingConnection, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+    QSignalSpy waitingReadySpy(waitingConnection, &RemoteProxyConnection::ready);
+    QVERIFY(waitingConnection->connectServer(m_serverUrl));
+    waitingReadySpy.wait();
+    QVERIFY(waitingReadySpy.count() == 1);
+
+    QSignalSpy waitingAuthenticatedSpy(waitingConnection, &RemoteProxyConnection::authenticated);
+    QVERIFY(waitingConnection->authenticate(m_testToken, QUuid::createUuid().toString()));
+    waitingAuthenticatedSpy.wait();
+    QVERIFY(waitingAuthenticatedSpy.count() == 1);
+
+    // A new process takes over the listening socket
+    QSignalSpy handedOverSpy(Engine::instance()->handoverServer(), &HandoverServer::listeningSocketHandedOver);
+    QSignalSpy waitingDisconnectedSpy(waitingConnection, &RemoteProxyConnection::disconnected);
+
+    TakeoverThread takeover;
+    takeover.serverName = m_configuration->handoverSocketFileName();
+    takeover.start();
+    QTRY_COMPARE(handedOverSpy.count(), 1);
+    QVERIFY(takeover.wait(5000));
+    QVERIFY(takeover.descriptor >= 0);
+    QCOMPARE(takeover.information.value("clientCount").toInt(), 3);
+    QCOMPARE(takeover.information.value("tunnelCount").toInt(), 1);
+
+    QVERIFY(Engine::instance()->draining());
+    QVERIFY(!Engine::instance()->webSocketServer()->running());
+    QVERIFY(!Engine::instance()->handoverServer()->running());
+    QVERIFY(!Engine::instance()->monitorServer()->running());
+
+    // The waiting client reconnects to the new process, the tunnel keeps working
+    QTRY_COMPARE(waitingDisconnectedSpy.count(), 1);
+
+    QSignalSpy remoteConnectionDataTwo(connectionTwo, &RemoteProxyConnection::dataReady);
+    QVERIFY(connectionOne->sendData("Hello after the handover"));
+    QTRY_COMPARE(remoteConnectionDataTwo.count(), 1);
+    QCOMPARE(remoteConnectionDataTwo.at(0).at(0).toByteArray().trimmed(), QByteArray("Hello after the handover"));
+
+    // The new process accepts connections on the same listening socket
+    WebSocketServer newServer(m_configuration->sslConfiguration());
+    newServer.setServerUrl(m_serverUrl);
+    newServer.setListeningDescriptor(takeover.descriptor);
+    QVERIFY(newServer.startServer());
+    QVERIFY(newServer.running());
+
+    QSignalSpy newClientSpy(&newServer, &WebSocketServer::clientConnected);
+    QWebSocket *socket = new QWebSocket("handover-testclient", QWebSocketProtocol::Version13);
+    connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+    socket->open(m_serverUrl);
+    QTRY_COMPARE(newClientSpy.count(), 1);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("clientCount").toInt(), 2);
+
+    // The old process is done once the tunnel has been closed
+    QSignalSpy drainFinishedSpy(Engine::instance(), &Engine::drainFinished);
+    connectionOne->disconnectServer();
+    QTRY_COMPARE_WITH_TIMEOUT(drainFinishedSpy.count(), 1, 5000);
+    QVERIFY(!Engine::instance()->draining());
+
+    // Clean up
+    socket->deleteLater();
+    newServer.stopServer();
+    connectionOne->deleteLater();
+    connectionTwo->deleteLater();
+    waitingConnection->deleteLater();
+    stopServer();
+    m_configuration->setHandoverSocketFileName(QString());
+    m_configuration->setDrainTimeout(600000);
+}
+
+void RemoteProxyOfflineTests::socketHandoverFailed()
+{
+    QTemporaryDir temporaryDir;
+    QVERIFY(temporaryDir.isValid());
+    m_configuration->setHandoverSocketFileName(temporaryDir.filePath("handover.sock"));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    m_configuration->setPlainWebSocketServerEnabled(true);
+    m_configuration->setPlainWebSocketServerPort(1216);
+#endif
+
+    // Start the server
+    startServer();
+    QVERIFY(Engine::instance()->handoverServer()->running());
+
+    // A successor which goes away before it received the listening socket
+    QSignalSpy handedOverSpy(Engine::instance()->handoverServer(), &HandoverServer::listeningSocketHandedOver);
+    QLocalSocket successor;
+    successor.connectToServer(m_configuration->handoverSocketFileName());
+    QVERIFY(successor.waitForConnected());
+    successor.abort();
+
+    // This process keeps serving
+    QTest::qWait(200);
+    QVERIFY(Engine::instance()->handoverServer()->running());
+    QVERIFY(Engine::instance()->monitorServer()->running());
+    QVERIFY(Engine::instance()->webSocketServer()->running());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    QVERIFY(Engine::instance()->plainWebSocketServer()->running());
+#endif
+    QVERIFY(!Engine::instance()->handoverServer()->handedOver());
+    QVERIFY(!Engine::instance()->draining());
+    QCOMPARE(handedOverSpy.count(), 0);
+
+    // A later successor still gets the listening socket
+    TakeoverThread takeover;
+    takeover.serverName = m_configuration->handoverSocketFileName();
+    takeover.start();
+    QTRY_COMPARE(handedOverSpy.count(), 1);
+    QVERIFY(takeover.wait(5000));
+    QVERIFY(takeover.descriptor >= 0);
+    ::close(static_cast<int>(takeover.descriptor));
+
+    // Clean up
+    stopServer();
+    m_configuration->setHandoverSocketFileName(QString());
+    m_configuration->setPlainWebSocketServerEnabled(false);
+    m_configuration->setPlainWebSocketServerPort(8080);
+}
+
+void RemoteProxyOfflineTests::drainMode()
+{
+    m_configuration->setDrainTimeout(2000);
+    m_configuration->setDrainBatchSize(1);
+    m_configuration->setDrainRetryAfter(5000);
+
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+
+    // Two tunnels established before draining
+    QList<RemoteProxyConnection *> connections;
+    for (int i = 0; i < 2; i++) {
+        QString nonce = QUuid::createUuid().toString();
+        for (int j = 0; j < 2; j++) {
+            RemoteProxyConnection *connection = new RemoteProxyConnection(QUuid::createUuid(), QString("Tunnel %1 client %2").arg(i).arg(j), this);
+            connect(connection, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+            QSignalSpy readySpy(connection, &RemoteProxyConnection::ready);
+            QVERIFY(connection->connectServer(m_serverUrl));
+            readySpy.wait();
+            QVERIFY(readySpy.count() == 1);
+
+            QVERIFY(connection->authenticate(m_testToken, nonce));
+            connections.append(connection);
+        }
+    }
+
+    foreach (RemoteProxyConnection *connection, connections) {
+        QTRY_VERIFY(connection->state() == RemoteProxyConnection::StateRemoteConnected);
+    }
+
+    // A connected client which did not authenticate yet
+    QWebSocket *socket = new QWebSocket("drain-testclient", QWebSocketProtocol::Version13);
+    connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+    QSignalSpy connectedSpy(socket, &QWebSocket::connected);
+    socket->open(m_serverUrl);
+    QTRY_COMPARE(connectedSpy.count(), 1);
+
+    // Drain using the monitor socket
+    QLocalSocket monitor;
+    monitor.connectToServer(m_configuration->monitorSocketFileName());
+    QVERIFY(monitor.waitForConnected(1000));
+    monitor.write("{\"command\":\"drain\"}\n");
+
+    // The monitor data of the server might arrive meanwhile
+    QByteArray monitorData;
+    QTRY_VERIFY((monitorData += monitor.readAll()).contains("\"command\""));
+
+    QVariantMap commandResponse;
+    foreach (const QByteArray &line, monitorData.split('\n')) {
+        QVariantMap data = QJsonDocument::fromJson(line).toVariant().toMap();
+        if (data.contains("command"))
+            commandResponse = data;
+    }
+    QCOMPARE(commandResponse.value("command").toString(), QString("drain"));
+    QVERIFY(commandResponse.value("success").toBool());
+
+    QVERIFY(Engine::instance()->draining());
+    QVERIFY(!Engine::instance()->webSocketServer()->running());
+
+    // New tunnel clients get a retry hint
+    QSignalSpy dataSpy(socket, &QWebSocket::textMessageReceived);
+    QSignalSpy disconnectedSpy(socket, &QWebSocket::disconnected);
+
+    QVariantMap params;
+    params.insert("uuid", QUuid::createUuid().toString());
+    params.insert("name", "Late client");
+    params.insert("token", m_testToken);
+    params.insert("nonce", QUuid::createUuid().toString());
+
+    QVariantMap request;
+    request.insert("id", 1);
+    request.insert("method", "Authentication.Authenticate");
+    request.insert("params", params);
+    socket->sendTextMessage(QString::fromUtf8(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact)));
+    QTRY_COMPARE(dataSpy.count(), 1);
+
+    QVariant response = QJsonDocument::fromJson(dataSpy.at(0).at(0).toString().toUtf8()).toVariant();
+    verifyAuthenticationError(response, Authenticator::AuthenticationErrorBusy);
+    QCOMPARE(response.toMap().value("params").toMap().value("retryAfter").toInt(), 5000);
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+
+    QVariantMap drainStatistics = Engine::instance()->proxyServer()->currentStatistics().value("drain").toMap();
+    QVERIFY(drainStatistics.value("active").toBool());
+    QCOMPARE(drainStatistics.value("rejectedCount").toInt(), 1);
+    QCOMPARE(drainStatistics.value("remainingTunnels").toInt(), 2);
+    QCOMPARE(drainStatistics.value("closedCount").toInt(), 0);
+
+    // The tunnels keep working until the drain timeout
+    QSignalSpy remoteDataSpy(connections.at(1), &RemoteProxyConnection::dataReady);
+    QVERIFY(connections.at(0)->sendData("Hello while draining"));
+    QTRY_COMPARE(remoteDataSpy.count(), 1);
+
+    // Once the timeout expired, the tunnels get closed one per second
+    QSignalSpy drainFinishedSpy(Engine::instance(), &Engine::drainFinished);
+    QTRY_COMPARE_WITH_TIMEOUT(Engine::instance()->proxyServer()->currentStatistics().value("drain").toMap().value("remainingTunnels").toInt(), 1, 5000);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("drain").toMap().value("closedCount").toInt(), 1);
+    QTRY_COMPARE_WITH_TIMEOUT(Engine::instance()->proxyServer()->currentStatistics().value("drain").toMap().value("remainingTunnels").toInt(), 0, 3000);
+    QCOMPARE(Engine::instance()->proxyServer()->currentStatistics().value("drain").toMap().value("closedCount").toInt(), 2);
+    QTRY_COMPARE_WITH_TIMEOUT(drainFinishedSpy.count(), 1, 3000);
+
+    // Draining twice is not possible
+    monitor.readAll();
+    monitor.write("{\"command\":\"drain\"}\n");
+    monitorData.clear();
+    QTRY_VERIFY((monitorData += monitor.readAll()).contains("\"command\""));
+
+    commandResponse.clear();
+    foreach (const QByteArray &line, monitorData.split('\n')) {
+        QVariantMap data = QJsonDocument::fromJson(line).toVariant().toMap();
+        if (data.contains("command"))
+            commandResponse = data;
+    }
+    QCOMPARE(commandResponse.value("command").toString(), QString("drain"));
+    QVERIFY(!commandResponse.value("success").toBool());
+
+    // Clean up
+    monitor.close();
+    socket->deleteLater();
+    foreach (RemoteProxyConnection *connection, connections) {
+        connection->deleteLater();
+    }
+    stopServer();
+    m_configuration->setDrainTimeout(600000);
+    m_configuration->setDrainBatchSize(10);
+    m_configuration->setDrainRetryAfter(10000);
+}
+
+void RemoteProxyOfflineTests::reloadConfiguration()
+{
+    QTemporaryDir temporaryDir;
+    QVERIFY(temporaryDir.isValid());
+    QString configurationFileName = temporaryDir.path() + "/nymea-remoteproxy.conf";
+    QVERIFY(QFile::copy(":/test-configuration.conf", configurationFileName));
+    QVERIFY(QFile::setPermissions(configurationFileName, QFile::ReadOwner | QFile::WriteOwner));
+    QVERIFY(m_configuration->loadConfiguration(configurationFileName));
+
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+
+    // Establish a tunnel before reloading
+    QString nonce = QUuid::createUuid().toString();
+    RemoteProxyConnection *connectionOne = new RemoteProxyConnection(QUuid::createUuid(), "Test client one", this);
+    connect(connectionOne, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+    RemoteProxyConnection *connectionTwo = new RemoteProxyConnection(QUuid::createUuid(), "Test client two", this);
+    connect(connectionTwo, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+    foreach (RemoteProxyConnection *connection, QList<RemoteProxyConnection *>() << connectionOne << connectionTwo) {
+        QSignalSpy readySpy(connection, &RemoteProxyConnection::ready);
+        QVERIFY(connection->connectServer(m_serverUrl));
+        readySpy.wait();
+        QVERIFY(readySpy.count() == 1);
+        QVERIFY(connection->authenticate(m_testToken, nonce));
+    }
+
+    QTRY_VERIFY(connectionOne->state() == RemoteProxyConnection::StateRemoteConnected);
+    QTRY_VERIFY(connectionTwo->state() == RemoteProxyConnection::StateRemoteConnected);
+    QCOMPARE(invokeApiCall("RemoteProxy.Hello").toMap().value("params").toMap().value("name").toString(), QString("test-nymea-remoteproxy"));
+
+    // Change runtime and restart only settings
+    {
+        QSettings settings(configurationFileName, QSettings::IniFormat);
+        settings.setValue("ProxyServer/name", "reloaded-nymea-remoteproxy");
+        settings.setValue("ProxyServer/aloneTimeout", 500);
+        settings.setValue("ProxyServer/drainRetryAfter", 2000);
+        settings.setValue("WebSocketServer/port", 1300);
+    }
+
+    // Reload using the monitor socket
+    QLocalSocket monitor;
+    monitor.connectToServer(m_configuration->monitorSocketFileName());
+    QVERIFY(monitor.waitForConnected(1000));
+    monitor.write("{\"command\":\"reload\"}\n");
+
+    // The monitor data of the server might arrive meanwhile
+    QByteArray monitorData;
+    QTRY_VERIFY((monitorData += monitor.readAll()).contains("\"command\""));
+
+    QVariantMap commandResponse;
+    foreach (const QByteArray &line, monitorData.split('\n')) {
+        QVariantMap data = QJsonDocument::fromJson(line).toVariant().toMap();
+        if (data.contains("command"))
+            commandResponse = data;
+    }
+    QCOMPARE(commandResponse.value("command").toString(), QString("reload"));
+    QVERIFY(commandResponse.value("success").toBool());
+    QCOMPARE(commandResponse.value("reload").toMap().value("count").toInt(), 1);
+    QCOMPARE(commandResponse.value("reload").toMap().value("restartRequired").toStringList(), QStringList() << "WebSocketServer");
+    QVERIFY(commandResponse.value("reload").toMap().value("lastReload").toLongLong() > 0);
+
+    // New values apply, the listening socket stays
+    QCOMPARE(m_configuration->serverName(), QString("reloaded-nymea-remoteproxy"));
+    QCOMPARE(m_configuration->aloneTimeout(), 500);
+    QCOMPARE(m_configuration->drainRetryAfter(), 2000);
+    QCOMPARE(m_configuration->webSocketServerPort(), static_cast<quint16>(1212));
+    QVERIFY(Engine::instance()->webSocketServer()->running());
+    QCOMPARE(invokeApiCall("RemoteProxy.Hello").toMap().value("params").toMap().value("name").toString(), QString("reloaded-nymea-remoteproxy"));
+
+    // The established tunnel continues
+    QSignalSpy remoteDataSpy(connectionTwo, &RemoteProxyConnection::dataReady);
+    QVERIFY(connectionOne->sendData("Hello after reload"));
+    QTRY_COMPARE(remoteDataSpy.count(), 1);
+    QCOMPARE(remoteDataSpy.at(0).at(0).toByteArray(), QByteArray("Hello after reload"));
+
+    // A faulty configuration gets reported and the running one stays
+    {
+        QSettings settings(configurationFileName, QSettings::IniFormat);
+        settings.setValue("ProxyServer/name", "faulty-nymea-remoteproxy");
+        settings.setValue("SSL/certificate", temporaryDir.path() + "/not-existing-certificate.crt");
+    }
+
+    QVERIFY(!Engine::instance()->reloadConfiguration());
+    QVERIFY(Engine::instance()->reloadErrorString().contains("not-existing-certificate.crt"));
+    QCOMPARE(m_configuration->serverName(), QString("reloaded-nymea-remoteproxy"));
+    QVariantMap reloadStatistics = Engine::instance()->reloadStatistics();
+    QCOMPARE(reloadStatistics.value("count").toInt(), 1);
+    QCOMPARE(reloadStatistics.value("failedCount").toInt(), 1);
+    QCOMPARE(reloadStatistics.value("error").toString(), Engine::instance()->reloadErrorString());
+    QVERIFY(connectionOne->state() == RemoteProxyConnection::StateRemoteConnected);
+
+    // Clean up
+    monitor.close();
+    connectionOne->deleteLater();
+    connectionTwo->deleteLater();
+    stopServer();
+    QVERIFY(m_configuration->loadConfiguration(":/test-configuration.conf"));
+}
+
+void RemoteProxyOfflineTests::tlsHandshakeStatistics()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 9, 0)
+    QSKIP("The TLS handshake statistics require Qt 5.9 or newer");
+#endif
+
+    // Start the server
+    startServer();
+
+    QVariantMap tlsStatistics = Engine::instance()->webSocketServer()->currentStatistics();
+    QCOMPARE(tlsStatistics.value("handshakeCount").toInt(), 0);
+    QCOMPARE(tlsStatistics.value("handshakeFailedCount").toInt(), 0);
+
+    // A websocket client passes the handshake and gets upgraded
+    QWebSocket *socket = new QWebSocket("tls-testclient", QWebSocketProtocol::Version13);
+    connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+    QSignalSpy connectedSpy(socket, &QWebSocket::connected);
+    socket->open(m_serverUrl);
+    QTRY_COMPARE(connectedSpy.count(), 1);
+    QVERIFY(!invokeApiCall("RemoteProxy.Hello").toMap().isEmpty());
+
+    tlsStatistics = Engine::instance()->webSocketServer()->currentStatistics();
+    QCOMPARE(tlsStatistics.value("handshakeCount").toInt(), 2);
+    QCOMPARE(tlsStatistics.value("pendingHandshakes").toInt(), 0);
+    QVERIFY(tlsStatistics.value("averageHandshakeDuration").toLongLong() > 0);
+    QVERIFY(tlsStatistics.value("maximumHandshakeDuration").toLongLong() >= tlsStatistics.value("averageHandshakeDuration").toLongLong());
+
+    // Plain text does not pass
+    QTcpSocket plainSocket;
+    QSignalSpy plainDisconnectedSpy(&plainSocket, &QTcpSocket::disconnected);
+    plainSocket.connectToHost(QHostAddress(m_serverUrl.host()), static_cast<quint16>(m_serverUrl.port()));
+    QTRY_COMPARE(plainSocket.state(), QAbstractSocket::ConnectedState);
+    plainSocket.write("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    QTRY_COMPARE(plainDisconnectedSpy.count(), 1);
+
+    tlsStatistics = Engine::instance()->webSocketServer()->currentStatistics();
+    QCOMPARE(tlsStatistics.value("handshakeCount").toInt(), 2);
+    QCOMPARE(tlsStatistics.value("handshakeFailedCount").toInt(), 1);
+    QCOMPARE(tlsStatistics.value("pendingHandshakes").toInt(), 0);
+
+    // Session tickets are never issued
+    QVERIFY(Engine::instance()->configuration()->sslConfiguration().testSslOption(QSsl::SslOptionDisableSessionTickets));
+
+    // Clean up
+    socket->deleteLater();
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::tlsHandshakeThreads()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 9, 0)
+    QSKIP("The TLS handshake threads require Qt 5.9 or newer");
+#endif
+
+    m_configuration->setHandshakeThreads(2);
+
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setExpectedAuthenticationError();
+    m_mockAuthenticator->setTimeoutDuration(100);
+
+    // The encrypted connections arrive in the main thread and relay as usual
+    QString nonce = QUuid::createUuid().toString();
+    QList<RemoteProxyConnection *> connections;
+    for (int i = 0; i < 2; i++) {
+        RemoteProxyConnection *connection = new RemoteProxyConnection(QUuid::createUuid(), QString("Test client %1").arg(i), this);
+        connect(connection, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+        QSignalSpy readySpy(connection, &RemoteProxyConnection::ready);
+        QVERIFY(connection->connectServer(m_serverUrl));
+        readySpy.wait();
+        QVERIFY(readySpy.count() == 1);
+        QVERIFY(connection->authenticate(m_testToken, nonce));
+        connections.append(connection);
+    }
+
+    foreach (RemoteProxyConnection *connection, connections) {
+        QTRY_VERIFY(connection->state() == RemoteProxyConnection::StateRemoteConnected);
+    }
+
+    QSignalSpy remoteDataSpy(connections.at(1), &RemoteProxyConnection::dataReady);
+    QVERIFY(connections.at(0)->sendData("Hello from the handshake threads"));
+    QTRY_COMPARE(remoteDataSpy.count(), 1);
+    QCOMPARE(remoteDataSpy.at(0).at(0).toByteArray(), QByteArray("Hello from the handshake threads"));
+
+    QVariantMap tlsStatistics = Engine::instance()->webSocketServer()->currentStatistics();
+    QCOMPARE(tlsStatistics.value("handshakeThreads").toInt(), 2);
+    QCOMPARE(tlsStatistics.value("handshakeCount").toInt(), 2);
+    QCOMPARE(tlsStatistics.value("pendingHandshakes").toInt(), 0);
+
+    // The event loop lag gets measured every second
+    QTest::qWait(1500);
+    QVariantMap eventLoopStatistics = Engine::instance()->eventLoopStatistics();
+    QVERIFY(eventLoopStatistics.contains("lag"));
+    QVERIFY(eventLoopStatistics.contains("averageLag"));
+    QVERIFY(eventLoopStatistics.value("maximumLag").toLongLong() >= eventLoopStatistics.value("lag").toLongLong());
+
+    // Clean up
+    foreach (RemoteProxyConnection *connection, connections) {
+        connection->deleteLater();
+    }
+    stopServer();
+    m_configuration->setHandshakeThreads(0);
+}
+
+void RemoteProxyOfflineTests::tlsHandshakeTimeout()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 9, 0)
+    QSKIP("The TLS handshake timeout requires Qt 5.9 or newer");
+#endif
+
+    m_configuration->setHandshakeTimeout(500);
+
+    // Start the server
+    startServer();
+
+    // A client which connects and never starts the handshake
+    QTcpSocket silentSocket;
+    QSignalSpy silentDisconnectedSpy(&silentSocket, &QTcpSocket::disconnected);
+    silentSocket.connectToHost(QHostAddress(m_serverUrl.host()), static_cast<quint16>(m_serverUrl.port()));
+    QTRY_COMPARE(silentSocket.state(), QAbstractSocket::ConnectedState);
+    QTRY_COMPARE(Engine::instance()->webSocketServer()->currentStatistics().value("pendingHandshakes").toInt(), 1);
+
+    // Not closed before the timeout
+    QTest::qWait(200);
+    QCOMPARE(silentDisconnectedSpy.count(), 0);
+
+    QTRY_COMPARE_WITH_TIMEOUT(silentDisconnectedSpy.count(), 1, 2000);
+    QVariantMap tlsStatistics = Engine::instance()->webSocketServer()->currentStatistics();
+    QCOMPARE(tlsStatistics.value("handshakeFailedCount").toInt(), 1);
+    QCOMPARE(tlsStatistics.value("pendingHandshakes").toInt(), 0);
+
+    // Clients finishing the handshake in time are not affected
+    QVERIFY(!invokeApiCall("RemoteProxy.Hello").toMap().isEmpty());
+
+    // Clean up
+    stopServer();
+    m_configuration->setHandshakeTimeout(5000);
+}
+
+void RemoteProxyOfflineTests::proxyProtocolHeader_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("result");
+    QTest::addColumn<int>("headerLength");
+    QTest::addColumn<QString>("address");
+    QTest::addColumn<int>("port");
+
+    QByteArray request("GET / HTTP/1.1\r\n");
+    QByteArray signature("\r\n\r\n\0\r\nQUIT\n", 12);
+
+    QByteArray v2Ipv4 = signature + QByteArray::fromHex("2111000c" "cb007107" "7f000001" "9c40" "01bb");
+    QByteArray v2Ipv6 = signature + QByteArray::fromHex("21210024" "20010db8000000000000000000000001" "00000000000000000000000000000001" "9c40" "01bb");
+    QByteArray v2Local = signature + QByteArray::fromHex("20000000");
+    QByteArray v2Version = signature + QByteArray::fromHex("1111000c" "cb007107" "7f000001" "9c40" "01bb");
+
+    QTest::newRow("v1 TCP4") << QByteArray("PROXY TCP4 203.0.113.7 127.0.0.1 40000 443\r\n") + request << static_cast<int>(ProxyProtocolServer::HeaderResultValid) << 44 << "203.0.113.7" << 40000;
+    QTest::newRow("v1 TCP6") << QByteArray("PROXY TCP6 2001:db8::1 ::1 40000 443\r\n") << static_cast<int>(ProxyProtocolServer::HeaderResultValid) << 38 << "2001:db8::1" << 40000;
+    QTest::newRow("v1 UNKNOWN") << QByteArray("PROXY UNKNOWN\r\n") << static_cast<int>(ProxyProtocolServer::HeaderResultValid) << 15 << "" << 0;
+    QTest::newRow("v1 incomplete") << QByteArray("PROXY TCP4 203.0.11") << static_cast<int>(ProxyProtocolServer::HeaderResultIncomplete) << 0 << "" << 0;
+    QTest::newRow("v1 prefix") << QByteArray("PRO") << static_cast<int>(ProxyProtocolServer::HeaderResultIncomplete) << 0 << "" << 0;
+    QTest::newRow("v1 protocol mismatch") << QByteArray("PROXY TCP4 2001:db8::1 ::1 40000 443\r\n") << static_cast<int>(ProxyProtocolServer::HeaderResultInvalid) << 38 << "" << 0;
+    QTest::newRow("v1 invalid port") << QByteArray("PROXY TCP4 203.0.113.7 127.0.0.1 70000 443\r\n") << static_cast<int>(ProxyProtocolServer::HeaderResultInvalid) << 44 << "" << 0;
+    QTest::newRow("v1 too long") << QByteArray("PROXY ") + QByteArray(120, 'x') << static_cast<int>(ProxyProtocolServer::HeaderResultInvalid) << 0 << "" << 0;
+    QTest::newRow("v2 TCP4") << v2Ipv4 + request << static_cast<int>(ProxyProtocolServer::HeaderResultValid) << 28 << "203.0.113.7" << 40000;
+    QTest::newRow("v2 TCP6") << v2Ipv6 << static_cast<int>(ProxyProtocolServer::HeaderResultValid) << 52 << "2001:db8::1" << 40000;
+    QTest::newRow("v2 LOCAL") << v2Local << static_cast<int>(ProxyProtocolServer::HeaderResultValid) << 16 << "" << 0;
+    QTest::newRow("v2 incomplete") << v2Ipv4.left(20) << static_cast<int>(ProxyProtocolServer::HeaderResultIncomplete) << 0 << "" << 0;
+    QTest::newRow("v2 invalid version") << v2Version << static_cast<int>(ProxyProtocolServer::HeaderResultInvalid) << 0 << "" << 0;
+    QTest::newRow("no header") << request << static_cast<int>(ProxyProtocolServer::HeaderResultInvalid) << 0 << "" << 0;
+}
+
+void RemoteProxyOfflineTests::proxyProtocolHeader()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, result);
+    QFETCH(int, headerLength);
+    QFETCH(QString, address);
+    QFETCH(int, port);
+
+    int parsedHeaderLength = -1;
+    QHostAddress clientAddress;
+    quint16 clientPort = 0;
+    QCOMPARE(static_cast<int>(ProxyProtocolServer::parseHeader(data, &parsedHeaderLength, &clientAddress, &clientPort)), result);
+    if (result == ProxyProtocolServer::HeaderResultIncomplete)
+        return;
+
+    QCOMPARE(parsedHeaderLength, headerLength);
+    if (result == ProxyProtocolServer::HeaderResultValid) {
+        QCOMPARE(clientAddress, address.isEmpty() ? QHostAddress() : QHostAddress(address));
+        QCOMPARE(static_cast<int>(clientPort), port);
+    }
+}
+
+void RemoteProxyOfflineTests::proxyProtocolServer()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 9, 0)
+    QSKIP("The PROXY protocol requires Qt 5.9 or newer");
+#endif
+
+    m_configuration->setPlainWebSocketServerEnabled(true);
+    m_configuration->setPlainWebSocketServerPort(1216);
+    m_configuration->setTrustedProxies(QStringList() << "127.0.0.0/8");
+    m_configuration->setProxyHeaderTimeout(500);
+
+    // Start the server
+    startServer();
+    QVERIFY(Engine::instance()->plainWebSocketServer());
+    QVERIFY(Engine::instance()->plainWebSocketServer()->running());
+
+    QByteArray upgradeRequest("GET / HTTP/1.1\r\n"
+                              "Host: 127.0.0.1:1216\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                              "Sec-WebSocket-Version: 13\r\n\r\n");
+
+    // The client address of the header gets used
+    QTcpSocket proxiedSocket;
+    proxiedSocket.connectToHost(QHostAddress::LocalHost, 1216);
+    QTRY_COMPARE(proxiedSocket.state(), QAbstractSocket::ConnectedState);
+    proxiedSocket.write("PROXY TCP4 203.0.113.7 127.0.0.1 40000 1216\r\n" + upgradeRequest);
+
+    QByteArray response;
+    QTRY_VERIFY((response += proxiedSocket.readAll()).contains("\r\n\r\n"));
+    QVERIFY(response.startsWith("HTTP/1.1 101"));
+
+    QTRY_COMPARE(Engine::instance()->proxyServer()->currentStatistics().value("clientCount").toInt(), 1);
+    QVariantMap clientMap = Engine::instance()->proxyServer()->currentStatistics().value("clients").toList().first().toMap();
+    QCOMPARE(clientMap.value("address").toString(), QString("203.0.113.7"));
+
+    // Connections without a header get closed
+    QTcpSocket plainSocket;
+    QSignalSpy plainDisconnectedSpy(&plainSocket, &QTcpSocket::disconnected);
+    plainSocket.connectToHost(QHostAddress::LocalHost, 1216);
+    QTRY_COMPARE(plainSocket.state(), QAbstractSocket::ConnectedState);
+    plainSocket.write(upgradeRequest);
+    QTRY_COMPARE(plainDisconnectedSpy.count(), 1);
+
+    QVariantMap proxyProtocolStatistics = Engine::instance()->plainWebSocketServer()->currentStatistics();
+    QCOMPARE(proxyProtocolStatistics.value("acceptedCount").toInt(), 1);
+    QCOMPARE(proxyProtocolStatistics.value("invalidHeaderCount").toInt(), 1);
+    QCOMPARE(proxyProtocolStatistics.value("untrustedCount").toInt(), 0);
+
+    // Connections which do not complete the header in time get closed
+    QTcpSocket slowSocket;
+    QSignalSpy slowDisconnectedSpy(&slowSocket, &QTcpSocket::disconnected);
+    slowSocket.connectToHost(QHostAddress::LocalHost, 1216);
+    QTRY_COMPARE(slowSocket.state(), QAbstractSocket::ConnectedState);
+    slowSocket.write("PROXY TCP4 203.0.113.8");
+    QTRY_COMPARE(Engine::instance()->plainWebSocketServer()->currentStatistics().value("pendingConnections").toInt(), 1);
+    QTest::qWait(200);
+    QCOMPARE(slowDisconnectedSpy.count(), 0);
+    QTRY_COMPARE_WITH_TIMEOUT(slowDisconnectedSpy.count(), 1, 2000);
+
+    proxyProtocolStatistics = Engine::instance()->plainWebSocketServer()->currentStatistics();
+    QCOMPARE(proxyProtocolStatistics.value("headerTimeoutCount").toInt(), 1);
+    QCOMPARE(proxyProtocolStatistics.value("pendingConnections").toInt(), 0);
+
+    proxiedSocket.close();
+    stopServer();
+
+    // Connections from untrusted addresses get closed before reading anything
+    m_configuration->setTrustedProxies(QStringList() << "10.0.0.0/8");
+    startServer();
+
+    QTcpSocket untrustedSocket;
+    QSignalSpy untrustedDisconnectedSpy(&untrustedSocket, &QTcpSocket::disconnected);
+    untrustedSocket.connectToHost(QHostAddress::LocalHost, 1216);
+    QTRY_COMPARE(untrustedDisconnectedSpy.count(), 1);
+
+    proxyProtocolStatistics = Engine::instance()->plainWebSocketServer()->currentStatistics();
+    QCOMPARE(proxyProtocolStatistics.value("untrustedCount").toInt(), 1);
+    QCOMPARE(proxyProtocolStatistics.value("acceptedCount").toInt(), 0);
+
+    // Clean up
+    stopServer();
+    m_configuration->setPlainWebSocketServerEnabled(false);
+    m_configuration->setPlainWebSocketServerPort(8080);
+    m_configuration->setTrustedProxies(QStringList());
+    m_configuration->setProxyHeaderTimeout(5000);
+}
+
+void RemoteProxyOfflineTests::tunnelThroughput()
+{
+    // Start the server
+    startServer();
+
+    m_mockAuthenticator->setTimeoutDuration(10);
+    m_mockAuthenticator->setExpectedAuthenticationError();
+
+    RemoteProxyConnection *connectionOne = new RemoteProxyConnection(QUuid::createUuid(), "Sending client", this);
+    connect(connectionOne, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+    RemoteProxyConnection *connectionTwo = new RemoteProxyConnection(QUuid::createUuid(), "Receiving client", this);
+    connect(connectionTwo, &RemoteProxyConnection::sslErrors, this, &BaseTest::ignoreConnectionSslError);
+
+    QSignalSpy connectionOneReadySpy(connectionOne, &RemoteProxyConnection::ready);
+    QSignalSpy connectionTwoReadySpy(connectionTwo, &RemoteProxyConnection::ready);
+    QVERIFY(connectionOne->connectServer(m_serverUrl));
+    QVERIFY(connectionTwo->connectServer(m_serverUrl));
+    QTRY_COMPARE(connectionOneReadySpy.count(), 1);
+    QTRY_COMPARE(connectionTwoReadySpy.count(), 1);
+
+    QVERIFY(connectionOne->authenticate(m_testToken));
+    QVERIFY(connectionTwo->authenticate(m_testToken));
+    QTRY_COMPARE(connectionOne->state(), RemoteProxyConnection::StateRemoteConnected);
+    QTRY_COMPARE(connectionTwo->state(), RemoteProxyConnection::StateRemoteConnected);
+
+    // Pipe the payload through the TLS tunnel on loopback. Clients and server share this process and the
+    // event loop of one core, so the consumed CPU time is the cost per core for both TLS ends of each hop.
+    int messageCount = 2000;
+    QByteArray payload(4096, 'x');
+    QSignalSpy dataSpy(connectionTwo, &RemoteProxyConnection::dataReady);
+
+    QElapsedTimer timer;
+    timer.start();
+    std::clock_t cpuStart = std::clock();
+    for (int i = 0; i < messageCount; i++)
+        connectionOne->sendData(payload);
+
+    QTRY_COMPARE_WITH_TIMEOUT(dataSpy.count(), messageCount, 60000);
+    double cpuSeconds = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    double seconds = timer.nsecsElapsed() / 1000000000.0;
+    double megaBytes = static_cast<double>(messageCount) * payload.size() / (1024 * 1024);
+    qDebug() << "Tunnel throughput:" << megaBytes / seconds << "MiB/s," << megaBytes / cpuSeconds << "MiB per CPU second";
+
+    QCOMPARE(dataSpy.last().at(0).toByteArray().trimmed(), payload);
+
+    connectionOne->deleteLater();
+    connectionTwo->deleteLater();
+
+    // Clean up
+    stopServer();
+}
+
+void RemoteProxyOfflineTests::tlsProfile_data()
+{
+    QTest::addColumn<QString>("profile");
+    QTest::addColumn<QString>("certificate");
+    QTest::addColumn<QString>("certificateKey");
+
+    QTest::newRow("default RSA") << "default" << ":/test-certificate.crt" << ":/test-certificate.key";
+    QTest::newRow("default ECDSA") << "default" << ":/test-certificate-ecdsa.crt" << ":/test-certificate-ecdsa.key";
+    QTest::newRow("modern RSA") << "modern" << ":/test-certificate.crt" << ":/test-certificate.key";
+    QTest::newRow("modern ECDSA") << "modern" << ":/test-certificate-ecdsa.crt" << ":/test-certificate-ecdsa.key";
+    QTest::newRow("strict RSA") << "strict" << ":/test-certificate.crt" << ":/test-certificate.key";
+    QTest::newRow("strict ECDSA") << "strict" << ":/test-certificate-ecdsa.crt" << ":/test-certificate-ecdsa.key";
+}
+
+void RemoteProxyOfflineTests::tlsProfile()
+{
+    QFETCH(QString, profile);
+    QFETCH(QString, certificate);
+    QFETCH(QString, certificateKey);
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 12, 0)
+    if (profile == "strict")
+        QSKIP("The strict SSL profile requires Qt 5.12 or newer");
+#endif
+
+    QTemporaryDir temporaryDir;
+    QVERIFY(temporaryDir.isValid());
+    QString configurationFileName = temporaryDir.path() + "/nymea-remoteproxy.conf";
+    QVERIFY(QFile::copy(":/test-configuration.conf", configurationFileName));
+    QVERIFY(QFile::setPermissions(configurationFileName, QFile::ReadOwner | QFile::WriteOwner));
+    {
+        QSettings settings(configurationFileName, QSettings::IniFormat);
+        settings.setValue("SSL/profile", profile);
+        settings.setValue("SSL/certificate", certificate);
+        settings.setValue("SSL/certificateKey", certificateKey);
+    }
+    QVERIFY(m_configuration->loadConfiguration(configurationFileName));
+    QVERIFY(!m_configuration->sslConfiguration().privateKey().isNull());
+    QCOMPARE(m_configuration->sslConfiguration().privateKey().algorithm(), m_configuration->sslConfiguration().localCertificate().publicKey().algorithm());
+
+    if (profile != "default") {
+        foreach (const QSslCipher &cipher, m_configuration->sslConfiguration().ciphers())
+            QVERIFY2(cipher.name().contains("GCM") || cipher.name().contains("CHACHA20"), qUtf8Printable(cipher.name()));
+
+        QVERIFY(!m_configuration->sslConfiguration().ellipticCurves().isEmpty());
+        QSslEllipticCurve x25519 = QSslEllipticCurve::fromShortName("X25519");
+        if (x25519.isValid())
+            QCOMPARE(m_configuration->sslConfiguration().ellipticCurves().first(), x25519);
+    }
+
+    // Start the server
+    startServer();
+
+    // The client gets the configured certificate and protocol
+    QSslSocket socket;
+    socket.setPeerVerifyMode(QSslSocket::VerifyNone);
+    QSignalSpy encryptedSpy(&socket, &QSslSocket::encrypted);
+    socket.connectToHostEncrypted(m_serverUrl.host(), static_cast<quint16>(m_serverUrl.port()));
+    QVERIFY(encryptedSpy.wait());
+    QCOMPARE(socket.peerCertificate(), m_configuration->sslConfiguration().localCertificate());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    if (profile == "strict")
+        QCOMPARE(socket.sessionProtocol(), QSsl::TlsV1_3);
+#endif
+    qDebug() << "Negotiated" << socket.sessionCipher().name() << "with" << socket.sessionCipher().protocolString();
+    socket.abort();
+
+    // Measure full handshakes, the server does not resume sessions
+    QBENCHMARK {
+        QSslSocket benchmarkSocket;
+        benchmarkSocket.setPeerVerifyMode(QSslSocket::VerifyNone);
+        QSignalSpy benchmarkEncryptedSpy(&benchmarkSocket, &QSslSocket::encrypted);
+        benchmarkSocket.connectToHostEncrypted(m_serverUrl.host(), static_cast<quint16>(m_serverUrl.port()));
+        QVERIFY(benchmarkEncryptedSpy.wait());
+        benchmarkSocket.abort();
+    }
+
+    // Clean up
+    stopServer();
+    QVERIFY(m_configuration->loadConfiguration(":/test-configuration.conf"));
+}
+
+void RemoteProxyOfflineTests::rateLimiterBuckets()
+{
+    RateLimiter rateLimiter;
+
+    // Disabled limits allow everything and track nothing
+    for (int i = 0; i < 100; i++)
+        QVERIFY(rateLimiter.allowConnection(QHostAddress("192.0.2.1")));
+    QCOMPARE(rateLimiter.count(), 0);
+
+    // Per address
+    rateLimiter.setConnectionLimit(0.001, 3);
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("192.0.2.1")));
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("192.0.2.1")));
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("192.0.2.1")));
+    QVERIFY(!rateLimiter.allowConnection(QHostAddress("192.0.2.1")));
+    QVERIFY(!rateLimiter.allowConnection(QHostAddress("::ffff:192.0.2.1")));
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("192.0.2.2")));
+    QCOMPARE(rateLimiter.currentStatistics().value("rejectedConnectionCount").toInt(), 2);
+
+    // Per subnet
+    rateLimiter.clear();
+    rateLimiter.setConnectionLimit(0, 0);
+    rateLimiter.setSubnetConnectionLimit(0.001, 2);
+    rateLimiter.setSubnetPrefixLengths(24, 64);
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("198.51.100.1")));
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("198.51.100.2")));
+    QVERIFY(!rateLimiter.allowConnection(QHostAddress("198.51.100.3")));
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("198.51.101.1")));
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("2001:db8:0:1::1")));
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("2001:db8:0:1:ffff::2")));
+    QVERIFY(!rateLimiter.allowConnection(QHostAddress("2001:db8:0:1::3")));
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("2001:db8:0:2::1")));
+    QCOMPARE(rateLimiter.currentStatistics().value("rejectedSubnetConnectionCount").toInt(), 2);
+    QCOMPARE(rateLimiter.currentStatistics().value("subnetBuckets").toInt(), 4);
+
+    // Calls have their own buckets
+    rateLimiter.setCallLimit(0.001, 1);
+    QVERIFY(rateLimiter.allowCall(QHostAddress("198.51.100.1")));
+    QVERIFY(!rateLimiter.allowCall(QHostAddress("198.51.100.1")));
+    QVERIFY(rateLimiter.allowCall(QHostAddress("198.51.100.2")));
+    QCOMPARE(rateLimiter.currentStatistics().value("rejectedCallCount").toInt(), 1);
+
+    // The buckets refill and expire once they are full again
+    rateLimiter.clear();
+    rateLimiter.setSubnetConnectionLimit(0, 0);
+    rateLimiter.setCallLimit(0, 0);
+    rateLimiter.setConnectionLimit(10, 1);
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("192.0.2.1")));
+    QVERIFY(!rateLimiter.allowConnection(QHostAddress("192.0.2.1")));
+    QTest::qWait(150);
+    QVERIFY(rateLimiter.allowConnection(QHostAddress("192.0.2.1")));
+    QCOMPARE(rateLimiter.count(), 1);
+    QTest::qWait(150);
+    rateLimiter.expire();
+    QCOMPARE(rateLimiter.count(), 0);
+
+    // The number of buckets stays bounded
+    rateLimiter.setMaximumSize(10);
+    for (int i = 1; i <= 20; i++)
+        QVERIFY(rateLimiter.allowConnection(QHostAddress(QString("203.0.113.%1").arg(i))));
+    QCOMPARE(rateLimiter.count(), 10);
+    QCOMPARE(rateLimiter.currentStatistics().value("evictionCount").toInt(), 10);
+}
+
+void RemoteProxyOfflineTests::rateLimitConnections()
+{
+    m_configuration->setConnectionRate(0.001);
+    m_configuration->setConnectionBurst(2);
+
+    // Start the server
+    startServer();
+
+    QList<QWebSocket *> sockets;
+    for (int i = 0; i < 2; i++) {
+        QWebSocket *socket = new QWebSocket("rate-limit-testclient", QWebSocketProtocol::Version13, this);
+        connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+        QSignalSpy connectedSpy(socket, &QWebSocket::connected);
+        socket->open(m_serverUrl);
+        QTRY_COMPARE(connectedSpy.count(), 1);
+        sockets.append(socket);
+    }
+
+    // The third connection from this address gets closed before the TLS handshake
+    QWebSocket *rejectedSocket = new QWebSocket("rate-limit-testclient", QWebSocketProtocol::Version13, this);
+    connect(rejectedSocket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+    QSignalSpy rejectedConnectedSpy(rejectedSocket, &QWebSocket::connected);
+    QSignalSpy rejectedDisconnectedSpy(rejectedSocket, &QWebSocket::disconnected);
+    rejectedSocket->open(m_serverUrl);
+    QTRY_COMPARE(rejectedDisconnectedSpy.count(), 1);
+    sockets.append(rejectedSocket);
+
+    QVariantMap rateLimitStatistics = Engine::instance()->rateLimiter()->currentStatistics();
+    QCOMPARE(rateLimitStatistics.value("rejectedConnectionCount").toInt(), 1);
+    QCOMPARE(rateLimitStatistics.value("connectionBuckets").toInt(), 1);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    QCOMPARE(rejectedConnectedSpy.count(), 0);
+    QCOMPARE(Engine::instance()->webSocketServer()->currentStatistics().value("handshakeCount").toInt(), 2);
+    QCOMPARE(Engine::instance()->webSocketServer()->currentStatistics().value("handshakeFailedCount").toInt(), 0);
+#endif
+
+    qDeleteAll(sockets);
+
+    // Clean up
+    stopServer();
+    m_configuration->setConnectionRate(0);
+    m_configuration->setConnectionBurst(20);
+}
+
+void RemoteProxyOfflineTests::rateLimitCalls()
+{
+    m_configuration->setCallRate(0.001);
+    m_configuration->setCallBurst(2);
+
+    // Start the server
+    startServer();
+
+    QWebSocket *socket = new QWebSocket("rate-limit-testclient", QWebSocketProtocol::Version13, this);
+    connect(socket, &QWebSocket::sslErrors, this, &BaseTest::sslErrors);
+    QSignalSpy connectedSpy(socket, &QWebSocket::connected);
+    QSignalSpy disconnectedSpy(socket, &QWebSocket::disconnected);
+    QSignalSpy dataSpy(socket, &QWebSocket::textMessageReceived);
+    socket->open(m_serverUrl);
+    QTRY_COMPARE(connectedSpy.count(), 1);
+
+    // Unauthenticated calls beyond the burst close the connection
+    for (int i = 0; i < 3; i++) {
+        QVariantMap request;
+        request.insert("id", i);
+        request.insert("method", "RemoteProxy.Hello");
+        socket->sendTextMessage(QString(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact)));
+    }
+
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+    QCOMPARE(dataSpy.count(), 2);
+    QCOMPARE(Engine::instance()->rateLimiter()->currentStatistics().value("rejectedCallCount").toInt(), 1);
+
+    // Clean up
+    socket->deleteLater();
+    stopServer();
+    m_configuration->setCallRate(0);
+    m_configuration->setCallBurst(20);
+}
+
 QTEST_MAIN(RemoteProxyOfflineTests)
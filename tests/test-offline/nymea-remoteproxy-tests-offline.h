@@ -79,6 +79,44 @@ private slots:
     void inactiveTimeout();
     void authenticationReplyTimeout();
     void authenticationReplyConnection();
+    void authenticationScheduler();
+    void authenticationSchedulerDisconnect();
+    void tokenDatabase();
+    void negativeAuthenticationCache();
+    void awsBatchAuthentication();
+    void awsCredentialRefresh();
+    void jsonValidator();
+    void authenticationConnect();
+    void earlyData();
+    void multiplexedTunnels();
+    void standbyPool();
+    void tunnelResumption();
+    void sessionTickets();
+
+    void clusterRendezvous();
+    void clusterRedirect();
+
+    void socketHandover();
+    void socketHandoverFailed();
+    void drainMode();
+
+    void reloadConfiguration();
+    void tlsHandshakeStatistics();
+    void tlsHandshakeThreads();
+    void tlsHandshakeTimeout();
+
+    void proxyProtocolHeader_data();
+    void proxyProtocolHeader();
+    void proxyProtocolServer();
+
+    void tunnelThroughput();
+
+    void tlsProfile_data();
+    void tlsProfile();
+
+    void rateLimiterBuckets();
+    void rateLimitConnections();
+    void rateLimitCalls();
 
 };
 
@@ -39,10 +39,13 @@
 
 #include "jsonrpc/jsontypes.h"
 #include "mockauthenticator.h"
+#include "mockauthorizerserver.h"
 #include "proxyconfiguration.h"
 #include "remoteproxyconnection.h"
 #include "authentication/aws/awsauthenticator.h"
 #include "authentication/dummy/dummyauthenticator.h"
+#include "authentication/authenticationcache.h"
+#include "authentication/tokendatabase/tokendatabaseauthenticator.h"
 
 using namespace remoteproxy;
 using namespace remoteproxyclient;
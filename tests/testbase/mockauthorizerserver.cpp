@@ -0,0 +1,192 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "mockauthorizerserver.h"
+
+#include <QDateTime>
+#include <QJsonDocument>
+
+MockAuthorizerServer::MockAuthorizerServer(QObject *parent) :
+    QTcpServer(parent)
+{
+    connect(this, &QTcpServer::newConnection, this, &MockAuthorizerServer::onNewConnection);
+    listen(QHostAddress::LocalHost);
+}
+
+QUrl MockAuthorizerServer::url() const
+{
+    QUrl url;
+    url.setScheme("http");
+    url.setHost(serverAddress().toString());
+    url.setPort(serverPort());
+    return url;
+}
+
+QUrl MockAuthorizerServer::credentialsUrl() const
+{
+    QUrl credentialsUrl = url();
+    credentialsUrl.setPath("/latest/meta-data/iam/security-credentials/test-role");
+    return credentialsUrl;
+}
+
+int MockAuthorizerServer::invocationCount() const
+{
+    return m_invocationCount;
+}
+
+QList<int> MockAuthorizerServer::batchSizes() const
+{
+    return m_batchSizes;
+}
+
+void MockAuthorizerServer::setCredentialsLifetime(int credentialsLifetime)
+{
+    m_credentialsLifetime = credentialsLifetime;
+}
+
+void MockAuthorizerServer::setCredentialsFailing(bool credentialsFailing)
+{
+    m_credentialsFailing = credentialsFailing;
+}
+
+QList<qint64> MockAuthorizerServer::credentialsRequestTimes() const
+{
+    return m_credentialsRequestTimes;
+}
+
+QVariantMap MockAuthorizerServer::createResult(const QVariantMap &request) const
+{
+    QString token = request.value("token").toString();
+
+    QVariantMap result;
+    result.insert("isValid", token.startsWith("valid"));
+    if (token.startsWith("valid")) {
+        QVariantMap verifiedParsedToken;
+        verifiedParsedToken.insert("email", token + "@example.com");
+        verifiedParsedToken.insert("cognito:username", token);
+
+        QVariantMap verifiedData;
+        verifiedData.insert("vendorId", "test-vendor");
+        verifiedData.insert("userPoolId", "test-pool");
+        verifiedData.insert("verifiedParsedToken", verifiedParsedToken);
+        result.insert("verifiedData", verifiedData);
+    }
+
+    return result;
+}
+
+void MockAuthorizerServer::processRequest(QTcpSocket *socket, const QByteArray &method, const QByteArray &path, const QByteArray &body)
+{
+    if (method == "GET" && path == credentialsUrl().path()) {
+        m_credentialsRequestTimes.append(QDateTime::currentMSecsSinceEpoch());
+        if (m_credentialsFailing) {
+            sendResponse(socket, QByteArray(), "500 Internal Server Error");
+            return;
+        }
+
+        QVariantMap credentials;
+        credentials.insert("Code", "Success");
+        credentials.insert("AccessKeyId", "test-access-key");
+        credentials.insert("SecretAccessKey", "test-secret-access-key");
+        credentials.insert("Token", "test-session-token");
+        credentials.insert("LastUpdated", QDateTime::currentDateTimeUtc().toString("yyyy-MM-ddThh:mm:ssZ"));
+        credentials.insert("Expiration", QDateTime::currentDateTimeUtc().addSecs(m_credentialsLifetime).toString("yyyy-MM-ddThh:mm:ssZ"));
+        sendResponse(socket, QJsonDocument::fromVariant(credentials).toJson(QJsonDocument::Compact));
+        return;
+    }
+
+    m_invocationCount++;
+
+    QVariant request = QJsonDocument::fromJson(body).toVariant();
+    if (request.type() == QVariant::List) {
+        QVariantList results;
+        foreach (const QVariant &entry, request.toList()) {
+            results.append(createResult(entry.toMap()));
+        }
+        m_batchSizes.append(results.count());
+        sendResponse(socket, QJsonDocument::fromVariant(results).toJson(QJsonDocument::Compact));
+    } else {
+        m_batchSizes.append(1);
+        sendResponse(socket, QJsonDocument::fromVariant(createResult(request.toMap())).toJson(QJsonDocument::Compact));
+    }
+}
+
+void MockAuthorizerServer::sendResponse(QTcpSocket *socket, const QByteArray &body, const QByteArray &status)
+{
+    QByteArray response = "HTTP/1.1 " + status + "\r\n";
+    response.append("Content-Type: application/json\r\n");
+    response.append("Content-Length: " + QByteArray::number(body.size()) + "\r\n");
+    response.append("Connection: close\r\n\r\n");
+    response.append(body);
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+void MockAuthorizerServer::onNewConnection()
+{
+    while (hasPendingConnections()) {
+        QTcpSocket *socket = nextPendingConnection();
+        connect(socket, &QTcpSocket::readyRead, this, &MockAuthorizerServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket](){
+            m_buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MockAuthorizerServer::onReadyRead()
+{
+    QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+    QByteArray &buffer = m_buffers[socket];
+    buffer.append(socket->readAll());
+
+    int headerEnd = buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0)
+        return;
+
+    QList<QByteArray> headerLines = buffer.left(headerEnd).split('\n');
+    QList<QByteArray> requestLine = headerLines.takeFirst().trimmed().split(' ');
+    if (requestLine.count() < 2) {
+        socket->disconnectFromHost();
+        return;
+    }
+
+    int contentLength = 0;
+    foreach (const QByteArray &headerLine, headerLines) {
+        int separator = headerLine.indexOf(':');
+        if (headerLine.left(separator).trimmed().toLower() == "content-length") {
+            contentLength = headerLine.mid(separator + 1).trimmed().toInt();
+        }
+    }
+
+    if (buffer.size() < headerEnd + 4 + contentLength)
+        return;
+
+    QByteArray body = buffer.mid(headerEnd + 4, contentLength);
+    buffer.clear();
+    processRequest(socket, requestLine.at(0), requestLine.at(1), body);
+}
@@ -0,0 +1,76 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MOCKAUTHORIZERSERVER_H
+#define MOCKAUTHORIZERSERVER_H
+
+#include <QUrl>
+#include <QHash>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+// Minimal HTTP stand-in for the AWS credentials endpoint and the authorizer lambda function.
+// Tokens starting with "valid" are accepted.
+class MockAuthorizerServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit MockAuthorizerServer(QObject *parent = nullptr);
+
+    QUrl url() const;
+    QUrl credentialsUrl() const;
+
+    int invocationCount() const;
+    QList<int> batchSizes() const;
+
+    // Lifetime of the served credentials in seconds, failing answers with an internal server error
+    void setCredentialsLifetime(int credentialsLifetime);
+    void setCredentialsFailing(bool credentialsFailing);
+
+    // Milliseconds since epoch of each credentials request
+    QList<qint64> credentialsRequestTimes() const;
+
+private:
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    int m_invocationCount = 0;
+    QList<int> m_batchSizes;
+    int m_credentialsLifetime = 3600;
+    bool m_credentialsFailing = false;
+    QList<qint64> m_credentialsRequestTimes;
+
+    QVariantMap createResult(const QVariantMap &request) const;
+    void processRequest(QTcpSocket *socket, const QByteArray &method, const QByteArray &path, const QByteArray &body);
+    void sendResponse(QTcpSocket *socket, const QByteArray &body, const QByteArray &status = "200 OK");
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+};
+
+#endif // MOCKAUTHORIZERSERVER_H
@@ -13,8 +13,10 @@ LIBS += -L$$top_builddir/libnymea-remoteproxy/ -lnymea-remoteproxy \
 HEADERS += \
     $${PWD}/basetest.h \
     $${PWD}/mockauthenticator.h \
+    $${PWD}/mockauthorizerserver.h \
 
 SOURCES += \
     $${PWD}/basetest.cpp \
     $${PWD}/mockauthenticator.cpp \
+    $${PWD}/mockauthorizerserver.cpp \
 
@@ -0,0 +1,139 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+*  Copyright 2013 - 2020, nymea GmbH
+*  Contact: contact@nymea.io
+*
+*  This file is part of nymea.
+*  This project including source code and documentation is protected by copyright law, and
+*  remains the property of nymea GmbH. All rights, including reproduction, publication,
+*  editing and translation, are reserved. The use of this project is subject to the terms of a
+*  license agreement to be concluded with nymea GmbH in accordance with the terms
+*  of use of nymea GmbH, available under https://nymea.io/license
+*
+*  GNU General Public License Usage
+*  Alternatively, this project may be redistributed and/or modified under
+*  the terms of the GNU General Public License as published by the Free Software Foundation,
+*  GNU version 3. this project is distributed in the hope that it will be useful, but WITHOUT ANY
+*  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+*  PURPOSE. See the GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License along with this project.
+*  If not, see <https://www.gnu.org/licenses/>.
+*
+*  For any further details and any questions please contact us under contact@nymea.io
+*  or see our FAQ/Licensing Information on https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QFile>
+#include <QHash>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+
+#include <stdio.h>
+
+#include "authentication/tokendatabase/tokendatabase.h"
+
+using namespace remoteproxy;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("nymea-remoteproxy-tokendb");
+    application.setOrganizationName("nymea");
+    application.setApplicationVersion(SERVER_VERSION_STRING);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.setApplicationDescription(QString("\nThe nymea remote proxy token database tool. This tool creates the token database "
+                                             "for the token database authenticator from a CSV file.\n\n"
+                                             "Each CSV line has the format: token,email,cognitoUsername,vendorId,userPoolId\n"
+                                             "Empty lines and lines starting with # will be ignored.\n\n"
+                                             "Version: %1\n"
+                                             "API version: %2\n\n"
+                                             "Copyright %3 2020 nymea GmbH <contact@nymea.io>\n")
+                                     .arg(SERVER_VERSION_STRING)
+                                     .arg(API_VERSION_STRING)
+                                     .arg(QChar(0xA9)));
+
+    QCommandLineOption inputOption(QStringList() << "i" << "input", "The CSV file containing the tokens and user information.", "csv");
+    parser.addOption(inputOption);
+
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "The token database file to create. An existing database will be replaced atomically.", "database");
+    parser.addOption(outputOption);
+
+    QCommandLineOption verifyOption(QStringList() << "verify", "Verify the given token database file and print information about it.", "database");
+    parser.addOption(verifyOption);
+
+    parser.process(application);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (parser.isSet(verifyOption)) {
+        TokenDatabase database;
+        QElapsedTimer timer;
+        timer.start();
+        if (!database.open(parser.value(verifyOption))) {
+            err << "Invalid token database: " << database.errorString() << endl;
+            return 1;
+        }
+
+        out << "Token database " << database.fileName() << " is valid (" << timer.elapsed() << " ms)" << endl;
+        out << "  Entries: " << database.entryCount() << endl;
+        out << "  Buckets: " << database.bucketCount() << endl;
+        return 0;
+    }
+
+    if (!parser.isSet(inputOption) || !parser.isSet(outputOption)) {
+        err << "Please specify the input CSV file and the output database file." << endl;
+        parser.showHelp(1);
+    }
+
+    QFile csvFile(parser.value(inputOption));
+    if (!csvFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        err << "Could not open " << csvFile.fileName() << ": " << csvFile.errorString() << endl;
+        return 1;
+    }
+
+    QHash<QByteArray, UserInformation> entries;
+    int lineNumber = 0;
+    while (!csvFile.atEnd()) {
+        QString line = QString::fromUtf8(csvFile.readLine()).trimmed();
+        lineNumber++;
+        if (line.isEmpty() || line.startsWith("#"))
+            continue;
+
+        QStringList columns = line.split(",");
+        if (columns.count() < 2 || columns.at(0).trimmed().isEmpty()) {
+            err << "Invalid line " << lineNumber << " in " << csvFile.fileName() << endl;
+            return 1;
+        }
+
+        // Skip the optional header line
+        if (lineNumber == 1 && columns.at(0).trimmed() == "token")
+            continue;
+
+        while (columns.count() < 5)
+            columns.append(QString());
+
+        QByteArray tokenHash = TokenDatabase::hashToken(columns.at(0).trimmed());
+        if (entries.contains(tokenHash))
+            err << "Warning: duplicated token on line " << lineNumber << endl;
+
+        entries.insert(tokenHash, UserInformation(columns.at(1).trimmed(), columns.at(2).trimmed(), columns.at(3).trimmed(), columns.at(4).trimmed()));
+    }
+
+    QString errorString;
+    if (!TokenDatabase::writeDatabase(parser.value(outputOption), entries, &errorString)) {
+        err << "Could not write token database " << parser.value(outputOption) << ": " << errorString << endl;
+        return 1;
+    }
+
+    out << "Created token database " << parser.value(outputOption) << " with " << entries.count() << " tokens." << endl;
+    return 0;
+}